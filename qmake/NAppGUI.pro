@@ -45,6 +45,7 @@ SOURCES += \
     ../src/core/clock.c \
     ../src/core/date.c \
     ../src/core/dbind.c \
+    ../src/core/hashtab.c \
     ../src/core/heap.c \
     ../src/core/hfile.c \
     ../src/core/keybuf.c \
@@ -60,6 +61,7 @@ SOURCES += \
     ../src/draw2d/btext.c \
     ../src/draw2d/color.c \
     ../src/draw2d/dctx.c \
+    ../src/draw2d/extcache.c \
     ../src/draw2d/font.c \
     ../src/draw2d/guicontext.c \
     ../src/draw2d/higram.c \
@@ -94,6 +96,7 @@ SOURCES += \
     ../src/osapp/osapp.c \
     ../src/osbs/log.c \
     ../src/osbs/bsocket.c \
+    ../src/osbs/bpool.c \
     ../src/osgui/osguictx.c \
     ../src/sewer/blib.c \
     ../src/sewer/bmem.c \
@@ -117,6 +120,9 @@ HEADERS +=  \
     ../src/core/date.h \
     ../src/core/dbind.h \
     ../src/core/event.h \
+    ../src/core/hashpt.h \
+    ../src/core/hashst.h \
+    ../src/core/hashtab.h \
     ../src/core/heap.h \
     ../src/core/hfile.h \
     ../src/core/keybuf.h \
@@ -190,6 +196,7 @@ HEADERS +=  \
     ../src/osapp/osmain.h \
     ../src/osbs/bfile.h \
     ../src/osbs/bmutex.h \
+    ../src/osbs/bpool.h \
     ../src/osbs/bproc.h \
     ../src/osbs/bthread.h \
     ../src/osbs/btime.h \
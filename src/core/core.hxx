@@ -221,13 +221,17 @@ typedef struct _buffer_t Buffer;
 typedef struct _keybuf_t KeyBuf;
 typedef struct _clock_t Clock;
 typedef struct _event_t Event;
+typedef struct _hashtab_t HashTab;
 typedef struct _listener_t Listener;
 typedef struct _rbtree_t RBTree;
+typedef struct _rbiter_t RBIter;
 typedef const char_t* ResId;
 typedef struct _respack ResPack;
 typedef struct _regex RegEx;
+typedef struct _regexit_t RegExIt;
 typedef struct _stream_t Stream;
 typedef struct _string_t String;
+typedef struct _strbuf_t StrBuf;
 typedef struct _direntry_t DirEntry;
 typedef struct _evfiledir_t EvFileDir;
 
@@ -236,10 +240,14 @@ typedef struct _evfiledir_t EvFileDir;
 #define ARRPT           "ArrPt::"
 #define SETST           "SetSt::"
 #define SETPT           "SetPt::"
+#define HASHST          "HashSt::"
+#define HASHPT          "HashPt::"
 #define ArrPt(type)     struct Arr##Pt##type
 #define ArrSt(type)     struct Arr##St##type
 #define SetPt(type)     struct Set##Pt##type
 #define SetSt(type)     struct Set##St##type
+#define HashPt(type)    struct Hash##Pt##type
+#define HashSt(type)    struct Hash##St##type
 
 typedef void(*FPtr_remove)(void *obj);
 #define FUNC_CHECK_REMOVE(func, type)\
@@ -289,24 +297,40 @@ struct _evfiledir_t
     uint32_t depth;
 };
 
+/* External tree iterator (can live in the stack). Red-Black height <= 2 * log2(n + 1) */
+struct _rbiter_t
+{
+    const RBTree *tree;
+    bool_t isptr;
+    uint32_t size;
+    void *path[64];
+};
+
 #include "array.h"
 #include "rbtree.h"
+#include "hashtab.h"
 #include "arrst.hxx"
 #include "arrpt.hxx"
 #include "setst.hxx"
 #include "setpt.hxx"
+#include "hashst.hxx"
+#include "hashpt.hxx"
 
 #define DeclSt(type)\
     ArrStDebug(type);\
     SetStDebug(type);\
+    HashStDebug(type);\
     ArrStFuncs(type);\
-    SetStFuncs(type)
+    SetStFuncs(type);\
+    HashStFuncs(type)
 
 #define DeclPt(type)\
     ArrPtDebug(type);\
     SetPtDebug(type);\
+    HashPtDebug(type);\
     ArrPtFuncs(type);\
-    SetPtFuncs(type)
+    SetPtFuncs(type);\
+    HashPtFuncs(type)
 
 DeclSt(bool_t);
 DeclSt(int8_t);
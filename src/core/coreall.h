@@ -22,6 +22,7 @@
 #include "bmath.h"
 #include "bmem.h"
 #include "bmutex.h"
+#include "bpool.h"
 #include "bproc.h"
 #include "bthread.h"
 #include "btime.h"
@@ -37,11 +38,14 @@
 #include "buffer.h"
 #include "date.h"
 #include "dbind.h"
+#include "hashpt.h"
+#include "hashst.h"
 #include "clock.h"
 #include "event.h"
 #include "heap.h"
 #include "hfile.h"
 #include "keybuf.h"
+#include "logbin.h"
 #include "respack.h"
 #include "regex.h"
 #include "setpt.h"
@@ -13,10 +13,13 @@
 #include "dbind.h"
 #include "dbind.inl"
 #include "tfilter.inl"
+#include "osbs.h"
 #include "arrpt.h"
 #include "arrst.h"
 #include "bmath.h"
+#include "bhash.h"
 #include "bmem.h"
+#include "bmutex.h"
 #include "bstd.h"
 #include "buffer.h"
 #include "cassert.h"
@@ -27,8 +30,35 @@
 #include "strings.h"
 
 typedef union i_attr_t i_Attr;
+typedef struct i_index_t i_Index;
+typedef struct i_op_t i_Op;
+typedef struct i_plan_t i_Plan;
 typedef struct i_databind_t i_DataBind;
 
+/* Name hash -> array position. Open addressing, zero hash means empty slot */
+struct i_index_t
+{
+    uint32_t capacity;
+    uint32_t *hashes;
+    uint32_t *positions;
+};
+
+/* Serialization step. NULL member means a raw memory block */
+struct i_op_t
+{
+    uint16_t offset;
+    uint16_t size;
+    DBind *member;
+};
+
+/* Compiled member list. Contiguous POD members are merged in single blocks */
+struct i_plan_t
+{
+    bool_t pod;
+    ArrSt(i_Op) *ops;
+    ArrSt(i_Op) *checks;
+};
+
 union i_attr_t
 {
     struct _bool_
@@ -113,6 +143,8 @@ struct _stbind_t
     FPtr_write func_write;
     FPtr_destroy func_destroy;
     ArrSt(DBind) *members;
+    i_Index mindex;
+    i_Plan *plan;
 };
 
 struct _enumvbind_t
@@ -132,6 +164,12 @@ struct i_databind_t
 {
     ArrPt(StBind) *stbinds;
     ArrPt(EnumBind) *ebinds;
+    i_Index tindex;
+    i_Index eindex;
+    /* Plans are compiled on demand, maybe from several threads */
+    Mutex *plan_mutex;
+    /* Reset plans could still be running in other threads */
+    ArrPt(i_Plan) *old_plans;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -140,6 +178,8 @@ DeclSt(EnumVBind);
 DeclPt(EnumBind);
 DeclSt(DBind);
 DeclPt(StBind);
+DeclSt(i_Op);
+DeclPt(i_Plan);
 
 //struct StBindData{ StBind elem[1024];};struct ArrStStBind{ uint32_t reserved; uint32_t size; uint16_t elem_sizeof; struct StBindData *content;}; struct ArrStStBind;inline struct ArrStStBind* arrst_StBind_create(const uint16_t esize){ return (struct ArrStStBind*)array_create(esize, (const char_t*)("ArrSt::""StBind"));}inline struct ArrStStBind* arrst_StBind_copy(const struct ArrStStBind *array, void(func_copy)(StBind*, const StBind*)){ return (struct ArrStStBind*)array_copy((Array*)array, (FPtr_scopy)func_copy, (const char_t*)("ArrSt::""StBind"));}inline struct ArrStStBind* arrst_StBind_read(Stream *stream, const uint16_t esize, void(func_read)(Stream*, StBind*)){ return (struct ArrStStBind*)array_read(stream, esize, (FPtr_read_init)func_read, (const char_t*)("ArrSt::""StBind"));}inline void arrst_StBind_destroy(struct ArrStStBind **array, void(func_remove)(StBind*)){ array_destroy((Array**)array, (FPtr_remove)func_remove, (const char_t*)("ArrSt::""StBind"));}inline void arrst_StBind_destopt(struct ArrStStBind **array, void(func_remove)(StBind*)){ array_destopt((Array**)array, (FPtr_remove)func_remove, (const char_t*)("ArrSt::""StBind"));}inline void arrst_StBind_clear(struct ArrStStBind *array, void(func_remove)(StBind*)){ array_clear((Array*)array, (FPtr_remove)func_remove);}inline void arrst_StBind_write(Stream *stream, const struct ArrStStBind *array, void(func_write)(Stream*, const StBind*)){ array_write(stream, (const Array*)array, (FPtr_write)func_write);}inline uint32_t arrst_StBind_size(const struct ArrStStBind *array){ return array_size((const Array*)array);}inline StBind *arrst_StBind_get(struct ArrStStBind *array, const uint32_t pos){ return (StBind*)array_get((Array*)array, pos);}inline const StBind *arrst_StBind_get_const(const struct ArrStStBind *array, const uint32_t pos){ return (const StBind*)array_get((Array*)array, pos);}inline StBind *arrst_StBind_last(struct ArrStStBind *array){ return (StBind*)array_get_last((Array*)array);}inline const StBind *arrst_StBind_last_const(const struct ArrStStBind *array){ return (const StBind*)array_get_last((const Array*)array);}inline StBind *arrst_StBind_all(struct ArrStStBind *array){ return (StBind*)array_all((Array*)array);}inline const StBind *arrst_StBind_all_const(const struct ArrStStBind *array){ return (const StBind*)array_all((Array*)array);}inline StBind *arrst_StBind_insert(struct ArrStStBind *array, const uint32_t pos, const uint32_t n){ return (StBind*)array_insert((Array*)array, pos, n);}inline StBind *arrst_StBind_insert0(struct ArrStStBind *array, const uint32_t pos, const uint32_t n){ return (StBind*)array_insert0((Array*)array, pos, n);}inline void arrst_StBind_join(struct ArrStStBind *dest, const struct ArrStStBind *src, void(func_copy)(StBind*, const StBind*)){ array_join((Array*)dest, (const Array*)src, (FPtr_scopy)func_copy);}inline void arrst_StBind_delete(struct ArrStStBind *array, const uint32_t pos, void(func_remove)(StBind*)){ array_delete((Array*)array, pos, 1, (FPtr_remove)func_remove);}inline void arrst_StBind_pop(struct ArrStStBind *array, void(func_remove)(StBind*)){ array_pop((Array*)array, (FPtr_remove)func_remove);}inline void arrst_StBind_sort(struct ArrStStBind *array, int(func_compare)(const StBind*, const StBind*)){ array_sort((Array*)array, (FPtr_compare)func_compare);}inline void arrst_StBind_sort_ex(struct ArrStStBind *array, FPtr_compare_ex func_compare, void *data){ array_sort_ex((Array*)array, func_compare, data);}inline StBind* arrst_StBind_search(struct ArrStStBind *array, FPtr_compare func_compare, const void *key, uint32_t *pos){ return (StBind*)array_search((Array*)array, func_compare, key, pos);}inline const StBind* arrst_StBind_search_const(const struct ArrStStBind *array, FPtr_compare func_compare, const void *key, uint32_t *pos){ return (const StBind*)array_search((Array*)array, func_compare, key, pos);}inline StBind* arrst_StBind_bsearch(struct ArrStStBind *array, FPtr_compare func_compare, const void *key, uint32_t *pos){ return (StBind*)array_bsearch((Array*)array, func_compare, key, pos);}inline const StBind* arrst_StBind_bsearch_const(const struct ArrStStBind *array, FPtr_compare func_compare, const void *key, uint32_t *pos){ return (const StBind*)array_bsearch((Array*)array, func_compare, key, pos);}inline void arrst_StBind_end(void);
 //struct DBindData{ DBind elem[1024];};
@@ -186,12 +226,141 @@ static void i_remove_object(byte_t *data, const StBind *stbind, const uint16_t s
 static void i_destroy_object(byte_t **data, const StBind *stbind, const uint16_t size);
 static void i_write_value(Stream *stm, DBind *dbind, dtype_t type, const char_t *subtype, const void *data);
 static bool_t i_read_value(Stream *stm, DBind *dbind, dtype_t type, const char_t *subtype, void *data);
-static i_DataBind i_DATABIND = { 0, 0 };
+static i_DataBind i_DATABIND = { 0, 0, { 0, 0, 0 }, { 0, 0, 0 }, 0 };
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint32_t i_name_hash(const char_t *name)
+{
+    return bhash_from_block((const byte_t*)name, str_len_c(name)) | 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_index_remove(i_Index *index)
+{
+    cassert_no_null(index);
+    if (index->capacity > 0)
+    {
+        heap_delete_n(&index->hashes, index->capacity, uint32_t);
+        heap_delete_n(&index->positions, index->capacity, uint32_t);
+        index->capacity = 0;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_index_add(i_Index *index, const char_t *name, const uint32_t position)
+{
+    uint32_t hash = i_name_hash(name);
+    uint32_t mask, i;
+    cassert_no_null(index);
+    mask = index->capacity - 1;
+    i = hash & mask;
+    while (index->hashes[i] != 0)
+        i = (i + 1) & mask;
+    index->hashes[i] = hash;
+    index->positions[i] = position;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Rebuilt at registration time, array positions change with inserts */
+static void i_index_init(i_Index *index, const uint32_t n)
+{
+    uint32_t capacity = 8;
+    cassert_no_null(index);
+    while (capacity < n * 2)
+        capacity <<= 1;
+
+    if (capacity != index->capacity)
+    {
+        i_index_remove(index);
+        index->hashes = heap_new_n(capacity, uint32_t);
+        index->positions = heap_new_n(capacity, uint32_t);
+        index->capacity = capacity;
+    }
+
+    bmem_zero_n(index->hashes, capacity, uint32_t);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Next array position with the same hash, UINT32_MAX if none */
+static uint32_t i_index_next(const i_Index *index, const uint32_t hash, uint32_t *slot)
+{
+    uint32_t mask, i;
+    cassert_no_null(index);
+    cassert_no_null(slot);
+    if (index->capacity == 0)
+        return UINT32_MAX;
+
+    mask = index->capacity - 1;
+    i = *slot == UINT32_MAX ? hash & mask : (*slot + 1) & mask;
+    while (index->hashes[i] != 0)
+    {
+        if (index->hashes[i] == hash)
+        {
+            *slot = i;
+            return index->positions[i];
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return UINT32_MAX;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_index_stbinds(void)
+{
+    i_index_init(&i_DATABIND.tindex, arrpt_size(i_DATABIND.stbinds, StBind));
+    arrpt_foreach(bind, i_DATABIND.stbinds, StBind)
+        i_index_add(&i_DATABIND.tindex, tc(bind->type), bind_i);
+    arrpt_end();
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_index_ebinds(void)
+{
+    i_index_init(&i_DATABIND.eindex, arrpt_size(i_DATABIND.ebinds, EnumBind));
+    arrpt_foreach(bind, i_DATABIND.ebinds, EnumBind)
+        i_index_add(&i_DATABIND.eindex, tc(bind->type), bind_i);
+    arrpt_end();
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_index_members(StBind *stbind)
+{
+    cassert_no_null(stbind);
+    i_index_init(&stbind->mindex, arrst_size(stbind->members, DBind));
+    arrst_foreach(member, stbind->members, DBind)
+        i_index_add(&stbind->mindex, tc(member->name), member_i);
+    arrst_end();
+}
 
 /*---------------------------------------------------------------------------*/
 
 static StBind *i_find_stbind(const char_t *type, uint32_t *index)
 {
+    /* Lookup, not insertion point */
+    if (index == NULL)
+    {
+        uint32_t hash = i_name_hash(type);
+        uint32_t slot = UINT32_MAX, pos;
+        while ((pos = i_index_next(&i_DATABIND.tindex, hash, &slot)) != UINT32_MAX)
+        {
+            StBind *bind = arrpt_get(i_DATABIND.stbinds, pos, StBind);
+            if (str_equ(bind->type, type) == TRUE)
+                return bind;
+        }
+
+        return NULL;
+    }
+
     arrpt_foreach(bind, i_DATABIND.stbinds, StBind)
         int compare = str_cmp(bind->type, type);
         if (compare == 0)
@@ -214,6 +383,20 @@ static StBind *i_find_stbind(const char_t *type, uint32_t *index)
 
 static EnumBind *i_find_enum(const char_t *type, uint32_t *index)
 {
+    if (index == NULL)
+    {
+        uint32_t hash = i_name_hash(type);
+        uint32_t slot = UINT32_MAX, pos;
+        while ((pos = i_index_next(&i_DATABIND.eindex, hash, &slot)) != UINT32_MAX)
+        {
+            EnumBind *bind = arrpt_get(i_DATABIND.ebinds, pos, EnumBind);
+            if (str_equ(bind->type, type) == TRUE)
+                return bind;
+        }
+
+        return NULL;
+    }
+
     arrpt_foreach(bind, i_DATABIND.ebinds, EnumBind)
         int compare = str_cmp(bind->type, type);
         if (compare == 0)
@@ -304,12 +487,45 @@ static void i_remove_member(DBind *member)
 
 /*---------------------------------------------------------------------------*/
 
+static void i_plan_destroy(i_Plan **plan)
+{
+    cassert_no_null(plan);
+    cassert_no_null(*plan);
+    arrst_destroy(&(*plan)->ops, NULL, i_Op);
+    arrst_destroy(&(*plan)->checks, NULL, i_Op);
+    heap_delete(plan, i_Plan);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Plans inline nested structs and point to members, any change invalidates all.
+ * Readers use the plan out of the mutex, so old plans live until '_dbind_finish'.
+ */
+static void i_plans_reset(void)
+{
+    bmutex_lock(i_DATABIND.plan_mutex);
+    arrpt_foreach(bind, i_DATABIND.stbinds, StBind)
+        if (bind->plan != NULL)
+        {
+            arrpt_append(i_DATABIND.old_plans, bind->plan, i_Plan);
+            bind->plan = NULL;
+        }
+    arrpt_end();
+    bmutex_unlock(i_DATABIND.plan_mutex);
+}
+
+/*---------------------------------------------------------------------------*/
+
 /* DBind destruction may depends on other StBind */
 static void i_remove_stbind(StBind *stbind)
 {
     cassert_no_null(stbind);
     if (stbind->members != NULL)
         arrst_destroy(&stbind->members, i_remove_member, DBind);
+    if (stbind->plan != NULL)
+        i_plan_destroy(&stbind->plan);
+    i_index_remove(&stbind->mindex);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -351,6 +567,8 @@ void _dbind_start(void)
     {
         i_DATABIND.stbinds = arrpt_create(StBind);
         i_DATABIND.ebinds = arrpt_create(EnumBind);
+        i_DATABIND.plan_mutex = bmutex_create();
+        i_DATABIND.old_plans = arrpt_create(i_Plan);
     }
 }
 
@@ -366,6 +584,10 @@ void _dbind_finish(void)
         arrpt_destroy(&i_DATABIND.stbinds, i_destroy_stbind, StBind);
 
         arrpt_destroy(&i_DATABIND.ebinds, i_destroy_enumbind, EnumBind);
+        i_index_remove(&i_DATABIND.tindex);
+        i_index_remove(&i_DATABIND.eindex);
+        bmutex_close(&i_DATABIND.plan_mutex);
+        arrpt_destroy(&i_DATABIND.old_plans, i_plan_destroy, i_Plan);
     }
 }
 
@@ -681,6 +903,7 @@ static StBind *i_stbind(const char_t *type, const uint16_t size)
         stbind->type = str_c(type);
         stbind->size = size;
         stbind->members = arrst_create(DBind);
+        i_index_stbinds();
     }
 
     return stbind;
@@ -709,6 +932,8 @@ static void i_add_member(StBind *stbind, const char_t *mname, const char_t *mtyp
             member->name = str_c(mname);
             member->offset = moffset;
             member->size = msize;
+            i_index_members(stbind);
+            i_plans_reset();
 
             switch (member->type) {
             case ekDTYPE_BOOL:
@@ -959,6 +1184,7 @@ static EnumBind *i_enum_bind(const char_t *type)
         ebind->type = str_c(type);
         ebind->values = arrst_create(EnumVBind);
         arrpt_insert(i_DATABIND.ebinds, index, ebind, EnumBind);
+        i_index_ebinds();
     }
 
     return ebind;
@@ -1036,6 +1262,7 @@ void dbind_opaque_imp(
     stbind->func_read = func_read;
     stbind->func_write = func_write;
     stbind->func_destroy = func_destroy;
+    i_index_stbinds();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -1623,15 +1850,291 @@ void dbind_destopt_imp(byte_t **data, const char_t *type)
 
 /*---------------------------------------------------------------------------*/
 
+/* Values whose stream image is a plain memory copy (native endian) */
+static bool_t i_pod_type(const dtype_t type, const uint16_t size)
+{
+    switch (type) {
+    case ekDTYPE_BOOL:
+    case ekDTYPE_INT8:
+    case ekDTYPE_INT16:
+    case ekDTYPE_INT32:
+    case ekDTYPE_INT64:
+    case ekDTYPE_UINT8:
+    case ekDTYPE_UINT16:
+    case ekDTYPE_UINT32:
+    case ekDTYPE_UINT64:
+    case ekDTYPE_REAL32:
+    case ekDTYPE_REAL64:
+        return TRUE;
+
+    case ekDTYPE_ENUM:
+        return (bool_t)(size == sizeof(int32_t));
+
+    case ekDTYPE_STRING:
+    case ekDTYPE_STRING_PTR:
+    case ekDTYPE_ARRAY:
+    case ekDTYPE_ARRPTR:
+    case ekDTYPE_OBJECT:
+    case ekDTYPE_OBJECT_PTR:
+    case ekDTYPE_OBJECT_OPAQUE:
+        return FALSE;
+
+    case ekDTYPE_UNKNOWN:
+    cassert_default();
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_plan_block(ArrSt(i_Op) *ops, const uint16_t offset, const uint16_t size)
+{
+    i_Op *op = arrst_size(ops, i_Op) > 0 ? arrst_last(ops, i_Op) : NULL;
+    if (op != NULL && op->member == NULL && op->offset + op->size == offset)
+    {
+        op->size = (uint16_t)(op->size + size);
+    }
+    else
+    {
+        op = arrst_new(ops, i_Op);
+        op->offset = offset;
+        op->size = size;
+        op->member = NULL;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static const i_Plan *i_plan_imp(StBind *stbind);
+
+/*---------------------------------------------------------------------------*/
+
+static void i_plan_members(const StBind *stbind, const uint16_t base, ArrSt(i_Op) *ops, ArrSt(i_Op) *checks)
+{
+    cassert_no_null(stbind);
+    arrst_foreach(member, stbind->members, DBind)
+        uint16_t offset = (uint16_t)(base + member->offset);
+        if (member->type == ekDTYPE_OBJECT && i_plan_imp(member->attr.object.stbind)->pod == TRUE)
+        {
+            i_plan_members(member->attr.object.stbind, offset, ops, checks);
+        }
+        else if (i_pod_type(member->type, member->size) == TRUE)
+        {
+            i_plan_block(ops, offset, member->size);
+            /* Blocks skip the read filters, they are applied later */
+            if (member->type == ekDTYPE_BOOL || member->type == ekDTYPE_REAL32 || member->type == ekDTYPE_REAL64)
+            {
+                i_Op *check = arrst_new(checks, i_Op);
+                check->offset = offset;
+                check->size = member->size;
+                check->member = member;
+            }
+        }
+        else
+        {
+            i_Op *op = arrst_new(ops, i_Op);
+            op->offset = offset;
+            op->size = member->size;
+            op->member = member;
+        }
+    arrst_end();
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Compiled on first (de)serialization of the type */
+static const i_Plan *i_plan_imp(StBind *stbind)
+{
+    cassert_no_null(stbind);
+    cassert_no_null(stbind->members);
+    if (stbind->plan == NULL)
+    {
+        i_Plan *plan = heap_new(i_Plan);
+        const i_Op *op = NULL;
+        plan->ops = arrst_create(i_Op);
+        plan->checks = arrst_create(i_Op);
+        i_plan_members(stbind, 0, plan->ops, plan->checks);
+        if (arrst_size(plan->ops, i_Op) == 1)
+            op = arrst_get_const(plan->ops, 0, i_Op);
+        plan->pod = (bool_t)(op != NULL && op->member == NULL && op->offset == 0 && op->size == stbind->size);
+        stbind->plan = plan;
+    }
+
+    return stbind->plan;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* The plan is shared by all the threads that (de)serialize the type */
+static const i_Plan *i_plan(StBind *stbind)
+{
+    const i_Plan *plan = NULL;
+    bmutex_lock(i_DATABIND.plan_mutex);
+    plan = i_plan_imp(stbind);
+    bmutex_unlock(i_DATABIND.plan_mutex);
+    return plan;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE bool_t i_native_write(const Stream *stm)
+{
+    return (bool_t)(stm_get_write_endian(stm) == osbs_endian());
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE bool_t i_native_read(const Stream *stm)
+{
+    return (bool_t)(stm_get_read_endian(stm) == osbs_endian());
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_write_plan(Stream *stm, const byte_t *object, const i_Plan *plan)
+{
+    cassert_no_null(plan);
+    arrst_foreach_const(op, plan->ops, i_Op)
+        if (op->member == NULL)
+            stm_write(stm, object + op->offset, op->size);
+        else
+            i_write_value(stm, op->member, op->member->type, i_subtype_str(op->member), (const void*)(object + op->offset));
+    arrst_end();
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Same filters that i_read_value applies to individual values */
+static void i_plan_checks(byte_t *object, const i_Plan *plan)
+{
+    cassert_no_null(plan);
+    arrst_foreach_const(check, plan->checks, i_Op)
+        byte_t *data = object + check->offset;
+        switch (check->member->type) {
+        case ekDTYPE_BOOL:
+            if (*data != 0 && *data != 1)
+            {
+                log_printf("Error reading boolean.");
+                *((bool_t*)data) = FALSE;
+            }
+            break;
+
+        case ekDTYPE_REAL32:
+            *((real32_t*)data) = _dbind_real32(check->member, *((real32_t*)data));
+            break;
+
+        case ekDTYPE_REAL64:
+            *((real64_t*)data) = _dbind_real64(check->member, *((real64_t*)data));
+            break;
+
+        case ekDTYPE_INT8:
+        case ekDTYPE_INT16:
+        case ekDTYPE_INT32:
+        case ekDTYPE_INT64:
+        case ekDTYPE_UINT8:
+        case ekDTYPE_UINT16:
+        case ekDTYPE_UINT32:
+        case ekDTYPE_UINT64:
+        case ekDTYPE_ENUM:
+        case ekDTYPE_STRING:
+        case ekDTYPE_STRING_PTR:
+        case ekDTYPE_ARRAY:
+        case ekDTYPE_ARRPTR:
+        case ekDTYPE_OBJECT:
+        case ekDTYPE_OBJECT_PTR:
+        case ekDTYPE_OBJECT_OPAQUE:
+        case ekDTYPE_UNKNOWN:
+        cassert_default();
+        }
+    arrst_end();
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_read_plan(Stream *stm, byte_t *object, const i_Plan *plan)
+{
+    bool_t ok = TRUE;
+    cassert_no_null(plan);
+    arrst_foreach_const(op, plan->ops, i_Op)
+        if (op->member == NULL)
+        {
+            stm_read(stm, object + op->offset, op->size);
+            ok &= (bool_t)(stm_state(stm) == ekSTOK);
+        }
+        else
+        {
+            ok &= i_read_value(stm, op->member, op->member->type, i_subtype_str(op->member), (void*)(object + op->offset));
+        }
+    arrst_end();
+    i_plan_checks(object, plan);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static bool_t i_read_array(Stream *stm, dtype_t type, const char_t *subtype, Array *array)
 {
     bool_t ok = TRUE;
     uint32_t i, n = stm_read_u32(stm);
-    for (i = 0; i < n; ++i)
+    const i_Plan *plan = NULL;
+    bool_t pod = FALSE;
+    if (n > 0 && i_native_read(stm) == TRUE)
+    {
+        if (type == ekDTYPE_OBJECT)
+        {
+            plan = i_plan(i_find_stbind(subtype, NULL));
+            pod = plan->pod;
+        }
+        else
+        {
+            pod = i_pod_type(type, array_esize(array));
+        }
+    }
+
+    if (pod == TRUE)
+    {
+        /* The whole array in a single block */
+        uint32_t es = array_esize(array);
+        byte_t *obj = NULL;
+        /* Corrupted or hostile size */
+        if (n > UINT32_MAX / es)
+        {
+            log_printf("Error reading array: Too many elements (%u).", n);
+            return FALSE;
+        }
+
+        obj = array_insert(array, UINT32_MAX, n);
+        stm_read(stm, obj, n * es);
+        ok = (bool_t)(stm_state(stm) == ekSTOK);
+        if (plan != NULL)
+        {
+            for (i = 0; i < n; ++i, obj += es)
+                i_plan_checks(obj, plan);
+        }
+        else if (type == ekDTYPE_BOOL)
+        {
+            for (i = 0; i < n; ++i)
+            {
+                if (obj[i] != 0 && obj[i] != 1)
+                {
+                    log_printf("Error reading boolean.");
+                    obj[i] = FALSE;
+                }
+            }
+        }
+    }
+    else
     {
-        byte_t *obj = array_insert(array, UINT32_MAX, 1);
-        dbind_init_imp(obj, subtype);
-        ok &= i_read_value(stm, NULL, type, subtype, obj);
+        for (i = 0; i < n; ++i)
+        {
+            byte_t *obj = array_insert(array, UINT32_MAX, 1);
+            dbind_init_imp(obj, subtype);
+            if (plan != NULL)
+                ok &= i_read_plan(stm, obj, plan);
+            else
+                ok &= i_read_value(stm, NULL, type, subtype, obj);
+        }
     }
 
     return ok;
@@ -1670,12 +2173,19 @@ static bool_t i_read_object(Stream *stm, const char_t *type, void *object)
     {
         StBind *stbind = i_find_stbind(type, NULL);
         cassert_msg(stbind != NULL, "DBind: Unknown struct type.");
-        arrst_foreach(member, stbind->members, DBind)
-            dtype_t mtype = member->type;
-            const char_t *mstype = i_subtype_str(member);
-            uint16_t moffset = member->offset;
-            ok &= i_read_value(stm, member, mtype, mstype, (void*)((byte_t*)object + moffset));
-        arrst_end();
+        if (i_native_read(stm) == TRUE)
+        {
+            ok = i_read_plan(stm, (byte_t*)object, i_plan(stbind));
+        }
+        else
+        {
+            arrst_foreach(member, stbind->members, DBind)
+                dtype_t mtype = member->type;
+                const char_t *mstype = i_subtype_str(member);
+                uint16_t moffset = member->offset;
+                ok &= i_read_value(stm, member, mtype, mstype, (void*)((byte_t*)object + moffset));
+            arrst_end();
+        }
     }
 
     return ok;
@@ -1989,12 +2499,19 @@ static void i_write_object(Stream *stm, const void *object, const char_t *type)
     {
         StBind *stbind = i_find_stbind(type, NULL);
         cassert_msg(stbind != NULL, "DBind: Unknown struct type.");
-        arrst_foreach(member, stbind->members, DBind)
-            dtype_t mtype = member->type;
-            const char_t *mstype = i_subtype_str(member);
-            uint16_t moffset = member->offset;
-            i_write_value(stm, member, mtype, mstype, (const void*)((byte_t*)object + moffset));
-        arrst_end();
+        if (i_native_write(stm) == TRUE)
+        {
+            i_write_plan(stm, (const byte_t*)object, i_plan(stbind));
+        }
+        else
+        {
+            arrst_foreach(member, stbind->members, DBind)
+                dtype_t mtype = member->type;
+                const char_t *mstype = i_subtype_str(member);
+                uint16_t moffset = member->offset;
+                i_write_value(stm, member, mtype, mstype, (const void*)((byte_t*)object + moffset));
+            arrst_end();
+        }
     }
 }
 
@@ -2057,9 +2574,37 @@ static void i_write_array(Stream *stm, const Array *array, const char_t *type)
         String *subtype = NULL;
         dtype_t atype = i_data_type(type, &subtype, NULL);
         const char_t *stype = subtype != NULL ? tc(subtype) : NULL;
+        const i_Plan *plan = NULL;
+        bool_t pod = FALSE;
+        if (n > 0 && i_native_write(stm) == TRUE)
+        {
+            if (atype == ekDTYPE_OBJECT)
+            {
+                plan = i_plan(i_find_stbind(stype, NULL));
+                pod = plan->pod;
+            }
+            else
+            {
+                pod = i_pod_type(atype, (uint16_t)es);
+            }
+        }
+
         stm_write_u32(stm, n);
-        for (i = 0; i < n; ++i, data += es)
-            i_write_value(stm, NULL, atype, stype, (const void*)data);
+        if (pod == TRUE)
+        {
+            stm_write(stm, data, n * es);
+        }
+        else if (plan != NULL)
+        {
+            for (i = 0; i < n; ++i, data += es)
+                i_write_plan(stm, data, plan);
+        }
+        else
+        {
+            for (i = 0; i < n; ++i, data += es)
+                i_write_value(stm, NULL, atype, stype, (const void*)data);
+        }
+
         str_destopt(&subtype);
     }
     else
@@ -2193,12 +2738,18 @@ void dbind_write_imp(Stream *stm, const void *data, const char_t *type)
 
 /*---------------------------------------------------------------------------*/
 
-static DBind *i_find_by_name(ArrSt(DBind) *members, const char_t *name)
+static DBind *i_find_by_name(StBind *stbind, const char_t *name)
 {
-    arrst_foreach(member, members, DBind)
-        if (str_equ_c(tc(member->name), name) == TRUE)
+    uint32_t hash = i_name_hash(name);
+    uint32_t slot = UINT32_MAX, pos;
+    cassert_no_null(stbind);
+    while ((pos = i_index_next(&stbind->mindex, hash, &slot)) != UINT32_MAX)
+    {
+        DBind *member = arrst_get(stbind->members, pos, DBind);
+        if (str_equ(member->name, name) == TRUE)
             return member;
-    arrst_end();
+    }
+
     return NULL;
 }
 
@@ -2209,7 +2760,7 @@ static DBind *i_member(const char_t *type, const char_t *name)
     StBind *stbind = i_find_stbind(type, NULL);
     if (stbind == NULL)
         return NULL;
-    return i_find_by_name(stbind->members, name);
+    return i_find_by_name(stbind, name);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,72 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: hashpt.h
+ *
+ */
+
+/* Hash tables of pointers */
+/* Keys are plain memory blocks of 'ktype' (hashed by 'bhash_from_block') */
+
+#define hashpt_create(ktype, type)\
+    hashpt_##type##_create((uint16_t)sizeof(ktype), (uint16_t)sizeof(type*))
+
+#define hashpt_destroy(hash, func_destroy, type)\
+    hashpt_##type##_destroy(hash, func_destroy)
+
+#define hashpt_size(hash, type)\
+    hashpt_##type##_size(hash)
+
+#define hashpt_get(hash, key, type)\
+    hashpt_##type##_get(hash, key)
+
+#define hashpt_get_const(hash, key, type)\
+    hashpt_##type##_get_const(hash, key)
+
+#define hashpt_insert(hash, key, value, type)\
+    hashpt_##type##_insert(hash, key, value)
+
+#define hashpt_delete(hash, key, func_destroy, type)\
+    hashpt_##type##_delete(hash, key, func_destroy)
+
+#define hashpt_next(hash, pos, type)\
+    hashpt_##type##_next(hash, pos)
+
+#define hashpt_next_const(hash, pos, type)\
+    hashpt_##type##_next_const(hash, pos)
+
+#define hashpt_key(hash, pos, type)\
+    hashpt_##type##_key(hash, pos)
+
+#define hashpt_foreach(elem, hash, type)\
+    {\
+        uint32_t elem##_pos = 0;\
+        register uint32_t elem##_i = 0, elem##_total = hashpt_size(hash, type);\
+        register type *elem = hashpt_next(hash, &elem##_pos, type);\
+        while (elem != NULL)\
+        {
+
+#define hashpt_foreach_const(elem, hash, type)\
+    {\
+        uint32_t elem##_pos = 0;\
+        register uint32_t elem##_i = 0, elem##_total = hashpt_size(hash, type);\
+        register const type *elem = hashpt_next_const(hash, &elem##_pos, type);\
+        while (elem != NULL)\
+        {
+
+#define hashpt_fornext(elem, hash, type)\
+            elem = hashpt_next(hash, &elem##_pos, type);\
+            elem##_i += 1;\
+            unref(elem##_total);\
+        }\
+    }
+
+#define hashpt_fornext_const(elem, hash, type)\
+            elem = hashpt_next_const(hash, &elem##_pos, type);\
+            elem##_i += 1;\
+            unref(elem##_total);\
+        }\
+    }
@@ -0,0 +1,89 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: hashpt.hxx
+ *
+ */
+
+/* Hash table macros for type checking at compile time */
+
+#define HashPtDebug(type)\
+struct Hash##Pt##type\
+{\
+    uint32_t elems;\
+    uint32_t capacity;\
+    uint16_t ksize;\
+    uint16_t esize;\
+    uint32_t ssize;\
+    uint32_t *hashes;\
+    byte_t *slots;\
+}
+
+#define HashPtFuncs(type)\
+HashPt(type);\
+\
+static __TYPECHECK HashPt(type)* hashpt_##type##_create(const uint16_t ksize, const uint16_t esize);\
+static HashPt(type)* hashpt_##type##_create(const uint16_t ksize, const uint16_t esize)\
+{\
+    return (HashPt(type)*)hashtab_create(ksize, esize, (const char_t*)(HASHPT#type));\
+}\
+\
+static __TYPECHECK void hashpt_##type##_destroy(struct Hash##Pt##type **hash, void(func_destroy)(type**));\
+static void hashpt_##type##_destroy(struct Hash##Pt##type **hash, void(func_destroy)(type**))\
+{\
+    hashtab_destroy_ptr((HashTab**)hash, (FPtr_destroy)func_destroy, (const char_t*)(HASHPT#type));\
+}\
+\
+static __TYPECHECK uint32_t hashpt_##type##_size(const struct Hash##Pt##type *hash);\
+static uint32_t hashpt_##type##_size(const struct Hash##Pt##type *hash)\
+{\
+	return hashtab_size((const HashTab*)hash);\
+}\
+\
+static __TYPECHECK type *hashpt_##type##_get(struct Hash##Pt##type *hash, const void *key);\
+static type *hashpt_##type##_get(struct Hash##Pt##type *hash, const void *key)\
+{\
+	return (type*)hashtab_get((const HashTab*)hash, key, TRUE);\
+}\
+\
+static __TYPECHECK const type *hashpt_##type##_get_const(const struct Hash##Pt##type *hash, const void *key);\
+static const type *hashpt_##type##_get_const(const struct Hash##Pt##type *hash, const void *key)\
+{\
+	return (const type*)hashtab_get((const HashTab*)hash, key, TRUE);\
+}\
+\
+static __TYPECHECK bool_t hashpt_##type##_insert(struct Hash##Pt##type *hash, const void *key, type *value);\
+static bool_t hashpt_##type##_insert(struct Hash##Pt##type *hash, const void *key, type *value)\
+{\
+	return hashtab_insert_ptr((HashTab*)hash, key, (void*)value);\
+}\
+\
+static __TYPECHECK bool_t hashpt_##type##_delete(struct Hash##Pt##type *hash, const void *key, void(func_destroy)(type**));\
+static bool_t hashpt_##type##_delete(struct Hash##Pt##type *hash, const void *key, void(func_destroy)(type**))\
+{\
+	return hashtab_delete_ptr((HashTab*)hash, key, (FPtr_destroy)func_destroy);\
+}\
+\
+static __TYPECHECK type *hashpt_##type##_next(struct Hash##Pt##type *hash, uint32_t *pos);\
+static type *hashpt_##type##_next(struct Hash##Pt##type *hash, uint32_t *pos)\
+{\
+	return (type*)hashtab_next((const HashTab*)hash, pos, TRUE);\
+}\
+\
+static __TYPECHECK const type *hashpt_##type##_next_const(const struct Hash##Pt##type *hash, uint32_t *pos);\
+static const type *hashpt_##type##_next_const(const struct Hash##Pt##type *hash, uint32_t *pos)\
+{\
+	return (const type*)hashtab_next((const HashTab*)hash, pos, TRUE);\
+}\
+\
+static __TYPECHECK const void *hashpt_##type##_key(const struct Hash##Pt##type *hash, const uint32_t pos);\
+static const void *hashpt_##type##_key(const struct Hash##Pt##type *hash, const uint32_t pos)\
+{\
+	return hashtab_key((const HashTab*)hash, pos);\
+}\
+\
+__INLINE void hashpt_##type##_end(void)\
+
@@ -0,0 +1,73 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: hashst.h
+ *
+ */
+
+/* Hash tables of structures */
+/* Keys are plain memory blocks of 'ktype' (hashed by 'bhash_from_block') */
+/* Insertions can move the elements. Don't keep pointers after insert */
+
+#define hashst_create(ktype, type)\
+    hashst_##type##_create((uint16_t)sizeof(ktype), (uint16_t)sizeof(type))
+
+#define hashst_destroy(hash, func_remove, type)\
+    hashst_##type##_destroy(hash, func_remove)
+
+#define hashst_size(hash, type)\
+    hashst_##type##_size(hash)
+
+#define hashst_get(hash, key, type)\
+    hashst_##type##_get(hash, key)
+
+#define hashst_get_const(hash, key, type)\
+    hashst_##type##_get_const(hash, key)
+
+#define hashst_insert(hash, key, type)\
+    hashst_##type##_insert(hash, key)
+
+#define hashst_delete(hash, key, func_remove, type)\
+    hashst_##type##_delete(hash, key, func_remove)
+
+#define hashst_next(hash, pos, type)\
+    hashst_##type##_next(hash, pos)
+
+#define hashst_next_const(hash, pos, type)\
+    hashst_##type##_next_const(hash, pos)
+
+#define hashst_key(hash, pos, type)\
+    hashst_##type##_key(hash, pos)
+
+#define hashst_foreach(elem, hash, type)\
+    {\
+        uint32_t elem##_pos = 0;\
+        register uint32_t elem##_i = 0, elem##_total = hashst_size(hash, type);\
+        register type *elem = hashst_next(hash, &elem##_pos, type);\
+        while (elem != NULL)\
+        {
+
+#define hashst_foreach_const(elem, hash, type)\
+    {\
+        uint32_t elem##_pos = 0;\
+        register uint32_t elem##_i = 0, elem##_total = hashst_size(hash, type);\
+        register const type *elem = hashst_next_const(hash, &elem##_pos, type);\
+        while (elem != NULL)\
+        {
+
+#define hashst_fornext(elem, hash, type)\
+            elem = hashst_next(hash, &elem##_pos, type);\
+            elem##_i += 1;\
+            unref(elem##_total);\
+        }\
+    }
+
+#define hashst_fornext_const(elem, hash, type)\
+            elem = hashst_next_const(hash, &elem##_pos, type);\
+            elem##_i += 1;\
+            unref(elem##_total);\
+        }\
+    }
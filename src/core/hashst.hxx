@@ -0,0 +1,89 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: hashst.hxx
+ *
+ */
+
+/* Hash table macros for type checking at compile time */
+
+#define HashStDebug(type)\
+struct Hash##St##type\
+{\
+    uint32_t elems;\
+    uint32_t capacity;\
+    uint16_t ksize;\
+    uint16_t esize;\
+    uint32_t ssize;\
+    uint32_t *hashes;\
+    byte_t *slots;\
+}
+
+#define HashStFuncs(type)\
+HashSt(type);\
+\
+static __TYPECHECK HashSt(type)* hashst_##type##_create(const uint16_t ksize, const uint16_t esize);\
+static HashSt(type)* hashst_##type##_create(const uint16_t ksize, const uint16_t esize)\
+{\
+    return (HashSt(type)*)hashtab_create(ksize, esize, (const char_t*)(HASHST#type));\
+}\
+\
+static __TYPECHECK void hashst_##type##_destroy(struct Hash##St##type **hash, void(func_remove)(type*));\
+static void hashst_##type##_destroy(struct Hash##St##type **hash, void(func_remove)(type*))\
+{\
+    hashtab_destroy((HashTab**)hash, (FPtr_remove)func_remove, (const char_t*)(HASHST#type));\
+}\
+\
+static __TYPECHECK uint32_t hashst_##type##_size(const struct Hash##St##type *hash);\
+static uint32_t hashst_##type##_size(const struct Hash##St##type *hash)\
+{\
+	return hashtab_size((const HashTab*)hash);\
+}\
+\
+static __TYPECHECK type *hashst_##type##_get(struct Hash##St##type *hash, const void *key);\
+static type *hashst_##type##_get(struct Hash##St##type *hash, const void *key)\
+{\
+	return (type*)hashtab_get((const HashTab*)hash, key, FALSE);\
+}\
+\
+static __TYPECHECK const type *hashst_##type##_get_const(const struct Hash##St##type *hash, const void *key);\
+static const type *hashst_##type##_get_const(const struct Hash##St##type *hash, const void *key)\
+{\
+	return (const type*)hashtab_get((const HashTab*)hash, key, FALSE);\
+}\
+\
+static __TYPECHECK type *hashst_##type##_insert(struct Hash##St##type *hash, const void *key);\
+static type *hashst_##type##_insert(struct Hash##St##type *hash, const void *key)\
+{\
+	return (type*)hashtab_insert((HashTab*)hash, key);\
+}\
+\
+static __TYPECHECK bool_t hashst_##type##_delete(struct Hash##St##type *hash, const void *key, void(func_remove)(type*));\
+static bool_t hashst_##type##_delete(struct Hash##St##type *hash, const void *key, void(func_remove)(type*))\
+{\
+	return hashtab_delete((HashTab*)hash, key, (FPtr_remove)func_remove);\
+}\
+\
+static __TYPECHECK type *hashst_##type##_next(struct Hash##St##type *hash, uint32_t *pos);\
+static type *hashst_##type##_next(struct Hash##St##type *hash, uint32_t *pos)\
+{\
+	return (type*)hashtab_next((const HashTab*)hash, pos, FALSE);\
+}\
+\
+static __TYPECHECK const type *hashst_##type##_next_const(const struct Hash##St##type *hash, uint32_t *pos);\
+static const type *hashst_##type##_next_const(const struct Hash##St##type *hash, uint32_t *pos)\
+{\
+	return (const type*)hashtab_next((const HashTab*)hash, pos, FALSE);\
+}\
+\
+static __TYPECHECK const void *hashst_##type##_key(const struct Hash##St##type *hash, const uint32_t pos);\
+static const void *hashst_##type##_key(const struct Hash##St##type *hash, const uint32_t pos)\
+{\
+	return hashtab_key((const HashTab*)hash, pos);\
+}\
+\
+__INLINE void hashst_##type##_end(void)\
+
@@ -0,0 +1,359 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: hashtab.c
+ *
+ */
+
+/* Open addressing hash tables */
+
+#include "hashtab.h"
+#include "bhash.h"
+#include "bmem.h"
+#include "cassert.h"
+#include "heap.h"
+
+/*
+ * Linear probing with backward-shift deletion (no tombstones).
+ * Each slot stores the key (padded to pointer size) followed by the element.
+ * A zero hash means empty slot, occupied slots have the high bit set.
+ */
+
+struct _hashtab_t
+{
+    uint32_t elems;
+    uint32_t capacity;
+    uint16_t ksize;
+    uint16_t esize;
+    uint32_t ssize;
+    uint32_t *hashes;
+    byte_t *slots;
+};
+
+#define i_MIN_CAPACITY  16
+#define i_USED_BIT      0x80000000
+
+#define i_SLOT(table, i)\
+    ((table)->slots + (i) * (table)->ssize)
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint32_t i_hash(const void *key, const uint16_t ksize)
+{
+    return bhash_from_block((const byte_t*)key, (uint32_t)ksize) | i_USED_BIT;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint16_t i_align(const uint16_t size)
+{
+    return (uint16_t)((size + sizeof(void*) - 1) & ~(sizeof(void*) - 1));
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_alloc_slots(HashTab *table, const uint32_t capacity)
+{
+    cassert_no_null(table);
+    cassert((capacity & (capacity - 1)) == 0);
+    table->capacity = capacity;
+    table->hashes = heap_new_n0(capacity, uint32_t);
+    table->slots = heap_malloc(capacity * table->ssize, "HashTabSlots");
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_dealloc_slots(uint32_t **hashes, byte_t **slots, const uint32_t capacity, const uint32_t ssize)
+{
+    heap_delete_n(hashes, capacity, uint32_t);
+    heap_free(slots, capacity * ssize, "HashTabSlots");
+}
+
+/*---------------------------------------------------------------------------*/
+
+HashTab *hashtab_create(const uint16_t ksize, const uint16_t esize, const char_t *type)
+{
+    HashTab *table = (HashTab*)heap_malloc(sizeof(HashTab), type);
+    cassert(ksize > 0);
+    table->elems = 0;
+    table->ksize = ksize;
+    table->esize = esize;
+    table->ssize = (uint32_t)i_align(ksize) + (uint32_t)i_align(esize);
+    i_alloc_slots(table, i_MIN_CAPACITY);
+    return table;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_destroy_hashtab(HashTab **table, FPtr_remove func_remove, FPtr_destroy func_destroy, const char_t *type)
+{
+    cassert_no_null(table);
+    cassert_no_null(*table);
+
+    if (func_remove != NULL || func_destroy != NULL)
+    {
+        register uint32_t i, koffset = i_align((*table)->ksize);
+        for (i = 0; i < (*table)->capacity; ++i)
+        {
+            if ((*table)->hashes[i] != 0)
+            {
+                byte_t *data = i_SLOT(*table, i) + koffset;
+                if (func_remove != NULL)
+                    func_remove(data);
+                else
+                    func_destroy((void**)data);
+            }
+        }
+    }
+
+    i_dealloc_slots(&(*table)->hashes, &(*table)->slots, (*table)->capacity, (*table)->ssize);
+    heap_free((byte_t**)table, sizeof(HashTab), type);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void hashtab_destroy(HashTab **table, FPtr_remove func_remove, const char_t *type)
+{
+    i_destroy_hashtab(table, func_remove, NULL, type);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void hashtab_destroy_ptr(HashTab **table, FPtr_destroy func_destroy, const char_t *type)
+{
+    cassert_no_null(table);
+    cassert_no_null(*table);
+    cassert((*table)->esize == sizeof(void*));
+    i_destroy_hashtab(table, NULL, func_destroy, type);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t hashtab_size(const HashTab *table)
+{
+    cassert_no_null(table);
+    return table->elems;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_find(const HashTab *table, const void *key, const uint32_t hash)
+{
+    register uint32_t mask = table->capacity - 1;
+    register uint32_t i = hash & mask;
+    cassert(table->elems < table->capacity);
+    for (;;)
+    {
+        register uint32_t h = table->hashes[i];
+        if (h == 0)
+            return UINT32_MAX;
+
+        if (h == hash && bmem_cmp(i_SLOT(table, i), (const byte_t*)key, (uint32_t)table->ksize) == 0)
+            return i;
+
+        i = (i + 1) & mask;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+byte_t *hashtab_get(const HashTab *table, const void *key, const bool_t isptr)
+{
+    uint32_t i;
+    cassert_no_null(table);
+    i = i_find(table, key, i_hash(key, table->ksize));
+    if (i != UINT32_MAX)
+    {
+        byte_t *elem = i_SLOT(table, i) + i_align(table->ksize);
+        return isptr ? *((byte_t**)elem) : elem;
+    }
+
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint32_t i_empty_slot(const HashTab *table, const uint32_t hash)
+{
+    register uint32_t mask = table->capacity - 1;
+    register uint32_t i = hash & mask;
+    while (table->hashes[i] != 0)
+        i = (i + 1) & mask;
+    return i;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_grow(HashTab *table)
+{
+    uint32_t *hashes = table->hashes;
+    byte_t *slots = table->slots;
+    uint32_t capacity = table->capacity;
+    register uint32_t i;
+
+    i_alloc_slots(table, capacity << 1);
+    for (i = 0; i < capacity; ++i)
+    {
+        if (hashes[i] != 0)
+        {
+            register uint32_t j = i_empty_slot(table, hashes[i]);
+            table->hashes[j] = hashes[i];
+            bmem_copy(i_SLOT(table, j), slots + i * table->ssize, table->ssize);
+        }
+    }
+
+    i_dealloc_slots(&hashes, &slots, capacity, table->ssize);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static byte_t *i_insert(HashTab *table, const void *key)
+{
+    uint32_t hash, i;
+    byte_t *slot = NULL;
+    cassert_no_null(table);
+    hash = i_hash(key, table->ksize);
+    if (i_find(table, key, hash) != UINT32_MAX)
+        return NULL;
+
+    /* Max load factor 3/4 */
+    if ((table->elems + 1) * 4 > table->capacity * 3)
+        i_grow(table);
+
+    i = i_empty_slot(table, hash);
+    table->hashes[i] = hash;
+    table->elems += 1;
+    slot = i_SLOT(table, i);
+    bmem_copy(slot, (const byte_t*)key, (uint32_t)table->ksize);
+    return slot + i_align(table->ksize);
+}
+
+/*---------------------------------------------------------------------------*/
+
+byte_t *hashtab_insert(HashTab *table, const void *key)
+{
+    byte_t *elem = i_insert(table, key);
+    if (elem != NULL)
+        bmem_set_zero(elem, (uint32_t)table->esize);
+    return elem;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t hashtab_insert_ptr(HashTab *table, const void *key, void *ptr)
+{
+    byte_t *elem = NULL;
+    cassert_no_null(table);
+    cassert(table->esize == sizeof(void*));
+    elem = i_insert(table, key);
+    if (elem != NULL)
+    {
+        *((void**)elem) = ptr;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_remove_slot(HashTab *table, const uint32_t pos)
+{
+    register uint32_t mask = table->capacity - 1;
+    register uint32_t i = pos;
+    register uint32_t j = (pos + 1) & mask;
+
+    /* Backward-shift the following elements of the cluster */
+    while (table->hashes[j] != 0)
+    {
+        register uint32_t home = table->hashes[j] & mask;
+        register bool_t move = FALSE;
+        if (i <= j)
+            move = (bool_t)(home <= i || home > j);
+        else
+            move = (bool_t)(home <= i && home > j);
+
+        if (move == TRUE)
+        {
+            table->hashes[i] = table->hashes[j];
+            bmem_copy(i_SLOT(table, i), i_SLOT(table, j), table->ssize);
+            i = j;
+        }
+
+        j = (j + 1) & mask;
+    }
+
+    table->hashes[i] = 0;
+    table->elems -= 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t hashtab_delete(HashTab *table, const void *key, FPtr_remove func_remove)
+{
+    uint32_t i;
+    cassert_no_null(table);
+    i = i_find(table, key, i_hash(key, table->ksize));
+    if (i != UINT32_MAX)
+    {
+        if (func_remove != NULL)
+            func_remove(i_SLOT(table, i) + i_align(table->ksize));
+        i_remove_slot(table, i);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t hashtab_delete_ptr(HashTab *table, const void *key, FPtr_destroy func_destroy)
+{
+    uint32_t i;
+    cassert_no_null(table);
+    cassert(table->esize == sizeof(void*));
+    i = i_find(table, key, i_hash(key, table->ksize));
+    if (i != UINT32_MAX)
+    {
+        if (func_destroy != NULL)
+            func_destroy((void**)(i_SLOT(table, i) + i_align(table->ksize)));
+        i_remove_slot(table, i);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+byte_t *hashtab_next(const HashTab *table, uint32_t *pos, const bool_t isptr)
+{
+    register uint32_t i;
+    cassert_no_null(table);
+    cassert_no_null(pos);
+    for (i = *pos; i < table->capacity; ++i)
+    {
+        if (table->hashes[i] != 0)
+        {
+            byte_t *elem = i_SLOT(table, i) + i_align(table->ksize);
+            *pos = i + 1;
+            return isptr ? *((byte_t**)elem) : elem;
+        }
+    }
+
+    *pos = table->capacity;
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+const void *hashtab_key(const HashTab *table, const uint32_t pos)
+{
+    cassert_no_null(table);
+    cassert(pos > 0 && pos <= table->capacity);
+    cassert(table->hashes[pos - 1] != 0);
+    return (const void*)i_SLOT(table, pos - 1);
+}
@@ -0,0 +1,39 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: hashtab.h
+ *
+ */
+
+/* Open addressing hash tables */
+
+#include "core.hxx"
+
+__EXTERN_C
+
+HashTab *hashtab_create(const uint16_t ksize, const uint16_t esize, const char_t *type);
+
+void hashtab_destroy(HashTab **table, FPtr_remove func_remove, const char_t *type);
+
+void hashtab_destroy_ptr(HashTab **table, FPtr_destroy func_destroy, const char_t *type);
+
+uint32_t hashtab_size(const HashTab *table);
+
+byte_t *hashtab_get(const HashTab *table, const void *key, const bool_t isptr);
+
+byte_t *hashtab_insert(HashTab *table, const void *key);
+
+bool_t hashtab_insert_ptr(HashTab *table, const void *key, void *ptr);
+
+bool_t hashtab_delete(HashTab *table, const void *key, FPtr_remove func_remove);
+
+bool_t hashtab_delete_ptr(HashTab *table, const void *key, FPtr_destroy func_destroy);
+
+byte_t *hashtab_next(const HashTab *table, uint32_t *pos, const bool_t isptr);
+
+const void *hashtab_key(const HashTab *table, const uint32_t pos);
+
+__END_C
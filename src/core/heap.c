@@ -24,6 +24,10 @@
 typedef struct i_page_t i_Page;
 typedef struct i_memory_t i_Memory;
 
+#define SIZE_CLASS_GRAIN 8
+#define NUM_SIZE_CLASSES 32
+#define MAX_SIZE_CLASS (SIZE_CLASS_GRAIN * NUM_SIZE_CLASSES)
+
 #if defined (__MEMORY_AUDITOR__)
 
 #define OBJECT_NAME_SIZE 64
@@ -37,6 +41,7 @@ struct i_object_t
     uint64_t bytes_alloc;
     uint64_t bytes_dealloc;
     bool_t equal_sized;
+    bool_t untyped;
 };
 
 typedef struct i_access_t i_Access;
@@ -55,8 +60,10 @@ struct i_page_t
 {
     uint32_t num_allocs;
     uint32_t used_memory;
+    uint32_t idle_bytes;
     uint32_t offset;
     uint32_t mark;
+    i_Memory *memory;
     i_Page *next;
     i_Page *prev;
 };
@@ -68,6 +75,8 @@ struct i_memory_t
     uint32_t mtcount;
     uint32_t page_size;
     i_Page *current_page;
+    i_Page *slot_page;
+    i_Page *last_page;
     uint64_t num_allocs;
     uint64_t total_bytes_allocated;
     uint64_t num_deallocs;
@@ -81,6 +90,25 @@ struct i_memory_t
     uint32_t great_pages_alloc;
     uint32_t std_pages_dealloc;
     uint32_t great_pages_dealloc;
+    uint32_t pages_alive;
+    uint32_t max_pages_alive;
+    uint64_t paged_bytes;
+    uint64_t max_paged_bytes;
+
+    /* Size-class free lists (recycled slots of small blocks) */
+    bool_t size_classes;
+    byte_t *free_slots[NUM_SIZE_CLASSES];
+    uint64_t slots_recycled;
+    uint64_t slots_idle_bytes;
+    uint32_t empty_pages;
+    uint64_t empty_bytes;
+
+    /* Per-thread arenas (multi-threaded mode) */
+    uint32_t num_threads;
+    i_Memory **arenas;
+    uint32_t num_arenas;
+    uint32_t next_arena;
+    uint64_t mt_max_bytes_allocated;
 
     #if defined (__MEMORY_AUDITOR__)
     i_Object *objects;
@@ -92,6 +120,7 @@ struct i_memory_t
 /*---------------------------------------------------------------------------*/
 
 static i_Memory i_MEMORY;
+static __THREAD_LOCAL i_Memory *i_THREAD_MEMORY = NULL;
 
 #if defined (__x86__)
     #define DEFAULT_PAGE_SIZE   65536
@@ -104,43 +133,58 @@ static i_Memory i_MEMORY;
 #endif
 
 #define OBJECTS_ARRAY_GROW_SIZE 128
+#define MAX_THREAD_ARENAS 64
 static uint32_t i_PAGESIZE = DEFAULT_PAGE_SIZE;
 static bool_t i_HEAP_VERBOSE = FALSE;
 static bool_t i_HEAP_STATS = TRUE;
+static bool_t i_SIZE_CLASSES = FALSE;
 
 /*---------------------------------------------------------------------------*/
 
-static void i_init_page(i_Page *page)
+static void i_init_page(i_Page *page, i_Memory *memory)
 {
     cassert_no_null(page);
     page->num_allocs = 0;
     page->used_memory = 0;
+    page->idle_bytes = 0;
     page->offset = sizeof(i_Page);
     page->mark = 0xA16F9B0C;
+    page->memory = memory;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE bool_t i_live_page(const i_Memory *memory, const i_Page *page)
+{
+    return (bool_t)(page == memory->current_page || page == memory->slot_page);
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void i_new_page(const uint32_t page_size, i_Page **current_page, uint32_t *num_pages)
+/* New pages are added at the end of the list */
+static i_Page *i_new_page(i_Memory *memory)
 {
     i_Page *new_page = NULL;
-    cassert_no_null(current_page);
-    cassert_no_null(num_pages);
-    new_page = (i_Page*)bmem_malloc(page_size);
-    *num_pages += 1;
-    i_init_page(new_page);
+    cassert_no_null(memory);
+    new_page = (i_Page*)bmem_malloc(memory->page_size);
+    memory->std_pages_alloc += 1;
+    memory->pages_alive += 1;
+    if (memory->pages_alive > memory->max_pages_alive)
+        memory->max_pages_alive = memory->pages_alive;
+    i_init_page(new_page, memory);
     new_page->next = NULL;
-    new_page->prev = *current_page;
+    new_page->prev = memory->last_page;
 
-    if ((*current_page) != NULL)
-        (*current_page)->next = new_page;
+    if (memory->last_page != NULL)
+        memory->last_page->next = new_page;
 
-    *current_page = new_page;
+    memory->last_page = new_page;
+    return new_page;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void i_init_memory(i_Memory *memory, const uint32_t page_size)
+static void i_init_memory(i_Memory *memory, const uint32_t page_size, const bool_t size_classes)
 {
     cassert_no_null(memory);    
     /* Page size is power of 2 */
@@ -150,7 +194,8 @@ static void i_init_memory(i_Memory *memory, const uint32_t page_size)
     memory->mutex = bmutex_create();
     memory->mtcount = 0;
     memory->page_size = page_size;
-    i_new_page(memory->page_size, &memory->current_page, &memory->std_pages_alloc);
+    memory->size_classes = size_classes;
+    memory->current_page = i_new_page(memory);
 
     #if defined (__MEMORY_AUDITOR__)
     memory->objects_alloc = OBJECTS_ARRAY_GROW_SIZE;
@@ -161,14 +206,62 @@ static void i_init_memory(i_Memory *memory, const uint32_t page_size)
 
 /*---------------------------------------------------------------------------*/
 
+static void i_remove_pages(i_Memory *memory)
+{
+    i_Page *page = NULL;
+    cassert_no_null(memory);
+    /* In size-class mode, pages with idle slots can remain */
+    page = memory->last_page;
+    while (page != NULL)
+    {
+        i_Page *prev = page->prev;
+        bmem_free((byte_t*)page);
+        page = prev;
+    }
+
+    memory->current_page = NULL;
+    memory->slot_page = NULL;
+    memory->last_page = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_remove_arena(i_Memory **arena)
+{
+    cassert_no_null(arena);
+    cassert_no_null(*arena);
+    cassert((*arena)->arenas == NULL);
+    i_remove_pages(*arena);
+    bmutex_close(&(*arena)->mutex);
+
+    #if defined (__MEMORY_AUDITOR__)
+    bmem_free((byte_t*)(*arena)->objects);
+    #endif
+
+    bmem_free((byte_t*)*arena);
+    *arena = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void i_remove_memory(i_Memory *memory)
 {
     cassert_no_null(memory);
     cassert(bthread_current_id() == memory->main_thread_id);
     cassert(memory->mtcount == 0);
 
-    bmem_free((byte_t*)memory->current_page);
-    memory->current_page = NULL;
+    if (memory->arenas != NULL)
+    {
+        register uint32_t i;
+        for (i = 0; i < memory->num_arenas; ++i)
+            i_remove_arena(&memory->arenas[i]);
+
+        bmem_free((byte_t*)memory->arenas);
+        memory->arenas = NULL;
+        memory->num_arenas = 0;
+    }
+
+    i_remove_pages(memory);
     bmutex_close(&memory->mutex);
 
     #if defined (__MEMORY_AUDITOR__)
@@ -181,35 +274,247 @@ static void i_remove_memory(i_Memory *memory)
 
 /*---------------------------------------------------------------------------*/
 
-static byte_t* i_malloc(i_Memory *memory, const uint32_t size, const uint32_t align)
+static __INLINE void i_paged_bytes(i_Memory *memory, const uint32_t size, const bool_t alloc)
 {
-    byte_t *mem = NULL;
+    if (alloc == TRUE)
+    {
+        memory->paged_bytes += size;
+        if (memory->paged_bytes > memory->max_paged_bytes)
+            memory->max_paged_bytes = memory->paged_bytes;
+    }
+    else
+    {
+        cassert(memory->paged_bytes >= size);
+        memory->paged_bytes -= size;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
 
+static __INLINE uint32_t i_block_size(const i_Memory *memory, const uint32_t size)
+{
+    /* Small blocks are rounded to its size-class */
+    if (memory->size_classes == TRUE && size <= MAX_SIZE_CLASS)
+        return (size + (SIZE_CLASS_GRAIN - 1)) & ~(uint32_t)(SIZE_CLASS_GRAIN - 1);
+    else
+        return size;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_release_page(i_Memory *memory, i_Page *page)
+{
     cassert_no_null(memory);
-    cassert_no_null(memory->current_page);
+    cassert_no_null(page);
+    cassert(i_live_page(memory, page) == FALSE);
+    cassert(page->num_allocs == 0);
+    cassert(page->used_memory == 0);
+    if (page->next != NULL)
+        page->next->prev = page->prev;
+    else
+        memory->last_page = page->prev;
 
-    // Block can be stored by paged allocator
-    if (__TRUE_EXPECTED(size + align + sizeof(i_Page) + sizeof(void*) < memory->page_size))
+    if (page->prev != NULL)
+        page->prev->next = page->next;
+
+    bmem_free((byte_t*)page);
+    memory->std_pages_dealloc += 1;
+    memory->pages_alive -= 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE bool_t i_empty_page(const i_Memory *memory, const i_Page *page)
+{
+    return (bool_t)(page->num_allocs == 0 && i_live_page(memory, page) == FALSE);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Removes from the free lists the slots of pages without live blocks and
+ * releases these pages. It runs when at least half of the idle bytes are
+ * in empty pages, so its cost is amortized by the released slots.
+ */
+static void i_sweep_slots(i_Memory *memory)
+{
+    register uint32_t i;
+    i_Page *page = NULL;
+    cassert_no_null(memory);
+    for (i = 0; i < NUM_SIZE_CLASSES; ++i)
+    {
+        uint32_t size = (i + 1) * SIZE_CLASS_GRAIN;
+        byte_t **slot = &memory->free_slots[i];
+        while (*slot != NULL)
+        {
+            i_Page *spage = (i_Page*)*((void**)(*slot + size));
+            cassert(spage->mark == 0xA16F9B0C);
+            if (i_empty_page(memory, spage) == TRUE)
+            {
+                cassert(spage->idle_bytes >= size);
+                spage->idle_bytes -= size;
+                cassert(memory->slots_idle_bytes >= size);
+                memory->slots_idle_bytes -= size;
+                *slot = *((byte_t**)*slot);
+            }
+            else
+            {
+                slot = (byte_t**)*slot;
+            }
+        }
+    }
+
+    page = memory->last_page;
+    while (page != NULL)
+    {
+        i_Page *prev = page->prev;
+        if (i_empty_page(memory, page) == TRUE)
+        {
+            cassert(page->idle_bytes == 0);
+            i_release_page(memory, page);
+        }
+        page = prev;
+    }
+
+    memory->empty_pages = 0;
+    memory->empty_bytes = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_page_empty(i_Memory *memory, i_Page *page)
+{
+    cassert_no_null(memory);
+    cassert_no_null(page);
+    cassert(page->num_allocs == 0);
+
+    /* No idle slots: The page is released (or reused if current) */
+    if (page->idle_bytes == 0)
+    {
+        if (__TRUE_EXPECTED(i_live_page(memory, page) == FALSE))
+            i_release_page(memory, page);
+        else
+            i_init_page(page, memory);
+    }
+    /* The current pages keep their idle slots until they are replaced */
+    else if (i_live_page(memory, page) == FALSE)
     {
-        register uint32_t mod = memory->current_page->offset % align;
-        register uint32_t offset = memory->current_page->offset;
+        memory->empty_pages += 1;
+        memory->empty_bytes += page->idle_bytes;
+        if (memory->empty_bytes * 2 >= memory->slots_idle_bytes)
+            i_sweep_slots(memory);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint32_t i_align(const uint32_t offset, const uint32_t align)
+{
+    uint32_t mod = offset % align;
+    return mod > 0 ? offset + align - mod : offset;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Replaces a full current page (bump blocks or slots) */
+static i_Page *i_next_page(i_Memory *memory, i_Page *page)
+{
+    cassert_no_null(memory);
+    if (page != NULL && page->num_allocs == 0)
+    {
+        /* The page only keeps idle slots, it can be released from now on */
+        cassert(page->idle_bytes > 0);
+        memory->empty_pages += 1;
+        memory->empty_bytes += page->idle_bytes;
+    }
+
+    return i_new_page(memory);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static byte_t *i_page_block(i_Memory *memory, i_Page **page, const uint32_t size, const uint32_t align)
+{
+    byte_t *mem = NULL;
+    uint32_t offset = 0;
+    cassert_no_null(page);
+
+    if (*page == NULL)
+        *page = i_new_page(memory);
 
-        if (mod > 0)
-            offset += align - mod;
+    offset = i_align((*page)->offset, align);
 
-        /* Block can't be stored in current page */
-        if (offset + size + sizeof(void*) >= memory->page_size)
+    /* Block can't be stored in current page */
+    if (offset + size + sizeof(void*) >= memory->page_size)
+    {
+        *page = i_next_page(memory, *page);
+        offset = i_align((*page)->offset, align);
+    }
+
+    cassert(offset + size + sizeof(void*) < memory->page_size);
+    (*page)->num_allocs += 1;
+    (*page)->used_memory += size;
+    (*page)->offset = offset + size + (uint32_t)sizeof(void*);
+    mem = (byte_t*)*page + offset;
+    *((void**)(mem + size)) = (void*)*page;
+    return mem;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static byte_t* i_malloc(i_Memory *memory, const uint32_t block_size, const uint32_t align)
+{
+    byte_t *mem = NULL;
+    uint32_t size = 0;
+
+    cassert_no_null(memory);
+    cassert_no_null(memory->current_page);
+    size = i_block_size(memory, block_size);
+
+    /* Reuse a previously freed slot of the same size-class */
+    if (memory->size_classes == TRUE && size <= MAX_SIZE_CLASS)
+    {
+        uint32_t sclass = (size / SIZE_CLASS_GRAIN) - 1;
+        if (memory->free_slots[sclass] != NULL && ((intptr_t)memory->free_slots[sclass] % (intptr_t)align) == 0)
         {
-            i_new_page(memory->page_size, &memory->current_page, &memory->std_pages_alloc);
-            offset = memory->current_page->offset + (memory->current_page->offset % align);
+            i_Page *page = NULL;
+            mem = memory->free_slots[sclass];
+            page = (i_Page*)*((void**)(mem + size));
+            cassert(page->mark == 0xA16F9B0C);
+            memory->free_slots[sclass] = *((byte_t**)mem);
+
+            /* The page has a live block again */
+            if (i_empty_page(memory, page) == TRUE)
+            {
+                cassert(memory->empty_pages > 0);
+                cassert(memory->empty_bytes >= page->idle_bytes);
+                memory->empty_pages -= 1;
+                memory->empty_bytes -= page->idle_bytes;
+            }
+
+            cassert(page->idle_bytes >= size);
+            page->idle_bytes -= size;
+            page->num_allocs += 1;
+            page->used_memory += size;
+            memory->slots_recycled += 1;
+            cassert(memory->slots_idle_bytes >= size);
+            memory->slots_idle_bytes -= size;
+            i_paged_bytes(memory, size, TRUE);
+            return mem;
         }
 
-        cassert(offset + size + sizeof(void*) < memory->page_size);
-        memory->current_page->num_allocs += 1;
-        memory->current_page->used_memory += size;
-        memory->current_page->offset = offset + size + (uint32_t)sizeof(void*);
-        mem = (byte_t*)memory->current_page + offset;
-        *((void**)(mem + size)) = (void*)memory->current_page;
+        /*
+         * New slots are carved from their own pages. Mixed with bigger blocks,
+         * recycled slots would keep alive pages whose space can't be reused.
+         */
+        mem = i_page_block(memory, &memory->slot_page, size, align);
+        i_paged_bytes(memory, size, TRUE);
+    }
+    // Block can be stored by paged allocator
+    else if (__TRUE_EXPECTED(size + align + sizeof(i_Page) + sizeof(void*) < memory->page_size))
+    {
+        mem = i_page_block(memory, &memory->current_page, size, align);
+        i_paged_bytes(memory, size, TRUE);
     }
     /* Block needs its own allocation */
     else
@@ -224,15 +529,38 @@ static byte_t* i_malloc(i_Memory *memory, const uint32_t size, const uint32_t al
 
 /*---------------------------------------------------------------------------*/
 
-static void i_free(i_Memory *memory, byte_t *mem, const uint32_t size, const uint32_t align)
+static void i_free(i_Memory *memory, byte_t *mem, const uint32_t block_size, const uint32_t align)
 {
+    uint32_t size = 0;
     cassert_no_null(memory);
+    size = i_block_size(memory, block_size);
     
     /* Block filled with waste */
     #if defined (__ASSERTS__)
     bmem_set1(mem, size, 0x3F);
     #endif
 
+    /* Small block slot is kept in its size-class free list */
+    if (memory->size_classes == TRUE && size <= MAX_SIZE_CLASS)
+    {
+        uint32_t sclass = (size / SIZE_CLASS_GRAIN) - 1;
+        i_Page *page = (i_Page*)*((void**)(mem + size));
+        cassert(page->mark == 0xA16F9B0C);
+        cassert(page->num_allocs > 0);
+        cassert(page->used_memory >= size);
+        *((byte_t**)mem) = memory->free_slots[sclass];
+        memory->free_slots[sclass] = mem;
+        memory->slots_idle_bytes += size;
+        page->num_allocs -= 1;
+        page->used_memory -= size;
+        page->idle_bytes += size;
+        i_paged_bytes(memory, size, FALSE);
+
+        if (page->num_allocs == 0)
+            i_page_empty(memory, page);
+        return;
+    }
+
     /* Block was stored by paged allocator */
     if (__TRUE_EXPECTED(size + align + sizeof(i_Page) + sizeof(void*) < memory->page_size))
     {
@@ -243,30 +571,11 @@ static void i_free(i_Memory *memory, byte_t *mem, const uint32_t size, const uin
         cassert(page->used_memory >= size);
         page->num_allocs -= 1;
         page->used_memory -= size;
+        i_paged_bytes(memory, size, FALSE);
 
-        /* The whole page is freeded, we destroy the page */
+        /* The whole page is freeded, we destroy (or reuse) the page */
         if (page->num_allocs == 0)
-        {
-            cassert(page->used_memory == 0);
-
-            /* The page isn't the current page. Update list pointers and free. */
-            if (__TRUE_EXPECTED(page != memory->current_page))
-            {
-                cassert(page->next != NULL);
-                page->next->prev = page->prev;
-                if (page->prev != NULL)
-                    page->prev->next = page->next;
-
-                bmem_free((byte_t*)page);
-                memory->std_pages_dealloc += 1;
-            }
-            /* Page for free is current page, we can reuse it. */
-            else
-            {
-                cassert(page->next == NULL);
-                i_init_page(page);
-            }            
-        }
+            i_page_empty(memory, page);
     }
     /* Block was stored using an own block */
     else
@@ -284,8 +593,14 @@ static byte_t* i_realloc(i_Memory *memory, byte_t *prev_mem, const uint32_t size
     cassert_no_null(memory);
     cassert_no_null(memory->current_page);
 
+    /* Both sizes fit in the same size-class slot */
+    if (memory->size_classes == TRUE && size <= MAX_SIZE_CLASS && prev_size <= MAX_SIZE_CLASS
+        && i_block_size(memory, size) == i_block_size(memory, prev_size))
+    {
+        mem = prev_mem;
+    }
     /* Some of new/previous block can be/is stored in paged allocator */
-    if (__TRUE_EXPECTED((prev_size + align + sizeof(i_Page) + sizeof(void*) < memory->page_size) 
+    else if (__TRUE_EXPECTED((prev_size + align + sizeof(i_Page) + sizeof(void*) < memory->page_size) 
         || (size + align + sizeof(i_Page) + sizeof(void*) < memory->page_size)))
     {
         register uint32_t min_size;
@@ -307,15 +622,399 @@ static byte_t* i_realloc(i_Memory *memory, byte_t *prev_mem, const uint32_t size
 
 /*---------------------------------------------------------------------------*/
 
+static __INLINE i_Memory *i_block_memory(i_Memory *memory, byte_t *mem, const uint32_t size, const uint32_t align)
+{
+    cassert_no_null(memory);
+
+    /* Paged blocks must be returned to the arena that owns the page */
+    if (__TRUE_EXPECTED(size + align + sizeof(i_Page) + sizeof(void*) < memory->page_size))
+    {
+        i_Page *page = (i_Page*)*((void**)(mem + i_block_size(memory, size)));
+        cassert_no_null(page);
+        cassert(page->mark == 0xA16F9B0C);
+        cassert_no_null(page->memory);
+        return page->memory;
+    }
+    /* Great blocks don't belong to any arena */
+    else
+    {
+        return memory;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Arenas of ended threads are reused before creating new ones */
+static i_Memory *i_idle_arena(i_Memory *memory)
+{
+    register uint32_t i;
+    cassert_no_null(memory);
+    for (i = 0; i < memory->num_arenas; ++i)
+    {
+        if (memory->arenas[i]->num_threads == 0)
+        {
+            memory->arenas[i]->num_threads = 1;
+            return memory->arenas[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * The thread has ended: Its arena keeps the blocks still in use (freed later
+ * by other threads) and releases the pages without them.
+ */
+static void i_thread_end(void *data)
+{
+    i_Memory *arena = (i_Memory*)data;
+    cassert_no_null(arena);
+    bmutex_lock(arena->mutex);
+    if (arena->slot_page != NULL && arena->slot_page->num_allocs == 0)
+        arena->slot_page = NULL;
+    i_sweep_slots(arena);
+    bmutex_unlock(arena->mutex);
+
+    bmutex_lock(i_MEMORY.mutex);
+    cassert(arena->num_threads > 0);
+    arena->num_threads -= 1;
+    bmutex_unlock(i_MEMORY.mutex);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_Memory *i_thread_memory(void)
+{
+    i_Memory *memory = i_THREAD_MEMORY;
+    if (__FALSE_EXPECTED(memory == NULL))
+    {
+        /* First allocation of a secondary thread: Bind it to an arena */
+        i_Memory *arena = NULL;
+        bmutex_lock(i_MEMORY.mutex);
+        if (i_MEMORY.arenas != NULL)
+            memory = i_idle_arena(&i_MEMORY);
+        bmutex_unlock(i_MEMORY.mutex);
+
+        /* New arena is created out of the lock ('bmutex_create' uses the osbs mutex) */
+        if (memory == NULL && i_MEMORY.num_arenas < MAX_THREAD_ARENAS)
+        {
+            arena = (i_Memory*)bmem_malloc(sizeof32(i_Memory));
+            i_init_memory(arena, i_MEMORY.page_size, i_MEMORY.size_classes);
+        }
+
+        if (memory == NULL)
+        {
+            bmutex_lock(i_MEMORY.mutex);
+
+            if (i_MEMORY.arenas == NULL)
+            {
+                i_MEMORY.arenas = (i_Memory**)bmem_malloc(MAX_THREAD_ARENAS * sizeof32(i_Memory*));
+                i_MEMORY.num_arenas = 0;
+                i_MEMORY.next_arena = 0;
+            }
+
+            /* Other thread could have ended meanwhile */
+            memory = i_idle_arena(&i_MEMORY);
+
+            if (memory == NULL && arena != NULL && i_MEMORY.num_arenas < MAX_THREAD_ARENAS)
+            {
+                memory = arena;
+                memory->num_threads = 1;
+                i_MEMORY.arenas[i_MEMORY.num_arenas] = memory;
+                i_MEMORY.num_arenas += 1;
+                arena = NULL;
+            }
+            /* Too many threads, arenas will be shared */
+            else if (memory == NULL)
+            {
+                memory = i_MEMORY.arenas[i_MEMORY.next_arena % MAX_THREAD_ARENAS];
+                memory->num_threads += 1;
+                i_MEMORY.next_arena += 1;
+            }
+
+            bmutex_unlock(i_MEMORY.mutex);
+        }
+
+        if (arena != NULL)
+            i_remove_arena(&arena);
+
+        i_THREAD_MEMORY = memory;
+        _osbs_thread_exit(i_thread_end, (void*)memory);
+    }
+
+    return memory;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE void i_add_bytes(i_Memory *memory, const uint32_t size)
+{
+    memory->num_allocs += 1;
+    memory->total_bytes_allocated += size;
+    memory->bytes_allocated += size;
+    /* Arena balances are deltas and can be temporarily negative */
+    if ((int64_t)memory->bytes_allocated > (int64_t)memory->max_bytes_allocated)
+        memory->max_bytes_allocated = memory->bytes_allocated;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE void i_sub_bytes(i_Memory *memory, const uint32_t size)
+{
+    memory->num_deallocs += 1;
+    memory->total_bytes_deallocated += size;
+    cassert_fatal(i_MEMORY.mtcount > 0 || memory->bytes_allocated >= size);
+    memory->bytes_allocated -= size;
+}
+
+#if defined (__MEMORY_AUDITOR__)
+
+/*---------------------------------------------------------------------------*/
+
+//static void i_dump_objects(void)
+//{
+//    register uint32_t i;
+//    log_printf("Num objects: %d", i_MEMORY.num_objects);
+//    for (i = 0; i < i_MEMORY.num_objects; ++i)
+//        log_printf("%s %d %d", i_MEMORY.objects[i].name, i_MEMORY.objects[i].num_allocs, i_MEMORY.objects[i].num_deallocs);
+//}
+
+/*---------------------------------------------------------------------------*/
+
+static int i_object_key(const i_Object *object, const char_t *name)
+{
+    return str_cmp_cn(object->name, name, OBJECT_NAME_SIZE);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_Object *i_new_object(i_Memory *memory, const uint32_t index, const char_t *name, const bool_t equal_sized, const uint32_t size)
+{
+    i_Object *new_object = NULL;
+    cassert_no_null(memory);
+    if (memory->num_objects == memory->objects_alloc)
+    {
+        memory->objects = (i_Object*)bmem_realloc((byte_t*)memory->objects, memory->objects_alloc * (uint32_t)sizeof(i_Object), (memory->objects_alloc + OBJECTS_ARRAY_GROW_SIZE) * (uint32_t)sizeof(i_Object));
+        memory->objects_alloc += OBJECTS_ARRAY_GROW_SIZE;
+    }
+
+    /* Move all elems from index 1 postion right (keep the array sorted) */
+    if ((memory->num_objects - index) > 0)
+    {
+        bmem_move((byte_t*)(memory->objects + index + 1),
+                    (const byte_t*)(memory->objects + index),
+                    (memory->num_objects - index) * (uint32_t)sizeof(i_Object));
+    }
+
+    new_object = memory->objects + index;
+    bmem_zero(new_object, i_Object);
+    str_copy_c(new_object->name, OBJECT_NAME_SIZE, name);
+    new_object->equal_sized = equal_sized;
+    new_object->size = size;
+    memory->num_objects += 1;
+    return new_object;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_Object *i_get_object(i_Memory *memory, const char_t *name, const bool_t equal_sized, const uint32_t size)
+{
+    uint32_t index = UINT32_MAX;
+    cassert_no_null(memory);
+    if (blib_bsearch((const byte_t*)memory->objects, (const byte_t*)name, memory->num_objects, sizeof(i_Object), (FPtr_compare)i_object_key, &index) == TRUE)
+    {
+        i_Object *object = memory->objects + index;
+
+        /* Object type was registered by a cross-thread free */
+        if (object->untyped == TRUE)
+        {
+            object->equal_sized = equal_sized;
+            object->size = size;
+            object->untyped = FALSE;
+        }
+
+        cassert_msg(object->equal_sized == equal_sized, "heap auditor: Not 'equal_sized' property with same 'name'.");
+        cassert_msg(object->equal_sized == FALSE || object->size == size, "heap auditor: alloc 'equal_sized' object type with different size.");
+        return object;
+    }
+    else
+    {
+        return i_new_object(memory, index, name, equal_sized, size);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_Object *i_get_existing_object(i_Memory *memory, const char_t *name)
+{
+    uint32_t index = UINT32_MAX;
+    cassert_no_null(memory);
+    if (blib_bsearch((const byte_t*)memory->objects, (const byte_t*)name, memory->num_objects, sizeof(i_Object), (FPtr_compare)i_object_key, &index) == TRUE)
+    {
+        return memory->objects + index;
+    }
+    /* In multi-threaded mode, the object could be allocated in other arena */
+    else if (i_MEMORY.mtcount > 0)
+    {
+        i_Object *object = i_new_object(memory, index, name, FALSE, 0);
+        object->untyped = TRUE;
+        return object;
+    }
+    else
+    {
+        cassert_fatal_msg(FALSE, "heap auditor: non-existent 'name' object.");
+        return NULL;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_merge_objects(i_Memory *memory, i_Memory *arena)
+{
+    register uint32_t i;
+    cassert_no_null(memory);
+    cassert_no_null(arena);
+    for (i = 0; i < arena->num_objects; ++i)
+    {
+        const i_Object *src = arena->objects + i;
+        i_Object *dest = NULL;
+
+        if (src->untyped == FALSE)
+        {
+            dest = i_get_object(memory, src->name, src->equal_sized, src->size);
+        }
+        else
+        {
+            uint32_t index = UINT32_MAX;
+            if (blib_bsearch((const byte_t*)memory->objects, (const byte_t*)src->name, memory->num_objects, sizeof(i_Object), (FPtr_compare)i_object_key, &index) == TRUE)
+            {
+                dest = memory->objects + index;
+            }
+            else
+            {
+                dest = i_new_object(memory, index, src->name, FALSE, 0);
+                dest->untyped = TRUE;
+            }
+        }
+
+        dest->num_allocs += src->num_allocs;
+        dest->num_deallocs += src->num_deallocs;
+        dest->bytes_alloc += src->bytes_alloc;
+        dest->bytes_dealloc += src->bytes_dealloc;
+    }
+
+    arena->num_objects = 0;
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+static void i_merge_arenas(i_Memory *memory)
+{
+    register uint32_t i;
+    uint64_t max_bytes_allocated = 0;
+    cassert_no_null(memory);
+
+    /* Arena peaks are not simultaneous, so the merged peak is an upper bound */
+    max_bytes_allocated = memory->max_bytes_allocated;
+
+    for (i = 0; i < memory->num_arenas; ++i)
+    {
+        i_Memory *arena = memory->arenas[i];
+        bmutex_lock(arena->mutex);
+        memory->num_allocs += arena->num_allocs;
+        memory->total_bytes_allocated += arena->total_bytes_allocated;
+        memory->num_deallocs += arena->num_deallocs;
+        memory->total_bytes_deallocated += arena->total_bytes_deallocated;
+        memory->num_reallocs += arena->num_reallocs;
+        memory->num_effective_reallocs += arena->num_effective_reallocs;
+        memory->total_bytes_moved_in_reallocs += arena->total_bytes_moved_in_reallocs;
+        memory->bytes_allocated += arena->bytes_allocated;
+        memory->std_pages_alloc += arena->std_pages_alloc;
+        memory->great_pages_alloc += arena->great_pages_alloc;
+        memory->std_pages_dealloc += arena->std_pages_dealloc;
+        memory->great_pages_dealloc += arena->great_pages_dealloc;
+        memory->slots_recycled += arena->slots_recycled;
+        max_bytes_allocated += arena->max_bytes_allocated;
+
+        #if defined (__MEMORY_AUDITOR__)
+        i_merge_objects(memory, arena);
+        #endif
+
+        arena->num_allocs = 0;
+        arena->total_bytes_allocated = 0;
+        arena->num_deallocs = 0;
+        arena->total_bytes_deallocated = 0;
+        arena->num_reallocs = 0;
+        arena->num_effective_reallocs = 0;
+        arena->total_bytes_moved_in_reallocs = 0;
+        arena->bytes_allocated = 0;
+        arena->max_bytes_allocated = 0;
+        arena->std_pages_alloc = 0;
+        arena->great_pages_alloc = 0;
+        arena->std_pages_dealloc = 0;
+        arena->great_pages_dealloc = 0;
+        arena->slots_recycled = 0;
+        bmutex_unlock(arena->mutex);
+    }
+
+    if (memory->mt_max_bytes_allocated > max_bytes_allocated)
+        max_bytes_allocated = memory->mt_max_bytes_allocated;
+
+    if (memory->bytes_allocated > max_bytes_allocated)
+        max_bytes_allocated = memory->bytes_allocated;
+
+    memory->max_bytes_allocated = max_bytes_allocated;
+    memory->mt_max_bytes_allocated = max_bytes_allocated;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_fragmentation_stats(const i_Memory *memory)
+{
+    register uint32_t i;
+    uint32_t max_pages = memory->max_pages_alive;
+    uint64_t max_bytes = memory->max_paged_bytes;
+    uint64_t idle_bytes = memory->slots_idle_bytes;
+    uint64_t capacity = 0;
+
+    /* Arena peaks are added (upper bound) */
+    for (i = 0; i < memory->num_arenas; ++i)
+    {
+        max_pages += memory->arenas[i]->max_pages_alive;
+        max_bytes += memory->arenas[i]->max_paged_bytes;
+        idle_bytes += memory->arenas[i]->slots_idle_bytes;
+    }
+
+    capacity = (uint64_t)max_pages * (uint64_t)(memory->page_size - sizeof(i_Page));
+    if (capacity > 0 && max_bytes <= capacity)
+    {
+        uint32_t frag = (uint32_t)(((capacity - max_bytes) * 1000) / capacity);
+        log_printf("Page fragmentation: %u.%u%% (%" PRIu64 " bytes used in %u pages at peak)", frag / 10, frag % 10, max_bytes, max_pages);
+    }
+
+    if (memory->size_classes == TRUE)
+        log_printf("Size-class slots: %" PRIu64 " recycled, %" PRIu64 " idle bytes", memory->slots_recycled, idle_bytes);
+}
+
+/*---------------------------------------------------------------------------*/
+
 void _heap_start(void)
 {
-    i_init_memory(&i_MEMORY, i_PAGESIZE);
+    i_init_memory(&i_MEMORY, i_PAGESIZE, i_SIZE_CLASSES);
+    i_THREAD_MEMORY = &i_MEMORY;
 }
 
 /*---------------------------------------------------------------------------*/
 
 void _heap_finish(void)
 {
+    /* Collect the counters of blocks freed in thread arenas */
+    i_merge_arenas(&i_MEMORY);
+
     /* Show Objects Leaks*/
     #if defined(__MEMORY_AUDITOR__)
     {
@@ -376,6 +1075,9 @@ void _heap_finish(void)
             log_printf("Real allocations: %u pages of %u bytes", i_MEMORY.std_pages_alloc, i_MEMORY.page_size);
             if (i_MEMORY.great_pages_alloc > 0)
             log_printf("                  %u pages greater than %u bytes", i_MEMORY.great_pages_alloc, i_MEMORY.page_size);
+            if (i_MEMORY.num_arenas > 0)
+            log_printf("Thread arenas: %u", i_MEMORY.num_arenas);
+            i_fragmentation_stats(&i_MEMORY);
             log_printf("============================");
             
             #if defined(__MEMORY_AUDITOR__)
@@ -404,8 +1106,10 @@ void _heap_finish(void)
 	}
     
     i_remove_memory(&i_MEMORY);
+    i_THREAD_MEMORY = NULL;
 }
 
+
 /*---------------------------------------------------------------------------*/
 
 static uint32_t i_next_pow2(const uint32_t value)
@@ -438,102 +1142,39 @@ void _heap_verbose(const bool_t verbose)
     i_HEAP_VERBOSE = verbose;
 }
 
-#if defined (__MEMORY_AUDITOR__)
-
 /*---------------------------------------------------------------------------*/
 
-//static void i_dump_objects(void)
-//{
-//    register uint32_t i;
-//    log_printf("Num objects: %d", i_MEMORY.num_objects);
-//    for (i = 0; i < i_MEMORY.num_objects; ++i)
-//        log_printf("%s %d %d", i_MEMORY.objects[i].name, i_MEMORY.objects[i].num_allocs, i_MEMORY.objects[i].num_deallocs);
-//}
-
-/*---------------------------------------------------------------------------*/
-
-static int i_object_key(const i_Object *object, const char_t *name)
-{
-    return str_cmp_cn(object->name, name, OBJECT_NAME_SIZE);
-}
-
-/*---------------------------------------------------------------------------*/
-
-static i_Object *i_get_object(const char_t *name, const bool_t equal_sized, const uint32_t size)
+/* Threads that never called 'heap_start_mt' share the main heap, so it is locked too */
+static __INLINE i_Memory *i_lock(const bool_t mt)
 {
-    uint32_t index = UINT32_MAX;
-    if (blib_bsearch((const byte_t*)i_MEMORY.objects, (const byte_t*)name, i_MEMORY.num_objects, sizeof(i_Object), (FPtr_compare)i_object_key, &index) == TRUE)
-    {
-        i_Object *object = i_MEMORY.objects + index;
-        cassert_msg(object->equal_sized == equal_sized, "heap auditor: Not 'equal_sized' property with same 'name'.");
-        cassert_msg(object->equal_sized == FALSE || object->size == size, "heap auditor: alloc 'equal_sized' object type with different size.");
-        return object;
-    }
-    else
-    {
-        i_Object *new_object = NULL;
-        if (i_MEMORY.num_objects == i_MEMORY.objects_alloc)
-        {
-            i_MEMORY.objects = (i_Object*)bmem_realloc((byte_t*)i_MEMORY.objects, i_MEMORY.objects_alloc * (uint32_t)sizeof(i_Object), (i_MEMORY.objects_alloc + OBJECTS_ARRAY_GROW_SIZE) * (uint32_t)sizeof(i_Object));
-            i_MEMORY.objects_alloc += OBJECTS_ARRAY_GROW_SIZE;
-        }
-
-        /* Move all elems from index 1 postion right (keep the array sorted) */
-        if ((i_MEMORY.num_objects - index) > 0)
-        {
-            bmem_move((byte_t*)(i_MEMORY.objects + index + 1),
-                        (const byte_t*)(i_MEMORY.objects + index),
-                        (i_MEMORY.num_objects - index) * (uint32_t)sizeof(i_Object));
-        }
-
-        new_object = i_MEMORY.objects + index;
-        bmem_zero(new_object, i_Object);
-        str_copy_c(new_object->name, OBJECT_NAME_SIZE, name);
-        new_object->equal_sized = equal_sized;
-        new_object->size = size;
-        i_MEMORY.num_objects += 1;
-        return new_object;
-    }
+    i_Memory *memory = mt == TRUE ? i_thread_memory() : &i_MEMORY;
+    if (__TRUE_EXPECTED(memory->mutex != NULL))
+        bmutex_lock(memory->mutex);
+    return memory;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static i_Object *i_get_existing_object(const char_t *name)
+static __INLINE void i_unlock(i_Memory *memory)
 {
-    uint32_t index = UINT32_MAX;
-    if (blib_bsearch((const byte_t*)i_MEMORY.objects, (const byte_t*)name, i_MEMORY.num_objects, sizeof(i_Object), (FPtr_compare)i_object_key, &index) == TRUE)
-    {
-        return i_MEMORY.objects + index;
-    }
-    else
-    {
-        cassert_fatal_msg(FALSE, "heap auditor: non-existent 'name' object.");
-        return NULL;
-    }
+    if (__TRUE_EXPECTED(memory->mutex != NULL))
+        bmutex_unlock(memory->mutex);
 }
 
-#endif
-
 /*---------------------------------------------------------------------------*/
 
 static __INLINE byte_t *i_malloc_imp(const uint32_t size, const uint32_t align, const char_t *name, const bool_t equal_sized)
 {
     byte_t *mem = NULL;
+    bool_t mt = (bool_t)(i_MEMORY.mtcount > 0);
+    i_Memory *memory = i_lock(mt);
 
     cassert(size > 0);
-
-    if (i_MEMORY.mutex != NULL)
-        bmutex_lock(i_MEMORY.mutex);
-
-    i_MEMORY.num_allocs += 1;
-    i_MEMORY.total_bytes_allocated += size;
-    i_MEMORY.bytes_allocated += size;
-    if (i_MEMORY.bytes_allocated > i_MEMORY.max_bytes_allocated)
-        i_MEMORY.max_bytes_allocated = i_MEMORY.bytes_allocated;
+    i_add_bytes(memory, size);
 
     #if defined (__MEMORY_AUDITOR__)
     {
-        i_Object *object = i_get_object(name, equal_sized, size);
+        i_Object *object = i_get_object(memory, name, equal_sized, size);
         object->num_allocs += 1;
         object->bytes_alloc += size;
     }
@@ -542,11 +1183,8 @@ static __INLINE byte_t *i_malloc_imp(const uint32_t size, const uint32_t align,
     unref(equal_sized);
     #endif
 
-    mem = i_malloc(&i_MEMORY, size, align);
-
-    if (i_MEMORY.mutex != NULL)
-        bmutex_unlock(i_MEMORY.mutex);
-
+    mem = i_malloc(memory, size, align);
+    i_unlock(memory);
     return mem;
 }
 
@@ -556,6 +1194,13 @@ void heap_start_mt(void)
 {
     //cassert(bthread_current_id() == i_MEMORY.main_thread_id);
     bmutex_lock(i_MEMORY.mutex);
+    if (i_MEMORY.mtcount == 0)
+    {
+        /* Arena peaks will be measured from here */
+        i_MEMORY.mt_max_bytes_allocated = i_MEMORY.max_bytes_allocated;
+        i_MEMORY.max_bytes_allocated = i_MEMORY.bytes_allocated;
+    }
+
     i_MEMORY.mtcount += 1;
     _osbs_mutex(i_MEMORY.mutex);
     bmutex_unlock(i_MEMORY.mutex);
@@ -570,7 +1215,10 @@ void heap_end_mt(void)
     cassert(i_MEMORY.mtcount > 0);
     i_MEMORY.mtcount -= 1;
     if (i_MEMORY.mtcount == 0)
+    {
+        i_merge_arenas(&i_MEMORY);
         _osbs_mutex(NULL);
+    }
     bmutex_unlock(i_MEMORY.mutex);
 }
 
@@ -601,38 +1249,45 @@ static __INLINE byte_t *i_realloc_imp(byte_t *mem, const uint32_t size, const ui
     if (__TRUE_EXPECTED(size != new_size))
     {
         byte_t *new_mem = NULL;
-        bool_t locked = FALSE;
+        bool_t mt = (bool_t)(i_MEMORY.mtcount > 0);
+        i_Memory *memory = i_lock(mt);
+        i_Memory *owner = i_block_memory(memory, mem, size, align);
 
-        if (i_MEMORY.mtcount > 0)
+        /* Block belongs to the current arena (or to the main heap in single-thread mode) */
+        if (__TRUE_EXPECTED(owner == memory))
         {
-            bmutex_lock(i_MEMORY.mutex);
-            locked = TRUE;
+            new_mem = i_realloc(owner, mem, new_size, size, align);
+        }
+        /* Block belongs to another thread arena: allocate here and return it to the owner */
+        else
+        {
+            new_mem = i_malloc(memory, new_size, align);
+            bmem_copy(new_mem, mem, size < new_size ? size : new_size);
         }
 
-        new_mem = i_realloc(&i_MEMORY, mem, new_size, size, align);
-        i_MEMORY.num_reallocs += 1;
-        i_MEMORY.total_bytes_deallocated += size;
-        i_MEMORY.total_bytes_allocated += new_size;
+        memory->num_reallocs += 1;
+        memory->total_bytes_deallocated += size;
+        memory->total_bytes_allocated += new_size;
 
         if (new_mem != mem)
-            i_MEMORY.total_bytes_moved_in_reallocs += size;
+            memory->total_bytes_moved_in_reallocs += size;
         else
-            i_MEMORY.num_effective_reallocs += 1;
+            memory->num_effective_reallocs += 1;
 
         if (new_size > size)
         {
-            i_MEMORY.bytes_allocated += new_size - size;            
-            if (i_MEMORY.bytes_allocated > i_MEMORY.max_bytes_allocated)
-                i_MEMORY.max_bytes_allocated = i_MEMORY.bytes_allocated;
+            memory->bytes_allocated += new_size - size;
+            if ((int64_t)memory->bytes_allocated > (int64_t)memory->max_bytes_allocated)
+                memory->max_bytes_allocated = memory->bytes_allocated;
         }
         else
         {
-            i_MEMORY.bytes_allocated -= size - new_size;
+            memory->bytes_allocated -= size - new_size;
         }
 
         #if defined (__MEMORY_AUDITOR__)
         {
-            i_Object *object = i_get_object(name, FALSE, UINT32_MAX);
+            i_Object *object = i_get_object(memory, name, FALSE, UINT32_MAX);
             object->bytes_alloc += new_size;
             object->bytes_dealloc += size;
         }
@@ -640,8 +1295,15 @@ static __INLINE byte_t *i_realloc_imp(byte_t *mem, const uint32_t size, const ui
         unref(name);
         #endif
 
-        if (locked == TRUE)
-            bmutex_unlock(i_MEMORY.mutex);
+        i_unlock(memory);
+
+        /* Cross-thread handoff of the previous block */
+        if (owner != memory)
+        {
+            bmutex_lock(owner->mutex);
+            i_free(owner, mem, size, align);
+            bmutex_unlock(owner->mutex);
+        }
 
         return new_mem;
     }
@@ -687,31 +1349,42 @@ byte_t *heap_aligned_realloc(byte_t *mem, const uint32_t size, const uint32_t ne
 void heap_free(byte_t **mem, const uint32_t size, const char_t *name)
 {
     byte_t *mem_ptr = NULL;
-    bool_t locked = FALSE;
+    i_Memory *owner = NULL;
+    i_Memory *memory = NULL;
+    bool_t mt = (bool_t)(i_MEMORY.mtcount > 0);
     cassert_no_null(mem);
     cassert_no_null(*mem);
     cassert(size > 0);
 
-    if (i_MEMORY.mtcount > 0)
+    mem_ptr = *mem;
+    *mem = NULL;
+
+    if (mt == TRUE)
     {
-        bmutex_lock(i_MEMORY.mutex);
-        locked = TRUE;
+        /* Cross-thread frees are returned directly to the owner arena */
+        owner = i_block_memory(i_thread_memory(), mem_ptr, size, sizeof(void*));
+        memory = owner;
+    }
+    else
+    {
+        owner = i_block_memory(&i_MEMORY, mem_ptr, size, sizeof(void*));
+        memory = &i_MEMORY;
     }
 
-    mem_ptr = *mem;
-    *mem = NULL;
-    i_free(&i_MEMORY, mem_ptr, size, sizeof(void*));
+    if (__TRUE_EXPECTED(memory->mutex != NULL))
+        bmutex_lock(memory->mutex);
 
-    i_MEMORY.num_deallocs += 1;
-    i_MEMORY.total_bytes_deallocated += size;
-    cassert_fatal(i_MEMORY.bytes_allocated >= size);
-    i_MEMORY.bytes_allocated -= size;
+    i_free(owner, mem_ptr, size, sizeof(void*));
+    i_sub_bytes(memory, size);
 
     #if defined (__MEMORY_AUDITOR__)
     {
-        i_Object *object = i_get_existing_object(name);
-        cassert_msg(object->equal_sized == FALSE || object->size == size, "heap auditor: free 'equal_sized' object type with different size.");
-        cassert_msg(object->num_allocs > 0, "heap auditor: free object type without allocs.");
+        i_Object *object = i_get_existing_object(memory, name);
+        if (object->untyped == FALSE)
+        {
+            cassert_msg(object->equal_sized == FALSE || object->size == size, "heap auditor: free 'equal_sized' object type with different size.");
+            cassert_msg(mt == TRUE || object->num_allocs > 0, "heap auditor: free object type without allocs.");
+        }
         object->num_deallocs += 1;
         object->bytes_dealloc += size;
     }
@@ -719,8 +1392,7 @@ void heap_free(byte_t **mem, const uint32_t size, const char_t *name)
     unref(name);
     #endif
 
-    if (locked == TRUE)
-        bmutex_unlock(i_MEMORY.mutex);
+    i_unlock(memory);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -729,21 +1401,12 @@ void heap_auditor_add(const char_t *name)
 {
     #if defined (__MEMORY_AUDITOR__)
     {
-        i_Object *object = NULL;
-        bool_t locked = FALSE;
-
-        if (i_MEMORY.mtcount > 0)
-        {
-            bmutex_lock(i_MEMORY.mutex);
-            locked = TRUE;
-        }
-
-        object = i_get_object(name, TRUE, 0);
+        bool_t mt = (bool_t)(i_MEMORY.mtcount > 0);
+        i_Memory *memory = i_lock(mt);
+        i_Object *object = i_get_object(memory, name, TRUE, 0);
         object->num_allocs += 1;
-        i_MEMORY.num_allocs += 1;
-
-        if (locked == TRUE)
-            bmutex_unlock(i_MEMORY.mutex);
+        memory->num_allocs += 1;
+        i_unlock(memory);
     }
     #else
     unref(name);
@@ -756,22 +1419,13 @@ void heap_auditor_delete(const char_t *name)
 {
     #if defined (__MEMORY_AUDITOR__)
     {
-        i_Object *object = NULL;
-        bool_t locked = FALSE;
-
-        if (i_MEMORY.mtcount > 0)
-        {
-            bmutex_lock(i_MEMORY.mutex);
-            locked = TRUE;
-        }
-
-        object = i_get_existing_object(name);
-        cassert_msg(object->num_allocs > 0, "heap auditor: free auditor object type without allocs.");
+        bool_t mt = (bool_t)(i_MEMORY.mtcount > 0);
+        i_Memory *memory = i_lock(mt);
+        i_Object *object = i_get_existing_object(memory, name);
+        cassert_msg(mt == TRUE || object->num_allocs > 0, "heap auditor: free auditor object type without allocs.");
         object->num_deallocs += 1;
-        i_MEMORY.num_deallocs += 1;
-
-        if (locked == TRUE)
-            bmutex_unlock(i_MEMORY.mutex);
+        memory->num_deallocs += 1;
+        i_unlock(memory);
     }
     #else
     unref(name);
@@ -784,3 +1438,30 @@ void heap_stats(const bool_t stats)
 {
     i_HEAP_STATS = stats;
 }
+
+/*---------------------------------------------------------------------------*/
+
+void heap_size_classes(const bool_t enable)
+{
+    /* Must be selected before heap starts (core_start) */
+    cassert(i_MEMORY.current_page == NULL);
+    i_SIZE_CLASSES = enable;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t heap_pages_alive(void)
+{
+    uint32_t pages = 0;
+    register uint32_t i;
+    bmutex_lock(i_MEMORY.mutex);
+    pages = i_MEMORY.pages_alive;
+    for (i = 0; i < i_MEMORY.num_arenas; ++i)
+    {
+        bmutex_lock(i_MEMORY.arenas[i]->mutex);
+        pages += i_MEMORY.arenas[i]->pages_alive;
+        bmutex_unlock(i_MEMORY.arenas[i]->mutex);
+    }
+    bmutex_unlock(i_MEMORY.mutex);
+    return pages;
+}
@@ -39,6 +39,10 @@ void heap_auditor_delete(const char_t *name);
 
 void heap_stats(const bool_t stats);
 
+void heap_size_classes(const bool_t enable);
+
+uint32_t heap_pages_alive(void);
+
 __END_C
 
 #define heap_malloc(size, name)\
@@ -598,6 +598,23 @@ Stream *hfile_stream(const char_t *pathname, ferror_t *error)
 
 /*---------------------------------------------------------------------------*/
 
+const byte_t *hfile_mmap(const char_t *pathname, uint32_t *size, ferror_t *error)
+{
+    uint32_t lsize = 0;
+    const byte_t *data = bfile_mmap(pathname, &lsize, error);
+    ptr_assign(size, lsize);
+    return data;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void hfile_munmap(const byte_t **data, const uint32_t size)
+{
+    bfile_munmap(data, size);
+}
+
+/*---------------------------------------------------------------------------*/
+
 bool_t hfile_from_string(const char_t *pathname, const String *str, ferror_t *error)
 {
     File *file = bfile_create(pathname, error);
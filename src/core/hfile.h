@@ -41,6 +41,10 @@ String *hfile_string(const char_t *pathname, ferror_t *error);
 
 Stream *hfile_stream(const char_t *pathname, ferror_t *error);
 
+const byte_t *hfile_mmap(const char_t *pathname, uint32_t *size, ferror_t *error);
+
+void hfile_munmap(const byte_t **data, const uint32_t size);
+
 bool_t hfile_from_string(const char_t *pathname, const String *str, ferror_t *error);
 
 bool_t hfile_from_data(const char_t *pathname, const byte_t *data, const uint32_t size, ferror_t *error);
@@ -0,0 +1,403 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: logbin.c
+ *
+ */
+
+/* Binary log (log_binary) to text */
+
+#include "logbin.h"
+#include "arrst.h"
+#include "hashst.h"
+#include "stream.h"
+#include "strings.h"
+#include "bmem.h"
+#include "bstd.h"
+#include "btime.h"
+#include "cassert.h"
+#include "heap.h"
+#include "osbs.h"
+
+typedef struct _format_t Format;
+
+struct _format_t
+{
+    String *text;
+};
+
+DeclSt(Format);
+
+static void i_remove_format(Format *format)
+{
+    str_destroy(&format->text);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 'swap' for logs written in a machine with the other endianness */
+static bool_t i_read(const byte_t **data, const byte_t *end, const bool_t swap, void *value, const uint32_t size)
+{
+    if ((uint32_t)(end - *data) < size)
+        return FALSE;
+
+    bmem_copy((byte_t*)value, *data, size);
+    if (swap == TRUE)
+        bmem_rev_elems_imp((byte_t*)value, size, 1);
+    *data += size;
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_read_block(const byte_t **data, const byte_t *end, const bool_t swap, const byte_t **block, uint16_t *size)
+{
+    if (i_read(data, end, swap, size, sizeof(uint16_t)) == FALSE)
+        return FALSE;
+
+    if ((uint32_t)(end - *data) < *size)
+        return FALSE;
+
+    *block = *data;
+    *data += *size;
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_time(StrBuf *line, const uint64_t time)
+{
+    Date date;
+    btime_to_date(time, &date);
+    strbuf_printf(line, "[%02d:%02d:%02d.%06u] ", date.hour, date.minute, date.second, (uint32_t)(time % 1000000));
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Bounds for widths and precisions read from the file */
+#define i_MAX_FIELD     1024
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_has_flag(const char_t *flags, const uint32_t n, const char_t flag)
+{
+    uint32_t i;
+    for (i = 0; i < n; ++i)
+    {
+        if (flags[i] == flag)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_digits(const char_t **f)
+{
+    uint32_t value = 0;
+    while (**f >= '0' && **f <= '9')
+    {
+        if (value <= i_MAX_FIELD)
+            value = value * 10 + (uint32_t)(**f - '0');
+        *f += 1;
+    }
+
+    return value < i_MAX_FIELD ? value : i_MAX_FIELD;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_field(const int64_t value)
+{
+    if (value < 0)
+        return value < -i_MAX_FIELD ? i_MAX_FIELD : (uint32_t)-value;
+    return value < i_MAX_FIELD ? (uint32_t)value : i_MAX_FIELD;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Same conversion walk as the encoder in 'osbs/log.c'. FALSE if arguments are missing.
+ * The file format never reaches printf: each conversion is parsed (flags, width,
+ * precision, type) and its spec is written again from the parsed and bounded values.
+ */
+static bool_t i_event(StrBuf *line, const char_t *format, const byte_t *args, const byte_t *end, const bool_t swap)
+{
+    const char_t *f = format;
+    while (*f != '\0')
+    {
+        const char_t *start = f;
+        char_t flags[8];
+        char_t spec[48];
+        uint32_t nflags = 0;
+        uint32_t width = 0;
+        int32_t prec = -1;
+        char_t conv = '\0';
+        uint64_t value = 0;
+
+        while (*f != '\0' && *f != '%')
+            f += 1;
+
+        strbuf_cat_n(line, start, (uint32_t)(f - start));
+        if (*f == '\0')
+            break;
+
+        f += 1;
+        if (*f == '%')
+        {
+            strbuf_cat(line, "%");
+            f += 1;
+            continue;
+        }
+
+        /* Each flag once, repeated flags are dropped */
+        while (*f == '-' || *f == '+' || *f == ' ' || *f == '#' || *f == '0' || *f == '\'')
+        {
+            if (i_has_flag(flags, nflags, *f) == FALSE)
+                flags[nflags++] = *f;
+            f += 1;
+        }
+
+        /* '*' values are written in the event. Negative width is the '-' flag */
+        if (*f == '*')
+        {
+            int64_t w = 0;
+            if (i_read(&args, end, swap, &w, sizeof(int64_t)) == FALSE)
+                return FALSE;
+
+            if (w < 0 && i_has_flag(flags, nflags, '-') == FALSE)
+                flags[nflags++] = '-';
+
+            width = i_field(w);
+            f += 1;
+        }
+        else
+        {
+            width = i_digits(&f);
+        }
+
+        if (*f == '.')
+        {
+            f += 1;
+            if (*f == '*')
+            {
+                int64_t p = 0;
+                if (i_read(&args, end, swap, &p, sizeof(int64_t)) == FALSE)
+                    return FALSE;
+
+                /* Negative precision is taken as if omitted */
+                if (p >= 0)
+                    prec = (int32_t)i_field(p);
+                f += 1;
+            }
+            else
+            {
+                prec = (int32_t)i_digits(&f);
+            }
+        }
+
+        flags[nflags] = '\0';
+
+        /* Values were widened to 64 bits */
+        while (*f == 'h' || *f == 'l' || *f == 'j' || *f == 'q' || *f == 'z' || *f == 't' || *f == 'L')
+            f += 1;
+
+        if (*f == 'I')
+        {
+            if ((f[1] == '6' && f[2] == '4') || (f[1] == '3' && f[2] == '2'))
+                f += 3;
+            else
+                f += 1;
+        }
+
+        conv = *f;
+        switch (conv) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+        case 'p':
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+        case 's':
+            break;
+        case 'n':
+            f += 1;
+            continue;
+        default:
+            strbuf_cat(line, " <unknown conversion>");
+            return TRUE;
+        }
+
+        f += 1;
+
+        {
+            const char_t *len = (conv == 'd' || conv == 'i' || conv == 'u' || conv == 'o' || conv == 'x' || conv == 'X') ? "ll" : "";
+            uint32_t n = bstd_sprintf(spec, sizeof(spec), "%%%s", flags);
+            if (width > 0)
+                n += bstd_sprintf(spec + n, sizeof(spec) - n, "%u", width);
+            if (prec >= 0)
+                n += bstd_sprintf(spec + n, sizeof(spec) - n, ".%d", prec);
+            bstd_sprintf(spec + n, sizeof(spec) - n, "%s%c", len, conv);
+        }
+
+        if (conv == 's')
+        {
+            const byte_t *str = NULL;
+            uint16_t size = 0;
+            char_t *text = NULL;
+            if (i_read_block(&args, end, swap, &str, &size) == FALSE)
+                return FALSE;
+
+            text = (char_t*)heap_malloc((uint32_t)size + 1, "LogBinStr");
+            bmem_copy((byte_t*)text, str, (uint32_t)size);
+            text[size] = '\0';
+            strbuf_printf(line, spec, text);
+            heap_free((byte_t**)&text, (uint32_t)size + 1, "LogBinStr");
+            continue;
+        }
+
+        if (i_read(&args, end, swap, &value, sizeof(uint64_t)) == FALSE)
+            return FALSE;
+
+        switch (conv) {
+        case 'd':
+        case 'i':
+            strbuf_printf(line, spec, (long long)value);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            strbuf_printf(line, spec, (unsigned long long)value);
+            break;
+        case 'c':
+            strbuf_printf(line, spec, (int)value);
+            break;
+        case 'p':
+            strbuf_printf(line, spec, (void*)(size_t)value);
+            break;
+        default:
+        {
+            real64_t real;
+            bmem_copy((byte_t*)&real, (const byte_t*)&value, sizeof(real64_t));
+            strbuf_printf(line, spec, real);
+            break;
+        }
+        }
+    }
+
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Pass 1 collects the formats, pass 2 renders. Definitions can arrive later than the events */
+static bool_t i_decode(const byte_t *data, const byte_t *end, const bool_t swap, HashSt(Format) *formats, Stream *stm, const bool_t render)
+{
+    StrBuf *line = strbuf_create(256);
+    bool_t ok = TRUE;
+
+    while (data < end && ok == TRUE)
+    {
+        byte_t type = *data++;
+        uint32_t id = 0;
+        uint64_t time = 0;
+        const byte_t *block = NULL;
+        uint16_t size = 0;
+
+        switch (type) {
+        case 'F':
+            ok = i_read(&data, end, swap, &id, sizeof(uint32_t));
+            if (ok == TRUE)
+                ok = i_read_block(&data, end, swap, &block, &size);
+
+            if (ok == TRUE && render == FALSE && hashst_get(formats, &id, Format) == NULL)
+            {
+                Format *format = hashst_insert(formats, &id, Format);
+                format->text = str_cn((const char_t*)block, (uint32_t)size);
+            }
+            break;
+
+        case 'E':
+            ok = i_read(&data, end, swap, &id, sizeof(uint32_t));
+            if (ok == TRUE)
+                ok = i_read(&data, end, swap, &time, sizeof(uint64_t));
+            if (ok == TRUE)
+                ok = i_read_block(&data, end, swap, &block, &size);
+
+            if (ok == TRUE && render == TRUE)
+            {
+                const Format *format = hashst_get_const(formats, &id, Format);
+                strbuf_clear(line);
+                i_time(line, time);
+                if (format != NULL)
+                {
+                    if (i_event(line, tc(format->text), block, block + size, swap) == FALSE)
+                        strbuf_cat(line, " <truncated>");
+                }
+                else
+                    strbuf_printf(line, "<unknown format %08X>", id);
+                strbuf_cat(line, "\n");
+                stm_writef(stm, strbuf_data(line));
+            }
+            break;
+
+        case 'T':
+            ok = i_read(&data, end, swap, &time, sizeof(uint64_t));
+            if (ok == TRUE)
+                ok = i_read_block(&data, end, swap, &block, &size);
+
+            if (ok == TRUE && render == TRUE)
+            {
+                strbuf_clear(line);
+                i_time(line, time);
+                strbuf_cat_n(line, (const char_t*)block, (uint32_t)size);
+                strbuf_cat(line, "\n");
+                stm_writef(stm, strbuf_data(line));
+            }
+            break;
+
+        default:
+            ok = FALSE;
+            break;
+        }
+    }
+
+    strbuf_destroy(&line);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* File: "NLOG" u16 version, u8 endian, u8 zero, records (see 'osbs/log.c') */
+bool_t logbin_text(const byte_t *data, const uint32_t size, Stream *stm)
+{
+    HashSt(Format) *formats = NULL;
+    bool_t swap = FALSE;
+    bool_t ok = TRUE;
+    cassert(data != NULL || size == 0);
+    cassert_no_null(stm);
+    if (size < 8 || bmem_cmp(data, (const byte_t*)"NLOG", 4) != 0)
+        return FALSE;
+
+    formats = hashst_create(uint32_t, Format);
+    swap = (bool_t)((data[6] == 0) != (osbs_endian() == ekLITEND));
+    i_decode(data + 8, data + size, swap, formats, stm, FALSE);
+    ok = i_decode(data + 8, data + size, swap, formats, stm, TRUE);
+    hashst_destroy(&formats, i_remove_format, Format);
+    return ok;
+}
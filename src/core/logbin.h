@@ -0,0 +1,19 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: logbin.h
+ *
+ */
+
+/* Binary log (log_binary) to text */
+
+#include "core.hxx"
+
+__EXTERN_C
+
+bool_t logbin_text(const byte_t *data, const uint32_t size, Stream *stm);
+
+__END_C
@@ -21,6 +21,8 @@
 
 typedef struct _ntoken_t NToken;
 typedef struct _trans_t Trans;
+typedef struct _dstate_t DState;
+typedef struct _dfa_t DFA;
 
 typedef enum _symbol_t
 {
@@ -46,18 +48,50 @@ struct _trans_t
     uint32_t extra;
 };
 
+/* Lazy DFA state: a set of NFA states (subset construction) */
+struct _dstate_t
+{
+    uint32_t hash;
+    uint32_t nstates;
+    uint32_t nclasses;
+    uint32_t *states;
+    uint32_t *next;
+    bool_t accept;
+};
+
+/* Lazy DFA: Codepoints are grouped in equivalence classes (ranges with the same NFA behaviour) */
+struct _dfa_t
+{
+    uint32_t nbounds;
+    uint32_t *bounds;
+    uint32_t ascii[128];
+    uint32_t memory;
+    bool_t full;
+    ArrPt(DState) *dstates;
+    /* Open addressing index over 'dstates' (id + 1, 0 = empty) */
+    uint32_t *index;
+    uint32_t index_size;
+};
+
 struct _nfa_t
 {
     ArrSt(Trans) *ttable;
     ArrSt(uint32_t) *current;
     ArrSt(uint32_t) *temp;
+    DFA *dfa;
+    /* Search DFA: the start set is added again after each codepoint */
+    DFA *udfa;
 };
 
 #define MIN_UNICODE 5
 #define MAX_UNICODE 1114112
+#define DFA_UNKNOWN (UINT32_MAX - 2)
+#define DFA_MAX_MEMORY (256 * 1024)
+#define DFA_INDEX_SIZE 64
 DeclSt(NToken);
 DeclSt(Trans);
 DeclSt(symbol_t);
+DeclPt(DState);
 
 /*---------------------------------------------------------------------------*/
 
@@ -223,11 +257,41 @@ NFA *nfa_string(const char_t *str)
 
 /*---------------------------------------------------------------------------*/
 
+static void i_destroy_dstate(DState **dstate)
+{
+    cassert_no_null(dstate);
+    cassert_no_null(*dstate);
+    heap_delete_n(&(*dstate)->states, (*dstate)->nstates, uint32_t);
+    heap_delete_n(&(*dstate)->next, (*dstate)->nclasses, uint32_t);
+    heap_delete(dstate, DState);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_destroy_dfa(DFA **dfa)
+{
+    cassert_no_null(dfa);
+    cassert_no_null(*dfa);
+    arrpt_destroy(&(*dfa)->dstates, i_destroy_dstate, DState);
+    heap_delete_n(&(*dfa)->index, (*dfa)->index_size, uint32_t);
+    if ((*dfa)->bounds != NULL)
+        heap_delete_n(&(*dfa)->bounds, (*dfa)->nbounds, uint32_t);
+    heap_delete(dfa, DFA);
+}
+
+/*---------------------------------------------------------------------------*/
+
 void nfa_destroy(NFA **nfa)
 {
     cassert_no_null(nfa);
     cassert_no_null(*nfa);
     arrst_destroy(&(*nfa)->ttable, NULL, Trans);
+    if ((*nfa)->dfa != NULL)
+        i_destroy_dfa(&(*nfa)->dfa);
+
+    if ((*nfa)->udfa != NULL)
+        i_destroy_dfa(&(*nfa)->udfa);
+
     if ((*nfa)->current != NULL)
     {
         arrst_destroy(&(*nfa)->current, NULL, uint32_t);
@@ -857,13 +921,7 @@ void nfa_start(NFA *nfa)
 bool_t nfa_next(NFA *nfa, const uint32_t codepoint)
 {
     cassert_no_null(nfa);
-    arrst_clear(nfa->temp, NULL, uint32_t);
-    arrst_foreach(state, nfa->current, uint32_t)
-        const Trans *trans = arrst_get(nfa->ttable, *state, Trans);
-        if (codepoint >= trans->symbol && codepoint <= trans->extra)
-            i_add_closure(nfa->ttable, nfa->temp, trans->state);
-    arrst_end();
-
+    nfa_set_next(nfa, nfa->current, nfa->temp, codepoint);
     bmem_swap_type(&nfa->current, &nfa->temp, ArrSt(uint32_t)*);
     return (bool_t)(arrst_size(nfa->current, uint32_t) > 0);
 }
@@ -871,14 +929,325 @@ bool_t nfa_next(NFA *nfa, const uint32_t codepoint)
 /*---------------------------------------------------------------------------*/
 
 bool_t nfa_accept(NFA *nfa)
+{
+    cassert_no_null(nfa);
+    return nfa_set_accept(nfa, nfa->current);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void nfa_set_start(const NFA *nfa, ArrSt(uint32_t) *states)
+{
+    cassert_no_null(nfa);
+    i_add_closure(nfa->ttable, states, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void nfa_set_next(const NFA *nfa, const ArrSt(uint32_t) *current, ArrSt(uint32_t) *next, const uint32_t codepoint)
+{
+    cassert_no_null(nfa);
+    arrst_clear(next, NULL, uint32_t);
+    arrst_foreach_const(state, current, uint32_t)
+        const Trans *trans = arrst_get_const(nfa->ttable, *state, Trans);
+        if (trans->state != UINT32_MAX && codepoint >= trans->symbol && codepoint <= trans->extra)
+            i_add_closure(nfa->ttable, next, trans->state);
+    arrst_end();
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t nfa_set_accept(const NFA *nfa, const ArrSt(uint32_t) *states)
 {
     register uint32_t accept;
     cassert_no_null(nfa);
     accept = arrst_size(nfa->ttable, Trans) - 1;
-    arrst_foreach(state, nfa->current, uint32_t)
+    arrst_foreach_const(state, states, uint32_t)
         if (*state == accept)
             return TRUE;
     arrst_end();
     return FALSE;
 }
 
+/*---------------------------------------------------------------------------*/
+
+static void i_add_bound(ArrSt(uint32_t) *bounds, const uint32_t bound)
+{
+    if (bound > 0 && bound <= MAX_UNICODE)
+        i_add_state(bounds, bound);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_class(const DFA *dfa, const uint32_t codepoint)
+{
+    register uint32_t i = 0, j;
+    cassert_no_null(dfa);
+    j = dfa->nbounds;
+    /* Classes are separated by 'bounds'. Class 'i' = [bounds[i-1], bounds[i]) */
+    while (i < j)
+    {
+        register uint32_t m = (i + j) / 2;
+        if (dfa->bounds[m] <= codepoint)
+            i = m + 1;
+        else
+            j = m;
+    }
+
+    return i;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static DFA *i_create_dfa(const ArrSt(Trans) *ttable)
+{
+    DFA *dfa = heap_new0(DFA);
+    ArrSt(uint32_t) *bounds = arrst_create(uint32_t);
+    uint32_t i;
+
+    arrst_foreach_const(trans, ttable, Trans)
+        if (trans->symbol != UINT32_MAX && trans->extra != 0)
+        {
+            i_add_bound(bounds, trans->symbol);
+            i_add_bound(bounds, trans->extra + 1);
+        }
+    arrst_end();
+
+    dfa->nbounds = arrst_size(bounds, uint32_t);
+    if (dfa->nbounds > 0)
+    {
+        dfa->bounds = heap_new_n(dfa->nbounds, uint32_t);
+        bmem_copy_n(dfa->bounds, arrst_all(bounds, uint32_t), dfa->nbounds, uint32_t);
+    }
+
+    for (i = 0; i < 128; ++i)
+        dfa->ascii[i] = i_class(dfa, i);
+
+    dfa->dstates = arrpt_create(DState);
+    dfa->index_size = DFA_INDEX_SIZE;
+    dfa->index = heap_new_n0(DFA_INDEX_SIZE, uint32_t);
+    dfa->memory = sizeof(DFA) + (dfa->nbounds + DFA_INDEX_SIZE) * sizeof(uint32_t);
+    arrst_destroy(&bounds, NULL, uint32_t);
+    return dfa;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_hash_states(const uint32_t *states, const uint32_t n)
+{
+    register uint32_t i, hash = 2166136261u;
+    for (i = 0; i < n; ++i)
+    {
+        hash ^= states[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_index_insert(uint32_t *index, const uint32_t size, const uint32_t hash, const uint32_t id)
+{
+    register uint32_t i = hash & (size - 1);
+    while (index[i] != 0)
+        i = (i + 1) & (size - 1);
+    index[i] = id + 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* The index is kept at most half full */
+static void i_index_grow(DFA *dfa)
+{
+    uint32_t size = dfa->index_size * 2;
+    uint32_t *index = heap_new_n0(size, uint32_t);
+    arrpt_foreach_const(dstate, dfa->dstates, DState)
+        i_index_insert(index, size, dstate->hash, dstate_i);
+    arrpt_end();
+    heap_delete_n(&dfa->index, dfa->index_size, uint32_t);
+    dfa->memory += dfa->index_size * sizeof(uint32_t);
+    dfa->index = index;
+    dfa->index_size = size;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Returns the DFA state equivalent to 'states' (sorted NFA set), creating it if necessary */
+static uint32_t i_dstate(DFA *dfa, const ArrSt(uint32_t) *states, const uint32_t accept)
+{
+    const uint32_t *set = arrst_all_const(states, uint32_t);
+    uint32_t n = arrst_size(states, uint32_t);
+    uint32_t hash = 0, nclasses = 0, id, i;
+    DState *dstate = NULL;
+    cassert_no_null(dfa);
+
+    if (n == 0)
+        return NFA_DEAD;
+
+    hash = i_hash_states(set, n);
+    i = hash & (dfa->index_size - 1);
+    while (dfa->index[i] != 0)
+    {
+        const DState *cstate = arrpt_get_const(dfa->dstates, dfa->index[i] - 1, DState);
+        if (cstate->hash == hash && cstate->nstates == n && bmem_cmp((const byte_t*)cstate->states, (const byte_t*)set, n * sizeof(uint32_t)) == 0)
+            return dfa->index[i] - 1;
+        i = (i + 1) & (dfa->index_size - 1);
+    }
+
+    nclasses = dfa->nbounds + 1;
+    if (dfa->memory + sizeof(DState) + (n + nclasses) * sizeof(uint32_t) > DFA_MAX_MEMORY)
+    {
+        dfa->full = TRUE;
+        return NFA_FULL;
+    }
+
+    dstate = heap_new(DState);
+    dstate->hash = hash;
+    dstate->nstates = n;
+    dstate->nclasses = nclasses;
+    dstate->states = heap_new_n(n, uint32_t);
+    dstate->next = heap_new_n(nclasses, uint32_t);
+    dstate->accept = FALSE;
+    bmem_copy_n(dstate->states, set, n, uint32_t);
+    for (i = 0; i < n; ++i)
+    {
+        if (set[i] == accept)
+            dstate->accept = TRUE;
+    }
+
+    for (i = 0; i < nclasses; ++i)
+        dstate->next[i] = DFA_UNKNOWN;
+
+    dfa->memory += sizeof(DState) + (n + nclasses) * sizeof(uint32_t);
+    arrpt_append(dfa->dstates, dstate, DState);
+    id = arrpt_size(dfa->dstates, DState) - 1;
+    if ((id + 1) * 2 > dfa->index_size)
+        i_index_grow(dfa);
+    else
+        i_index_insert(dfa->index, dfa->index_size, hash, id);
+    return id;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE DFA **i_dfa(NFA *nfa, const bool_t unanchored)
+{
+    cassert_no_null(nfa);
+    return unanchored == TRUE ? &nfa->udfa : &nfa->dfa;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t nfa_dfa_start(NFA *nfa, const bool_t unanchored)
+{
+    DFA **dfa = i_dfa(nfa, unanchored);
+    if (*dfa == NULL)
+    {
+        *dfa = i_create_dfa(nfa->ttable);
+        nfa_start(nfa);
+        /* The start set is always the first DFA state */
+        i_dstate(*dfa, nfa->current, arrst_size(nfa->ttable, Trans) - 1);
+    }
+
+    cassert(arrpt_size((*dfa)->dstates, DState) > 0);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_compute_next(NFA *nfa, DFA *dfa, DState *dstate, const uint32_t cclass, const bool_t unanchored)
+{
+    uint32_t codepoint, ntrans, i;
+    cassert_no_null(nfa);
+    cassert_no_null(dfa);
+    cassert_no_null(dstate);
+
+    if (dfa->full == TRUE)
+        return NFA_FULL;
+
+    /* Any codepoint in the class is a valid representative */
+    codepoint = cclass == 0 ? 0 : dfa->bounds[cclass - 1];
+    ntrans = arrst_size(nfa->ttable, Trans);
+    arrst_clear(nfa->temp, NULL, uint32_t);
+    for (i = 0; i < dstate->nstates; ++i)
+    {
+        const Trans *trans = NULL;
+        /* Live mark of unanchored sets */
+        if (dstate->states[i] == ntrans)
+            continue;
+
+        trans = arrst_get_const(nfa->ttable, dstate->states[i], Trans);
+        /* The accept state (no outgoing transition) has symbol = extra = 0 */
+        if (trans->state == UINT32_MAX)
+            continue;
+
+        if (codepoint >= trans->symbol && codepoint <= trans->extra)
+            i_add_closure(nfa->ttable, nfa->temp, trans->state);
+    }
+
+    /* A new match can begin at any position. If some thread of the previous positions
+       is still alive, the set is marked with 'ntrans' (not a state), so it never merges
+       with the start set. Returning to the start state means that all threads died */
+    if (unanchored == TRUE)
+    {
+        if (arrst_size(nfa->temp, uint32_t) > 0)
+            i_add_state(nfa->temp, ntrans);
+        i_add_closure(nfa->ttable, nfa->temp, 0);
+    }
+
+    return i_dstate(dfa, nfa->temp, ntrans - 1);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t nfa_dfa_next(NFA *nfa, const bool_t unanchored, const uint32_t dstate, const uint32_t codepoint)
+{
+    DFA *dfa = *i_dfa(nfa, unanchored);
+    DState *cstate = NULL;
+    uint32_t cclass, next;
+    cassert_no_null(dfa);
+    cstate = arrpt_get(dfa->dstates, dstate, DState);
+    cclass = codepoint < 128 ? dfa->ascii[codepoint] : i_class(dfa, codepoint);
+    next = cstate->next[cclass];
+    if (next == DFA_UNKNOWN)
+    {
+        /* 'i_compute_next' might realloc the state array, but not the states */
+        next = i_compute_next(nfa, dfa, cstate, cclass, unanchored);
+        if (next != NFA_FULL)
+            cstate->next[cclass] = next;
+    }
+
+    return next;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t nfa_dfa_accept(const NFA *nfa, const bool_t unanchored, const uint32_t dstate)
+{
+    const DFA *dfa = NULL;
+    cassert_no_null(nfa);
+    dfa = unanchored == TRUE ? nfa->udfa : nfa->dfa;
+    cassert_no_null(dfa);
+    return arrpt_get_const(dfa->dstates, dstate, DState)->accept;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void nfa_dfa_states(const NFA *nfa, const bool_t unanchored, const uint32_t dstate, ArrSt(uint32_t) *states)
+{
+    const DFA *dfa = NULL;
+    const DState *cstate = NULL;
+    uint32_t n = 0;
+    cassert_no_null(nfa);
+    dfa = unanchored == TRUE ? nfa->udfa : nfa->dfa;
+    cassert_no_null(dfa);
+    cstate = arrpt_get_const(dfa->dstates, dstate, DState);
+    n = cstate->nstates;
+    /* The live mark is always the last (greatest) value */
+    if (n > 0 && cstate->states[n - 1] == arrst_size(nfa->ttable, Trans))
+        n -= 1;
+    arrst_clear(states, NULL, uint32_t);
+    arrst_grow(states, n, uint32_t);
+    bmem_copy_n(arrst_all(states, uint32_t), cstate->states, n, uint32_t);
+}
@@ -12,6 +12,10 @@
 
 #include "core.ixx"
 
+/* Lazy DFA special states */
+#define NFA_DEAD    UINT32_MAX
+#define NFA_FULL    (UINT32_MAX - 1)
+
 __EXTERN_C
 
 NFA *nfa_string(const char_t *str);
@@ -26,5 +30,19 @@ bool_t nfa_next(NFA *nfa, const uint32_t codepoint);
 
 bool_t nfa_accept(NFA *nfa);
 
+void nfa_set_start(const NFA *nfa, ArrSt(uint32_t) *states);
+
+void nfa_set_next(const NFA *nfa, const ArrSt(uint32_t) *current, ArrSt(uint32_t) *next, const uint32_t codepoint);
+
+bool_t nfa_set_accept(const NFA *nfa, const ArrSt(uint32_t) *states);
+
+uint32_t nfa_dfa_start(NFA *nfa, const bool_t unanchored);
+
+uint32_t nfa_dfa_next(NFA *nfa, const bool_t unanchored, const uint32_t dstate, const uint32_t codepoint);
+
+bool_t nfa_dfa_accept(const NFA *nfa, const bool_t unanchored, const uint32_t dstate);
+
+void nfa_dfa_states(const NFA *nfa, const bool_t unanchored, const uint32_t dstate, ArrSt(uint32_t) *states);
+
 __END_C
 
@@ -30,6 +30,7 @@ typedef struct i_iterator_t i_Iterator;
 struct i_node_t
 {
     i_type_t type;
+    uint32_t size;
     i_Node *lnode;
     i_Node *rnode;
 };
@@ -38,6 +39,10 @@ struct i_node_t
     ((void)((i_Node*)node == node),\
     ((byte_t*)node + sizeof(i_Node)))
 
+/* Number of elements in the subtree (order statistics) */
+#define i_SIZE(node)\
+    ((node) != NULL ? (node)->size : 0)
+
 struct i_iterator_t
 {
     uint16_t path_size;
@@ -61,6 +66,7 @@ static i_Node *i_create_node(const uint16_t esize, const uint16_t ksize)
 {
     i_Node *node = (i_Node*)heap_malloc(sizeof32(i_Node) + esize + ksize, "RBNode");
     node->type = i_RED_NODE;
+    node->size = 1;
     node->lnode = NULL;
     node->rnode = NULL;    
     return node;
@@ -311,144 +317,168 @@ byte_t *rbtree_get(const RBTree *tree, const void *key, const bool_t isptr)
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_first(i_Node *root, i_Iterator *it)
+static uint32_t i_path_first(i_Node *root, i_NodePt *path)
 {
-    if (root != NULL)
-    {
-        i_Node *lnode = root->lnode;
-        cassert_no_null(it);
-        it->path_size = 1;
-        it->path[0] = root;
-        while (lnode != NULL)
-        {
-            it->path[it->path_size] = lnode;
-            it->path_size += 1;
-            lnode = lnode->lnode;
-        }
-
-        return TRUE;
-    }
-    else
+    register uint32_t size = 0;
+    register i_Node *node = root;
+    cassert_no_null(path);
+    while (node != NULL)
     {
-        it->path_size = 0;
-        return FALSE;
+        path[size] = node;
+        size += 1;
+        node = node->lnode;
     }
+
+    return size;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_last(i_Node *root, i_Iterator *it)
+static uint32_t i_path_last(i_Node *root, i_NodePt *path)
 {
-    if (root != NULL)
-    {
-        i_Node *rnode = root->rnode;
-        cassert_no_null(it);
-        it->path_size = 1;
-        it->path[0] = root;
-        while (rnode != NULL)
-        {
-            it->path[it->path_size] = rnode;
-            it->path_size += 1;
-            rnode = rnode->rnode;
-        }
-
-        return TRUE;
-    }
-    else
+    register uint32_t size = 0;
+    register i_Node *node = root;
+    cassert_no_null(path);
+    while (node != NULL)
     {
-        it->path_size = 0;
-        return FALSE;
+        path[size] = node;
+        size += 1;
+        node = node->rnode;
     }
+
+    return size;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_inorder_next(i_Iterator *it)
+static uint32_t i_path_next(i_NodePt *path, uint32_t size)
 {
-    i_Node *cnode = i_cnode(it);
+    i_Node *cnode = NULL;
+    cassert_no_null(path);
+    cassert(size > 0);
+    cnode = path[size - 1];
     cassert_no_null(cnode);
     if (cnode->rnode != NULL)
     {
         cnode = cnode->rnode;
-        it->path[it->path_size] = cnode;
-        it->path_size += 1;
+        path[size] = cnode;
+        size += 1;
 
         while (cnode->lnode != NULL)
         {
-            cassert(it->path_size <= it->path_alloc);
             cnode = cnode->lnode;
-            it->path[it->path_size] = cnode;
-            it->path_size += 1;            
+            path[size] = cnode;
+            size += 1;            
         }
 
-        return TRUE;
+        return size;
     }
     else
     {
-        while (it->path_size > 1)
+        while (size > 1)
         {
             i_Node *parent;
-            it->path_size -= 1;
-            parent = it->path[it->path_size - 1];
+            size -= 1;
+            parent = path[size - 1];
             cassert_no_null(parent);
             
             if (parent->lnode == cnode)
-                return TRUE;
+                return size;
             else
                 cnode = parent;
         }
 
         /*! <We are in the last inorder element> */
-        it->path_size = 0;
-        return FALSE;
+        return 0;
     }
 }
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_inorder_prev(i_Iterator *it)
+static uint32_t i_path_prev(i_NodePt *path, uint32_t size)
 {
-    i_Node *cnode = i_cnode(it);
+    i_Node *cnode = NULL;
+    cassert_no_null(path);
+    cassert(size > 0);
+    cnode = path[size - 1];
     cassert_no_null(cnode);
     if (cnode->lnode != NULL)
     {
         cnode = cnode->lnode;
-        it->path[it->path_size] = cnode;
-        it->path_size += 1;
+        path[size] = cnode;
+        size += 1;
 
         while (cnode->rnode != NULL)
         {
-            cassert(it->path_size <= it->path_alloc);
             cnode = cnode->rnode;
-            it->path[it->path_size] = cnode;
-            it->path_size += 1;            
+            path[size] = cnode;
+            size += 1;            
         }
 
-        return TRUE;
+        return size;
     }
     else
     {
-        while (it->path_size > 1)
+        while (size > 1)
         {
             i_Node *parent;
-            it->path_size -= 1;
-            parent = it->path[it->path_size - 1];
+            size -= 1;
+            parent = path[size - 1];
             cassert_no_null(parent);
             
             if (parent->rnode == cnode)
-                return TRUE;
+                return size;
             else
                 cnode = parent;
         }
 
         /*! <We are in the first inorder element> */
-        it->path_size = 0;
-        return FALSE;
+        return 0;
     }
 }
 
 /*---------------------------------------------------------------------------*/
 
+static bool_t i_first(i_Node *root, i_Iterator *it)
+{
+    cassert_no_null(it);
+    it->path_size = (uint16_t)i_path_first(root, it->path);
+    cassert(it->path_size <= it->path_alloc);
+    return (bool_t)(it->path_size > 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_last(i_Node *root, i_Iterator *it)
+{
+    cassert_no_null(it);
+    it->path_size = (uint16_t)i_path_last(root, it->path);
+    cassert(it->path_size <= it->path_alloc);
+    return (bool_t)(it->path_size > 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_inorder_next(i_Iterator *it)
+{
+    cassert_no_null(i_cnode(it));
+    it->path_size = (uint16_t)i_path_next(it->path, it->path_size);
+    cassert(it->path_size <= it->path_alloc);
+    return (bool_t)(it->path_size > 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_inorder_prev(i_Iterator *it)
+{
+    cassert_no_null(i_cnode(it));
+    it->path_size = (uint16_t)i_path_prev(it->path, it->path_size);
+    cassert(it->path_size <= it->path_alloc);
+    return (bool_t)(it->path_size > 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
 static __INLINE void i_rotate_left(i_Node *node, i_Node *parent, i_Node **root)
 {
     i_Node *rnode;    
@@ -457,6 +487,8 @@ static __INLINE void i_rotate_left(i_Node *node, i_Node *parent, i_Node **root)
     cassert_no_null(rnode);
     node->rnode = rnode->lnode;
     rnode->lnode = node;
+    rnode->size = node->size;
+    node->size = 1 + i_SIZE(node->lnode) + i_SIZE(node->rnode);
 
     if (__TRUE_EXPECTED(parent != NULL))
     {
@@ -488,6 +520,8 @@ static __INLINE void i_rotate_right(i_Node *node, i_Node *parent, i_Node **root)
     cassert_no_null(lnode);
     node->lnode = lnode->rnode;
     lnode->rnode = node;
+    lnode->size = node->size;
+    node->size = 1 + i_SIZE(node->lnode) + i_SIZE(node->rnode);
 
     if (__TRUE_EXPECTED(parent != NULL))
     {
@@ -656,6 +690,12 @@ static i_Node *i_insert_node(
                 parent->rnode = new_node;
             }
 
+            {
+                register uint32_t i;
+                for (i = 0; i < it->path_size; ++i)
+                    it->path[i]->size += 1;
+            }
+
             i_update_iterator_size(1 + elems, it);
             cassert(it->path_size < it->path_alloc);
             it->path[it->path_size] = new_node;
@@ -918,6 +958,12 @@ static bool_t i_delete_element(
                 deleted_node = mark_for_delete;
             }
 
+            {
+                register uint32_t i;
+                for (i = 0; i < it->path_size - 1; ++i)
+                    it->path[i]->size -= 1;
+            }
+
             /*! <Deleted_node isn't the root> */
             if (__TRUE_EXPECTED(it->path_size > 1))
             {
@@ -1049,6 +1095,208 @@ bool_t rbtree_delete_ptr(RBTree *tree, const void *key, FPtr_destroy func_destro
 
 /*---------------------------------------------------------------------------*/
 
+/* Balanced tree from in-order nodes. All levels are full except the last, whose nodes are red */
+static i_Node *i_build_tree(i_NodePt *nodes, const uint32_t n, const uint32_t depth, const uint32_t height)
+{
+    if (n > 0)
+    {
+        register uint32_t mid = n / 2;
+        i_Node *node = nodes[mid];
+        node->lnode = i_build_tree(nodes, mid, depth + 1, height);
+        node->rnode = i_build_tree(nodes + mid + 1, n - mid - 1, depth + 1, height);
+        node->size = n;
+        node->type = (depth + 1 == height && height > 1) ? i_RED_NODE : i_BLACK_NODE;
+        return node;
+    }
+
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+RBTree *rbtree_from_sorted(FPtr_compare func_compare, const byte_t *elems, const uint32_t n, const uint16_t esize, const bool_t isptr, const char_t *type)
+{
+    RBTree *tree = rbtree_create(func_compare, esize, 0, type);
+    if (n > 0)
+    {
+        i_NodePt *nodes = heap_new_n(n, i_NodePt);
+        register uint32_t i;
+        cassert_no_null(elems);
+        for (i = 0; i < n; ++i)
+        {
+            const byte_t *elem = elems + i * esize;
+            #if defined (__ASSERTS__)
+            if (i > 0)
+            {
+                const byte_t *prev = elem - esize;
+                cassert_msg(func_compare(isptr ? *(byte_t**)prev : prev, isptr ? *(byte_t**)elem : elem) < 0, "Elements not sorted or duplicated");
+            }
+            #else
+            unref(isptr);
+            #endif
+            nodes[i] = i_create_node(esize, 0);
+            bmem_copy(i_NODE_DATA(nodes[i]), elem, esize);
+        }
+
+        tree->root = i_build_tree(nodes, n, 0, i_log2(n));
+        tree->elems = n;
+        i_update_iterator_size(n, &tree->it);
+        heap_delete_n(&nodes, n, i_NodePt);
+    }
+
+    return tree;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Number of elements lower than 'key' */
+static uint32_t i_rank(const RBTree *tree, const void *key, const bool_t isptr)
+{
+    register const i_Node *node = tree->root;
+    register uint32_t rank = 0;
+    cassert_no_nullf(tree->func_compare);
+    while (node != NULL)
+    {
+        const byte_t *cdata = i_NODE_DATA(node);
+        if (tree->func_compare(isptr == TRUE ? *((byte_t**)cdata) : cdata, key) < 0)
+        {
+            rank += 1 + i_SIZE(node->lnode);
+            node = node->rnode;
+        }
+        else
+        {
+            node = node->lnode;
+        }
+    }
+
+    return rank;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Element at in-order position 'pos' */
+static i_Node *i_select(i_Node *root, uint32_t pos)
+{
+    register i_Node *node = root;
+    while (node != NULL)
+    {
+        register uint32_t lsize = i_SIZE(node->lnode);
+        if (pos < lsize)
+        {
+            node = node->lnode;
+        }
+        else if (pos > lsize)
+        {
+            pos -= lsize + 1;
+            node = node->rnode;
+        }
+        else
+        {
+            return node;
+        }
+    }
+
+    cassert(FALSE);
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t rbtree_count_range(const RBTree *tree, const void *lo, const void *hi, const bool_t isptr)
+{
+    uint32_t first, last;
+    cassert_no_null(tree);
+    first = i_rank(tree, lo, isptr);
+    last = i_rank(tree, hi, isptr);
+    return last > first ? last - first : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_delete_range(
+                        RBTree *tree, 
+                        const void *lo, 
+                        const void *hi, 
+                        const bool_t isptr,
+                        FPtr_remove func_remove,
+                        FPtr_destroy func_destroy,
+                        FPtr_destroy func_destroy_key)
+{
+    uint32_t first, last, n;
+    cassert_no_null(tree);
+    first = i_rank(tree, lo, isptr);
+    last = i_rank(tree, hi, isptr);
+    if (last <= first)
+        return 0;
+
+    n = last - first;
+
+    /* Few elements: Delete one by one O(k log n) */
+    if (n * i_log2(tree->elems) < tree->elems)
+    {
+        register uint32_t i;
+        for (i = 0; i < n; ++i)
+        {
+            i_Node *node = i_select(tree->root, first);
+            const byte_t *cdata = i_NODE_DATA(node);
+            const void *key = isptr == TRUE ? *((byte_t**)cdata) : cdata;
+            bool_t deleted = i_delete_element(&tree->root, tree->elems, key, isptr, tree->func_compare, &tree->it, tree->esize, tree->ksize, func_remove, func_destroy, func_destroy_key);
+            cassert_unref(deleted == TRUE, deleted);
+            tree->elems -= 1;
+        }
+    }
+    /* Many elements: Rebuild the tree with the survivors O(n) */
+    else
+    {
+        i_NodePt *nodes = heap_new_n(tree->elems, i_NodePt);
+        uint32_t i = 0, j = 0, size = i_path_first(tree->root, tree->it.path);
+        while (size > 0)
+        {
+            nodes[i++] = tree->it.path[size - 1];
+            size = i_path_next(tree->it.path, size);
+        }
+
+        cassert(i == tree->elems);
+        for (i = 0; i < tree->elems; ++i)
+        {
+            if (i >= first && i < last)
+            {
+                i_destroy_node_data(nodes[i], __DEBUG_PARAMC(tree->esize) tree->ksize, func_remove, func_destroy, func_destroy_key);
+                i_dealloc_node(&nodes[i], tree->esize, tree->ksize);
+            }
+            else
+            {
+                nodes[j++] = nodes[i];
+            }
+        }
+
+        cassert(j == tree->elems - n);
+        tree->root = i_build_tree(nodes, j, 0, j > 0 ? i_log2(j) : 0);
+        heap_delete_n(&nodes, tree->elems, i_NodePt);
+        tree->elems = j;
+        i_update_iterator_size(j, &tree->it);
+    }
+
+    tree->it.path_size = 0;
+    return n;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t rbtree_delete_range(RBTree *tree, const void *lo, const void *hi, FPtr_remove func_remove, FPtr_destroy func_destroy_key)
+{
+    return i_delete_range(tree, lo, hi, FALSE, func_remove, NULL, func_destroy_key);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t rbtree_delete_range_ptr(RBTree *tree, const void *lo, const void *hi, FPtr_destroy func_destroy, FPtr_destroy func_destroy_key)
+{
+    return i_delete_range(tree, lo, hi, TRUE, NULL, func_destroy, func_destroy_key);
+}
+
+/*---------------------------------------------------------------------------*/
+
 byte_t *rbtree_first(RBTree *tree)
 {
     cassert_no_null(tree);
@@ -1154,6 +1402,147 @@ const char_t *rbtree_get_key(const RBTree *tree)
 
 /*---------------------------------------------------------------------------*/
 
+static byte_t *i_iter_elem(const RBIter *iter)
+{
+    cassert_no_null(iter);
+    cassert(iter->size <= sizeof(iter->path) / sizeof(void*));
+    if (iter->size > 0)
+    {
+        byte_t *elem = i_NODE_DATA((i_Node*)iter->path[iter->size - 1]) + iter->tree->ksize;
+        return iter->isptr == TRUE ? *((byte_t**)elem) : elem;
+    }
+
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_iter_init(const RBTree *tree, RBIter *iter, const bool_t isptr)
+{
+    cassert_no_null(tree);
+    cassert_no_null(iter);
+    iter->tree = tree;
+    iter->isptr = isptr;
+    iter->size = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+byte_t *rbtree_iter_begin(const RBTree *tree, RBIter *iter, const bool_t isptr)
+{
+    i_iter_init(tree, iter, isptr);
+    iter->size = i_path_first(tree->root, (i_NodePt*)iter->path);
+    return i_iter_elem(iter);
+}
+
+/*---------------------------------------------------------------------------*/
+
+byte_t *rbtree_iter_end(const RBTree *tree, RBIter *iter, const bool_t isptr)
+{
+    i_iter_init(tree, iter, isptr);
+    iter->size = i_path_last(tree->root, (i_NodePt*)iter->path);
+    return i_iter_elem(iter);
+}
+
+/*---------------------------------------------------------------------------*/
+
+byte_t *rbtree_iter_next(RBIter *iter)
+{
+    cassert_no_null(iter);
+    if (iter->size > 0)
+        iter->size = i_path_next((i_NodePt*)iter->path, iter->size);
+    return i_iter_elem(iter);
+}
+
+/*---------------------------------------------------------------------------*/
+
+byte_t *rbtree_iter_prev(RBIter *iter)
+{
+    cassert_no_null(iter);
+    if (iter->size > 0)
+        iter->size = i_path_prev((i_NodePt*)iter->path, iter->size);
+    return i_iter_elem(iter);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 'bound' 0: Equal, 1: Lower bound (first >= key), 2: Upper bound (first > key) */
+static byte_t *i_iter_seek(const RBTree *tree, RBIter *iter, const void *key, const bool_t isptr, const uint32_t bound)
+{
+    register i_Node *node = NULL;
+    register uint32_t size = 0;
+    i_iter_init(tree, iter, isptr);
+    cassert_no_nullf(tree->func_compare);
+    node = tree->root;
+    while (node != NULL)
+    {
+        const byte_t *cdata = i_NODE_DATA(node);
+        int compare = tree->func_compare(isptr == TRUE ? *((byte_t**)cdata) : cdata, key);
+        iter->path[size] = node;
+        size += 1;
+        if (compare == 0 && bound != 2)
+        {
+            iter->size = size;
+            break;
+        }
+
+        if (compare > 0)
+        {
+            /* Candidate. A better one could be in the left subtree */
+            if (bound != 0)
+                iter->size = size;
+            node = node->lnode;
+        }
+        else
+        {
+            node = node->rnode;
+        }
+    }
+
+    return i_iter_elem(iter);
+}
+
+/*---------------------------------------------------------------------------*/
+
+byte_t *rbtree_iter_seek(const RBTree *tree, RBIter *iter, const void *key, const bool_t isptr)
+{
+    return i_iter_seek(tree, iter, key, isptr, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+byte_t *rbtree_iter_lower(const RBTree *tree, RBIter *iter, const void *key, const bool_t isptr)
+{
+    return i_iter_seek(tree, iter, key, isptr, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+
+byte_t *rbtree_iter_upper(const RBTree *tree, RBIter *iter, const void *key, const bool_t isptr)
+{
+    return i_iter_seek(tree, iter, key, isptr, 2);
+}
+
+/*---------------------------------------------------------------------------*/
+
+const char_t *rbtree_iter_key(const RBIter *iter)
+{
+    cassert_no_null(iter);
+    if (iter->size > 0)
+    {
+        const String *str = NULL;
+        cassert(iter->tree->ksize > 0);
+        str = *(String**)i_NODE_DATA((i_Node*)iter->path[iter->size - 1]);
+        return i_tochar(str);
+    }
+    else
+    {
+        return NULL;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void i_check_in_depth(
                         const i_Node *node, 
                         uint32_t path_accum, 
@@ -1168,11 +1557,13 @@ static void i_check_in_depth(
     cassert_no_null(max_depth);
 
     path_accum += 1;
+    cassert(node->size == 1 + i_SIZE(node->lnode) + i_SIZE(node->rnode));
 
     if (node->type == i_BLACK_NODE)
         black_path_accum += 1;
 
-    if (node->lnode == NULL && node->rnode == NULL)
+    /* Paths end at any NULL link, not only at leaves */
+    if (node->lnode == NULL || node->rnode == NULL)
     {
         if (path_accum < *min_depth)
             *min_depth = path_accum;
@@ -1185,23 +1576,21 @@ static void i_check_in_depth(
         else
             cassert(black_path_accum == *black_depth);
     }
-    else
+
+    if (node->lnode != NULL)
     {
-        if (node->lnode != NULL)
-        {
-            if (node->type == i_RED_NODE)
-                cassert(node->lnode->type == i_BLACK_NODE);
+        if (node->type == i_RED_NODE)
+            cassert(node->lnode->type == i_BLACK_NODE);
 
-            i_check_in_depth(node->lnode, path_accum, black_path_accum, black_depth, min_depth, max_depth);
-        }
+        i_check_in_depth(node->lnode, path_accum, black_path_accum, black_depth, min_depth, max_depth);
+    }
 
-        if (node->rnode != NULL)
-        {
-            if (node->type == i_RED_NODE)
-                cassert(node->rnode->type == i_BLACK_NODE);
+    if (node->rnode != NULL)
+    {
+        if (node->type == i_RED_NODE)
+            cassert(node->rnode->type == i_BLACK_NODE);
 
-            i_check_in_depth(node->rnode, path_accum, black_path_accum, black_depth, min_depth, max_depth);
-        }
+        i_check_in_depth(node->rnode, path_accum, black_path_accum, black_depth, min_depth, max_depth);
     }
 }
 
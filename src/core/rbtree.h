@@ -16,6 +16,8 @@ __EXTERN_C
 
 RBTree *rbtree_create(FPtr_compare func_compare, const uint16_t esize, const uint16_t ksize, const char_t *type);
 
+RBTree *rbtree_from_sorted(FPtr_compare func_compare, const byte_t *elems, const uint32_t n, const uint16_t esize, const bool_t isptr, const char_t *type);
+
 void rbtree_destroy(RBTree **tree, FPtr_remove func_remove, FPtr_destroy func_destroy_key, const char_t *type);
 
 void rbtree_destroy_ptr(RBTree **tree, FPtr_destroy func_destroy, FPtr_destroy func_destroy_key, const char_t *type);
@@ -32,6 +34,12 @@ bool_t rbtree_delete(RBTree *tree, const void *key, FPtr_remove func_remove, FPt
 
 bool_t rbtree_delete_ptr(RBTree *tree, const void *key, FPtr_destroy func_destroy, FPtr_destroy func_destroy_key);
 
+uint32_t rbtree_delete_range(RBTree *tree, const void *lo, const void *hi, FPtr_remove func_remove, FPtr_destroy func_destroy_key);
+
+uint32_t rbtree_delete_range_ptr(RBTree *tree, const void *lo, const void *hi, FPtr_destroy func_destroy, FPtr_destroy func_destroy_key);
+
+uint32_t rbtree_count_range(const RBTree *tree, const void *lo, const void *hi, const bool_t isptr);
+
 byte_t *rbtree_first(RBTree *tree);
 
 byte_t *rbtree_last(RBTree *tree);
@@ -50,6 +58,22 @@ byte_t *rbtree_prev_ptr(RBTree *tree);
 
 const char_t *rbtree_get_key(const RBTree *tree);
 
+byte_t *rbtree_iter_begin(const RBTree *tree, RBIter *iter, const bool_t isptr);
+
+byte_t *rbtree_iter_end(const RBTree *tree, RBIter *iter, const bool_t isptr);
+
+byte_t *rbtree_iter_next(RBIter *iter);
+
+byte_t *rbtree_iter_prev(RBIter *iter);
+
+byte_t *rbtree_iter_seek(const RBTree *tree, RBIter *iter, const void *key, const bool_t isptr);
+
+byte_t *rbtree_iter_lower(const RBTree *tree, RBIter *iter, const void *key, const bool_t isptr);
+
+byte_t *rbtree_iter_upper(const RBTree *tree, RBIter *iter, const void *key, const bool_t isptr);
+
+const char_t *rbtree_iter_key(const RBIter *iter);
+
 bool_t rbtree_check(const RBTree *tree);
 
 __END_C
@@ -12,8 +12,63 @@
 
 #include "regex.h"
 #include "nfa.inl"
+#include "arrst.h"
+#include "bmem.h"
+#include "cassert.h"
+#include "heap.h"
+#include "ptr.h"
+#include "stream.h"
 #include "unicode.h"
 
+typedef struct _run_t i_Run;
+typedef enum _search_t
+{
+    i_ekFOUND,
+    i_ekNOT_FOUND,
+    i_ekMORE
+} search_t;
+
+struct _run_t
+{
+    NFA *nfa;
+    uint32_t state;
+    bool_t unanchored;
+    bool_t simulated;
+    ArrSt(uint32_t) *current;
+    ArrSt(uint32_t) *temp;
+};
+
+/* The search is done in two phases. First, an unanchored run ('run') scans the data
+   once, until some match ends. Then, anchored runs from the candidate starts
+   [cand, scan] find the leftmost-longest match. No match starts before 'reset' */
+struct _regexit_t
+{
+    NFA *nfa;
+    Stream *stm;
+    const byte_t *data;
+    byte_t *buffer;
+    uint32_t capacity;
+    uint32_t size;
+    uint32_t pos;
+    uint32_t scan;
+    uint32_t reset;
+    uint32_t cand;
+    uint32_t empty;
+    uint64_t offset;
+    i_Run run;
+    bool_t started;
+    bool_t pending;
+    bool_t eof;
+    bool_t truncated;
+};
+
+#define i_NO_POS        UINT32_MAX
+
+/* Stream window. It grows while an open match needs the old bytes, up to the max size.
+   Beyond it, matches longer than half max window are truncated (regex_iter_truncated) */
+#define i_WINDOW_SIZE   (64 * 1024)
+#define i_WINDOW_MAX    (16 * 1024 * 1024)
+
 //RegEx *regex = regex_create("000_OCR_OK_01_.*\\.png");
 //bool_t ok1 = regex_match(regex, "000_OCR_OK_01_001.png");
 //bool_t ok2 = regex_match(regex, "000_OCR_OK_01_001spng");
@@ -48,19 +103,499 @@ void regex_destroy(RegEx **regex)
 
 /*---------------------------------------------------------------------------*/
 
+static bool_t i_run_start(i_Run *run, NFA *nfa, const bool_t unanchored)
+{
+    cassert_no_null(run);
+    run->nfa = nfa;
+    run->state = nfa_dfa_start(nfa, unanchored);
+    run->unanchored = unanchored;
+    run->simulated = FALSE;
+    run->current = NULL;
+    run->temp = NULL;
+    return nfa_dfa_accept(nfa, unanchored, run->state);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_run_end(i_Run *run)
+{
+    cassert_no_null(run);
+    if (run->simulated == TRUE)
+    {
+        arrst_destroy(&run->current, NULL, uint32_t);
+        arrst_destroy(&run->temp, NULL, uint32_t);
+        run->simulated = FALSE;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_run_next(i_Run *run, const uint32_t codepoint)
+{
+    cassert_no_null(run);
+    if (run->simulated == FALSE)
+    {
+        uint32_t next = nfa_dfa_next(run->nfa, run->unanchored, run->state, codepoint);
+        if (next == NFA_DEAD)
+            return FALSE;
+
+        if (next != NFA_FULL)
+        {
+            run->state = next;
+            return TRUE;
+        }
+
+        /* DFA cache memory exhausted: Continue with the NFA simulation.
+           Each run has its own state sets, because several runs can be alive */
+        run->current = arrst_create(uint32_t);
+        run->temp = arrst_create(uint32_t);
+        nfa_dfa_states(run->nfa, run->unanchored, run->state, run->current);
+        run->simulated = TRUE;
+    }
+
+    nfa_set_next(run->nfa, run->current, run->temp, codepoint);
+    if (run->unanchored == TRUE)
+        nfa_set_start(run->nfa, run->temp);
+    bmem_swap_type(&run->current, &run->temp, ArrSt(uint32_t)*);
+    return (bool_t)(arrst_size(run->current, uint32_t) > 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_run_accept(const i_Run *run)
+{
+    cassert_no_null(run);
+    if (run->simulated == FALSE)
+        return nfa_dfa_accept(run->nfa, run->unanchored, run->state);
+    return nfa_set_accept(run->nfa, run->current);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* In unanchored runs, the start state is only reached again when all threads died */
+static bool_t i_run_restart(const i_Run *run)
+{
+    cassert_no_null(run);
+    cassert(run->unanchored == TRUE);
+    return (bool_t)(run->simulated == FALSE && run->state == 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
 bool_t regex_match(const RegEx *regex, const char_t *str)
 {
+    i_Run run;
     uint32_t codepoint;
-    nfa_start((NFA*)regex);
+    bool_t match;
+    i_run_start(&run, (NFA*)regex, FALSE);
     codepoint = unicode_to_u32(str, ekUTF8);
     while(codepoint != 0)
     {
-        if (nfa_next((NFA*)regex, codepoint) == FALSE)
+        if (i_run_next(&run, codepoint) == FALSE)
+        {
+            i_run_end(&run);
             return FALSE;
+        }
 
         str = unicode_next(str, ekUTF8);
         codepoint = unicode_to_u32(str, ekUTF8);
     }
 
-    return nfa_accept((NFA*)regex);
+    match = i_run_accept(&run);
+    i_run_end(&run);
+    return match;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Bounded UTF-8 decoding. Returns 0 bytes if the sequence is cut at the end of buffer.
+   Malformed bytes are taken as single codepoints (logs are not always valid UTF-8) */
+static uint32_t i_decode(const byte_t *data, const uint32_t size, uint32_t *codepoint)
+{
+    register uint32_t n = 1, i;
+    cassert(size > 0);
+    cassert_no_null(codepoint);
+    if (data[0] < 0x80)
+    {
+        *codepoint = (uint32_t)data[0];
+        return 1;
+    }
+
+    if ((data[0] & 0xE0) == 0xC0)
+    {
+        n = 2;
+        *codepoint = (uint32_t)(data[0] & 0x1F);
+    }
+    else if ((data[0] & 0xF0) == 0xE0)
+    {
+        n = 3;
+        *codepoint = (uint32_t)(data[0] & 0x0F);
+    }
+    else if ((data[0] & 0xF8) == 0xF0)
+    {
+        n = 4;
+        *codepoint = (uint32_t)(data[0] & 0x07);
+    }
+    else
+    {
+        *codepoint = (uint32_t)data[0];
+        return 1;
+    }
+
+    if (n > size)
+        return 0;
+
+    for (i = 1; i < n; ++i)
+    {
+        if ((data[i] & 0xC0) != 0x80)
+        {
+            *codepoint = (uint32_t)data[0];
+            return 1;
+        }
+
+        *codepoint = (*codepoint << 6) | (uint32_t)(data[i] & 0x3F);
+    }
+
+    return n;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Next codepoint of the window. Returns 0 bytes if the sequence is cut and the data continues */
+static uint32_t i_next(const RegExIt *iter, const uint32_t pos, uint32_t *codepoint)
+{
+    uint32_t n = 0;
+    cassert_no_null(iter);
+    cassert(pos < iter->size);
+    n = i_decode(iter->data + pos, iter->size - pos, codepoint);
+    if (n == 0 && iter->eof == TRUE)
+    {
+        *codepoint = (uint32_t)iter->data[pos];
+        n = 1;
+    }
+
+    return n;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Phase 1: Single unanchored pass, until a (non repeated) match ends at 'scan' */
+static search_t i_scan(RegExIt *iter)
+{
+    cassert_no_null(iter);
+    cassert(iter->pending == FALSE);
+    if (iter->started == FALSE)
+    {
+        bool_t accept = i_run_start(&iter->run, iter->nfa, TRUE);
+        iter->started = TRUE;
+        iter->scan = iter->pos;
+        iter->reset = iter->pos;
+        if (accept == TRUE && iter->scan != iter->empty)
+        {
+            iter->pending = TRUE;
+            iter->cand = iter->pos;
+            return i_ekFOUND;
+        }
+    }
+
+    while (iter->scan < iter->size)
+    {
+        uint32_t codepoint;
+        uint32_t n = i_next(iter, iter->scan, &codepoint);
+        bool_t alive;
+        if (n == 0)
+            return i_ekMORE;
+
+        alive = i_run_next(&iter->run, codepoint);
+        cassert_unref(alive == TRUE, alive);
+        iter->scan += n;
+
+        if (i_run_restart(&iter->run) == TRUE)
+            iter->reset = iter->scan;
+
+        if (i_run_accept(&iter->run) == TRUE && iter->scan != iter->empty)
+        {
+            iter->pending = TRUE;
+            iter->cand = iter->pos > iter->reset ? iter->pos : iter->reset;
+            return i_ekFOUND;
+        }
+    }
+
+    return iter->eof == TRUE ? i_ekNOT_FOUND : i_ekMORE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Phase 2: Leftmost-longest match from the candidates [cand, scan].
+   'empty' avoids repeating an empty match at that position */
+static search_t i_leftmost(RegExIt *iter, uint32_t *start, uint32_t *end)
+{
+    cassert_no_null(iter);
+    cassert_no_null(start);
+    cassert_no_null(end);
+    cassert(iter->pending == TRUE);
+    while (iter->cand <= iter->scan)
+    {
+        i_Run run;
+        register uint32_t p = iter->cand;
+        uint32_t last = i_NO_POS;
+        uint32_t codepoint, n;
+        bool_t alive = TRUE;
+
+        if (i_run_start(&run, iter->nfa, FALSE) == TRUE)
+            last = p;
+
+        while (p < iter->size)
+        {
+            n = i_next(iter, p, &codepoint);
+            if (n == 0)
+                break;
+
+            if (i_run_next(&run, codepoint) == FALSE)
+            {
+                alive = FALSE;
+                break;
+            }
+
+            p += n;
+            if (i_run_accept(&run) == TRUE)
+                last = p;
+        }
+
+        i_run_end(&run);
+
+        /* The match could continue in the next data block,
+           unless the candidate is at the beginning of a full max window */
+        if (alive == TRUE && iter->eof == FALSE)
+        {
+            if (iter->cand > 0 || iter->size < i_WINDOW_MAX)
+                return i_ekMORE;
+
+            iter->truncated = TRUE;
+        }
+
+        if (last != i_NO_POS && (last > iter->cand || iter->cand != iter->empty))
+        {
+            *start = iter->cand;
+            *end = last;
+            return i_ekFOUND;
+        }
+
+        if (iter->cand == iter->size)
+            break;
+
+        n = i_decode(iter->data + iter->cand, iter->size - iter->cand, &codepoint);
+        iter->cand += n > 0 ? n : 1;
+    }
+
+    return i_ekNOT_FOUND;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static search_t i_search(RegExIt *iter, uint32_t *start, uint32_t *end)
+{
+    cassert_no_null(iter);
+    for(;;)
+    {
+        search_t res;
+        if (iter->pending == FALSE)
+        {
+            res = i_scan(iter);
+            if (res != i_ekFOUND)
+                return res;
+        }
+
+        res = i_leftmost(iter, start, end);
+        if (res == i_ekFOUND)
+        {
+            i_run_end(&iter->run);
+            iter->pos = *end;
+            iter->empty = *end;
+            iter->started = FALSE;
+            iter->pending = FALSE;
+            return i_ekFOUND;
+        }
+
+        if (res == i_ekMORE)
+            return i_ekMORE;
+
+        /* No candidate before 'scan' (window truncation): Continue the unanchored run */
+        iter->pending = FALSE;
+        iter->pos = iter->scan;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_iter_init(RegExIt *iter, const RegEx *regex, const byte_t *data, const uint32_t size, const bool_t eof)
+{
+    cassert_no_null(iter);
+    cassert_no_null(regex);
+    bmem_zero(iter, RegExIt);
+    iter->nfa = (NFA*)regex;
+    iter->data = data;
+    iter->size = size;
+    iter->empty = i_NO_POS;
+    iter->eof = eof;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t regex_search(const RegEx *regex, const char_t *str, const uint32_t size, uint32_t *start, uint32_t *end)
+{
+    RegExIt iter;
+    uint32_t pstart, pend;
+    search_t res;
+    cassert(str != NULL || size == 0);
+    i_iter_init(&iter, regex, (const byte_t*)str, size, TRUE);
+    res = i_search(&iter, &pstart, &pend);
+    i_run_end(&iter.run);
+    if (res == i_ekFOUND)
+    {
+        ptr_assign(start, pstart);
+        ptr_assign(end, pend);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+RegExIt *regex_iter_mem(const RegEx *regex, const char_t *str, const uint32_t size)
+{
+    RegExIt *iter = heap_new(RegExIt);
+    cassert(str != NULL || size == 0);
+    i_iter_init(iter, regex, (const byte_t*)str, size, TRUE);
+    return iter;
+}
+
+/*---------------------------------------------------------------------------*/
+
+RegExIt *regex_iter_stm(const RegEx *regex, Stream *stm)
+{
+    RegExIt *iter = heap_new(RegExIt);
+    byte_t *buffer = heap_new_n(i_WINDOW_SIZE, byte_t);
+    cassert_no_null(stm);
+    i_iter_init(iter, regex, buffer, 0, FALSE);
+    iter->stm = stm;
+    iter->buffer = buffer;
+    iter->capacity = i_WINDOW_SIZE;
+    return iter;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void regex_iter_destroy(RegExIt **iter)
+{
+    cassert_no_null(iter);
+    cassert_no_null(*iter);
+    i_run_end(&(*iter)->run);
+    if ((*iter)->buffer != NULL)
+        heap_delete_n(&(*iter)->buffer, (*iter)->capacity, byte_t);
+    heap_delete(iter, RegExIt);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint32_t i_shift(const uint32_t pos, const uint32_t keep)
+{
+    return pos > keep ? pos - keep : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Discards the window bytes that can't be part of a match and reads more stream data.
+   The window is doubled when the kept bytes take more than half of it, so each read
+   fills at least half window. The kept bytes are limited to half max window */
+static void i_refill(RegExIt *iter)
+{
+    uint32_t keep, remain, readed;
+    cassert_no_null(iter);
+    cassert_no_null(iter->stm);
+    cassert(iter->eof == FALSE);
+
+    if (iter->pending == TRUE)
+        keep = iter->cand;
+    else
+        keep = iter->pos > iter->reset ? iter->pos : iter->reset;
+
+    if (iter->scan - keep > i_WINDOW_MAX / 2)
+    {
+        keep = iter->scan - i_WINDOW_MAX / 2;
+        iter->truncated = TRUE;
+        /* Don't cut an UTF-8 sequence */
+        while (keep < iter->scan && (iter->buffer[keep] & 0xC0) == 0x80)
+            keep += 1;
+    }
+
+    cassert(keep <= iter->scan);
+    remain = iter->size - keep;
+    if (keep > 0)
+    {
+        if (remain > 0)
+            bmem_move(iter->buffer, iter->buffer + keep, remain);
+
+        iter->offset += keep;
+        iter->pos = i_shift(iter->pos, keep);
+        iter->scan -= keep;
+        iter->reset = i_shift(iter->reset, keep);
+        iter->cand = i_shift(iter->cand, keep);
+        if (iter->empty != i_NO_POS)
+            iter->empty = iter->empty >= keep ? iter->empty - keep : i_NO_POS;
+    }
+
+    while (remain > iter->capacity / 2 && iter->capacity < i_WINDOW_MAX)
+    {
+        uint32_t capacity = iter->capacity * 2;
+        iter->buffer = heap_realloc_n(iter->buffer, iter->capacity, capacity, byte_t);
+        iter->data = iter->buffer;
+        iter->capacity = capacity;
+    }
+
+    cassert(remain < iter->capacity);
+    readed = stm_read(iter->stm, iter->buffer + remain, iter->capacity - remain);
+    /* A short read is not the end (sockets, pipes) */
+    if (stm_state(iter->stm) != ekSTOK)
+        iter->eof = TRUE;
+
+    iter->size = remain + readed;
+}
+
+/*---------------------------------------------------------------------------*/
+
+const char_t *regex_iter_next(RegExIt *iter, uint32_t *size, uint64_t *offset)
+{
+    cassert_no_null(iter);
+    for(;;)
+    {
+        uint32_t start, end;
+        search_t res = i_search(iter, &start, &end);
+        if (res == i_ekFOUND)
+        {
+            ptr_assign(size, end - start);
+            ptr_assign(offset, iter->offset + start);
+            return (const char_t*)(iter->data + start);
+        }
+
+        if (res == i_ekNOT_FOUND)
+        {
+            cassert(iter->eof == TRUE);
+            iter->pos = iter->size;
+            return NULL;
+        }
+
+        cassert(res == i_ekMORE);
+        cassert(iter->stm != NULL);
+        i_refill(iter);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t regex_iter_truncated(const RegExIt *iter)
+{
+    cassert_no_null(iter);
+    return iter->truncated;
 }
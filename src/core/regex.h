@@ -21,4 +21,16 @@ void regex_destroy(RegEx **regex);
 
 bool_t regex_match(const RegEx *regex, const char_t *str);
 
+bool_t regex_search(const RegEx *regex, const char_t *str, const uint32_t size, uint32_t *start, uint32_t *end);
+
+RegExIt *regex_iter_mem(const RegEx *regex, const char_t *str, const uint32_t size);
+
+RegExIt *regex_iter_stm(const RegEx *regex, Stream *stm);
+
+void regex_iter_destroy(RegExIt **iter);
+
+const char_t *regex_iter_next(RegExIt *iter, uint32_t *size, uint64_t *offset);
+
+bool_t regex_iter_truncated(const RegExIt *iter);
+
 __END_C
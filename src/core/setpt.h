@@ -14,6 +14,9 @@
 #define setpt_create(func_compare, type)\
     setpt_##type##_create(func_compare, (uint16_t)sizeof(type*))
 
+#define setpt_from_sorted(func_compare, elems, n, type)\
+    setpt_##type##_from_sorted(func_compare, elems, n, (uint16_t)sizeof(type*))
+
 #define setpt_destroy(set, func_destroy, type)\
     setpt_##type##_destroy(set, func_destroy)
 
@@ -32,6 +35,12 @@
 #define setpt_delete(set, key, func_destroy, type)\
     setpt_##type##_delete(set, key, func_destroy)
 
+#define setpt_delete_range(set, lo, hi, func_destroy, type)\
+    setpt_##type##_delete_range(set, lo, hi, func_destroy)
+
+#define setpt_count_range(set, lo, hi, type)\
+    setpt_##type##_count_range(set, lo, hi)
+
 #define setpt_first(set, type)\
     setpt_##type##_first(set)
 
@@ -56,6 +65,27 @@
 #define setpt_prev_const(set, type)\
     setpt_##type##_prev_const(set)
 
+#define setpt_iter_begin(set, iter, type)\
+    setpt_##type##_iter_begin(set, iter)
+
+#define setpt_iter_end(set, iter, type)\
+    setpt_##type##_iter_end(set, iter)
+
+#define setpt_iter_next(iter, type)\
+    setpt_##type##_iter_next(iter)
+
+#define setpt_iter_prev(iter, type)\
+    setpt_##type##_iter_prev(iter)
+
+#define setpt_iter_seek(set, iter, key, type)\
+    setpt_##type##_iter_seek(set, iter, key)
+
+#define setpt_iter_lower(set, iter, key, type)\
+    setpt_##type##_iter_lower(set, iter, key)
+
+#define setpt_iter_upper(set, iter, key, type)\
+    setpt_##type##_iter_upper(set, iter, key)
+
 #define setpt_foreach(elem, set, type)\
     {\
         register type *elem = setpt_first(set, type);\
@@ -65,7 +95,8 @@
 
 #define setpt_foreach_const(elem, set, type)\
     {\
-        register const type *elem = setpt_first_const(set, type);\
+        RBIter elem##_it;\
+        register const type *elem = setpt_iter_begin(set, &elem##_it, type);\
         register uint32_t elem##_i = 0, elem##_total = setpt_size(set, type);\
         while (elem != NULL)\
         {
@@ -78,7 +109,7 @@
     }
 
 #define setpt_fornext_const(elem, set, type)\
-            elem = setpt_next_const(set, type);\
+            elem = setpt_iter_next(&elem##_it, type);\
             elem##_i += 1;\
             unref(elem##_total);\
         }\
@@ -15,6 +15,7 @@
 struct NodePt##type\
 {\
     uint32_t rb;\
+    uint32_t size;\
     struct NodePt##type *left;\
     struct NodePt##type *right;\
     type *data;\
@@ -38,6 +39,12 @@ static SetPt(type)* setpt_##type##_create(int(func_compare)(const type*, const t
     return (SetPt(type)*)rbtree_create((FPtr_compare)func_compare, esize, 0, (const char_t*)(SETPT#type));\
 }\
 \
+static __TYPECHECK SetPt(type)* setpt_##type##_from_sorted(int(func_compare)(const type*, const type*), type **elems, const uint32_t n, const uint16_t esize);\
+static SetPt(type)* setpt_##type##_from_sorted(int(func_compare)(const type*, const type*), type **elems, const uint32_t n, const uint16_t esize)\
+{\
+    return (SetPt(type)*)rbtree_from_sorted((FPtr_compare)func_compare, (const byte_t*)elems, n, esize, TRUE, (const char_t*)(SETPT#type));\
+}\
+\
 static __TYPECHECK void setpt_##type##_destroy(struct Set##Pt##type **set, void(func_destroy)(type**));\
 static void setpt_##type##_destroy(struct Set##Pt##type **set, void(func_destroy)(type**))\
 {\
@@ -74,6 +81,18 @@ static bool_t setpt_##type##_delete(struct Set##Pt##type *set, const type *key,
 	return rbtree_delete_ptr((RBTree*)set, (const void*)key, (FPtr_destroy)func_destroy, NULL);\
 }\
 \
+static __TYPECHECK uint32_t setpt_##type##_delete_range(struct Set##Pt##type *set, const type *lo, const type *hi, void(func_destroy)(type**));\
+static uint32_t setpt_##type##_delete_range(struct Set##Pt##type *set, const type *lo, const type *hi, void(func_destroy)(type**))\
+{\
+	return rbtree_delete_range_ptr((RBTree*)set, (const void*)lo, (const void*)hi, (FPtr_destroy)func_destroy, NULL);\
+}\
+\
+static __TYPECHECK uint32_t setpt_##type##_count_range(const struct Set##Pt##type *set, const type *lo, const type *hi);\
+static uint32_t setpt_##type##_count_range(const struct Set##Pt##type *set, const type *lo, const type *hi)\
+{\
+	return rbtree_count_range((const RBTree*)set, (const void*)lo, (const void*)hi, TRUE);\
+}\
+\
 static __TYPECHECK type *setpt_##type##_first(struct Set##Pt##type *set);\
 static type *setpt_##type##_first(struct Set##Pt##type *set)\
 {\
@@ -122,5 +141,47 @@ static const type *setpt_##type##_prev_const(const struct Set##Pt##type *set)\
 	return (const type*)rbtree_prev_ptr((RBTree*)set);\
 }\
 \
+static __TYPECHECK const type *setpt_##type##_iter_begin(const struct Set##Pt##type *set, RBIter *iter);\
+static const type *setpt_##type##_iter_begin(const struct Set##Pt##type *set, RBIter *iter)\
+{\
+	return (const type*)rbtree_iter_begin((const RBTree*)set, iter, TRUE);\
+}\
+\
+static __TYPECHECK const type *setpt_##type##_iter_end(const struct Set##Pt##type *set, RBIter *iter);\
+static const type *setpt_##type##_iter_end(const struct Set##Pt##type *set, RBIter *iter)\
+{\
+	return (const type*)rbtree_iter_end((const RBTree*)set, iter, TRUE);\
+}\
+\
+static __TYPECHECK const type *setpt_##type##_iter_next(RBIter *iter);\
+static const type *setpt_##type##_iter_next(RBIter *iter)\
+{\
+	return (const type*)rbtree_iter_next(iter);\
+}\
+\
+static __TYPECHECK const type *setpt_##type##_iter_prev(RBIter *iter);\
+static const type *setpt_##type##_iter_prev(RBIter *iter)\
+{\
+	return (const type*)rbtree_iter_prev(iter);\
+}\
+\
+static __TYPECHECK const type *setpt_##type##_iter_seek(const struct Set##Pt##type *set, RBIter *iter, const type *key);\
+static const type *setpt_##type##_iter_seek(const struct Set##Pt##type *set, RBIter *iter, const type *key)\
+{\
+	return (const type*)rbtree_iter_seek((const RBTree*)set, iter, (const void*)key, TRUE);\
+}\
+\
+static __TYPECHECK const type *setpt_##type##_iter_lower(const struct Set##Pt##type *set, RBIter *iter, const type *key);\
+static const type *setpt_##type##_iter_lower(const struct Set##Pt##type *set, RBIter *iter, const type *key)\
+{\
+	return (const type*)rbtree_iter_lower((const RBTree*)set, iter, (const void*)key, TRUE);\
+}\
+\
+static __TYPECHECK const type *setpt_##type##_iter_upper(const struct Set##Pt##type *set, RBIter *iter, const type *key);\
+static const type *setpt_##type##_iter_upper(const struct Set##Pt##type *set, RBIter *iter, const type *key)\
+{\
+	return (const type*)rbtree_iter_upper((const RBTree*)set, iter, (const void*)key, TRUE);\
+}\
+\
 __INLINE void setpt_##type##_end(void)\
 
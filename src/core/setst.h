@@ -14,6 +14,9 @@
 #define setst_create(func_compare, type)\
     setst_##type##_create(func_compare, (uint16_t)sizeof(type))
 
+#define setst_from_sorted(func_compare, elems, n, type)\
+    setst_##type##_from_sorted(func_compare, elems, n, (uint16_t)sizeof(type))
+
 #define setst_destroy(set, func_remove, type)\
     setst_##type##_destroy(set, func_remove)
 
@@ -32,6 +35,12 @@
 #define setst_delete(set, key, func_remove, type)\
     setst_##type##_delete(set, key, func_remove)
 
+#define setst_delete_range(set, lo, hi, func_remove, type)\
+    setst_##type##_delete_range(set, lo, hi, func_remove)
+
+#define setst_count_range(set, lo, hi, type)\
+    setst_##type##_count_range(set, lo, hi)
+
 #define setst_first(set, type)\
     setst_##type##_first(set)
 
@@ -56,6 +65,27 @@
 #define setst_prev_const(set, type)\
     setst_##type##_prev_const(set)
 
+#define setst_iter_begin(set, iter, type)\
+    setst_##type##_iter_begin(set, iter)
+
+#define setst_iter_end(set, iter, type)\
+    setst_##type##_iter_end(set, iter)
+
+#define setst_iter_next(iter, type)\
+    setst_##type##_iter_next(iter)
+
+#define setst_iter_prev(iter, type)\
+    setst_##type##_iter_prev(iter)
+
+#define setst_iter_seek(set, iter, key, type)\
+    setst_##type##_iter_seek(set, iter, key)
+
+#define setst_iter_lower(set, iter, key, type)\
+    setst_##type##_iter_lower(set, iter, key)
+
+#define setst_iter_upper(set, iter, key, type)\
+    setst_##type##_iter_upper(set, iter, key)
+
 #define setst_foreach(elem, set, type)\
     {\
         register type *elem = setst_first(set, type);\
@@ -65,7 +95,8 @@
 
 #define setst_foreach_const(elem, set, type)\
     {\
-        register const type *elem = setst_first_const(set, type);\
+        RBIter elem##_it;\
+        register const type *elem = setst_iter_begin(set, &elem##_it, type);\
         register uint32_t elem##_i = 0, elem##_total = setst_size(set, type);\
         while (elem != NULL)\
         {
@@ -78,7 +109,7 @@
     }
 
 #define setst_fornext_const(elem, set, type)\
-            elem = setst_next_const(set, type);\
+            elem = setst_iter_next(&elem##_it, type);\
             elem##_i += 1;\
             unref(elem##_total);\
         }\
@@ -15,6 +15,7 @@
 struct NodeSt##type\
 {\
     uint32_t rb;\
+    uint32_t size;\
     struct NodeSt##type *left;\
     struct NodeSt##type *right;\
     type data;\
@@ -38,6 +39,12 @@ static SetSt(type)* setst_##type##_create(int(func_compare)(const type*, const t
     return (SetSt(type)*)rbtree_create((FPtr_compare)func_compare, esize, 0, (const char_t*)(SETST#type));\
 }\
 \
+static __TYPECHECK SetSt(type)* setst_##type##_from_sorted(int(func_compare)(const type*, const type*), const type *elems, const uint32_t n, const uint16_t esize);\
+static SetSt(type)* setst_##type##_from_sorted(int(func_compare)(const type*, const type*), const type *elems, const uint32_t n, const uint16_t esize)\
+{\
+    return (SetSt(type)*)rbtree_from_sorted((FPtr_compare)func_compare, (const byte_t*)elems, n, esize, FALSE, (const char_t*)(SETST#type));\
+}\
+\
 static __TYPECHECK void setst_##type##_destroy(struct Set##St##type **set, void(func_remove)(type*));\
 static void setst_##type##_destroy(struct Set##St##type **set, void(func_remove)(type*))\
 {\
@@ -74,6 +81,18 @@ static bool_t setst_##type##_delete(struct Set##St##type *set, const type *key,
 	return rbtree_delete((RBTree*)set, (const void*)key, (FPtr_remove)func_remove, NULL);\
 }\
 \
+static __TYPECHECK uint32_t setst_##type##_delete_range(struct Set##St##type *set, const type *lo, const type *hi, void(func_remove)(type*));\
+static uint32_t setst_##type##_delete_range(struct Set##St##type *set, const type *lo, const type *hi, void(func_remove)(type*))\
+{\
+	return rbtree_delete_range((RBTree*)set, (const void*)lo, (const void*)hi, (FPtr_remove)func_remove, NULL);\
+}\
+\
+static __TYPECHECK uint32_t setst_##type##_count_range(const struct Set##St##type *set, const type *lo, const type *hi);\
+static uint32_t setst_##type##_count_range(const struct Set##St##type *set, const type *lo, const type *hi)\
+{\
+	return rbtree_count_range((const RBTree*)set, (const void*)lo, (const void*)hi, FALSE);\
+}\
+\
 static __TYPECHECK type *setst_##type##_first(struct Set##St##type *set);\
 static type *setst_##type##_first(struct Set##St##type *set)\
 {\
@@ -122,5 +141,47 @@ static const type *setst_##type##_prev_const(const struct Set##St##type *set)\
 	return (const type*)rbtree_prev((RBTree*)set);\
 }\
 \
+static __TYPECHECK const type *setst_##type##_iter_begin(const struct Set##St##type *set, RBIter *iter);\
+static const type *setst_##type##_iter_begin(const struct Set##St##type *set, RBIter *iter)\
+{\
+	return (const type*)rbtree_iter_begin((const RBTree*)set, iter, FALSE);\
+}\
+\
+static __TYPECHECK const type *setst_##type##_iter_end(const struct Set##St##type *set, RBIter *iter);\
+static const type *setst_##type##_iter_end(const struct Set##St##type *set, RBIter *iter)\
+{\
+	return (const type*)rbtree_iter_end((const RBTree*)set, iter, FALSE);\
+}\
+\
+static __TYPECHECK const type *setst_##type##_iter_next(RBIter *iter);\
+static const type *setst_##type##_iter_next(RBIter *iter)\
+{\
+	return (const type*)rbtree_iter_next(iter);\
+}\
+\
+static __TYPECHECK const type *setst_##type##_iter_prev(RBIter *iter);\
+static const type *setst_##type##_iter_prev(RBIter *iter)\
+{\
+	return (const type*)rbtree_iter_prev(iter);\
+}\
+\
+static __TYPECHECK const type *setst_##type##_iter_seek(const struct Set##St##type *set, RBIter *iter, const type *key);\
+static const type *setst_##type##_iter_seek(const struct Set##St##type *set, RBIter *iter, const type *key)\
+{\
+	return (const type*)rbtree_iter_seek((const RBTree*)set, iter, (const void*)key, FALSE);\
+}\
+\
+static __TYPECHECK const type *setst_##type##_iter_lower(const struct Set##St##type *set, RBIter *iter, const type *key);\
+static const type *setst_##type##_iter_lower(const struct Set##St##type *set, RBIter *iter, const type *key)\
+{\
+	return (const type*)rbtree_iter_lower((const RBTree*)set, iter, (const void*)key, FALSE);\
+}\
+\
+static __TYPECHECK const type *setst_##type##_iter_upper(const struct Set##St##type *set, RBIter *iter, const type *key);\
+static const type *setst_##type##_iter_upper(const struct Set##St##type *set, RBIter *iter, const type *key)\
+{\
+	return (const type*)rbtree_iter_upper((const RBTree*)set, iter, (const void*)key, FALSE);\
+}\
+\
 __INLINE void setst_##type##_end(void)\
 
@@ -24,6 +24,7 @@
 #include "osbs.h"
 #include "ptr.h"
 #include "strings.h"
+#include "types.h"
 #include "unicode.h"
 
 /* Stream state */
@@ -67,6 +68,7 @@ typedef enum i_type_t
 
 typedef struct i_file_t i_File;
 typedef struct i_socket_t i_Socket;
+typedef struct i_map_t i_Map;
 typedef struct i_buffer_t i_Buffer;
 
 struct i_buffer_t
@@ -90,10 +92,17 @@ struct i_socket_t
     serror_t sock_err;
 };
 
+struct i_map_t
+{
+    const byte_t *data;
+    uint32_t size;
+};
+
 typedef union i_channel_t
 {
     i_File file;
     i_Socket sock;
+    i_Map map;
 } i_Channel;
 
 struct _stream_t
@@ -253,6 +262,11 @@ static void i_close_channel(i_Channel *channel, const type_t type)
             break;
 
         case i_ekFROMMEMORY:
+            /* Memory mapped file */
+            if (channel->map.data != NULL)
+                bfile_munmap(&channel->map.data, channel->map.size);
+            break;
+
         case i_ekTOMEMORY:
         case i_ekTOSTDOUT:
         case i_ekTOSTDERR:
@@ -342,6 +356,30 @@ Stream *stm_from_file(const char_t *pathname, ferror_t *error)
 
 /*---------------------------------------------------------------------------*/
 
+Stream *stm_from_mmap(const char_t *pathname, ferror_t *error)
+{
+    uint32_t size = 0;
+    const byte_t *data = bfile_mmap(pathname, &size, error);
+    if (data != NULL)
+    {
+        /* A read-only memory stream over the file pages. No read cache */
+        Stream *stm = i_create_stream(i_ekFROMMEMORY);
+        if (size > 0)
+            i_init_const_buffer(&stm->buffer1, data, size);
+        stm->input = &stm->buffer1;
+        stm->input->woffset = size;
+        stm->channel.map.data = data;
+        stm->channel.map.size = size;
+        return stm;
+    }
+    else
+    {
+        return NULL;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 static Stream *i_to_file(File *file, const ferror_t lerror, ferror_t *error)
 {
     ptr_assign(error, lerror);
@@ -715,7 +753,7 @@ const byte_t *stm_buffer(const Stream *stm)
 uint32_t stm_buffer_size(const Stream *stm)
 {
     cassert_no_null(stm);
-    cassert(stm->type == i_ekTOMEMORY);
+    cassert(stm->type == i_ekTOMEMORY || stm->type == i_ekFROMMEMORY);
     cassert(stm->buffer1.woffset >= stm->buffer1.roffset);
     return stm->buffer1.woffset - stm->buffer1.roffset;
 }
@@ -1364,7 +1402,7 @@ static uint32_t i_read(Stream *stm, byte_t *data, const uint32_t size, const boo
     }
 
     /* Sockets doesn't use cache */
-    if (stm->type == i_ekSOCKET)
+    if (stm->type == i_ekSOCKET && readed < size)
     {
         register uint32_t remain = size - readed;
         
@@ -1388,7 +1426,7 @@ static uint32_t i_read(Stream *stm, byte_t *data, const uint32_t size, const boo
         
         readed += remain;
     }
-    else
+    else if (stm->type != i_ekSOCKET)
     {
         i_Buffer *input = stm->input;
         if (input == NULL)
@@ -2183,3 +2221,50 @@ void _stm_set_roffset(Stream *stm, const uint32_t offset)
     stm->buffer1.roffset = offset;
     stm->read_offset -= (offset - roffset);
 }
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t _stm_read_avail(Stream *stm, byte_t *data, const uint32_t size)
+{
+    uint32_t available = 0;
+    cassert_no_null(stm);
+    cassert_no_null(data);
+
+    /* Restore cache first */
+    if (stm->restore.woffset > stm->restore.roffset)
+        return i_read(stm, data, min_u32(size, stm->restore.woffset - stm->restore.roffset), FALSE);
+
+    /* Sockets doesn't use cache. Only one 'recv': It returns what the channel has (at least one byte) */
+    if (stm->type == i_ekSOCKET)
+    {
+        uint32_t readed = 0;
+        if (!IS_OK(stm->state))
+            return 0;
+
+        if (bsocket_recv(stm->channel.sock.socket, data, size, &readed, &stm->channel.sock.sock_err) == TRUE)
+        {
+            if (readed == 0)
+                BIT_SET(stm->state, END_BIT);
+        }
+        else
+        {
+            BIT_SET(stm->state, BROKEN_BIT);
+        }
+
+        stm->read_offset += readed;
+        return readed;
+    }
+
+    /* Only one cache fill, no more data than the channel offers */
+    if (stm->input != NULL)
+    {
+        available = stm->input->woffset - stm->input->roffset;
+        if (available == 0 && IS_OK(stm->state) && i_FUNC_FILL[stm->type] != NULL)
+        {
+            i_FUNC_FILL[stm->type](stm, size);
+            available = stm->input->woffset - stm->input->roffset;
+        }
+    }
+
+    return i_read(stm, data, min_u32(size, available), FALSE);
+}
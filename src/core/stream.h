@@ -21,6 +21,8 @@ Stream *stm_memory(const uint32_t size);
 
 Stream *stm_from_file(const char_t *pathname, ferror_t *error);
 
+Stream *stm_from_mmap(const char_t *pathname, ferror_t *error);
+
 Stream *stm_to_file(const char_t *pathname, ferror_t *error);
 
 Stream *stm_append_file(const char_t *pathname, ferror_t *error);
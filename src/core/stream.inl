@@ -30,5 +30,7 @@ uint32_t _stm_get_roffset(const Stream *stm);
 
 void _stm_set_roffset(Stream *stm, const uint32_t offset);
 
+uint32_t _stm_read_avail(Stream *stm, byte_t *data, const uint32_t size);
+
 __END_C
     
@@ -28,6 +28,14 @@
 #define i_SIZE(str) *((uint32_t*)str)
 #define i_DATA(str) ((char_t*)((char_t*)str + sizeof(uint32_t)))
 
+/* The block has String layout, so strbuf_take() doesn't copy the text */
+struct _strbuf_t
+{
+    String *str;
+    uint32_t length;
+    uint32_t capacity;
+};
+
 /*---------------------------------------------------------------------------*/
 
 static String *i_create_string(const uint32_t length, const char_t *data)
@@ -41,6 +49,96 @@ static String *i_create_string(const uint32_t length, const char_t *data)
 
 /*---------------------------------------------------------------------------*/
 
+static void i_strbuf_init(StrBuf *buf, const uint32_t capacity)
+{
+    cassert_no_null(buf);
+    buf->str = NULL;
+    buf->length = 0;
+    buf->capacity = 0;
+    if (capacity > 0)
+    {
+        buf->str = (String*)heap_malloc(capacity + sizeof32(uint32_t), "String");
+        buf->capacity = capacity;
+        i_DATA(buf->str)[0] = '\0';
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_strbuf_remove(StrBuf *buf)
+{
+    cassert_no_null(buf);
+    if (buf->str != NULL)
+        heap_free((byte_t**)&buf->str, buf->capacity + sizeof32(uint32_t), "String");
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Room for 'n' more chars plus '\0'. Doubling keeps appends amortized O(1) */
+static char_t *i_strbuf_reserve(StrBuf *buf, const uint32_t n)
+{
+    uint32_t size;
+    cassert_no_null(buf);
+    size = buf->length + n + 1;
+    if (size > buf->capacity)
+    {
+        uint32_t capacity = buf->capacity > 0 ? buf->capacity : 16;
+        while (capacity < size)
+            capacity <<= 1;
+
+        if (buf->str != NULL)
+        {
+            buf->str = (String*)heap_realloc((byte_t*)buf->str, buf->capacity + sizeof32(uint32_t), capacity + sizeof32(uint32_t), "String");
+        }
+        else
+        {
+            buf->str = (String*)heap_malloc(capacity + sizeof32(uint32_t), "String");
+            i_DATA(buf->str)[0] = '\0';
+        }
+
+        buf->capacity = capacity;
+    }
+
+    return i_DATA(buf->str) + buf->length;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_strbuf_cat(StrBuf *buf, const char_t *str, const uint32_t n)
+{
+    if (n > 0)
+    {
+        char_t *dest = i_strbuf_reserve(buf, n);
+        bmem_copy((byte_t*)dest, (const byte_t*)str, n);
+        dest[n] = '\0';
+        buf->length += n;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Shrinking realloc, the memory block becomes the String */
+static String *i_strbuf_take(StrBuf *buf)
+{
+    String *str = NULL;
+    uint32_t size;
+    cassert_no_null(buf);
+    if (buf->str == NULL)
+        i_strbuf_reserve(buf, 0);
+
+    size = buf->length + 1;
+    str = buf->str;
+    if (size != buf->capacity)
+        str = (String*)heap_realloc((byte_t*)str, buf->capacity + sizeof32(uint32_t), size + sizeof32(uint32_t), "String");
+    i_SIZE(str) = size;
+    buf->str = NULL;
+    buf->length = 0;
+    buf->capacity = 0;
+    return str;
+}
+
+/*---------------------------------------------------------------------------*/
+
 void str_destroy(String **str)
 {
     cassert_no_null(str);
@@ -158,49 +256,33 @@ String *str_copy(const String *str)
 
 String *str_printf(const char_t *format, ...)
 {
-    String *str = NULL;
-    char_t data_static[1024];
-    char_t *data_alloc = NULL;
-    char_t *data = NULL;
+    StrBuf buf;
     uint32_t length;
 
     cassert_no_null(format);
+    i_strbuf_init(&buf, 128);
 
-    /* Memory requeriments */
+    /* Printf directly in the final block, second pass only for long texts */
     {
         va_list args;
         va_start(args, format);
-        length = 1 + bstd_vsprintf(NULL, 0, format, args);
+        length = bstd_vsprintf(i_DATA(buf.str), buf.capacity, format, args);
         va_end(args);
     }
 
-    /* Temporal buffer */
-    if (length < 1024)
-    {
-        data = data_static;
-    }
-    else
-    {
-        data_alloc = (char_t*)heap_malloc(length, "StringPrintf");
-        data = data_alloc;
-    }
-
-    /* Printf */
+    if (length >= buf.capacity)
     {
         register uint32_t clength;
         va_list args;
+        char_t *data = i_strbuf_reserve(&buf, length);
         va_start(args, format);
-        clength = bstd_vsprintf(data, length, format, args);
+        clength = bstd_vsprintf(data, length + 1, format, args);
         va_end(args);
-        cassert_unref(clength + 1 == length, clength);
+        cassert_unref(clength == length, clength);
     }
 
-    str = i_create_string(length, data);
-
-    if (data_alloc != NULL)
-        heap_free((byte_t**)&data_alloc, length, "StringPrintf");
-
-    return str;
+    buf.length = length;
+    return i_strbuf_take(&buf);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -346,100 +428,40 @@ String *str_relpath(const char_t *path1, const char_t *path2)
 
 /*---------------------------------------------------------------------------*/
 
-static void i_replace(String **str, const char_t *replace, const char_t *with)
+/* Single pass, 'dest' receives 'src' with all the occurrences replaced */
+static void i_replace(StrBuf *dest, const StrBuf *src, const char_t *replace, const char_t *with)
 {
-    uint32_t len_inp = 0;           /* length of input */
-    uint32_t len_rep = 0;           /* length of rep (the string to remove) */
-    uint32_t len_with = 0;          /* length of with (the string to replace rep with) */
-    uint32_t count = 0;             /* number of replacements */
-    uint32_t len_new = 0;           /* length of new string */
-    String *lstr = NULL;
-    
-    cassert_no_null(str);
-    cassert_no_null(*str);
-    cassert_no_null(replace);
-    cassert_no_null(with);
-    
-    len_inp = blib_strlen(i_DATA(*str));
-    if (len_inp == 0)
-        return;
-
-    len_rep = blib_strlen(replace);
-    if (len_rep == 0)
-        return;
-    
-    /* Count the number of replacements needed */
+    uint32_t len_rep = blib_strlen(replace);
+    uint32_t len_with = blib_strlen(with);
+    const char_t *str = i_DATA(src->str);
+    const char_t *end = str + src->length;
+    cassert(len_rep > 0);
+    dest->length = 0;
+    for (;;)
     {
-        const char_t *src = NULL;  /* the next insert point */
-        const char_t *tmp = NULL;
-        src = i_DATA(*str);
-        tmp = blib_strstr(src, replace);
-        for (count = 0; tmp != NULL; ++count)
-        {
-            src = tmp + len_rep;
-            tmp = blib_strstr(src, replace);
-        }
-    }
-
-    if (count == 0)
-        return;
-
-    len_with = (uint32_t)blib_strlen(with);
+        const char_t *ins = blib_strstr(str, replace);
+        if (ins == NULL)
+            break;
 
-    /* Create the new String */
-    len_new = len_inp;
-    if (len_with < len_rep)
-        len_new -= (len_rep - len_with) * count;
-    else
-        len_new += (len_with - len_rep) * count;
-    len_new += 1;
-    lstr = i_create_string(len_new, NULL);
-
-    /* First time through the loop, all the variable are set correctly from here on. 
-       src points to the end of the result string
-       ins points to the next occurrence of rep in orig
-       orig points to the remainder of orig after "end of rep"
-     */
-    {
-        const char_t *src = i_DATA(*str);
-        char_t *dest = i_DATA(lstr);
-        while (count--)
-        {
-            const char_t *ins = NULL;       /* the next insert point */
-            uint32_t len_front = 0;         /* distance between rep and end of last rep */
-            ins = blib_strstr(src, replace);
-            len_front = (uint32_t)(ins - src);
-
-            if (len_front > 0)
-            {
-                str_copy_cn(dest, len_new, src, len_front);
-                dest += len_front;
-                len_new -= len_front;
-            }
-
-            if (len_with > 0)
-            {
-                str_copy_cn(dest, len_new, with, len_with);
-                dest += len_with;
-                len_new -= len_with;
-            }
-
-            src += len_front + len_rep;     /* move to next "end of replacement" */
-        }
-        
-        str_copy_c(dest, len_new, src);
+        i_strbuf_cat(dest, str, (uint32_t)(ins - str));
+        i_strbuf_cat(dest, with, len_with);
+        str = ins + len_rep;
     }
-    
-    str_destroy(str);
-    *str = lstr;
+
+    i_strbuf_cat(dest, str, (uint32_t)(end - str));
+    i_strbuf_reserve(dest, 0)[0] = '\0';
 }
 
 /*---------------------------------------------------------------------------*/
 
 String *str_repl(const char_t *str, ...)
 {
-    String *rstr = str_c(str);
+    StrBuf buf[2];
+    uint32_t i = 0;
     va_list params;
+    i_strbuf_init(&buf[0], 0);
+    i_strbuf_init(&buf[1], 0);
+    i_strbuf_cat(&buf[0], str, blib_strlen(str));
     va_start(params, str);
     for (;;)
     {
@@ -449,11 +471,16 @@ String *str_repl(const char_t *str, ...)
             break;
 
         with = (const char_t*)va_arg(params, char*);
-        if (with != NULL)
-            i_replace(&rstr, replace, with);
+        if (with != NULL && replace[0] != '\0' && buf[i].length > 0)
+        {
+            /* Both buffers are reused for all the pairs */
+            i_replace(&buf[1 - i], &buf[i], replace, with);
+            i = 1 - i;
+        }
     }
     va_end(params);
-    return rstr;
+    i_strbuf_remove(&buf[1 - i]);
+    return i_strbuf_take(&buf[i]);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -1298,3 +1325,102 @@ real64_t str_to_r64(const char_t *str, bool_t *error)
 {
     return blib_strtod(str, NULL, error);
 }
+
+/*---------------------------------------------------------------------------*/
+
+StrBuf *strbuf_create(const uint32_t capacity)
+{
+    StrBuf *buf = heap_new(StrBuf);
+    i_strbuf_init(buf, capacity);
+    return buf;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void strbuf_destroy(StrBuf **buf)
+{
+    cassert_no_null(buf);
+    i_strbuf_remove(*buf);
+    heap_delete(buf, StrBuf);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void strbuf_clear(StrBuf *buf)
+{
+    cassert_no_null(buf);
+    buf->length = 0;
+    if (buf->str != NULL)
+        i_DATA(buf->str)[0] = '\0';
+}
+
+/*---------------------------------------------------------------------------*/
+
+void strbuf_cat(StrBuf *buf, const char_t *str)
+{
+    cassert_no_null(str);
+    i_strbuf_cat(buf, str, blib_strlen(str));
+}
+
+/*---------------------------------------------------------------------------*/
+
+void strbuf_cat_n(StrBuf *buf, const char_t *str, const uint32_t n)
+{
+    cassert_no_null(str);
+    i_strbuf_cat(buf, str, n);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void strbuf_printf(StrBuf *buf, const char_t *format, ...)
+{
+    uint32_t length, avail;
+    char_t *data;
+
+    cassert_no_null(format);
+    data = i_strbuf_reserve(buf, 31);
+    avail = buf->capacity - buf->length;
+
+    {
+        va_list args;
+        va_start(args, format);
+        length = bstd_vsprintf(data, avail, format, args);
+        va_end(args);
+    }
+
+    if (length >= avail)
+    {
+        register uint32_t clength;
+        va_list args;
+        data = i_strbuf_reserve(buf, length);
+        va_start(args, format);
+        clength = bstd_vsprintf(data, length + 1, format, args);
+        va_end(args);
+        cassert_unref(clength == length, clength);
+    }
+
+    buf->length += length;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t strbuf_len(const StrBuf *buf)
+{
+    cassert_no_null(buf);
+    return buf->length;
+}
+
+/*---------------------------------------------------------------------------*/
+
+const char_t *strbuf_data(const StrBuf *buf)
+{
+    cassert_no_null(buf);
+    return buf->str != NULL ? i_DATA(buf->str) : "";
+}
+
+/*---------------------------------------------------------------------------*/
+
+String *strbuf_take(StrBuf *buf)
+{
+    return i_strbuf_take(buf);
+}
@@ -144,4 +144,22 @@ real32_t str_to_r32(const char_t *str, bool_t *error);
 
 real64_t str_to_r64(const char_t *str, bool_t *error);
 
+StrBuf *strbuf_create(const uint32_t capacity);
+
+void strbuf_destroy(StrBuf **buf);
+
+void strbuf_clear(StrBuf *buf);
+
+void strbuf_cat(StrBuf *buf, const char_t *str);
+
+void strbuf_cat_n(StrBuf *buf, const char_t *str, const uint32_t n);
+
+void strbuf_printf(StrBuf *buf, const char_t *format, ...) __PRINTF(2, 3);
+
+uint32_t strbuf_len(const StrBuf *buf);
+
+const char_t *strbuf_data(const StrBuf *buf);
+
+String *strbuf_take(StrBuf *buf);
+
 __END_C
@@ -21,6 +21,7 @@ struct _app_t
     ImageView *view;
     Label *time_label;
     Clock *clock;
+    Pool *pool;
     uint32_t threads;
     bool_t vertical;
     real64_t fct;
@@ -32,10 +33,7 @@ struct _thdata_t
     real64_t kreal;
     real64_t kimag;
     Pixbuf *pixbuf;
-    uint32_t i;
-    uint32_t j;
-    uint32_t width;
-    uint32_t height;
+    bool_t vertical;
 };
 
 static const real64_t i_FCT = 2.85;
@@ -66,114 +64,70 @@ static uint32_t i_inset(real64_t zreal, real64_t zimag, real64_t creal, real64_t
 
 /*---------------------------------------------------------------------------*/
 
-static uint32_t i_julia_thread(ThData *data)
+static uint32_t i_julia_color(const ThData *data, const real64_t creal, const real64_t cimag)
 {
-    real64_t fct = data->fct;
-    uint32_t imgwidth = pixbuf_width(data->pixbuf);
-    real64_t freal = fct / imgwidth;
-    real64_t fimag = fct / pixbuf_height(data->pixbuf);
-    real64_t kreal = data->kreal;
-    real64_t kimag = data->kimag;
-    uint32_t val;
-    real64_t creal, cimag;
-    register uint32_t stj = data->j;
-    register uint32_t edj = data->j + data->height;
-    register uint32_t sti = data->i;
-    register uint32_t edi = data->i + data->width;
-    register uint32_t i, j;
-
-    for(j = stj; j < edj; ++j)
+    uint32_t val = i_inset(creal, cimag, data->kreal, data->kimag);
+    if (val > 0)
     {
-        cimag = fimag * j - (fct / 2);
-
-        for(i = sti; i < edi; ++i)
-        {
-            creal = freal * i - (fct / 2);
-            val = i_inset(creal, cimag, kreal, kimag);
-            if (val > 0)
-            {
-                uint8_t n_val = (uint8_t)(val % 255);
-                if ( val < ( i_ITERATIONS >> 1 ) )
-                    val = color_rgb((uint8_t)(n_val << 2), (uint8_t)(n_val << 3), (uint8_t)(n_val << 4));
-                else
-                    val = color_rgb((uint8_t)(n_val << 4), (uint8_t)(n_val << 2), (uint8_t)(n_val << 5));
-            }
-            else
-            {
-                val = kCOLOR_BLACK;
-            }
-
-            pixbuf_set(data->pixbuf, i, j, val);
-        }
+        uint8_t n_val = (uint8_t)(val % 255);
+        if ( val < ( i_ITERATIONS >> 1 ) )
+            val = color_rgb((uint8_t)(n_val << 2), (uint8_t)(n_val << 3), (uint8_t)(n_val << 4));
+        else
+            val = color_rgb((uint8_t)(n_val << 4), (uint8_t)(n_val << 2), (uint8_t)(n_val << 5));
+    }
+    else
+    {
+        val = kCOLOR_BLACK;
     }
 
-    return 5;
+    return val;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void i_julia(const uint32_t nthreads, const bool_t vertical, const real64_t fct, const real64_t kreal, const real64_t kimag, Pixbuf *pixbuf)
+// Renders the columns (vertical) or rows [st, ed)
+static void i_julia_lines(ThData *data, const uint32_t st, const uint32_t ed)
 {
-    ThData data[8];
-    uint32_t width = pixbuf_width(pixbuf);
-    uint32_t height = pixbuf_height(pixbuf);
-    data[0].fct = fct;
-    data[0].kreal = kreal;
-    data[0].kimag = kimag;
-    data[0].pixbuf = pixbuf;
-
-    if (nthreads == 1)
+    real64_t fct = data->fct;
+    uint32_t width = pixbuf_width(data->pixbuf);
+    uint32_t height = pixbuf_height(data->pixbuf);
+    real64_t freal = fct / width;
+    real64_t fimag = fct / height;
+    register uint32_t i, j;
+
+    if (data->vertical == TRUE)
     {
-        data[0].i = 0;
-        data[0].j = 0;
-        data[0].width = width;
-        data[0].height = height;
-        i_julia_thread(&data[0]);
+        for(i = st; i < ed; ++i)
+        {
+            real64_t creal = freal * i - (fct / 2);
+            for(j = 0; j < height; ++j)
+                pixbuf_set(data->pixbuf, i, j, i_julia_color(data, creal, fimag * j - (fct / 2)));
+        }
     }
     else
     {
-        Thread *thread[8];
-
-        register uint32_t i;
-        if (vertical == TRUE)
-        {
-            uint32_t twidth = width / nthreads;
-            for (i = 0; i < nthreads; ++i)
-            {
-                data[i] = data[0];
-                data[i].i = i * twidth;
-                data[i].j = 0;
-                data[i].width = twidth;
-                data[i].height = height;
-            }
-
-            data[nthreads-1].width += (width - (twidth * nthreads));
-        }
-        else
+        for(j = st; j < ed; ++j)
         {
-            uint32_t theight = height / nthreads;
-            for (i = 0; i < nthreads; ++i)
-            {
-                data[i] = data[0];
-                data[i].i = 0;
-                data[i].j = i * theight;
-                data[i].width = width;
-                data[i].height = theight;
-            }
-
-            data[nthreads-1].height += (height - (theight * nthreads));
+            real64_t cimag = fimag * j - (fct / 2);
+            for(i = 0; i < width; ++i)
+                pixbuf_set(data->pixbuf, i, j, i_julia_color(data, freal * i - (fct / 2), cimag));
         }
+    }
+}
 
-        for (i = 0; i < nthreads; ++i)
-            thread[i] = bthread_create(i_julia_thread, &data[i], ThData);
+/*---------------------------------------------------------------------------*/
 
-        for (i = 0; i < nthreads; ++i)
-        {
-            uint32_t thid = bthread_wait(thread[i]);
-            cassert_unref(thid == 5, thid);
-            bthread_close(&thread[i]);
-        }
-    }
+static void i_julia(Pool *pool, const bool_t vertical, const real64_t fct, const real64_t kreal, const real64_t kimag, Pixbuf *pixbuf)
+{
+    ThData data;
+    uint32_t range = vertical == TRUE ? pixbuf_width(pixbuf) : pixbuf_height(pixbuf);
+    data.fct = fct;
+    data.kreal = kreal;
+    data.kimag = kimag;
+    data.pixbuf = pixbuf;
+    data.vertical = vertical;
+    /* Julia lines differ in cost, small chunks let idle threads steal work */
+    bparallel_for(pool, range, 4, i_julia_lines, &data, ThData);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -189,7 +143,7 @@ static void i_image(App *app)
     real64_t timems;
     String *str;
     clock_reset(app->clock);
-    i_julia(app->threads, app->vertical, app->fct, kreal, kimag, pixbuf);
+    i_julia(app->pool, app->vertical, app->fct, kreal, kimag, pixbuf);
     timems = 1000. * clock_elapsed(app->clock);
     str = str_printf("%.3f milliseconds", timems);
     label_text(app->time_label, tc(str));
@@ -202,6 +156,16 @@ static void i_image(App *app)
 
 /*---------------------------------------------------------------------------*/
 
+static void i_threads(App *app)
+{
+    /* The calling thread also renders, so the pool has one thread less */
+    ptr_destopt(bpool_destroy, &app->pool, Pool);
+    if (app->threads > 1)
+        app->pool = bpool_create(app->threads - 1);
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void i_OnSlider(App *app, Event *e)
 {
     const EvSlider *p = event_params(e, EvSlider);
@@ -221,7 +185,9 @@ static void i_OnThreads(App *app, Event *e)
     case 1: app->threads = 2; break;
     case 2: app->threads = 3; break;
     case 3: app->threads = 4; break;
-    case 4: app->threads = 8; break; }
+    case 4: app->threads = 8; break;
+    case 5: app->threads = osbs_num_cores(); break; }
+    i_threads(app);
     i_image(app);
 }
 
@@ -248,12 +214,15 @@ static Panel *i_panel(App *app)
     Button *button1 = button_radio();
     Button *button2 = button_radio();
     ImageView *view = imageview_create();
+    char_t ncores[64];
     label_text(label1, "Threads:");
     popup_add_elem(popup, "1", NULL);
     popup_add_elem(popup, "2", NULL);
     popup_add_elem(popup, "3", NULL);
     popup_add_elem(popup, "4", NULL);
     popup_add_elem(popup, "8", NULL);
+    bstd_sprintf(ncores, sizeof(ncores), "%u (cores)", osbs_num_cores());
+    popup_add_elem(popup, ncores, NULL);
     popup_selected(popup, 0);
     popup_OnSelect(popup, listener(app, i_OnThreads, App));
     slider_value(slider, .5f);
@@ -282,6 +251,7 @@ static Panel *i_panel(App *app)
     panel_layout(panel, layout1);
     app->fct = i_FCT;
     app->threads = 1;
+    app->pool = NULL;
     app->vertical = TRUE;
     app->view = view;
     app->time_label = label2;
@@ -320,6 +290,7 @@ static void i_destroy(App **app)
 {
     window_destroy(&(*app)->window);
     clock_destroy(&(*app)->clock);
+    ptr_destopt(bpool_destroy, &(*app)->pool, Pool);
     heap_delete(app, App);
 }
 
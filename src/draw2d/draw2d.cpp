@@ -16,6 +16,7 @@
 #include "draw.inl"
 #include "font.inl"
 #include "image.inl"
+#include "imgutils.inl"
 #include "respack.inl"
 #include "image.h"
 
@@ -64,7 +65,9 @@ void draw2d_start(void)
         core_start();
         osimage_alloc_globals();
         osfont_alloc_globals();
+        font_alloc_globals();
         drawimp_alloc_globals();
+        imgutil_start();
 
         i_DRAW2D.font_families = arrpt_create(String);
         
@@ -96,6 +99,7 @@ void draw2d_finish(void)
         _dbind_finish(); // Destroy possible images
         arrpt_destroy(&i_DRAW2D.font_families, str_destroy, String);
         arrst_destroy(&i_DRAW2D.named_colors, NULL, color_t);
+        font_dealloc_globals();
         osfont_dealloc_globals();
         osimage_dealloc_globals();
         drawimp_dealloc_globals();
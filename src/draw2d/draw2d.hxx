@@ -37,6 +37,14 @@ typedef enum _codec_t
     ekGIF
 } codec_t;
 
+typedef enum _resample_t
+{
+    ekRBOX,
+    ekRBILINEAR,
+    ekRBICUBIC,
+    ekRLANCZOS
+} resample_t;
+
 typedef enum _fstyle_t
 {
     ekFNORMAL       = 0,
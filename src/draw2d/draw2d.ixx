@@ -93,6 +93,7 @@ typedef enum _multisel_t
 typedef struct _osfont_t OSFont;
 typedef struct _osimage_t OSImage;
 typedef struct _higram_t Higram;
+typedef struct _extcache_t ExtCache;
 typedef struct _btext_t BText;
 
 typedef void(*FPtr_word_extents)(void *data, const char_t *word, real32_t *width, real32_t *height);
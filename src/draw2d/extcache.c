@@ -0,0 +1,240 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: extcache.c
+ *
+ */
+
+/* Text extents LRU cache */
+
+#include "extcache.inl"
+#include "bhash.h"
+#include "cassert.h"
+#include "hashst.h"
+#include "heap.h"
+#include "ptr.h"
+#include "strings.h"
+
+/* Keys are the font attributes, not the 'Font' object */
+typedef struct _extkey_t i_ExtKey;
+typedef struct _extent_t i_Extent;
+
+struct _extkey_t
+{
+    uint32_t family;
+    uint32_t style;
+    real32_t size;
+    real32_t refwidth;
+    uint32_t hash;
+    uint32_t tsize;
+};
+
+struct _extent_t
+{
+    i_ExtKey key;
+    String *text;
+    real32_t width;
+    real32_t height;
+    uint32_t prev;
+    uint32_t next;
+};
+
+struct _extcache_t
+{
+    HashSt(uint32_t) *index;
+    i_Extent *entries;
+    uint32_t capacity;
+    uint32_t size;
+    uint32_t first;
+    uint32_t last;
+    uint32_t hits;
+    uint32_t misses;
+};
+
+/*---------------------------------------------------------------------------*/
+
+#define i_NO_EXTENT     UINT32_MAX
+
+/*---------------------------------------------------------------------------*/
+
+ExtCache *extcache_create(const uint32_t capacity)
+{
+    ExtCache *cache = heap_new(ExtCache);
+    cassert(capacity > 0);
+    cache->index = hashst_create(i_ExtKey, uint32_t);
+    cache->entries = heap_new_n(capacity, i_Extent);
+    cache->capacity = capacity;
+    cache->size = 0;
+    cache->first = i_NO_EXTENT;
+    cache->last = i_NO_EXTENT;
+    cache->hits = 0;
+    cache->misses = 0;
+    return cache;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void extcache_destroy(ExtCache **cache)
+{
+    register uint32_t i;
+    cassert_no_null(cache);
+    cassert_no_null(*cache);
+    for (i = 0; i < (*cache)->size; ++i)
+        str_destroy(&(*cache)->entries[i].text);
+
+    hashst_destroy(&(*cache)->index, NULL, uint32_t);
+    heap_delete_n(&(*cache)->entries, (*cache)->capacity, i_Extent);
+    heap_delete(cache, ExtCache);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_key(i_ExtKey *key, const uint32_t family, const uint32_t style, const real32_t size, const char_t *text, const real32_t refwidth)
+{
+    cassert_no_null(key);
+    key->family = family;
+    key->style = style;
+    key->size = size;
+    key->refwidth = refwidth < 0 ? -1 : refwidth;
+    key->tsize = str_len_c(text);
+    /* 'bhash_from_block' doesn't accept empty blocks */
+    key->hash = key->tsize > 0 ? bhash_from_block((const byte_t*)text, key->tsize) : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_unlink(ExtCache *cache, const uint32_t id)
+{
+    i_Extent *extent = cache->entries + id;
+    if (extent->prev != i_NO_EXTENT)
+        cache->entries[extent->prev].next = extent->next;
+    else
+        cache->first = extent->next;
+
+    if (extent->next != i_NO_EXTENT)
+        cache->entries[extent->next].prev = extent->prev;
+    else
+        cache->last = extent->prev;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* The list goes from the most to the least recently used */
+static void i_push_front(ExtCache *cache, const uint32_t id)
+{
+    i_Extent *extent = cache->entries + id;
+    extent->prev = i_NO_EXTENT;
+    extent->next = cache->first;
+    if (cache->first != i_NO_EXTENT)
+        cache->entries[cache->first].prev = id;
+    else
+        cache->last = id;
+    cache->first = id;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_new_extent(ExtCache *cache, const i_ExtKey *key)
+{
+    uint32_t id = i_NO_EXTENT;
+    uint32_t *index = NULL;
+
+    if (cache->size < cache->capacity)
+    {
+        id = cache->size;
+        cache->size += 1;
+        cache->entries[id].text = NULL;
+    }
+    /* Full cache, the least recently used entry is recycled */
+    else
+    {
+        id = cache->last;
+        i_unlink(cache, id);
+        hashst_delete(cache->index, &cache->entries[id].key, NULL, uint32_t);
+    }
+
+    index = hashst_insert(cache->index, key, uint32_t);
+    cassert_no_null(index);
+    *index = id;
+    cache->entries[id].key = *key;
+    i_push_front(cache, id);
+    return id;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t extcache_get(ExtCache *cache, const uint32_t family, const uint32_t style, const real32_t size, const char_t *text, const real32_t refwidth, real32_t *width, real32_t *height)
+{
+    i_ExtKey key;
+    const uint32_t *index = NULL;
+    cassert_no_null(cache);
+    cassert_no_null(text);
+    i_key(&key, family, style, size, text, refwidth);
+    index = hashst_get(cache->index, &key, uint32_t);
+
+    if (index != NULL)
+    {
+        i_Extent *extent = cache->entries + *index;
+        i_unlink(cache, *index);
+        i_push_front(cache, *index);
+        if (str_equ(extent->text, text) == TRUE)
+        {
+            cache->hits += 1;
+            ptr_assign(width, extent->width);
+            ptr_assign(height, extent->height);
+            return TRUE;
+        }
+    }
+
+    cache->misses += 1;
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void extcache_add(ExtCache *cache, const uint32_t family, const uint32_t style, const real32_t size, const char_t *text, const real32_t refwidth, const real32_t width, const real32_t height)
+{
+    i_ExtKey key;
+    const uint32_t *index = NULL;
+    i_Extent *extent = NULL;
+    cassert_no_null(cache);
+    cassert_no_null(text);
+    i_key(&key, family, style, size, text, refwidth);
+    index = hashst_get(cache->index, &key, uint32_t);
+
+    /* Hash collision (same key, other text) reuses the entry */
+    if (index != NULL)
+    {
+        extent = cache->entries + *index;
+        i_unlink(cache, *index);
+        i_push_front(cache, *index);
+    }
+    else
+    {
+        extent = cache->entries + i_new_extent(cache, &key);
+    }
+
+    str_upd(&extent->text, text);
+    extent->width = width;
+    extent->height = height;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t extcache_size(const ExtCache *cache)
+{
+    cassert_no_null(cache);
+    return cache->size;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void extcache_stats(const ExtCache *cache, uint32_t *hits, uint32_t *misses)
+{
+    cassert_no_null(cache);
+    ptr_assign(hits, cache->hits);
+    ptr_assign(misses, cache->misses);
+}
@@ -0,0 +1,30 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: extcache.inl
+ *
+ */
+
+/* Text extents LRU cache */
+
+#include "draw2d.ixx"
+
+__EXTERN_C
+
+ExtCache *extcache_create(const uint32_t capacity);
+
+void extcache_destroy(ExtCache **cache);
+
+bool_t extcache_get(ExtCache *cache, const uint32_t family, const uint32_t style, const real32_t size, const char_t *text, const real32_t refwidth, real32_t *width, real32_t *height);
+
+void extcache_add(ExtCache *cache, const uint32_t family, const uint32_t style, const real32_t size, const char_t *text, const real32_t refwidth, const real32_t width, const real32_t height);
+
+uint32_t extcache_size(const ExtCache *cache);
+
+void extcache_stats(const ExtCache *cache, uint32_t *hits, uint32_t *misses);
+
+__END_C
+
@@ -13,6 +13,7 @@
 #include "font.h"
 #include "font.inl"
 #include "draw2d.inl"
+#include "extcache.inl"
 #include "cassert.h"
 #include "heap.h"
 #include "ptr.h"
@@ -28,9 +29,27 @@ struct _font_t
     OSFont *osfont;
 };
 
+static ExtCache *i_EXTENTS = NULL;
+
 /*---------------------------------------------------------------------------*/
 
 #define i_abs(x) (((x) < 0.f) ? -(x) : (x))
+#define i_EXTENTS_SIZE  1024
+
+/*---------------------------------------------------------------------------*/
+
+void font_alloc_globals(void)
+{
+    cassert(i_EXTENTS == NULL);
+    i_EXTENTS = extcache_create(i_EXTENTS_SIZE);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void font_dealloc_globals(void)
+{
+    extcache_destroy(&i_EXTENTS);
+}
 
 /*---------------------------------------------------------------------------*/
 
@@ -189,9 +208,26 @@ uint32_t font_style(const Font *font)
 
 void font_extents(const Font *font, const char_t *text, const real32_t refwidth, real32_t *width, real32_t *height)
 {
+    real32_t w = 0, h = 0;
     cassert_no_null(font);
-    i_osfont((Font*)font);
-    osfont_extents(font->osfont, text, refwidth, width, height);
+    cassert_no_null(i_EXTENTS);
+    if (extcache_get(i_EXTENTS, font->family, font->style, font->size, text, refwidth, &w, &h) == FALSE)
+    {
+        i_osfont((Font*)font);
+        osfont_extents(font->osfont, text, refwidth, &w, &h);
+        extcache_add(i_EXTENTS, font->family, font->style, font->size, text, refwidth, w, h);
+    }
+
+    ptr_assign(width, w);
+    ptr_assign(height, h);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void font_extents_stats(uint32_t *hits, uint32_t *misses)
+{
+    cassert_no_null(i_EXTENTS);
+    extcache_stats(i_EXTENTS, hits, misses);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -45,6 +45,8 @@ uint32_t font_style(const Font *font);
 
 void font_extents(const Font *font, const char_t *text, const real32_t refwidth, real32_t *width, real32_t *height);
 
+void font_extents_stats(uint32_t *hits, uint32_t *misses);
+
 bool_t font_exists_family(const char_t *family);
 
 ArrPt(String) *font_installed_families(void);
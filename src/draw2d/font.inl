@@ -14,6 +14,10 @@
 
 __EXTERN_C
 
+void font_alloc_globals(void);
+
+void font_dealloc_globals(void);
+
 void osfont_alloc_globals(void);
 
 void osfont_dealloc_globals(void);
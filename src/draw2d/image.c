@@ -290,7 +290,38 @@ Image *image_copy(const Image *image)
 Image *image_trim(const Image *image, const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height)
 {
     T2Df t2d;
-    DCtx *ctx = dctx_bitmap(width, height, ekRGB24);
+    DCtx *ctx = NULL;
+    Pixbuf *pixels = image_pixels(image, ekFIMAGE);
+
+    /*
+     * Inner crops are a copy of pixel rows, the rest are drawn. The result is
+     * always RGB24, as the drawn one. Alpha images are drawn over the background.
+     */
+    if (pixels != NULL)
+    {
+        Image *nimage = NULL;
+        pixformat_t format = pixbuf_format(pixels);
+        if ((format == ekGRAY8 || format == ekRGB24)
+            && x + width <= pixbuf_width(pixels) && y + height <= pixbuf_height(pixels))
+        {
+            Pixbuf *trim = pixbuf_trim(pixels, x, y, width, height);
+            if (format == ekGRAY8)
+            {
+                Pixbuf *rgb = pixbuf_convert(trim, NULL, ekRGB24);
+                pixbuf_destroy(&trim);
+                trim = rgb;
+            }
+
+            nimage = image_from_pixbuf(trim, NULL);
+            pixbuf_destroy(&trim);
+        }
+
+        pixbuf_destroy(&pixels);
+        if (nimage != NULL)
+            return nimage;
+    }
+
+    ctx = dctx_bitmap(width, height, ekRGB24);
     t2d_movef(&t2d, kT2D_IDENTf, - (real32_t)x, - (real32_t)y);
     draw_matrixf(ctx, &t2d);
     draw_image(ctx, image, 0, 0);
@@ -402,7 +433,26 @@ Image *image_scale(const Image *image, const uint32_t nwidth, const uint32_t nhe
     {
         OSImage *osimage = NULL;
         real32_t *frame_length = NULL;
-        cassert_no_null(image);
+        Pixbuf *pixels = image_pixels(image, ekFIMAGE);
+
+        /* Portable resampling, same result in all backends */
+        if (pixels != NULL)
+        {
+            Image *nimage = NULL;
+            pixformat_t format = pixbuf_format(pixels);
+            if (format == ekGRAY8 || format == ekRGB24 || format == ekRGBA32)
+            {
+                Pixbuf *scaled = pixbuf_resample(pixels, width, height, ekRBILINEAR, NULL);
+                nimage = image_from_pixbuf(scaled, NULL);
+                image_codec(nimage, image->codec);
+                pixbuf_destroy(&scaled);
+            }
+
+            pixbuf_destroy(&pixels);
+            if (nimage != NULL)
+                return nimage;
+        }
+
         osimage = osimage_create_scaled(image->osimage, width, height);
         return i_create_image(1, PARAM(num_frames, 0), &frame_length, image->codec, &osimage);
     }
@@ -520,7 +570,7 @@ Pixbuf *image_pixels(const Image *image, const pixformat_t format)
     //        {
     //            Pixbuf *npixels = NULL;
     //            cassert(palette == NULL || *palette == NULL);
-    //            npixels = imgutil_to_indexed(pixbuf_width(*pixels), pixbuf_height(*pixels), pixbuf_data(*pixels), rformat == ekRGB24 ? 3 : 4, palette);
+    //            npixels = imgutil_to_indexed(*pixels, 256, FALSE, palette);
     //            if (npixels != NULL)
     //            {
     //                pixbuf_destroy(pixels);
@@ -11,14 +11,35 @@
 /* Image utilities */
 
 #include "imgutils.inl"
+#include "bmath.h"
 #include "bmem.h"
+#include "bpool.h"
 #include "buffer.h"
 #include "cassert.h"
 #include "color.h"
+#include "hashst.h"
+#include "heap.h"
 #include "palette.h"
 #include "pixbuf.h"
+#include "ptr.h"
 #include "strings.h"
 #include "stream.h"
+#include "types.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define i_WITH_SSE2
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define i_SSSE3
+#else
+#define i_SSSE3 __attribute__((target("ssse3")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define i_WITH_NEON
+#include <arm_neon.h>
+#endif
 
 typedef struct _gif_desc_t GifDesc;
 typedef struct _gif_image_t GifImage;
@@ -667,96 +688,1556 @@ Palette *imgutils_def_palette(const pixformat_t format)
 
 /*---------------------------------------------------------------------------*/
 
-Pixbuf *imgutil_rgba_to_rgb(const byte_t *data, const uint32_t width, const uint32_t height)
+/*
+ * Pixel conversion kernels. They convert 'n' consecutive pixels, Pixbuf
+ * rows have no padding so a whole image is a single run. Scalar versions
+ * work everywhere. With SSE2 (always in x64) and SSSE3 (detected at
+ * 'imgutil_start') or NEON, kernels convert 16 pixels per iteration and
+ * let the scalar code finish the tail.
+ */
+
+#define i_color(r, g, b, a)\
+    (color_t)(((a) << 24) | ((b) << 16) | ((g) << 8) | (r))
+
+#define i_LUMA(r, g, b)\
+    (byte_t)((77 * (uint32_t)(r) + 148 * (uint32_t)(g) + 30 * (uint32_t)(b)) / 255)
+
+typedef void(*FPtr_row)(const byte_t *src, byte_t *dest, const uint32_t n);
+
+typedef struct _kernels_t i_Kernels;
+
+struct _kernels_t
+{
+    FPtr_row rgba_to_rgb;
+    FPtr_row rgb_to_rgba;
+    FPtr_row rgba_to_gray;
+    FPtr_row rgb_to_gray;
+    FPtr_row gray_to_rgb;
+    FPtr_row gray_to_rgba;
+};
+
+/*---------------------------------------------------------------------------*/
+
+static void i_rgba_to_rgb(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i < n; ++i, src += 4, dest += 3)
+    {
+        dest[0] = src[0];
+        dest[1] = src[1];
+        dest[2] = src[2];
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_rgb_to_rgba(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i < n; ++i, src += 3, dest += 4)
+    {
+        dest[0] = src[0];
+        dest[1] = src[1];
+        dest[2] = src[2];
+        dest[3] = 255;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_rgba_to_gray(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i < n; ++i, src += 4)
+        dest[i] = i_LUMA(src[0], src[1], src[2]);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_rgb_to_gray(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i < n; ++i, src += 3)
+        dest[i] = i_LUMA(src[0], src[1], src[2]);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_gray_to_rgb(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i < n; ++i, dest += 3)
+    {
+        dest[0] = src[i];
+        dest[1] = src[i];
+        dest[2] = src[i];
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_gray_to_rgba(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i < n; ++i, dest += 4)
+    {
+        dest[0] = src[i];
+        dest[1] = src[i];
+        dest[2] = src[i];
+        dest[3] = 255;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if defined(i_WITH_SSE2)
+
+/* 8 lumas (16 bits) of two RGBA registers. x / 255 == (x + 1 + (x >> 8)) >> 8 for x <= 65025 */
+static __INLINE __m128i i_luma8_sse2(const __m128i p0, const __m128i p1)
+{
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i r = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+    __m128i x = _mm_mullo_epi16(r, _mm_set1_epi16(77));
+    x = _mm_add_epi16(x, _mm_mullo_epi16(g, _mm_set1_epi16(148)));
+    x = _mm_add_epi16(x, _mm_mullo_epi16(b, _mm_set1_epi16(30)));
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE __m128i i_luma16_sse2(const __m128i p0, const __m128i p1, const __m128i p2, const __m128i p3)
+{
+    return _mm_packus_epi16(i_luma8_sse2(p0, p1), i_luma8_sse2(p2, p3));
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_rgba_to_gray_sse2(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, src += 64)
+    {
+        __m128i p0 = _mm_loadu_si128((const __m128i*)src);
+        __m128i p1 = _mm_loadu_si128((const __m128i*)(src + 16));
+        __m128i p2 = _mm_loadu_si128((const __m128i*)(src + 32));
+        __m128i p3 = _mm_loadu_si128((const __m128i*)(src + 48));
+        _mm_storeu_si128((__m128i*)(dest + i), i_luma16_sse2(p0, p1, p2, p3));
+    }
+
+    i_rgba_to_gray(src, dest + i, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_gray_to_rgba_sse2(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    const __m128i alpha = _mm_set1_epi8((char)0xFF);
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, dest += 64)
+    {
+        __m128i g = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i gg0 = _mm_unpacklo_epi8(g, g);
+        __m128i gg1 = _mm_unpackhi_epi8(g, g);
+        __m128i ga0 = _mm_unpacklo_epi8(g, alpha);
+        __m128i ga1 = _mm_unpackhi_epi8(g, alpha);
+        _mm_storeu_si128((__m128i*)dest, _mm_unpacklo_epi16(gg0, ga0));
+        _mm_storeu_si128((__m128i*)(dest + 16), _mm_unpackhi_epi16(gg0, ga0));
+        _mm_storeu_si128((__m128i*)(dest + 32), _mm_unpacklo_epi16(gg1, ga1));
+        _mm_storeu_si128((__m128i*)(dest + 48), _mm_unpackhi_epi16(gg1, ga1));
+    }
+
+    i_gray_to_rgba(src + i, dest, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 16 RGB pixels (48 bytes) to four RGBA registers */
+static i_SSSE3 __INLINE void i_load_rgb_ssse3(const byte_t *src, __m128i *p)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    __m128i s0 = _mm_loadu_si128((const __m128i*)src);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)(src + 16));
+    __m128i s2 = _mm_loadu_si128((const __m128i*)(src + 32));
+    p[0] = _mm_or_si128(_mm_shuffle_epi8(s0, shuffle), alpha);
+    p[1] = _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(s1, s0, 12), shuffle), alpha);
+    p[2] = _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(s2, s1, 8), shuffle), alpha);
+    p[3] = _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(s2, 4), shuffle), alpha);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_SSSE3 void i_rgb_to_rgba_ssse3(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, src += 48, dest += 64)
+    {
+        __m128i p[4];
+        i_load_rgb_ssse3(src, p);
+        _mm_storeu_si128((__m128i*)dest, p[0]);
+        _mm_storeu_si128((__m128i*)(dest + 16), p[1]);
+        _mm_storeu_si128((__m128i*)(dest + 32), p[2]);
+        _mm_storeu_si128((__m128i*)(dest + 48), p[3]);
+    }
+
+    i_rgb_to_rgba(src, dest, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_SSSE3 void i_rgb_to_gray_ssse3(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, src += 48)
+    {
+        __m128i p[4];
+        i_load_rgb_ssse3(src, p);
+        _mm_storeu_si128((__m128i*)(dest + i), i_luma16_sse2(p[0], p[1], p[2], p[3]));
+    }
+
+    i_rgb_to_gray(src, dest + i, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_SSSE3 void i_rgba_to_rgb_ssse3(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, src += 64, dest += 48)
+    {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), shuffle);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 16)), shuffle);
+        __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 32)), shuffle);
+        __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 48)), shuffle);
+        _mm_storeu_si128((__m128i*)dest, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128((__m128i*)(dest + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128((__m128i*)(dest + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+    }
+
+    i_rgba_to_rgb(src, dest, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_SSSE3 void i_gray_to_rgb_ssse3(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    const __m128i s0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m128i s1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m128i s2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, dest += 48)
+    {
+        __m128i g = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)dest, _mm_shuffle_epi8(g, s0));
+        _mm_storeu_si128((__m128i*)(dest + 16), _mm_shuffle_epi8(g, s1));
+        _mm_storeu_si128((__m128i*)(dest + 32), _mm_shuffle_epi8(g, s2));
+    }
+
+    i_gray_to_rgb(src + i, dest, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_with_ssse3(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0 ? TRUE : FALSE;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3") ? TRUE : FALSE;
+#endif
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+#if defined(i_WITH_NEON)
+
+/* 8 lumas of de-interleaved channels */
+static __INLINE uint8x8_t i_luma8_neon(const uint8x8_t r, const uint8x8_t g, const uint8x8_t b)
+{
+    uint16x8_t x = vmull_u8(r, vdup_n_u8(77));
+    x = vmlal_u8(x, g, vdup_n_u8(148));
+    x = vmlal_u8(x, b, vdup_n_u8(30));
+    x = vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8));
+    return vshrn_n_u16(x, 8);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint8x16_t i_luma16_neon(const uint8x16_t r, const uint8x16_t g, const uint8x16_t b)
+{
+    uint8x8_t lo = i_luma8_neon(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b));
+    uint8x8_t hi = i_luma8_neon(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b));
+    return vcombine_u8(lo, hi);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_rgba_to_rgb_neon(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, src += 64, dest += 48)
+    {
+        uint8x16x4_t p = vld4q_u8(src);
+        uint8x16x3_t o;
+        o.val[0] = p.val[0];
+        o.val[1] = p.val[1];
+        o.val[2] = p.val[2];
+        vst3q_u8(dest, o);
+    }
+
+    i_rgba_to_rgb(src, dest, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_rgb_to_rgba_neon(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, src += 48, dest += 64)
+    {
+        uint8x16x3_t p = vld3q_u8(src);
+        uint8x16x4_t o;
+        o.val[0] = p.val[0];
+        o.val[1] = p.val[1];
+        o.val[2] = p.val[2];
+        o.val[3] = vdupq_n_u8(255);
+        vst4q_u8(dest, o);
+    }
+
+    i_rgb_to_rgba(src, dest, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_rgba_to_gray_neon(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, src += 64)
+    {
+        uint8x16x4_t p = vld4q_u8(src);
+        vst1q_u8(dest + i, i_luma16_neon(p.val[0], p.val[1], p.val[2]));
+    }
+
+    i_rgba_to_gray(src, dest + i, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_rgb_to_gray_neon(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, src += 48)
+    {
+        uint8x16x3_t p = vld3q_u8(src);
+        vst1q_u8(dest + i, i_luma16_neon(p.val[0], p.val[1], p.val[2]));
+    }
+
+    i_rgb_to_gray(src, dest + i, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_gray_to_rgb_neon(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, dest += 48)
+    {
+        uint8x16x3_t o;
+        o.val[0] = vld1q_u8(src + i);
+        o.val[1] = o.val[0];
+        o.val[2] = o.val[0];
+        vst3q_u8(dest, o);
+    }
+
+    i_gray_to_rgb(src + i, dest, n - i);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_gray_to_rgba_neon(const byte_t *src, byte_t *dest, const uint32_t n)
+{
+    register uint32_t i;
+    for (i = 0; i + 16 <= n; i += 16, dest += 64)
+    {
+        uint8x16x4_t o;
+        o.val[0] = vld1q_u8(src + i);
+        o.val[1] = o.val[0];
+        o.val[2] = o.val[0];
+        o.val[3] = vdupq_n_u8(255);
+        vst4q_u8(dest, o);
+    }
+
+    i_gray_to_rgba(src + i, dest, n - i);
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+static i_Kernels i_KERNELS = {
+    i_rgba_to_rgb,
+    i_rgb_to_rgba,
+    i_rgba_to_gray,
+    i_rgb_to_gray,
+    i_gray_to_rgb,
+    i_gray_to_rgba
+};
+
+/*---------------------------------------------------------------------------*/
+
+void imgutil_start(void)
+{
+#if defined(i_WITH_SSE2)
+    i_KERNELS.rgba_to_gray = i_rgba_to_gray_sse2;
+    i_KERNELS.gray_to_rgba = i_gray_to_rgba_sse2;
+    if (i_with_ssse3() == TRUE)
+    {
+        i_KERNELS.rgba_to_rgb = i_rgba_to_rgb_ssse3;
+        i_KERNELS.rgb_to_rgba = i_rgb_to_rgba_ssse3;
+        i_KERNELS.rgb_to_gray = i_rgb_to_gray_ssse3;
+        i_KERNELS.gray_to_rgb = i_gray_to_rgb_ssse3;
+    }
+#elif defined(i_WITH_NEON)
+    i_KERNELS.rgba_to_rgb = i_rgba_to_rgb_neon;
+    i_KERNELS.rgb_to_rgba = i_rgb_to_rgba_neon;
+    i_KERNELS.rgba_to_gray = i_rgba_to_gray_neon;
+    i_KERNELS.rgb_to_gray = i_rgb_to_gray_neon;
+    i_KERNELS.gray_to_rgb = i_gray_to_rgb_neon;
+    i_KERNELS.gray_to_rgba = i_gray_to_rgba_neon;
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 'n' indices (one byte each) from packed pixels. Pixbuf packs LSB first */
+static void i_unpack(const byte_t *src, byte_t *index, const uint32_t n, const uint32_t bpp)
+{
+    if (bpp == 8)
+    {
+        bmem_copy(index, src, n);
+    }
+    else
+    {
+        register uint32_t i;
+        register uint32_t per = 8 / bpp;
+        register byte_t mask = (byte_t)((1 << bpp) - 1);
+        for (i = 0; i < n; ++i)
+            index[i] = (byte_t)((src[i / per] >> ((i % per) * bpp)) & mask);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_pack(const byte_t *index, byte_t *dest, const uint32_t n, const uint32_t bpp)
+{
+    if (bpp == 8)
+    {
+        bmem_copy(dest, index, n);
+    }
+    else
+    {
+        register uint32_t i, j;
+        register uint32_t per = 8 / bpp;
+        for (i = 0; i < n; i += per)
+        {
+            register byte_t b = 0;
+            for (j = 0; j < per && i + j < n; ++j)
+                b |= (byte_t)(index[i + j] << (j * bpp));
+            dest[i / per] = b;
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint32_t i_dist(const color_t c1, const color_t c2)
+{
+    register int32_t dr = (int32_t)(c1 & 0xFF) - (int32_t)(c2 & 0xFF);
+    register int32_t dg = (int32_t)((c1 >> 8) & 0xFF) - (int32_t)((c2 >> 8) & 0xFF);
+    register int32_t db = (int32_t)((c1 >> 16) & 0xFF) - (int32_t)((c2 >> 16) & 0xFF);
+    register int32_t da = (int32_t)(c1 >> 24) - (int32_t)(c2 >> 24);
+    return (uint32_t)(dr * dr + dg * dg + db * db + da * da);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_nearest(const color_t *colors, const uint32_t n, const color_t c)
+{
+    register uint32_t i, best = 0, dist = UINT32_MAX;
+    for (i = 0; i < n && dist > 0; ++i)
+    {
+        register uint32_t d = i_dist(c, colors[i]);
+        if (d < dist)
+        {
+            dist = d;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint32_t i_hash(const color_t c, const uint32_t bits)
+{
+    return (uint32_t)(((uint32_t)c * 2654435761u) >> (32 - bits));
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Direct-mapped color -> nearest index cache. Collisions just evict the older color */
+#define i_CACHE_BITS    12
+#define i_CACHE_SIZE    (1 << i_CACHE_BITS)
+
+typedef struct _cache_t i_Cache;
+
+struct _cache_t
+{
+    uint32_t ncolors;
+    /* Palette sorted by green, misses search outwards from the pixel green */
+    color_t sorted[256];
+    byte_t green[256];
+    byte_t sindex[256];
+    color_t color[i_CACHE_SIZE];
+    /* Index plus one, zero in empty slots */
+    uint16_t index[i_CACHE_SIZE];
+};
+
+/*---------------------------------------------------------------------------*/
+
+static i_Cache *i_cache_create(const color_t *colors, const uint32_t ncolors)
+{
+    i_Cache *cache = heap_new0(i_Cache);
+    register uint32_t i, j;
+    cassert(ncolors <= 256);
+    cache->ncolors = ncolors;
+    for (i = 0; i < ncolors; ++i)
+    {
+        byte_t g = (byte_t)((colors[i] >> 8) & 0xFF);
+        for (j = i; j > 0 && cache->green[j - 1] > g; --j)
+        {
+            cache->sorted[j] = cache->sorted[j - 1];
+            cache->green[j] = cache->green[j - 1];
+            cache->sindex[j] = cache->sindex[j - 1];
+        }
+
+        cache->sorted[j] = colors[i];
+        cache->green[j] = g;
+        cache->sindex[j] = (byte_t)i;
+    }
+
+    return cache;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Same result as 'i_nearest', lower index in ties. The green distance bounds the search */
+static uint32_t i_cache_search(const i_Cache *cache, const color_t c)
+{
+    register int32_t g = (int32_t)((c >> 8) & 0xFF);
+    register int32_t up = 0, down = 0;
+    register uint32_t best = 0, dist = UINT32_MAX;
+    register int32_t n = (int32_t)cache->ncolors;
+
+    while (up < n && (int32_t)cache->green[up] < g)
+        up += 1;
+
+    down = up - 1;
+    while (up < n || down >= 0)
+    {
+        if (up < n)
+        {
+            register int32_t dg = (int32_t)cache->green[up] - g;
+            if ((uint32_t)(dg * dg) > dist)
+            {
+                up = n;
+            }
+            else
+            {
+                register uint32_t d = i_dist(c, cache->sorted[up]);
+                if (d < dist || (d == dist && cache->sindex[up] < best))
+                {
+                    dist = d;
+                    best = cache->sindex[up];
+                }
+                up += 1;
+            }
+        }
+
+        if (down >= 0)
+        {
+            register int32_t dg = g - (int32_t)cache->green[down];
+            if ((uint32_t)(dg * dg) > dist)
+            {
+                down = -1;
+            }
+            else
+            {
+                register uint32_t d = i_dist(c, cache->sorted[down]);
+                if (d < dist || (d == dist && cache->sindex[down] < best))
+                {
+                    dist = d;
+                    best = cache->sindex[down];
+                }
+                down -= 1;
+            }
+        }
+    }
+
+    return best;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint32_t i_cache_nearest(i_Cache *cache, const color_t c)
+{
+    register uint32_t h = i_hash(c, i_CACHE_BITS);
+    if (cache->index[h] == 0 || cache->color[h] != c)
+    {
+        cache->color[h] = c;
+        cache->index[h] = (uint16_t)(i_cache_search(cache, c) + 1);
+    }
+
+    return (uint32_t)cache->index[h] - 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Exact color -> index map for up to 256 colors. Open addressing at half load */
+#define i_MAP_BITS      9
+#define i_MAP_SIZE      (1 << i_MAP_BITS)
+
+typedef struct _map_t i_ColorMap;
+
+struct _map_t
+{
+    color_t color[i_MAP_SIZE];
+    /* Index plus one, zero in empty slots */
+    uint16_t index[i_MAP_SIZE];
+};
+
+/*---------------------------------------------------------------------------*/
+
+static void i_map_init(i_ColorMap *map)
+{
+    bmem_zero_n(map->index, i_MAP_SIZE, uint16_t);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Index of 'c'. New colors get index 'n' while there are less than 'max', otherwise UINT32_MAX */
+static uint32_t i_map_index(i_ColorMap *map, const color_t c, uint32_t *n, const uint32_t max)
+{
+    register uint32_t h = i_hash(c, i_MAP_BITS);
+    cassert(max <= 256);
+    for (;;)
+    {
+        if (map->index[h] == 0)
+        {
+            if (*n == max)
+                return UINT32_MAX;
+
+            map->color[h] = c;
+            map->index[h] = (uint16_t)(*n + 1);
+            *n += 1;
+            return *n - 1;
+        }
+
+        if (map->color[h] == c)
+            return (uint32_t)map->index[h] - 1;
+
+        h = (h + 1) & (i_MAP_SIZE - 1);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Indexed pixels are processed in blocks, multiple of 8 keeps the packed bytes aligned */
+#define i_BLOCK     1024
+
+/*---------------------------------------------------------------------------*/
+
+static void i_from_indexed(const byte_t *src, byte_t *dest, const uint32_t n, const uint32_t ibpp, const color_t *colors, const uint32_t ncolors, const pixformat_t oformat)
+{
+    uint32_t lut[256];
+    byte_t index[i_BLOCK];
+    uint32_t obpp = pixbuf_format_bpp(oformat);
+    register uint32_t i, j;
+
+    /* Index to output pixel. Out of palette indices are black */
+    for (i = 0; i < 256; ++i)
+    {
+        color_t c = i < ncolors ? colors[i] : kCOLOR_BLACK;
+        switch (oformat) {
+        case ekGRAY8:
+            lut[i] = (uint32_t)i_LUMA(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF);
+            break;
+        case ekRGB24:
+        case ekRGBA32:
+            lut[i] = (uint32_t)c;
+            break;
+        case ekINDEX1:
+        case ekINDEX2:
+        case ekINDEX4:
+        case ekINDEX8:
+            /* Narrowing, indices that don't fit go to the nearest color that fits */
+            if (i < (1u << obpp))
+                lut[i] = i;
+            else
+                lut[i] = i_nearest(colors, min_val(ncolors, 1u << obpp), c);
+            break;
+        case ekFIMAGE:
+        cassert_default();
+        }
+    }
+
+    for (i = 0; i < n; i += i_BLOCK)
+    {
+        uint32_t m = min_val(i_BLOCK, n - i);
+        i_unpack(src + i / (8 / ibpp), index, m, ibpp);
+        switch (oformat) {
+        case ekGRAY8:
+            for (j = 0; j < m; ++j)
+                dest[i + j] = (byte_t)lut[index[j]];
+            break;
+
+        case ekRGB24:
+        {
+            byte_t *d = dest + i * 3;
+            for (j = 0; j < m; ++j, d += 3)
+            {
+                uint32_t c = lut[index[j]];
+                d[0] = (byte_t)c;
+                d[1] = (byte_t)(c >> 8);
+                d[2] = (byte_t)(c >> 16);
+            }
+            break;
+        }
+
+        case ekRGBA32:
+        {
+            uint32_t *d = (uint32_t*)dest + i;
+            for (j = 0; j < m; ++j)
+                d[j] = lut[index[j]];
+            break;
+        }
+
+        case ekINDEX1:
+        case ekINDEX2:
+        case ekINDEX4:
+        case ekINDEX8:
+            for (j = 0; j < m; ++j)
+                index[j] = (byte_t)lut[index[j]];
+            i_pack(index, dest + i / (8 / obpp), m, obpp);
+            break;
+
+        case ekFIMAGE:
+        cassert_default();
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 'mask' drops color bits before the search. Near colors share the cache entry */
+static void i_to_indexed(const byte_t *src, byte_t *dest, const uint32_t n, const pixformat_t iformat, const color_t *colors, const uint32_t ncolors, const uint32_t obpp, const uint32_t mask)
+{
+    byte_t index[i_BLOCK];
+    byte_t gray[256];
+    i_Cache *cache = NULL;
+    color_t last = 0;
+    uint32_t lasti = i_nearest(colors, ncolors, last);
+    register uint32_t i, j;
+
+    /* Only 256 possible gray inputs */
+    if (iformat == ekGRAY8)
+    {
+        for (i = 0; i < 256; ++i)
+            gray[i] = (byte_t)i_nearest(colors, ncolors, i_color(i, i, i, 255));
+    }
+    else
+    {
+        cache = i_cache_create(colors, ncolors);
+    }
+
+    for (i = 0; i < n; i += i_BLOCK)
+    {
+        uint32_t m = min_val(i_BLOCK, n - i);
+        if (iformat == ekGRAY8)
+        {
+            for (j = 0; j < m; ++j)
+                index[j] = gray[src[j]];
+            src += m;
+        }
+        else
+        {
+            for (j = 0; j < m; ++j)
+            {
+                register color_t c;
+                if (iformat == ekRGB24)
+                {
+                    c = i_color(src[0], src[1], src[2], 255);
+                    src += 3;
+                }
+                else
+                {
+                    cassert(iformat == ekRGBA32);
+                    c = i_color(src[0], src[1], src[2], src[3]);
+                    src += 4;
+                }
+
+                /* Images have runs of equal colors */
+                if (c != last)
+                {
+                    last = c;
+                    lasti = i_cache_nearest(cache, c & mask);
+                }
+
+                index[j] = (byte_t)lasti;
+            }
+        }
+
+        i_pack(index, dest + i / (8 / obpp), m, obpp);
+    }
+
+    if (cache != NULL)
+        heap_delete(&cache, i_Cache);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE bool_t i_indexed(const pixformat_t format)
+{
+    return (bool_t)(format == ekINDEX1 || format == ekINDEX2 || format == ekINDEX4 || format == ekINDEX8);
+}
+
+/*---------------------------------------------------------------------------*/
+
+Pixbuf *imgutil_convert(const Pixbuf *pixbuf, const Palette *palette, const pixformat_t oformat)
+{
+    pixformat_t iformat = pixbuf_format(pixbuf);
+    uint32_t width = pixbuf_width(pixbuf);
+    uint32_t height = pixbuf_height(pixbuf);
+    uint32_t n = width * height;
+    const byte_t *src = pixbuf_cdata(pixbuf);
+    Pixbuf *npixbuf = pixbuf_create(width, height, oformat);
+    byte_t *dest = pixbuf_data(npixbuf);
+    cassert(iformat != oformat);
+
+    if (i_indexed(iformat) == TRUE || i_indexed(oformat) == TRUE)
+    {
+        /* The palette is the source one for indexed inputs, the target one for the rest */
+        Palette *defpal = NULL;
+        if (palette == NULL)
+        {
+            defpal = imgutils_def_palette(i_indexed(iformat) == TRUE ? iformat : oformat);
+            palette = defpal;
+        }
+
+        if (i_indexed(iformat) == TRUE)
+        {
+            i_from_indexed(src, dest, n, pixbuf_format_bpp(iformat), palette_ccolors(palette), palette_size(palette), oformat);
+        }
+        else
+        {
+            uint32_t obpp = pixbuf_format_bpp(oformat);
+            i_to_indexed(src, dest, n, iformat, palette_ccolors(palette), min_val(palette_size(palette), 1u << obpp), obpp, 0xFFFFFFFF);
+        }
+
+        ptr_destopt(palette_destroy, &defpal, Palette);
+        return npixbuf;
+    }
+
+    switch (iformat) {
+    case ekGRAY8:
+        if (oformat == ekRGB24)
+            i_KERNELS.gray_to_rgb(src, dest, n);
+        else
+            i_KERNELS.gray_to_rgba(src, dest, n);
+        break;
+
+    case ekRGB24:
+        if (oformat == ekGRAY8)
+            i_KERNELS.rgb_to_gray(src, dest, n);
+        else
+            i_KERNELS.rgb_to_rgba(src, dest, n);
+        break;
+
+    case ekRGBA32:
+        if (oformat == ekGRAY8)
+            i_KERNELS.rgba_to_gray(src, dest, n);
+        else
+            i_KERNELS.rgba_to_rgb(src, dest, n);
+        break;
+
+    case ekINDEX1:
+    case ekINDEX2:
+    case ekINDEX4:
+    case ekINDEX8:
+    case ekFIMAGE:
+    cassert_default();
+    }
+
+    return npixbuf;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Resampling weights are 2.14 fixed point, the sum of each window is exactly 1 */
+#define i_WBITS     14
+
+typedef struct _coeffs_t i_Coeffs;
+typedef struct _resampler_t i_Resampler;
+
+struct _coeffs_t
+{
+    uint32_t n;
+    uint32_t taps;
+    uint32_t *start;
+    uint32_t *count;
+    int16_t *weights;
+};
+
+struct _resampler_t
+{
+    const byte_t *src;
+    byte_t *tmp;
+    byte_t *dest;
+    uint32_t bpp;
+    uint32_t sstride;
+    uint32_t dstride;
+    /* First source row in 'tmp' */
+    uint32_t ystart;
+    bool_t premul;
+    i_Coeffs *hcoeffs;
+    i_Coeffs *vcoeffs;
+};
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE int32_t i_clamp(const int32_t v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static real64_t i_sinc(const real64_t x)
+{
+    real64_t px = x * kBMATH_PId;
+    if (x == 0)
+        return 1;
+    return bmath_sind(px) / px;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static real64_t i_support(const resample_t filter)
+{
+    switch (filter) {
+    case ekRBOX:
+        return .5;
+    case ekRBILINEAR:
+        return 1;
+    case ekRBICUBIC:
+        return 2;
+    case ekRLANCZOS:
+        return 3;
+    cassert_default();
+    }
+
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static real64_t i_filter(const resample_t filter, const real64_t x)
+{
+    real64_t ax = bmath_absd(x);
+    switch (filter) {
+    case ekRBOX:
+        return (x > -.5 && x <= .5) ? 1 : 0;
+    case ekRBILINEAR:
+        return ax < 1 ? 1 - ax : 0;
+    case ekRBICUBIC:
+        /* Keys, a = -0.5 */
+        if (ax < 1)
+            return (1.5 * ax - 2.5) * ax * ax + 1;
+        if (ax < 2)
+            return ((-.5 * ax + 2.5) * ax - 4) * ax + 2;
+        return 0;
+    case ekRLANCZOS:
+        return ax < 3 ? i_sinc(x) * i_sinc(x / 3) : 0;
+    cassert_default();
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* The filter widens with the reduction factor, so every input pixel contributes */
+static i_Coeffs *i_coeffs_create(const uint32_t isize, const uint32_t osize, const resample_t filter)
+{
+    i_Coeffs *coeffs = heap_new(i_Coeffs);
+    real64_t scale = (real64_t)isize / (real64_t)osize;
+    real64_t fscale = scale > 1 ? scale : 1;
+    real64_t support = i_support(filter) * fscale;
+    real64_t *w = NULL;
+    register uint32_t i, k;
+
+    coeffs->n = osize;
+    coeffs->taps = (uint32_t)bmath_ceild(support) * 2 + 1;
+    coeffs->start = heap_new_n(osize, uint32_t);
+    coeffs->count = heap_new_n(osize, uint32_t);
+    coeffs->weights = heap_new_n(osize * coeffs->taps, int16_t);
+    w = heap_new_n(coeffs->taps, real64_t);
+
+    for (i = 0; i < osize; ++i)
+    {
+        real64_t center = ((real64_t)i + .5) * scale;
+        int32_t xmin = (int32_t)bmath_floord(center - support + .5);
+        int32_t xmax = (int32_t)bmath_floord(center + support + .5);
+        int16_t *iw = coeffs->weights + i * coeffs->taps;
+        real64_t total = 0;
+        int32_t sum = 0;
+        uint32_t count, big = 0;
+
+        if (xmin < 0)
+            xmin = 0;
+        if (xmax > (int32_t)isize)
+            xmax = (int32_t)isize;
+        count = (uint32_t)(xmax - xmin);
+        cassert(count > 0 && count <= coeffs->taps);
+
+        for (k = 0; k < count; ++k)
+        {
+            w[k] = i_filter(filter, ((real64_t)xmin + (real64_t)k - center + .5) / fscale);
+            total += w[k];
+        }
+
+        for (k = 0; k < count; ++k)
+        {
+            iw[k] = (int16_t)bmath_roundd((total != 0 ? w[k] / total : 1. / count) * (1 << i_WBITS));
+            sum += iw[k];
+            if (iw[k] > iw[big])
+                big = k;
+        }
+
+        /* Rounding leftovers go to the main tap, flat areas stay flat */
+        iw[big] = (int16_t)(iw[big] + (1 << i_WBITS) - sum);
+
+        /* Zero taps at the window ends (exact positions in linear filters) */
+        while (count > 1 && iw[count - 1] == 0)
+            count -= 1;
+
+        while (count > 1 && iw[0] == 0)
+        {
+            bmem_move((byte_t*)iw, (const byte_t*)(iw + 1), (count - 1) * sizeof32(int16_t));
+            xmin += 1;
+            count -= 1;
+        }
+
+        coeffs->start[i] = (uint32_t)xmin;
+        coeffs->count[i] = count;
+    }
+
+    heap_delete_n(&w, coeffs->taps, real64_t);
+    return coeffs;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_coeffs_destroy(i_Coeffs **coeffs)
+{
+    cassert_no_null(coeffs);
+    cassert_no_null(*coeffs);
+    heap_delete_n(&(*coeffs)->start, (*coeffs)->n, uint32_t);
+    heap_delete_n(&(*coeffs)->count, (*coeffs)->n, uint32_t);
+    heap_delete_n(&(*coeffs)->weights, (*coeffs)->n * (*coeffs)->taps, int16_t);
+    heap_delete(coeffs, i_Coeffs);
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if !defined(i_WITH_SSE2)
+
+static void i_hrow(const byte_t *src, byte_t *dest, const i_Coeffs *coeffs, const uint32_t bpp)
+{
+    register uint32_t i, k;
+    for (i = 0; i < coeffs->n; ++i, dest += bpp)
+    {
+        const int16_t *w = coeffs->weights + i * coeffs->taps;
+        const byte_t *s = src + coeffs->start[i] * bpp;
+        uint32_t count = coeffs->count[i];
+        register int32_t r = 1 << (i_WBITS - 1), g = r, b = r, a = r;
+
+        switch (bpp) {
+        case 1:
+            for (k = 0; k < count; ++k)
+                r += (int32_t)s[k] * w[k];
+            dest[0] = (byte_t)i_clamp(r >> i_WBITS);
+            break;
+
+        case 3:
+            for (k = 0; k < count; ++k, s += 3)
+            {
+                r += (int32_t)s[0] * w[k];
+                g += (int32_t)s[1] * w[k];
+                b += (int32_t)s[2] * w[k];
+            }
+
+            dest[0] = (byte_t)i_clamp(r >> i_WBITS);
+            dest[1] = (byte_t)i_clamp(g >> i_WBITS);
+            dest[2] = (byte_t)i_clamp(b >> i_WBITS);
+            break;
+
+        case 4:
+            for (k = 0; k < count; ++k, s += 4)
+            {
+                r += (int32_t)s[0] * w[k];
+                g += (int32_t)s[1] * w[k];
+                b += (int32_t)s[2] * w[k];
+                a += (int32_t)s[3] * w[k];
+            }
+
+            dest[0] = (byte_t)i_clamp(r >> i_WBITS);
+            dest[1] = (byte_t)i_clamp(g >> i_WBITS);
+            dest[2] = (byte_t)i_clamp(b >> i_WBITS);
+            dest[3] = (byte_t)i_clamp(a >> i_WBITS);
+            break;
+
+        cassert_default();
+        }
+    }
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+static void i_vrow(const byte_t *src, const uint32_t stride, byte_t *dest, const uint32_t size, const int16_t *w, const uint32_t count, int32_t *acc)
 {
-    register uint32_t i, n = width * height;
-    Pixbuf *pixbuf = pixbuf_create(width, height, ekRGB24);
-    byte_t *dest = pixbuf_data(pixbuf);
-    for (i = 0; i < n; ++i, data += 4, dest += 3)
+    register uint32_t x, k;
+    for (x = 0; x < size; ++x)
+        acc[x] = 1 << (i_WBITS - 1);
+
+    /* Row by row, the source is walked in memory order */
+    for (k = 0; k < count; ++k, src += stride)
     {
-        dest[0] = data[0];
-        dest[1] = data[1];
-        dest[2] = data[2];
+        register int32_t wk = w[k];
+        for (x = 0; x < size; ++x)
+            acc[x] += (int32_t)src[x] * wk;
     }
 
-    return pixbuf;
+    for (x = 0; x < size; ++x)
+        dest[x] = (byte_t)i_clamp(acc[x] >> i_WBITS);
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if defined(i_WITH_SSE2)
+
+/* Two 16 bits weights per 32 bits lane, to be used with '_mm_madd_epi16' */
+static __INLINE __m128i i_wpair_sse2(const int16_t w0, const int16_t w1)
+{
+    return _mm_set1_epi32((int32_t)((uint32_t)(uint16_t)w0 | ((uint32_t)(uint16_t)w1 << 16)));
 }
 
 /*---------------------------------------------------------------------------*/
 
-Pixbuf *imgutil_rgb_to_rgba(const byte_t *data, const uint32_t width, const uint32_t height)
+/* Eight taps per step, the weights are contiguous */
+static void i_hrow_gray_sse2(const byte_t *src, byte_t *dest, const i_Coeffs *coeffs)
 {
-    register uint32_t i, n = width * height;
-    Pixbuf *pixbuf = pixbuf_create(width, height, ekRGBA32);
-    byte_t *dest = pixbuf_data(pixbuf);
-    for (i = 0; i < n; ++i, data += 3, dest += 4)
+    const __m128i zero = _mm_setzero_si128();
+    register uint32_t i, k;
+    for (i = 0; i < coeffs->n; ++i)
     {
-        dest[0] = data[0];
-        dest[1] = data[1];
-        dest[2] = data[2];
-        dest[3] = 255;
+        const int16_t *w = coeffs->weights + i * coeffs->taps;
+        const byte_t *s = src + coeffs->start[i];
+        uint32_t count = coeffs->count[i];
+        __m128i acc = zero;
+        int32_t sum[4];
+        register int32_t v;
+
+        for (k = 0; k + 8 <= count; k += 8)
+        {
+            __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(s + k)), zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_loadu_si128((const __m128i*)(w + k))));
+        }
+
+        _mm_storeu_si128((__m128i*)sum, acc);
+        v = sum[0] + sum[1] + sum[2] + sum[3] + (1 << (i_WBITS - 1));
+        for (; k < count; ++k)
+            v += (int32_t)s[k] * w[k];
+
+        dest[i] = (byte_t)i_clamp(v >> i_WBITS);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Two pixels per step: r0 r1 g0 g1 b0 b1 times w0 w1. The fourth lane is garbage */
+static void i_hrow_rgb_sse2(const byte_t *src, byte_t *dest, const i_Coeffs *coeffs, const uint32_t size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi32(1 << (i_WBITS - 1));
+    register uint32_t i, k;
+    for (i = 0; i < coeffs->n; ++i, dest += 3)
+    {
+        const int16_t *w = coeffs->weights + i * coeffs->taps;
+        uint32_t pos = coeffs->start[i] * 3;
+        uint32_t count = coeffs->count[i];
+        __m128i acc = half;
+        int32_t sum[4];
+
+        /* 8 bytes are read for 6, never past the row end */
+        for (k = 0; k + 1 < count && pos + 8 <= size; k += 2, pos += 6)
+        {
+            __m128i p = _mm_loadl_epi64((const __m128i*)(src + pos));
+            p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p, _mm_srli_si128(p, 3)), zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(p, i_wpair_sse2(w[k], w[k + 1])));
+        }
+
+        _mm_storeu_si128((__m128i*)sum, acc);
+        for (; k < count; ++k, pos += 3)
+        {
+            sum[0] += (int32_t)src[pos] * w[k];
+            sum[1] += (int32_t)src[pos + 1] * w[k];
+            sum[2] += (int32_t)src[pos + 2] * w[k];
+        }
+
+        dest[0] = (byte_t)i_clamp(sum[0] >> i_WBITS);
+        dest[1] = (byte_t)i_clamp(sum[1] >> i_WBITS);
+        dest[2] = (byte_t)i_clamp(sum[2] >> i_WBITS);
     }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_hrow_rgba_sse2(const byte_t *src, byte_t *dest, const i_Coeffs *coeffs)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi32(1 << (i_WBITS - 1));
+    register uint32_t i, k;
+    for (i = 0; i < coeffs->n; ++i, dest += 4)
+    {
+        const int16_t *w = coeffs->weights + i * coeffs->taps;
+        const byte_t *s = src + coeffs->start[i] * 4;
+        uint32_t count = coeffs->count[i];
+        __m128i acc = half;
+
+        /* Four pixels per step, as pairs r0 r1 g0 g1 b0 b1 a0 a1 times w0 w1 */
+        for (k = 0; k + 3 < count; k += 4, s += 16)
+        {
+            __m128i p = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)s), _MM_SHUFFLE(3, 1, 2, 0));
+            p = _mm_unpacklo_epi8(p, _mm_srli_si128(p, 8));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), i_wpair_sse2(w[k], w[k + 1])));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), i_wpair_sse2(w[k + 2], w[k + 3])));
+        }
+
+        for (; k + 1 < count; k += 2, s += 8)
+        {
+            __m128i p = _mm_loadl_epi64((const __m128i*)s);
+            p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p, _mm_srli_si128(p, 4)), zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(p, i_wpair_sse2(w[k], w[k + 1])));
+        }
+
+        if (k < count)
+        {
+            __m128i p = _mm_cvtsi32_si128(*(const int32_t*)s);
+            p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p, zero), zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(p, i_wpair_sse2(w[k], 0)));
+        }
 
-    return pixbuf;
+        acc = _mm_srai_epi32(acc, i_WBITS);
+        acc = _mm_packs_epi32(acc, acc);
+        *(int32_t*)dest = _mm_cvtsi128_si32(_mm_packus_epi16(acc, acc));
+    }
 }
 
 /*---------------------------------------------------------------------------*/
 
-Pixbuf *imgutil_rgba_to_gray(const byte_t *data, const uint32_t width, const uint32_t height)
+/* Two source rows per step, 16 bytes of any format at a time */
+static void i_vrow_sse2(const byte_t *src, const uint32_t stride, byte_t *dest, const uint32_t size, const int16_t *w, const uint32_t count, int32_t *acc)
 {
-    register uint32_t i, n = width * height;
-    Pixbuf *pixbuf = pixbuf_create(width, height, ekGRAY8);
-    byte_t *dest = pixbuf_data(pixbuf);
-    for (i = 0; i < n; ++i, data += 4, dest += 1)
-        *dest = (byte_t)((77 * (uint32_t)data[0] + 148 * (uint32_t)data[1] + 30 * (uint32_t)data[2]) / 255);
-    return pixbuf;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi32(1 << (i_WBITS - 1));
+    register uint32_t x, k;
+    for (x = 0; x + 16 <= size; x += 16)
+    {
+        const byte_t *s = src + x;
+        __m128i a0 = half, a1 = half, a2 = half, a3 = half;
+        for (k = 0; k < count; k += 2, s += 2 * stride)
+        {
+            __m128i r0 = _mm_loadu_si128((const __m128i*)s);
+            __m128i r1 = k + 1 < count ? _mm_loadu_si128((const __m128i*)(s + stride)) : zero;
+            __m128i wp = i_wpair_sse2(w[k], k + 1 < count ? w[k + 1] : 0);
+            __m128i lo = _mm_unpacklo_epi8(r0, r1);
+            __m128i hi = _mm_unpackhi_epi8(r0, r1);
+            a0 = _mm_add_epi32(a0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), wp));
+            a1 = _mm_add_epi32(a1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), wp));
+            a2 = _mm_add_epi32(a2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), wp));
+            a3 = _mm_add_epi32(a3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), wp));
+        }
+
+        a0 = _mm_packs_epi32(_mm_srai_epi32(a0, i_WBITS), _mm_srai_epi32(a1, i_WBITS));
+        a2 = _mm_packs_epi32(_mm_srai_epi32(a2, i_WBITS), _mm_srai_epi32(a3, i_WBITS));
+        _mm_storeu_si128((__m128i*)(dest + x), _mm_packus_epi16(a0, a2));
+    }
+
+    if (x < size)
+        i_vrow(src + x, stride, dest + x, size - x, w, count, acc);
 }
 
+#endif
+
 /*---------------------------------------------------------------------------*/
 
-Pixbuf *imgutil_rgb_to_gray(const byte_t *data, const uint32_t width, const uint32_t height)
+/* Rounded x * a / 255 */
+static __INLINE byte_t i_mul255(const uint32_t x, const uint32_t a)
 {
-    register uint32_t i, n = width * height;
-    Pixbuf *pixbuf = pixbuf_create(width, height, ekGRAY8);
-    byte_t *dest = pixbuf_data(pixbuf);
-    for (i = 0; i < n; ++i, data += 3, dest += 1)
-        *dest = (byte_t)((77 * (uint32_t)data[0] + 148 * (uint32_t)data[1] + 30 * (uint32_t)data[2]) / 255);
-    return pixbuf;
+    register uint32_t t = x * a + 128;
+    return (byte_t)((t + (t >> 8)) >> 8);
 }
 
 /*---------------------------------------------------------------------------*/
 
-Buffer *imgutil_gray_to_rgba(const byte_t *data, const uint32_t width, const uint32_t height)
+static bool_t i_opaque(const byte_t *src, const uint32_t n)
 {
-    register uint32_t i, n = width * height;
-    Buffer *buffer = buffer_create(n * 4);
-    byte_t *dest = buffer_data(buffer);
-    for (i = 0; i < n; ++i, data += 1, dest += 4)
+    register uint32_t i;
+    for (i = 0; i < n; ++i, src += 4)
     {
-        dest[0] = data[0];
-        dest[1] = data[0];
-        dest[2] = data[0];
-        dest[3] = 255;
+        if (src[3] != 255)
+            return FALSE;
     }
 
-    return buffer;
+    return TRUE;
 }
 
 /*---------------------------------------------------------------------------*/
 
-Buffer *imgutil_gray_to_rgb(const byte_t *data, const uint32_t width, const uint32_t height)
+/* Filtering straight alpha spreads the color of transparent pixels */
+static void i_premultiply(const byte_t *src, byte_t *dest, const uint32_t n)
 {
-    register uint32_t i, n = width * height;
-    Buffer *buffer = buffer_create(n * 3);
-    byte_t *dest = buffer_data(buffer);
-    for (i = 0; i < n; ++i, data += 1, dest += 3)
+    register uint32_t i = 0;
+#if defined(i_WITH_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i amask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    const __m128i round = _mm_set1_epi16(128);
+    for (; i + 4 <= n; i += 4, src += 16, dest += 16)
     {
-        dest[0] = data[0];
-        dest[1] = data[0];
-        dest[2] = data[0];
+        __m128i p = _mm_loadu_si128((const __m128i*)src);
+        __m128i lo = _mm_unpacklo_epi8(p, zero);
+        __m128i hi = _mm_unpackhi_epi8(p, zero);
+        __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+        __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+        __m128i tlo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), round);
+        __m128i thi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), round);
+        tlo = _mm_srli_epi16(_mm_add_epi16(tlo, _mm_srli_epi16(tlo, 8)), 8);
+        thi = _mm_srli_epi16(_mm_add_epi16(thi, _mm_srli_epi16(thi, 8)), 8);
+        tlo = _mm_or_si128(_mm_andnot_si128(amask, tlo), _mm_and_si128(amask, lo));
+        thi = _mm_or_si128(_mm_andnot_si128(amask, thi), _mm_and_si128(amask, hi));
+        _mm_storeu_si128((__m128i*)dest, _mm_packus_epi16(tlo, thi));
     }
+#endif
 
-    return buffer;
+    for (; i < n; ++i, src += 4, dest += 4)
+    {
+        register uint32_t a = src[3];
+        dest[0] = i_mul255(src[0], a);
+        dest[1] = i_mul255(src[1], a);
+        dest[2] = i_mul255(src[2], a);
+        dest[3] = (byte_t)a;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_unpremultiply(byte_t *data, const uint32_t n)
+{
+    register uint32_t i, c;
+    for (i = 0; i < n; ++i, data += 4)
+    {
+        register uint32_t a = data[3];
+        if (a == 0)
+        {
+            data[0] = 0;
+            data[1] = 0;
+            data[2] = 0;
+        }
+        else if (a != 255)
+        {
+            for (c = 0; c < 3; ++c)
+            {
+                register uint32_t v = (data[c] * 255 + a / 2) / a;
+                data[c] = (byte_t)(v > 255 ? 255 : v);
+            }
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_hpass(i_Resampler *r, const uint32_t st, const uint32_t ed)
+{
+    byte_t *row = NULL;
+    register uint32_t j;
+    cassert_no_null(r);
+
+    /* Rows are premultiplied on the fly, no copy of the whole image */
+    if (r->premul == TRUE)
+        row = heap_malloc(r->sstride, "ImgUtilResample");
+
+    for (j = st; j < ed; ++j)
+    {
+        const byte_t *src = r->src + (r->ystart + j) * r->sstride;
+        byte_t *dest = r->tmp + j * r->dstride;
+        if (row != NULL)
+        {
+            i_premultiply(src, row, r->sstride / 4);
+            src = row;
+        }
+
+#if defined(i_WITH_SSE2)
+        switch (r->bpp) {
+        case 1:
+            i_hrow_gray_sse2(src, dest, r->hcoeffs);
+            break;
+        case 3:
+            i_hrow_rgb_sse2(src, dest, r->hcoeffs, r->sstride);
+            break;
+        case 4:
+            i_hrow_rgba_sse2(src, dest, r->hcoeffs);
+            break;
+        cassert_default();
+        }
+#else
+        i_hrow(src, dest, r->hcoeffs, r->bpp);
+#endif
+    }
+
+    if (row != NULL)
+        heap_free(&row, r->sstride, "ImgUtilResample");
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_vpass(i_Resampler *r, const uint32_t st, const uint32_t ed)
+{
+    int32_t *acc = heap_new_n(r->dstride, int32_t);
+    register uint32_t j;
+    cassert_no_null(r);
+    for (j = st; j < ed; ++j)
+    {
+        const byte_t *src = r->tmp + (r->vcoeffs->start[j] - r->ystart) * r->dstride;
+        const int16_t *w = r->vcoeffs->weights + j * r->vcoeffs->taps;
+#if defined(i_WITH_SSE2)
+        i_vrow_sse2(src, r->dstride, r->dest + j * r->dstride, r->dstride, w, r->vcoeffs->count[j], acc);
+#else
+        i_vrow(src, r->dstride, r->dest + j * r->dstride, r->dstride, w, r->vcoeffs->count[j], acc);
+#endif
+    }
+
+    heap_delete_n(&acc, r->dstride, int32_t);
+}
+
+/*---------------------------------------------------------------------------*/
+
+Pixbuf *imgutil_resample(const Pixbuf *pixbuf, const uint32_t width, const uint32_t height, const resample_t filter, Pool *pool)
+{
+    pixformat_t format = pixbuf_format(pixbuf);
+    uint32_t swidth = pixbuf_width(pixbuf);
+    uint32_t sheight = pixbuf_height(pixbuf);
+    Pixbuf *npixbuf = NULL;
+    byte_t *premul = NULL;
+    uint32_t tsize = 0;
+    i_Resampler r;
+
+    cassert(format == ekGRAY8 || format == ekRGB24 || format == ekRGBA32);
+    cassert(width > 0 && height > 0);
+    if (swidth == width && sheight == height)
+        return pixbuf_copy(pixbuf);
+
+    npixbuf = pixbuf_create(width, height, format);
+    r.src = pixbuf_cdata(pixbuf);
+    r.bpp = pixbuf_format_bpp(format) / 8;
+    r.sstride = swidth * r.bpp;
+    r.dstride = width * r.bpp;
+    r.dest = pixbuf_data(npixbuf);
+    r.hcoeffs = swidth != width ? i_coeffs_create(swidth, width, filter) : NULL;
+    r.vcoeffs = sheight != height ? i_coeffs_create(sheight, height, filter) : NULL;
+
+    r.premul = (bool_t)(format == ekRGBA32 && i_opaque(r.src, swidth * sheight) == FALSE);
+
+    /* Without horizontal pass, the vertical one reads the source */
+    if (r.premul == TRUE && r.hcoeffs == NULL)
+    {
+        premul = heap_malloc(swidth * sheight * 4, "ImgUtilResample");
+        i_premultiply(r.src, premul, swidth * sheight);
+        r.src = premul;
+    }
+
+    /* Horizontal pass, only the source rows used by the vertical one */
+    if (r.vcoeffs != NULL)
+    {
+        /* Trimmed zero taps can break the monotony of windows */
+        uint32_t j, yend = 0;
+        r.ystart = UINT32_MAX;
+        for (j = 0; j < height; ++j)
+        {
+            if (r.vcoeffs->start[j] < r.ystart)
+                r.ystart = r.vcoeffs->start[j];
+            if (r.vcoeffs->start[j] + r.vcoeffs->count[j] > yend)
+                yend = r.vcoeffs->start[j] + r.vcoeffs->count[j];
+        }
+
+        tsize = yend - r.ystart;
+    }
+    else
+    {
+        r.ystart = 0;
+        tsize = sheight;
+    }
+
+    if (r.hcoeffs != NULL)
+    {
+        r.tmp = r.vcoeffs != NULL ? heap_malloc(tsize * r.dstride, "ImgUtilResample") : r.dest;
+        bparallel_for(pool, tsize, 0, i_hpass, &r, i_Resampler);
+    }
+    else
+    {
+        r.tmp = (byte_t*)r.src + r.ystart * r.sstride;
+    }
+
+    if (r.vcoeffs != NULL)
+        bparallel_for(pool, height, 0, i_vpass, &r, i_Resampler);
+
+    if (r.hcoeffs != NULL && r.vcoeffs != NULL)
+        heap_free(&r.tmp, tsize * r.dstride, "ImgUtilResample");
+
+    if (premul != NULL)
+        heap_free(&premul, swidth * sheight * 4, "ImgUtilResample");
+
+    if (r.premul == TRUE)
+        i_unpremultiply(r.dest, width * height);
+
+    if (r.hcoeffs != NULL)
+        i_coeffs_destroy(&r.hcoeffs);
+
+    if (r.vcoeffs != NULL)
+        i_coeffs_destroy(&r.vcoeffs);
+
+    return npixbuf;
 }
 
 ///*---------------------------------------------------------------------------*/
@@ -1062,28 +2543,17 @@ Pixbuf *imgutil_indexed_to_rgb(const uint32_t width, const uint32_t height, cons
 
 uint32_t imgutil_effective_palette(const uint32_t *ipalette, const uint32_t isize, uint32_t *opalette, uint8_t *oindex)
 {
-    register uint32_t i, j;
+    i_ColorMap map;
+    register uint32_t i;
     uint32_t n = 0;
     // Maximum 8bit palettes
     cassert(isize <= 256);
+    i_map_init(&map);
     for (i = 0; i < isize; ++i)
     {
-        for (j = 0; j < n; ++j)
-        {
-            if (ipalette[i] == opalette[j])
-            {
-                oindex[i] = (uint8_t)j;
-                break;
-            }
-        }
-
-        // No color in effective palete
-        if (j == n)
-        {
-            opalette[n] = ipalette[i];
-            oindex[i] = (uint8_t)n;
-            n += 1;
-        }
+        uint32_t j = i_map_index(&map, ipalette[i], &n, 256);
+        opalette[j] = ipalette[i];
+        oindex[i] = (uint8_t)j;
     }
 
     return n;
@@ -1156,126 +2626,398 @@ Pixbuf *imgutil_indexed_to_indexed(const uint32_t width, const uint32_t height,
 
 /*---------------------------------------------------------------------------*/
 
-#define i_color(r, g, b, a)\
-    (color_t)(((a) << 24) | ((b) << 16) | ((g) << 8) | (r))
+static __INLINE color_t i_pixel(const byte_t *src, const pixformat_t format)
+{
+    switch (format) {
+    case ekGRAY8:
+        return i_color(src[0], src[0], src[0], 255);
+    case ekRGB24:
+        return i_color(src[0], src[1], src[2], 255);
+    case ekRGBA32:
+        return i_color(src[0], src[1], src[2], src[3]);
+    case ekINDEX1:
+    case ekINDEX2:
+    case ekINDEX4:
+    case ekINDEX8:
+    case ekFIMAGE:
+    cassert_default();
+    }
+
+    return 0;
+}
 
 /*---------------------------------------------------------------------------*/
 
-static Pixbuf *i_rgb_to_indexed(const byte_t *pixdata, const uint32_t width, const uint32_t height, const uint32_t bytespp, const color_t *palrgb, const uint32_t pn, Palette **palette)
+/* All the image colors if they are 'ncolors' or less. UINT32_MAX if there are more */
+static uint32_t i_exact_palette(const byte_t *src, const uint32_t n, const pixformat_t format, const uint32_t ncolors, color_t *colors)
 {
-    uint32_t bpp = 0;
-    pixformat_t format = ENUM_MAX(pixformat_t);
-    Pixbuf *pixels = NULL;
-    register uint32_t n = width * height;
-    register byte_t omask = 0;
-    register byte_t *destdata = NULL;
-    register uint32_t i, j;
+    i_ColorMap map;
+    uint32_t bytespp = pixbuf_format_bpp(format) / 8;
+    uint32_t pn = 0;
+    color_t last = 0;
+    register uint32_t i;
+
+    i_map_init(&map);
+    for (i = 0; i < n; ++i, src += bytespp)
+    {
+        register color_t c = i_pixel(src, format);
+        if (c != last || i == 0)
+        {
+            register uint32_t j = i_map_index(&map, c, &pn, ncolors);
+            if (j == UINT32_MAX)
+                return UINT32_MAX;
+
+            colors[j] = c;
+            last = c;
+        }
+    }
+
+    return pn;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Median cut works over 5 bits per channel. The exact colors are kept as sums */
+typedef struct _bucket_t i_Bucket;
+typedef struct _box_t i_Box;
+
+struct _bucket_t
+{
+    uint32_t count;
+    byte_t mean[4];
+    uint64_t sum[4];
+};
+
+struct _box_t
+{
+    uint32_t start;
+    uint32_t end;
+    uint32_t count;
+    uint32_t channel;
+    uint32_t range;
+};
+
+DeclSt(i_Bucket);
+
+/*---------------------------------------------------------------------------*/
+
+/* Exact colors if the image has less, otherwise 5 bits per channel */
+#define i_EXACT_BUCKETS     32768
 
-    cassert(pn <= 256);
+/*---------------------------------------------------------------------------*/
+
+static HashSt(i_Bucket) *i_buckets(const byte_t *src, const uint32_t n, const pixformat_t format, const uint32_t mask, const uint32_t max)
+{
+    HashSt(i_Bucket) *hash = hashst_create(uint32_t, i_Bucket);
+    uint32_t bytespp = pixbuf_format_bpp(format) / 8;
+    i_Bucket *bucket = NULL;
+    uint32_t lastkey = 0;
+    register uint32_t i;
 
-    if (pn <= 2)
+    for (i = 0; i < n; ++i, src += bytespp)
     {
-        format = ekINDEX1;
-        bpp = 1;
+        register color_t c = i_pixel(src, format);
+        uint32_t key = (uint32_t)c & mask;
+
+        /* The hash can move the buckets, only the last one is kept */
+        if (bucket == NULL || key != lastkey)
+        {
+            bucket = hashst_get(hash, &key, i_Bucket);
+            if (bucket == NULL)
+            {
+                if (hashst_size(hash, i_Bucket) == max)
+                {
+                    hashst_destroy(&hash, NULL, i_Bucket);
+                    return NULL;
+                }
+
+                bucket = hashst_insert(hash, &key, i_Bucket);
+            }
+
+            lastkey = key;
+        }
+
+        bucket->count += 1;
+        bucket->sum[0] += c & 0xFF;
+        bucket->sum[1] += (c >> 8) & 0xFF;
+        bucket->sum[2] += (c >> 16) & 0xFF;
+        bucket->sum[3] += c >> 24;
     }
-    else if (pn <= 4)
+
+    return hash;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_Bucket *i_histogram(const byte_t *src, const uint32_t n, const pixformat_t format, uint32_t *nbuckets)
+{
+    HashSt(i_Bucket) *hash = i_buckets(src, n, format, 0xFFFFFFFF, i_EXACT_BUCKETS);
+    i_Bucket *buckets = NULL;
+
+    if (hash == NULL)
+        hash = i_buckets(src, n, format, 0xF8F8F8F8, UINT32_MAX);
+
+    *nbuckets = hashst_size(hash, i_Bucket);
+    buckets = heap_new_n(*nbuckets, i_Bucket);
+    hashst_foreach_const(elem, hash, i_Bucket)
+        uint32_t k;
+        buckets[elem_i] = *elem;
+        for (k = 0; k < 4; ++k)
+            buckets[elem_i].mean[k] = (byte_t)((elem->sum[k] + elem->count / 2) / elem->count);
+    hashst_fornext_const(elem, hash, i_Bucket)
+
+    hashst_destroy(&hash, NULL, i_Bucket);
+    return buckets;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_box_fit(i_Box *box, const i_Bucket *buckets)
+{
+    byte_t min[4] = {255, 255, 255, 255};
+    byte_t max[4] = {0, 0, 0, 0};
+    register uint32_t i, k;
+
+    box->count = 0;
+    for (i = box->start; i < box->end; ++i)
     {
-        format = ekINDEX2;
-        bpp = 2;
+        for (k = 0; k < 4; ++k)
+        {
+            if (buckets[i].mean[k] < min[k])
+                min[k] = buckets[i].mean[k];
+            if (buckets[i].mean[k] > max[k])
+                max[k] = buckets[i].mean[k];
+        }
+
+        box->count += buckets[i].count;
     }
-    else if (pn <= 16)
+
+    box->channel = 0;
+    box->range = 0;
+    for (k = 0; k < 4; ++k)
     {
-        format = ekINDEX4;
-        bpp = 4;
+        if ((uint32_t)(max[k] - min[k]) > box->range)
+        {
+            box->channel = k;
+            box->range = (uint32_t)(max[k] - min[k]);
+        }
     }
-    else
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Counting sort, channel values are bytes */
+static void i_sort_channel(i_Bucket *buckets, i_Bucket *temp, const i_Box *box)
+{
+    uint32_t pos[256];
+    register uint32_t i, k = box->channel;
+
+    bmem_zero_n(pos, 256, uint32_t);
+    for (i = box->start; i < box->end; ++i)
+        pos[buckets[i].mean[k]] += 1;
+
+    for (i = 0, k = box->start; i < 256; ++i)
     {
-        format = ekINDEX8;
-        bpp = 8;
+        register uint32_t count = pos[i];
+        pos[i] = k;
+        k += count;
     }
 
-    omask = (byte_t)(1 << bpp) - 1;
-    pixels = pixbuf_create(width, height, format);
-    destdata = pixbuf_data(pixels);
+    k = box->channel;
+    for (i = box->start; i < box->end; ++i)
+        temp[pos[buckets[i].mean[k]]++] = buckets[i];
 
-    for (i = 0; i < n; ++i)
-    {
-        register color_t c;
+    bmem_copy_n(buckets + box->start, temp + box->start, box->end - box->start, i_Bucket);
+}
 
-        if (bytespp == 3)
-            c = i_color(pixdata[0], pixdata[1], pixdata[2], 255);
-        else
-            c = i_color(pixdata[0], pixdata[1], pixdata[2], pixdata[3]);
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_median_cut(i_Bucket *buckets, const uint32_t nbuckets, const uint32_t ncolors, color_t *colors)
+{
+    i_Box boxes[256];
+    i_Bucket *temp = heap_new_n(nbuckets, i_Bucket);
+    uint32_t nboxes = 1;
+    register uint32_t i, k;
+
+    cassert(ncolors <= 256);
+    boxes[0].start = 0;
+    boxes[0].end = nbuckets;
+    i_box_fit(&boxes[0], buckets);
 
-        for (j = 0; j < pn; ++j)
+    while (nboxes < ncolors)
+    {
+        uint32_t best = UINT32_MAX;
+        uint64_t score = 0;
+        uint32_t half, split;
+        uint64_t acc = 0;
+
+        /* The most populated and widest box is split first */
+        for (i = 0; i < nboxes; ++i)
         {
-            if (palrgb[j] == c)
+            uint64_t s = (uint64_t)boxes[i].range * boxes[i].count;
+            if (boxes[i].end - boxes[i].start >= 2 && s > score)
             {
-                // Write the pixel value leaving intact the other bits
-                register byte_t *obyte = destdata + i / (8 / bpp);
-                register byte_t opos = (byte_t)(i % (8 / (uint8_t)bpp));
-                *obyte &= ~(omask << (opos * bpp));
-                *obyte |= (j << (opos * bpp));
-                break;
+                score = s;
+                best = i;
             }
         }
 
-        // RGB must exists in palette
-        cassert(j < pn);
-        pixdata += bytespp;
+        if (best == UINT32_MAX)
+            break;
+
+        i_sort_channel(buckets, temp, &boxes[best]);
+
+        /* Weighted median, both halves keep a bucket at least */
+        half = boxes[best].count / 2;
+        for (split = boxes[best].start; split < boxes[best].end - 2; ++split)
+        {
+            acc += buckets[split].count;
+            if (acc >= half)
+                break;
+        }
+
+        boxes[nboxes].start = split + 1;
+        boxes[nboxes].end = boxes[best].end;
+        boxes[best].end = split + 1;
+        i_box_fit(&boxes[best], buckets);
+        i_box_fit(&boxes[nboxes], buckets);
+        nboxes += 1;
     }
 
-    if (palette != NULL)
+    for (i = 0; i < nboxes; ++i)
     {
-        *palette = palette_create(pn);
-        bmem_copy_n(palette_colors(*palette), palrgb, pn, color_t);
+        uint64_t sum[4] = {0, 0, 0, 0};
+        uint64_t count = boxes[i].count;
+        uint32_t j;
+        for (j = boxes[i].start; j < boxes[i].end; ++j)
+        {
+            for (k = 0; k < 4; ++k)
+                sum[k] += buckets[j].sum[k];
+        }
+
+        for (k = 0; k < 4; ++k)
+            sum[k] = (sum[k] + count / 2) / count;
+
+        colors[i] = i_color((uint32_t)sum[0], (uint32_t)sum[1], (uint32_t)sum[2], (uint32_t)sum[3]);
     }
 
-    return pixels;
+    heap_delete_n(&temp, nbuckets, i_Bucket);
+    return nboxes;
 }
 
 /*---------------------------------------------------------------------------*/
 
-Pixbuf *imgutil_to_indexed(const uint32_t width, const uint32_t height, const byte_t *pixdata, const uint32_t bytespp, Palette **palette)
+/* Floyd-Steinberg. The errors are kept multiplied by 16 */
+static void i_dither(const byte_t *src, byte_t *dest, const uint32_t width, const uint32_t height, const pixformat_t iformat, const color_t *colors, const uint32_t ncolors, const uint32_t obpp)
 {
-    register uint32_t i, n = width * height;
-    register uint32_t j, pn = 0;
-    register const byte_t *datai = pixdata;
-    color_t pal[256];
+    uint32_t bytespp = pixbuf_format_bpp(iformat) / 8;
+    uint32_t rsize = (width + 2) * 4;
+    int32_t *err = heap_new_n0(2 * rsize, int32_t);
+    i_Cache *cache = i_cache_create(colors, ncolors);
+    byte_t index[i_BLOCK];
+    uint32_t m = 0, p = 0;
+    register uint32_t i, j, k;
 
-    for (i = 0; i < n; ++i)
+    for (j = 0; j < height; ++j)
     {
-        register color_t c;
-
-        if (bytespp == 3)
-            c = i_color(datai[0], datai[1], datai[2], 255);
-        else
-            c = i_color(datai[0], datai[1], datai[2], datai[3]);
+        int32_t *cur = err + (j % 2) * rsize;
+        int32_t *next = err + ((j + 1) % 2) * rsize;
+        bmem_zero_n(next, rsize, int32_t);
 
-        for (j = 0; j < pn; ++j)
+        for (i = 0; i < width; ++i, src += bytespp)
         {
-            if (pal[j] == c)
-                break;
-        }
+            color_t c = i_pixel(src, iformat);
+            int32_t v[4];
+            uint32_t idx;
+            color_t pc;
 
-        if (j == pn)
-        {
-            if (pn < 256)
+            for (k = 0; k < 4; ++k)
+                v[k] = i_clamp((int32_t)((c >> (k * 8)) & 0xFF) + cur[(i + 1) * 4 + k] / 16);
+
+            /* Dithered colors rarely repeat. The error diffusion absorbs the 5 bits search */
+            idx = i_cache_nearest(cache, i_color(v[0], v[1], v[2], v[3]) & 0xF8F8F8F8);
+            pc = colors[idx];
+
+            for (k = 0; k < 4; ++k)
             {
-                pal[pn] = c;
-                pn += 1;
+                int32_t e = v[k] - (int32_t)((pc >> (k * 8)) & 0xFF);
+                cur[(i + 2) * 4 + k] += e * 7;
+                next[i * 4 + k] += e * 3;
+                next[(i + 1) * 4 + k] += e * 5;
+                next[(i + 2) * 4 + k] += e;
             }
-            else
-            {
-                if (palette != NULL)
-                    *palette = NULL;
 
-                return NULL;
+            index[m++] = (byte_t)idx;
+            if (m == i_BLOCK)
+            {
+                i_pack(index, dest + p / (8 / obpp), m, obpp);
+                p += m;
+                m = 0;
             }
         }
+    }
+
+    if (m > 0)
+        i_pack(index, dest + p / (8 / obpp), m, obpp);
+
+    heap_delete(&cache, i_Cache);
+    heap_delete_n(&err, 2 * rsize, int32_t);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static pixformat_t i_index_format(const uint32_t ncolors)
+{
+    cassert(ncolors <= 256);
+    if (ncolors <= 2)
+        return ekINDEX1;
+    if (ncolors <= 4)
+        return ekINDEX2;
+    if (ncolors <= 16)
+        return ekINDEX4;
+    return ekINDEX8;
+}
+
+/*---------------------------------------------------------------------------*/
 
-        datai += bytespp;
+Pixbuf *imgutil_to_indexed(const Pixbuf *pixbuf, const uint32_t ncolors, const bool_t dither, Palette **palette)
+{
+    pixformat_t iformat = pixbuf_format(pixbuf);
+    uint32_t width = pixbuf_width(pixbuf);
+    uint32_t height = pixbuf_height(pixbuf);
+    uint32_t n = width * height;
+    const byte_t *src = pixbuf_cdata(pixbuf);
+    color_t colors[256];
+    uint32_t pn = 0;
+    bool_t quantized = FALSE;
+    pixformat_t oformat = ENUM_MAX(pixformat_t);
+    Pixbuf *npixbuf = NULL;
+
+    cassert(iformat == ekGRAY8 || iformat == ekRGB24 || iformat == ekRGBA32);
+    cassert(ncolors >= 2 && ncolors <= 256);
+    cassert_no_null(palette);
+
+    pn = i_exact_palette(src, n, iformat, ncolors, colors);
+
+    /* More colors than allowed */
+    if (pn == UINT32_MAX)
+    {
+        uint32_t nbuckets = 0;
+        i_Bucket *buckets = i_histogram(src, n, iformat, &nbuckets);
+        pn = i_median_cut(buckets, nbuckets, ncolors, colors);
+        heap_delete_n(&buckets, nbuckets, i_Bucket);
+        quantized = TRUE;
     }
 
-    return i_rgb_to_indexed(pixdata, width, height, bytespp, pal, pn, palette);
+    oformat = i_index_format(pn);
+    npixbuf = pixbuf_create(width, height, oformat);
+
+    if (quantized == TRUE && dither == TRUE)
+        i_dither(src, pixbuf_data(npixbuf), width, height, iformat, colors, pn, pixbuf_format_bpp(oformat));
+    else
+        i_to_indexed(src, pixbuf_data(npixbuf), n, iformat, colors, pn, pixbuf_format_bpp(oformat), quantized == TRUE ? 0xFCFCFCFC : 0xFFFFFFFF);
+
+    *palette = palette_create(pn);
+    bmem_copy_n(palette_colors(*palette), colors, pn, color_t);
+    return npixbuf;
 }
@@ -18,17 +18,11 @@ bool_t imgutil_parse(Stream *stm_in, Stream *stm_out);
 
 Palette *imgutils_def_palette(const pixformat_t format);
 
-Pixbuf *imgutil_rgba_to_rgb(const byte_t *data, const uint32_t width, const uint32_t height);
+void imgutil_start(void);
 
-Pixbuf *imgutil_rgb_to_rgba(const byte_t *data, const uint32_t width, const uint32_t height);
+Pixbuf *imgutil_convert(const Pixbuf *pixbuf, const Palette *palette, const pixformat_t oformat);
 
-Pixbuf *imgutil_rgba_to_gray(const byte_t *data, const uint32_t width, const uint32_t height);
-
-Pixbuf *imgutil_rgb_to_gray(const byte_t *data, const uint32_t width, const uint32_t height);
-
-Buffer *imgutil_gray_to_rgba(const byte_t *data, const uint32_t width, const uint32_t height);
-
-Buffer *imgutil_gray_to_rgb(const byte_t *data, const uint32_t width, const uint32_t height);
+Pixbuf *imgutil_resample(const Pixbuf *pixbuf, const uint32_t width, const uint32_t height, const resample_t filter, Pool *pool);
 
 Pixbuf *imgutil_indexed_to_gray(const uint32_t width, const uint32_t height, const byte_t *pixdata, const uint32_t stride, const uint32_t ibpp, const color_t *palette);
 
@@ -40,6 +34,6 @@ uint32_t imgutil_effective_palette(const uint32_t *ipalette, const uint32_t isiz
 
 Pixbuf *imgutil_indexed_to_indexed(const uint32_t width, const uint32_t height, const byte_t *pixdata, const uint32_t stride, const uint32_t ibpp, const pixformat_t oformat, const uint8_t *palette_index);
 
-Pixbuf *imgutil_to_indexed(const uint32_t width, const uint32_t height, const byte_t *pixdata, const uint32_t bytespp, Palette **palette);
+Pixbuf *imgutil_to_indexed(const Pixbuf *pixbuf, const uint32_t ncolors, const bool_t dither, Palette **palette);
 
 __END_C
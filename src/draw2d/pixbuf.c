@@ -131,7 +131,7 @@ static uint32_t i_get4(const byte_t *data, const uint32_t x, const uint32_t y, c
 {
     register byte_t b = data[(y * width + x) / 2];
     register byte_t pos = (byte_t)((y * width + x) % 2);
-    return (uint32_t)((b >> (pos * 4)) & 7);
+    return (uint32_t)((b >> (pos * 4)) & 15);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -245,24 +245,112 @@ Pixbuf *pixbuf_copy(const Pixbuf *pixbuf)
 Pixbuf *pixbuf_trim(const Pixbuf *pixbuf, const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height)
 {
     Pixbuf *npixbuf = NULL;
-    register const byte_t *sdata = NULL;
-    register byte_t *data = NULL;
-    register pixformat_t format;
-    register uint32_t i, j, v, w;
     cassert_no_null(pixbuf);
     npixbuf = pixbuf_create(width, height, pixbuf->format);
-    sdata = i_DATA(pixbuf);
-    data = i_DATA(npixbuf);
-    format = npixbuf->format;
-    w = pixbuf->width;
-    for (i = 0; i < width; ++i)
-    for (j = 0; j < height; ++j)
+    pixbuf_blit(npixbuf, 0, 0, pixbuf, x, y, width, height);
+    return npixbuf;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Bit 'i' is (data[i / 8] >> (i % 8)) & 1, the same LSB first order of indexed pixels */
+static void i_copy_bits(const byte_t *src, uint32_t sbit, byte_t *dest, uint32_t dbit, uint32_t nbits)
+{
+    /* Up to the first dest byte boundary */
+    while (nbits > 0 && (dbit % 8) != 0)
     {
-        v = i_GET[format](sdata, x + i, y + j, w);
-        i_SET[format](data, i, j, width, v);
+        register byte_t v = (byte_t)((src[sbit / 8] >> (sbit % 8)) & 1);
+        dest[dbit / 8] = (byte_t)((dest[dbit / 8] & ~(1 << (dbit % 8))) | (v << (dbit % 8)));
+        sbit += 1;
+        dbit += 1;
+        nbits -= 1;
     }
 
-    return npixbuf;
+    /* Whole dest bytes */
+    if (nbits >= 8)
+    {
+        register uint32_t i, n = nbits / 8;
+        register const byte_t *s = src + sbit / 8;
+        register byte_t *d = dest + dbit / 8;
+        register uint32_t shift = sbit % 8;
+        if (shift == 0)
+        {
+            bmem_copy(d, s, n);
+        }
+        else
+        {
+            for (i = 0; i < n; ++i)
+                d[i] = (byte_t)((s[i] >> shift) | (s[i + 1] << (8 - shift)));
+        }
+
+        sbit += n * 8;
+        dbit += n * 8;
+        nbits -= n * 8;
+    }
+
+    /* Tail, leaving intact the other bits */
+    while (nbits > 0)
+    {
+        register byte_t v = (byte_t)((src[sbit / 8] >> (sbit % 8)) & 1);
+        dest[dbit / 8] = (byte_t)((dest[dbit / 8] & ~(1 << (dbit % 8))) | (v << (dbit % 8)));
+        sbit += 1;
+        dbit += 1;
+        nbits -= 1;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+void pixbuf_blit(Pixbuf *dest, const uint32_t dx, const uint32_t dy, const Pixbuf *src, const uint32_t sx, const uint32_t sy, const uint32_t width, const uint32_t height)
+{
+    register const byte_t *sdata = NULL;
+    register byte_t *ddata = NULL;
+    register uint32_t bpp, j;
+    cassert_no_null(dest);
+    cassert_no_null(src);
+    cassert(dest->format == src->format);
+    cassert(sx + width <= src->width);
+    cassert(sy + height <= src->height);
+    cassert(dx + width <= dest->width);
+    cassert(dy + height <= dest->height);
+
+    if (width == 0 || height == 0)
+        return;
+
+    sdata = i_DATA(src);
+    ddata = i_DATA(dest);
+    bpp = pixbuf_format_bpp(src->format);
+
+    if (bpp >= 8)
+    {
+        register uint32_t bytes = bpp / 8;
+        register uint32_t row = width * bytes;
+        register uint32_t sstride = src->width * bytes;
+        register uint32_t dstride = dest->width * bytes;
+        sdata += (sy * src->width + sx) * bytes;
+        ddata += (dy * dest->width + dx) * bytes;
+
+        /* Full rows are a single block */
+        if (row == sstride && row == dstride)
+        {
+            bmem_copy(ddata, sdata, row * height);
+        }
+        else
+        {
+            for (j = 0; j < height; ++j, sdata += sstride, ddata += dstride)
+                bmem_copy(ddata, sdata, row);
+        }
+    }
+    else
+    {
+        /* Indexed rows are packed without padding, they can start at any bit */
+        for (j = 0; j < height; ++j)
+        {
+            uint32_t sbit = ((sy + j) * src->width + sx) * bpp;
+            uint32_t dbit = ((dy + j) * dest->width + dx) * bpp;
+            i_copy_bits(sdata, sbit, ddata, dbit, width * bpp);
+        }
+    }
 }
 
 /*---------------------------------------------------------------------------*/
@@ -270,56 +358,9 @@ Pixbuf *pixbuf_trim(const Pixbuf *pixbuf, const uint32_t x, const uint32_t y, co
 Pixbuf *pixbuf_convert(const Pixbuf *pixbuf, const Palette *palette, const pixformat_t oformat)
 {
     cassert_no_null(pixbuf);
-    unref(palette);
     if (pixbuf->format != oformat)
     {
-        switch(pixbuf->format) {
-        case ekRGBA32:
-            switch(oformat) {
-            case ekRGB24:
-                return imgutil_rgba_to_rgb(i_DATA(pixbuf), pixbuf->width, pixbuf->height);
-
-            case ekGRAY8:
-                return imgutil_rgba_to_gray(i_DATA(pixbuf), pixbuf->width, pixbuf->height);
-
-            case ekINDEX1:
-
-            case ekINDEX2:
-            case ekINDEX4:
-            case ekINDEX8:
-            case ekRGBA32:
-            case ekFIMAGE:
-            cassert_default();
-            }
-            break;
-
-        case ekRGB24:
-            switch(oformat) {
-            case ekRGBA32:
-                return imgutil_rgb_to_rgba(i_DATA(pixbuf), pixbuf->width, pixbuf->height);
-            
-            case ekGRAY8:
-                return imgutil_rgb_to_gray(i_DATA(pixbuf), pixbuf->width, pixbuf->height);
-
-            case ekINDEX1:
-            case ekINDEX2:
-            case ekINDEX4:
-            case ekINDEX8:
-            case ekRGB24:
-            case ekFIMAGE:
-            cassert_default();
-            }
-            break;
-
-
-        case ekINDEX1:
-        case ekINDEX2:
-        case ekINDEX4:
-        case ekINDEX8:
-        case ekGRAY8:
-        case ekFIMAGE:
-        cassert_default();
-        }
+        return imgutil_convert(pixbuf, palette, oformat);
     }
     else
     {
@@ -327,8 +368,23 @@ Pixbuf *pixbuf_convert(const Pixbuf *pixbuf, const Palette *palette, const pixfo
         bmem_copy(i_DATA(npixbuf), i_DATA(pixbuf), i_bufsize(pixbuf->width, pixbuf->height, pixbuf->format));
         return npixbuf;
     }
-    
-    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+Pixbuf *pixbuf_resample(const Pixbuf *pixbuf, const uint32_t width, const uint32_t height, const resample_t filter, Pool *pool)
+{
+    cassert_no_null(pixbuf);
+    return imgutil_resample(pixbuf, width, height, filter, pool);
+}
+
+/*---------------------------------------------------------------------------*/
+
+Pixbuf *pixbuf_quantize(const Pixbuf *pixbuf, const uint32_t ncolors, const bool_t dither, Palette **palette)
+{
+    cassert_no_null(pixbuf);
+    cassert_no_null(palette);
+    return imgutil_to_indexed(pixbuf, ncolors, dither, palette);
 }
 
 /*---------------------------------------------------------------------------*/
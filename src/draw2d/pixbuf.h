@@ -24,8 +24,14 @@ Pixbuf *pixbuf_copy(const Pixbuf *pixbuf);
 
 Pixbuf *pixbuf_trim(const Pixbuf *pixbuf, const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height);
 
+void pixbuf_blit(Pixbuf *dest, const uint32_t dx, const uint32_t dy, const Pixbuf *src, const uint32_t sx, const uint32_t sy, const uint32_t width, const uint32_t height);
+
 Pixbuf *pixbuf_convert(const Pixbuf *pixbuf, const Palette *palette, const pixformat_t oformat);
 
+Pixbuf *pixbuf_resample(const Pixbuf *pixbuf, const uint32_t width, const uint32_t height, const resample_t filter, Pool *pool);
+
+Pixbuf *pixbuf_quantize(const Pixbuf *pixbuf, const uint32_t ncolors, const bool_t dither, Palette **palette);
+
 void pixbuf_destroy(Pixbuf **pixbuf);
 
 pixformat_t pixbuf_format(const Pixbuf *pixbuf);
@@ -14,6 +14,7 @@
 #include "oshttpreq.inl"
 #include "inet.inl"
 #include "url.h"
+#include "arrpt.h"
 #include "arrst.h"
 #include "bsocket.h"
 #include "cassert.h"
@@ -36,6 +37,14 @@ struct _http_t
     ArrSt(Field) *headers;
 };
 
+struct _httpmulti_t
+{
+    OSHttpMulti *osmulti;
+    ArrPt(Http) *running;
+};
+
+DeclPt(Http);
+
 /*---------------------------------------------------------------------------*/
 
 static void i_remove_field(Field *field)
@@ -107,6 +116,14 @@ void http_add_header(Http *http, const char_t *name, const char_t *value)
 
 /*---------------------------------------------------------------------------*/
 
+void http_body_stream(Http *http, Stream *body)
+{
+    cassert_no_null(http);
+    oshttp_body_stream(http->oshttp, body);
+}
+
+/*---------------------------------------------------------------------------*/
+
 static const char_t *i_field(ArrSt(Field) *fields, const char_t *name)
 {
     arrst_foreach(field, fields, Field)
@@ -353,22 +370,30 @@ bool_t http_response_body(const Http *http, Stream *body, ierror_t *error)
 
 /*---------------------------------------------------------------------------*/
 
+static Http *i_from_url(const Url *url)
+{
+    const char_t *sh = url_scheme(url);
+    const char_t *host = url_host(url);
+    uint16_t port = url_port(url);
+
+    if (str_equ_nocase(sh, "http") == TRUE)
+        return http_create(host, port);
+    else if (str_equ_nocase(sh, "https") == TRUE)
+        return http_secure(host, port);
+
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
 Stream *http_dget(const char_t *url, uint32_t *result, ierror_t *error)
 {
     Url *uurl = url_parse(url);
-    const char_t *sh = url_scheme(uurl);
-    const char_t *host = url_host(uurl);
-    uint16_t port = url_port(uurl);
-    Http *http = NULL;
+    Http *http = i_from_url(uurl);
     Stream *stm = NULL;
     
     ptr_assign(error, ekIOK);
 
-    if (str_equ_nocase(sh, "http") == TRUE)
-        http = http_create(host, port);
-    else if (str_equ_nocase(sh, "https") == TRUE)
-        http = http_secure(host, port);
-
     if (http != NULL)
     {
         String *res = url_resource(uurl);
@@ -396,19 +421,43 @@ Stream *http_dget(const char_t *url, uint32_t *result, ierror_t *error)
 
 /*---------------------------------------------------------------------------*/
 
+bool_t http_dget_stream(const char_t *url, Stream *body, uint32_t *result, ierror_t *error)
+{
+    Url *uurl = url_parse(url);
+    Http *http = i_from_url(uurl);
+    bool_t ok = FALSE;
+    cassert_no_null(body);
+
+    if (http != NULL)
+    {
+        String *res = url_resource(uurl);
+        http_body_stream(http, body);
+        if (http_get(http, tc(res), NULL, 0, error) == TRUE)
+        {
+            if (result != NULL)
+                *result = http_response_status(http);
+            ok = TRUE;
+        }
+
+        http_destroy(&http);
+        str_destroy(&res);
+    }
+    else
+    {
+        ptr_assign(error, ekINOHOST);
+    }
+
+    url_destroy(&uurl);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
 bool_t http_exists(const char_t *url)
 {
     bool_t exists = FALSE;
     Url *uurl = url_parse(url);
-    const char_t *sh = url_scheme(uurl);
-    const char_t *host = url_host(uurl);
-    uint16_t port = url_port(uurl);
-    Http *http = NULL;
-    
-    if (str_equ_nocase(sh, "http") == TRUE)
-        http = http_create(host, port);
-    else if (str_equ_nocase(sh, "https") == TRUE)
-        http = http_secure(host, port);
+    Http *http = i_from_url(uurl);
 
     if (http != NULL)
     {
@@ -429,3 +478,90 @@ bool_t http_exists(const char_t *url)
     url_destroy(&uurl);
     return exists;
 }
+
+/*---------------------------------------------------------------------------*/
+
+HttpMulti *http_multi_create(const uint32_t max_host_connections)
+{
+    HttpMulti *multi = heap_new(HttpMulti);
+    multi->osmulti = oshttp_multi_create(max_host_connections);
+    multi->running = arrpt_create(Http);
+    return multi;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void http_multi_destroy(HttpMulti **multi)
+{
+    cassert_no_null(multi);
+    cassert_no_null(*multi);
+    arrpt_foreach(http, (*multi)->running, Http)
+        oshttp_multi_remove((*multi)->osmulti, http->oshttp);
+    arrpt_end();
+    arrpt_destroy(&(*multi)->running, http_destroy, Http);
+    oshttp_multi_destroy(&(*multi)->osmulti);
+    heap_delete(multi, HttpMulti);
+}
+
+/*---------------------------------------------------------------------------*/
+
+Http *http_async_get(HttpMulti *multi, const char_t *url, Stream *body, ierror_t *error)
+{
+    Url *uurl = url_parse(url);
+    Http *http = i_from_url(uurl);
+    cassert_no_null(multi);
+
+    if (http != NULL)
+    {
+        String *res = url_resource(uurl);
+        i_clear_response(http);
+        if (body != NULL)
+            http_body_stream(http, body);
+
+        if (oshttp_multi_add(multi->osmulti, http->oshttp, TRUE, tc(res), NULL, 0, error) == TRUE)
+            arrpt_append(multi->running, http, Http);
+        else
+            http_destroy(&http);
+        str_destroy(&res);
+    }
+    else
+    {
+        ptr_assign(error, ekINOHOST);
+    }
+
+    url_destroy(&uurl);
+    return http;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t http_multi_perform(HttpMulti *multi, const uint32_t timeout_ms)
+{
+    cassert_no_null(multi);
+    return oshttp_multi_perform(multi->osmulti, timeout_ms);
+}
+
+/*---------------------------------------------------------------------------*/
+
+Http *http_multi_done(HttpMulti *multi, ierror_t *error)
+{
+    OSHttp *oshttp = NULL;
+    ierror_t lerror = ekIOK;
+    cassert_no_null(multi);
+    oshttp = oshttp_multi_done(multi->osmulti, &lerror);
+    if (oshttp != NULL)
+    {
+        arrpt_foreach(http, multi->running, Http)
+            if (http->oshttp == oshttp)
+            {
+                arrpt_delete(multi->running, http_i, NULL, Http);
+                http->error = lerror;
+                ptr_assign(error, lerror);
+                return http;
+            }
+        arrpt_end();
+        cassert(FALSE);
+    }
+
+    return NULL;
+}
@@ -25,6 +25,8 @@ void http_clear_headers(Http *http);
 
 void http_add_header(Http *http, const char_t *name, const char_t *value);
 
+void http_body_stream(Http *http, Stream *body);
+
 bool_t http_get(Http *http, const char_t *path, const byte_t *data, const uint32_t size, ierror_t *error);
 
 bool_t http_post(Http *http, const char_t *path, const byte_t *data, const uint32_t size, ierror_t *error);
@@ -47,7 +49,19 @@ bool_t http_response_body(const Http *http, Stream *body, ierror_t *error);
 
 Stream *http_dget(const char_t *url, uint32_t *result, ierror_t *error);
 
+bool_t http_dget_stream(const char_t *url, Stream *body, uint32_t *result, ierror_t *error);
+
 bool_t http_exists(const char_t *url);
 
+HttpMulti *http_multi_create(const uint32_t max_host_connections);
+
+void http_multi_destroy(HttpMulti **multi);
+
+Http *http_async_get(HttpMulti *multi, const char_t *url, Stream *body, ierror_t *error);
+
+uint32_t http_multi_perform(HttpMulti *multi, const uint32_t timeout_ms);
+
+Http *http_multi_done(HttpMulti *multi, ierror_t *error);
+
 __END_C
 
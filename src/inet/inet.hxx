@@ -28,10 +28,38 @@ typedef enum _ierror_t
     ekIOK
 } ierror_t;
 
+typedef enum _jsonev_t
+{
+    ekJSON_OBJECT_BEGIN = 1,
+    ekJSON_OBJECT_END,
+    ekJSON_ARRAY_BEGIN,
+    ekJSON_ARRAY_END,
+    ekJSON_KEY,
+    ekJSON_STRING,
+    ekJSON_NUMBER,
+    ekJSON_BOOL,
+    ekJSON_NULL,
+    ekJSON_EOF,
+    ekJSON_ERROR
+} jsonev_t;
+
+typedef enum _jsontype_t
+{
+    ekJSON_TNULL = 1,
+    ekJSON_TBOOL,
+    ekJSON_TNUMBER,
+    ekJSON_TSTRING,
+    ekJSON_TARRAY,
+    ekJSON_TOBJECT
+} jsontype_t;
+
 typedef struct _url_t Url;
 typedef struct _http_t Http;
+typedef struct _httpmulti_t HttpMulti;
 typedef struct _json_t Json;
 typedef struct _jsonopts_t JsonOpts;
+typedef struct _jsonreader_t JsonReader;
+typedef struct _jsonnode_t JsonNode;
 
 struct _jsonopts_t
 {
@@ -16,6 +16,7 @@
 #include "inet.hxx"
 
 typedef struct _oshttp_t OSHttp;
+typedef struct _oshttpmulti_t OSHttpMulti;
 typedef struct _field_t Field;
 
 struct _field_t
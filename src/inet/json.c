@@ -18,10 +18,13 @@
 #include "bmem.h"
 #include "bstd.h"
 #include "base64.h"
+#include "bhash.h"
 #include "cassert.h"
 #include "heap.h"
 #include "log.h"
+#include "ptr.h"
 #include "stream.h"
+#include "stream.inl"
 #include "strings.h"
 #include "unicode.h"
 
@@ -38,21 +41,48 @@ typedef enum _jtoken_t
     i_ekCLOSE_OBJECT,
     i_ekCOMMA,
     i_ekCOLON,
+    i_ekEOF,
     i_ekUNKNOWN
 } jtoken_t;
 
 typedef struct i_parser_t i_Parser;
+typedef struct i_writer_t i_Writer;
+
+#define i_BUFFER_SIZE   4096
+#define i_EOF           256
+#define i_BAD_COMMENT   257
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define i_WITH_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
 
 struct i_parser_t 
 {
     Stream *stm;
     jtoken_t token;
-    bool_t minus;
     uint32_t col;
     uint32_t row;
     uint32_t lexsize;
     const char_t *lexeme;
+    uint32_t pos;
+    uint32_t end;
+    uint64_t offset;
+    uint64_t line;
+    char_t *text;
+    uint32_t textsize;
     char_t number[128];
+    byte_t buffer[i_BUFFER_SIZE];
+};
+
+/* Text is built in memory and sent to the stream in large blocks */
+struct i_writer_t
+{
+    Stream *stm;
+    StrBuf *buf;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -62,8 +92,8 @@ static void *i_create_type(i_Parser *parser, const char_t *type);
 static bool_t i_jump_value(i_Parser *parser);
 static bool_t i_parse_object(i_Parser *parser, const char_t *subtype, void *object);
 static bool_t i_parse_value(i_Parser *parser, DBind *dbind, dtype_t type, const char_t *subtype, void *object);
-static void i_write_type(Stream *stm, dtype_t type, const char_t *subtype, const void *data, const bool_t inarray);
-static void i_write_object(Stream *stm, const void *object, const char_t *type, const bool_t inarray);
+static void i_write_type(i_Writer *writer, dtype_t type, const char_t *subtype, const void *data, const bool_t inarray);
+static void i_write_object(i_Writer *writer, const void *object, const char_t *type, const bool_t inarray);
 
 /*---------------------------------------------------------------------------*/
 
@@ -87,114 +117,565 @@ static bool_t i_error(const bool_t cond, const bool_t fatal, i_Parser *parser, c
 
 /*---------------------------------------------------------------------------*/
 
-static void i_new_token(i_Parser *parser)
+static jtoken_t i_ident(const char_t *lexeme, const uint32_t size)
+{
+    /* Keywords resolved by length and bytes, without string compare calls */
+    switch (size) {
+    case 4:
+        if (lexeme[0] == 't' && lexeme[1] == 'r' && lexeme[2] == 'u' && lexeme[3] == 'e')
+            return i_ekTRUE;
+        if (lexeme[0] == 'n' && lexeme[1] == 'u' && lexeme[2] == 'l' && lexeme[3] == 'l')
+            return i_ekNULL;
+        break;
+    case 5:
+        if (lexeme[0] == 'f' && lexeme[1] == 'a' && lexeme[2] == 'l' && lexeme[3] == 's' && lexeme[4] == 'e')
+            return i_ekFALSE;
+        break;
+    }
+
+    return i_ekUNKNOWN;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_fill(i_Parser *parser)
+{
+    cassert_no_null(parser);
+    cassert(parser->pos == parser->end);
+    parser->offset += parser->end;
+    parser->pos = 0;
+    parser->end = _stm_read_avail(parser->stm, parser->buffer, i_BUFFER_SIZE);
+    return (bool_t)(parser->end > 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_next_byte(i_Parser *parser, byte_t *c)
+{
+    cassert_no_null(parser);
+    cassert_no_null(c);
+    if (parser->pos == parser->end && i_fill(parser) == FALSE)
+        return FALSE;
+    *c = parser->buffer[parser->pos++];
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if defined(i_WITH_SSE2)
+static uint32_t i_ctz(const uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_skip_comment(i_Parser *parser)
+{
+    byte_t c;
+    cassert_no_null(parser);
+    cassert(parser->buffer[parser->pos] == '/');
+    parser->pos += 1;
+    if (i_next_byte(parser, &c) == FALSE)
+        return FALSE;
+
+    /* Single line comment, '\n' is processed as blank */
+    if (c == '/')
+    {
+        for (;;)
+        {
+            if (parser->pos == parser->end && i_fill(parser) == FALSE)
+                return TRUE;
+            if (parser->buffer[parser->pos] == '\n')
+                return TRUE;
+            parser->pos += 1;
+        }
+    }
+
+    /* Multi line comment */
+    if (c == '*')
+    {
+        byte_t prev = 0;
+        while (i_next_byte(parser, &c) == TRUE)
+        {
+            if (c == '\n')
+            {
+                parser->row += 1;
+                parser->line = parser->offset + parser->pos;
+            }
+            else if (c == '/' && prev == '*')
+            {
+                return TRUE;
+            }
+
+            prev = c;
+        }
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_skip_blanks(i_Parser *parser)
+{
+    cassert_no_null(parser);
+    for (;;)
+    {
+        const byte_t *data = parser->buffer;
+        uint32_t i, n;
+
+        if (parser->pos == parser->end && i_fill(parser) == FALSE)
+            return i_EOF;
+
+        i = parser->pos;
+        n = parser->end;
+
+        /* Most tokens are not preceded by blanks */
+        if (data[i] > ' ' && data[i] != '/')
+            return data[i];
+
+#if defined(i_WITH_SSE2)
+        /* Indentation runs, 16 bytes per step */
+        {
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i tab = _mm_set1_epi8('\t');
+            const __m128i cr = _mm_set1_epi8('\r');
+            const __m128i nl = _mm_set1_epi8('\n');
+            while (i + 16 <= n)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+                __m128i vnl = _mm_cmpeq_epi8(v, nl);
+                __m128i vsp = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab));
+                uint32_t blanks = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(vsp, _mm_cmpeq_epi8(v, cr)), vnl));
+                uint32_t lines = (uint32_t)_mm_movemask_epi8(vnl);
+                uint32_t skip = blanks == 0xFFFF ? 16 : i_ctz(~blanks);
+                lines &= (1u << skip) - 1;
+                while (lines != 0)
+                {
+                    parser->row += 1;
+                    parser->line = parser->offset + i + i_ctz(lines) + 1;
+                    lines &= lines - 1;
+                }
+
+                i += skip;
+                if (skip < 16)
+                    break;
+            }
+        }
+#endif
+
+        while (i < n)
+        {
+            byte_t c = data[i];
+            if (c == ' ' || c == '\t' || c == '\r')
+            {
+                i += 1;
+            }
+            else if (c == '\n')
+            {
+                i += 1;
+                parser->row += 1;
+                parser->line = parser->offset + i;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        parser->pos = i;
+        if (i < n)
+        {
+            if (data[i] != '/')
+                return data[i];
+
+            if (i_skip_comment(parser) == FALSE)
+                return i_BAD_COMMENT;
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_text_append(i_Parser *parser, const byte_t *data, const uint32_t size)
 {
-    ltoken_t token;
     cassert_no_null(parser);
-    token = stm_read_token(parser->stm);
-    parser->row = stm_token_col(parser->stm);
-    parser->col = stm_token_row(parser->stm);
-    parser->lexeme = stm_token_lexeme(parser->stm, &parser->lexsize);
-    switch (token) {
-    case ekTIDENT:
-        if (str_equ_c(parser->lexeme, "true") == TRUE)
-            parser->token = i_ekTRUE;
-        else if (str_equ_c(parser->lexeme, "false") == TRUE)
-            parser->token = i_ekFALSE;
-        else if (str_equ_c(parser->lexeme, "null") == TRUE)
-            parser->token = i_ekNULL;
+    /* Room for the final '\0' is reserved even with empty runs */
+    if (parser->lexsize + size + 1 > parser->textsize)
+    {
+        uint32_t nsize = parser->textsize > 0 ? parser->textsize : 256;
+        while (parser->lexsize + size + 1 > nsize)
+            nsize *= 2;
+
+        if (parser->text != NULL)
+            parser->text = (char_t*)heap_realloc((byte_t*)parser->text, parser->textsize, nsize, "JsonText");
         else
-            parser->token = i_ekUNKNOWN;
+            parser->text = (char_t*)heap_malloc(nsize, "JsonText");
+
+        parser->textsize = nsize;
+    }
+
+    /* Empty runs: Strings cut at the buffer end or escapes at the beginning */
+    if (size == 0)
+        return;
+
+    bmem_copy((byte_t*)parser->text + parser->lexsize, data, size);
+    parser->lexsize += size;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_hex4(i_Parser *parser, uint32_t *codepoint)
+{
+    uint32_t i;
+    cassert_no_null(codepoint);
+    *codepoint = 0;
+    for (i = 0; i < 4; ++i)
+    {
+        byte_t c;
+        uint32_t v;
+        if (i_next_byte(parser, &c) == FALSE)
+            return FALSE;
+
+        if (c >= '0' && c <= '9')
+            v = (uint32_t)(c - '0');
+        else if (c >= 'a' && c <= 'f')
+            v = (uint32_t)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            v = (uint32_t)(c - 'A' + 10);
+        else
+            return FALSE;
+
+        *codepoint = (*codepoint << 4) | v;
+    }
+
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_escape(i_Parser *parser)
+{
+    byte_t c;
+    if (i_next_byte(parser, &c) == FALSE)
+        return FALSE;
+
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+        break;
+    case 'b':
+        c = '\b';
+        break;
+    case 'f':
+        c = '\f';
+        break;
+    case 'n':
+        c = '\n';
+        break;
+    case 'r':
+        c = '\r';
+        break;
+    case 't':
+        c = '\t';
         break;
+    case 'u':
+    {
+        char_t utf8[8];
+        uint32_t n, codepoint;
+        if (i_hex4(parser, &codepoint) == FALSE)
+            return FALSE;
 
-    case ekTINTEGER:
-    case ekTREAL:
-        parser->token = i_ekNUMBER;
-        if (parser->minus == TRUE)
+        /* UTF-16 surrogate pair */
+        if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
         {
-            bstd_sprintf(parser->number, sizeof(parser->number), "-%s", parser->lexeme);
-            parser->minus = FALSE;
+            byte_t c1, c2;
+            uint32_t low;
+            if (i_next_byte(parser, &c1) == FALSE || c1 != '\\')
+                return FALSE;
+            if (i_next_byte(parser, &c2) == FALSE || c2 != 'u')
+                return FALSE;
+            if (i_hex4(parser, &low) == FALSE || low < 0xDC00 || low > 0xDFFF)
+                return FALSE;
+            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+        }
+
+        n = unicode_to_char(codepoint, utf8, ekUTF8);
+        i_text_append(parser, (const byte_t*)utf8, n);
+        return TRUE;
+    }
+
+    default:
+        return FALSE;
+    }
+
+    i_text_append(parser, &c, 1);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static const byte_t *i_find_quote(const byte_t *data, const byte_t *end)
+{
+#if defined(i_WITH_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    while (end - data >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)data);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)));
+        if (mask != 0)
+            return data + i_ctz(mask);
+        data += 16;
+    }
+#endif
+
+    while (data < end && *data != '"' && *data != '\\')
+        data += 1;
+
+    return data;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_string(i_Parser *parser)
+{
+    const byte_t *start, *end, *stop;
+    cassert_no_null(parser);
+    cassert(parser->buffer[parser->pos] == '"');
+    parser->pos += 1;
+    start = parser->buffer + parser->pos;
+    end = parser->buffer + parser->end;
+    stop = i_find_quote(start, end);
+
+    /* Whole string inside the buffer and without escapes, no copy */
+    if (stop < end && *stop == '"')
+    {
+        *((byte_t*)stop) = '\0';
+        parser->lexeme = (const char_t*)start;
+        parser->lexsize = (uint32_t)(stop - start);
+        parser->pos = (uint32_t)(stop - parser->buffer) + 1;
+        parser->token = i_ekSTRING;
+        return;
+    }
+
+    parser->lexsize = 0;
+    for (;;)
+    {
+        i_text_append(parser, start, (uint32_t)(stop - start));
+        parser->pos = (uint32_t)(stop - parser->buffer);
+        if (stop == end)
+        {
+            if (i_fill(parser) == FALSE)
+            {
+                parser->token = i_ekUNKNOWN;
+                return;
+            }
+        }
+        else if (*stop == '"')
+        {
+            parser->pos += 1;
+            break;
         }
         else
         {
-            str_copy_c(parser->number, sizeof(parser->number), parser->lexeme);
+            parser->pos += 1;
+            if (i_escape(parser) == FALSE)
+            {
+                parser->token = i_ekUNKNOWN;
+                return;
+            }
         }
-        break;
 
-    case ekTSTRING:
-        cassert(parser->lexeme[0] == '\"');
-        cassert(parser->lexeme[parser->lexsize - 1] == '\"');
-        ((char_t*)parser->lexeme)[parser->lexsize - 1] = '\0';
-        parser->lexeme += 1;
-        parser->lexsize -= 2;
-        parser->token = i_ekSTRING;
-        break;
+        start = parser->buffer + parser->pos;
+        end = parser->buffer + parser->end;
+        stop = i_find_quote(start, end);
+    }
 
-    case ekTOPENBRAC:
-        parser->token = i_ekOPEN_ARRAY;
-        break;
+    parser->text[parser->lexsize] = '\0';
+    parser->lexeme = parser->text;
+    parser->token = i_ekSTRING;
+}
 
-    case ekTCLOSBRAC:
-        parser->token = i_ekCLOSE_ARRAY;
-        break;
+/*---------------------------------------------------------------------------*/
 
-    case ekTOPENCURL:
-        parser->token = i_ekOPEN_OBJECT;
-        break;
+static bool_t i_is_digit(const char_t c)
+{
+    return (bool_t)(c >= '0' && c <= '9');
+}
 
-    case ekTCLOSCURL:
-        parser->token = i_ekCLOSE_OBJECT;
-        break;
+/*---------------------------------------------------------------------------*/
 
-    case ekTCOMMA:
-        parser->token = i_ekCOMMA;
-        break;
+static bool_t i_valid_number(const char_t *number)
+{
+    /* -?d+(.d+)?([eE][+-]?d+)? */
+    if (*number == '-')
+        number += 1;
+    if (i_is_digit(*number) == FALSE)
+        return FALSE;
+    while (i_is_digit(*number) == TRUE)
+        number += 1;
+    if (*number == '.')
+    {
+        number += 1;
+        if (i_is_digit(*number) == FALSE)
+            return FALSE;
+        while (i_is_digit(*number) == TRUE)
+            number += 1;
+    }
+    if (*number == 'e' || *number == 'E')
+    {
+        number += 1;
+        if (*number == '+' || *number == '-')
+            number += 1;
+        if (i_is_digit(*number) == FALSE)
+            return FALSE;
+        while (i_is_digit(*number) == TRUE)
+            number += 1;
+    }
+    return (bool_t)(*number == '\0');
+}
 
-    case ekTCOLON:
-        parser->token = i_ekCOLON;
-        break;
+/*---------------------------------------------------------------------------*/
 
-    case ekTMINUS:
-        cassert(parser->minus == FALSE);
-        parser->minus = TRUE;
-        i_new_token(parser);
-        break;
+static void i_number(i_Parser *parser)
+{
+    uint32_t n = 0;
+    cassert_no_null(parser);
+    for (;;)
+    {
+        byte_t c;
+        if (parser->pos == parser->end && i_fill(parser) == FALSE)
+            break;
 
-    case ekTSLCOM:
-    case ekTMLCOM:
-    case ekTSPACE:
-    case ekTEOL:
-    case ekTLESS:
-    case ekTGREAT:
-    case ekTPERIOD:
-    case ekTSCOLON:
-    case ekTOPENPAR:
-    case ekTCLOSPAR:
-    case ekTPLUS:
-    case ekTASTERK:
-    case ekTEQUALS:
-    case ekTDOLLAR:
-    case ekTPERCENT:
-    case ekTPOUND:
-    case ekTAMPER:
-    case ekTAPOST:
-    case ekTQUOTE:
-    case ekTCIRCUM:
-    case ekTTILDE:
-    case ekTEXCLA:
-    case ekTQUEST:
-    case ekTVLINE:
-    case ekTSLASH:
-    case ekTBSLASH:
-    case ekTAT:
-    case ekTOCTAL:
-    case ekTHEX:
-    case ekTUNDEF:
-    case ekTCORRUP:
-    case ekTEOF:
-    case ekTRESERVED:
-    default:
+        c = parser->buffer[parser->pos];
+        if (i_is_digit((char_t)c) == FALSE && c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E')
+            break;
+
+        if (n == sizeof(parser->number) - 1)
+        {
+            parser->token = i_ekUNKNOWN;
+            break;
+        }
+
+        parser->number[n++] = (char_t)c;
+        parser->pos += 1;
+    }
+
+    parser->number[n] = '\0';
+    parser->lexeme = parser->number;
+    parser->lexsize = n;
+    if (n < sizeof(parser->number) - 1 && i_valid_number(parser->number) == TRUE)
+        parser->token = i_ekNUMBER;
+    else
         parser->token = i_ekUNKNOWN;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_keyword(i_Parser *parser)
+{
+    uint32_t n = 0;
+    cassert_no_null(parser);
+    for (;;)
+    {
+        byte_t c;
+        if (parser->pos == parser->end && i_fill(parser) == FALSE)
+            break;
+
+        c = parser->buffer[parser->pos];
+        if ((c < 'a' || c > 'z') && (c < 'A' || c > 'Z') && i_is_digit((char_t)c) == FALSE && c != '_')
+            break;
+
+        if (n < sizeof(parser->number) - 1)
+            parser->number[n++] = (char_t)c;
+        parser->pos += 1;
+    }
+
+    parser->number[n] = '\0';
+    parser->lexeme = parser->number;
+    parser->lexsize = n;
+    parser->token = i_ident(parser->number, n);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_single(i_Parser *parser, const jtoken_t token, const char_t *lexeme)
+{
+    cassert_no_null(parser);
+    parser->pos += 1;
+    parser->token = token;
+    parser->lexeme = lexeme;
+    parser->lexsize = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_new_token(i_Parser *parser)
+{
+    uint32_t c;
+    cassert_no_null(parser);
+    c = i_skip_blanks(parser);
+    parser->col = (uint32_t)(parser->offset + parser->pos - parser->line) + 1;
+    switch (c) {
+    case '{':
+        i_single(parser, i_ekOPEN_OBJECT, "{");
+        break;
+    case '}':
+        i_single(parser, i_ekCLOSE_OBJECT, "}");
+        break;
+    case '[':
+        i_single(parser, i_ekOPEN_ARRAY, "[");
+        break;
+    case ']':
+        i_single(parser, i_ekCLOSE_ARRAY, "]");
+        break;
+    case ',':
+        i_single(parser, i_ekCOMMA, ",");
+        break;
+    case ':':
+        i_single(parser, i_ekCOLON, ":");
+        break;
+    case '"':
+        i_string(parser);
+        break;
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        i_number(parser);
+        break;
+    case i_EOF:
+        parser->token = i_ekEOF;
+        parser->lexeme = NULL;
+        parser->lexsize = 0;
+        break;
+    case i_BAD_COMMENT:
+        parser->token = i_ekUNKNOWN;
+        parser->lexeme = NULL;
+        parser->lexsize = 0;
+        break;
+    default:
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            i_keyword(parser);
+        else
+            i_single(parser, i_ekUNKNOWN, "?");
         break;
     }
 }
@@ -299,12 +780,13 @@ static bool_t i_jump_value(i_Parser *parser)
         return i_error(FALSE, TRUE, parser, "Unexpected Json token ','");
     case i_ekCOLON:
         return i_error(FALSE, TRUE, parser, "Unexpected Json token ':'");
+    case i_ekEOF:
+        return i_error(FALSE, TRUE, parser, "Unexpected end of Json");
     case i_ekUNKNOWN:
         return i_error(FALSE, TRUE, parser, "Unknown Json token");
     cassert_default();
     }
 
-    parser->minus = FALSE;
     return i_error(FALSE, TRUE, parser, "Fatal Json parsing error");
 }
 
@@ -703,6 +1185,8 @@ static bool_t i_parse_value(i_Parser *parser, DBind *dbind, dtype_t type, const
         return i_error(FALSE, TRUE, parser, "Unexpected Json token ','");
     case i_ekCOLON:
         return i_error(FALSE, TRUE, parser, "Unexpected Json token ':'");
+    case i_ekEOF:
+        return i_error(FALSE, TRUE, parser, "Unexpected end of Json");
     case i_ekUNKNOWN:
         return i_error(FALSE, TRUE, parser, "Unknown Json token");
     cassert_default();
@@ -959,66 +1443,118 @@ static void *i_create_type(i_Parser *parser, const char_t *type)
 
 /*---------------------------------------------------------------------------*/
 
+static void i_init_parser(i_Parser *parser, Stream *stm)
+{
+    cassert_no_null(parser);
+    parser->stm = stm;
+    stm_skip_bom(parser->stm);
+    parser->token = i_ekUNKNOWN;
+    parser->col = 0;
+    parser->row = 1;
+    parser->lexeme = NULL;
+    parser->lexsize = 0;
+    parser->pos = 0;
+    parser->end = 0;
+    parser->offset = 0;
+    parser->line = 0;
+    parser->text = NULL;
+    parser->textsize = 0;
+    parser->number[0] = '\0';
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_close_parser(i_Parser *parser)
+{
+    cassert_no_null(parser);
+
+    /* Bytes read in advance return to the stream */
+    if (parser->end > parser->pos)
+    {
+        _stm_restore(parser->stm, parser->buffer + parser->pos, parser->end - parser->pos);
+        parser->pos = parser->end;
+    }
+
+    if (parser->text != NULL)
+        heap_free((byte_t**)&parser->text, parser->textsize, "JsonText");
+}
+
+/*---------------------------------------------------------------------------*/
+
 void *json_read_imp(Stream *stm, const JsonOpts *opts, const char_t *type)
 {
     i_Parser parser;
     void *obj = NULL;
     unref(opts);
-    parser.stm = stm;
-    stm_token_escapes(parser.stm, TRUE);
-    stm_skip_bom(parser.stm);
-    parser.col = 0;
-    parser.row = 0;
-    parser.lexeme = NULL;
-    parser.lexsize = 0;
-    parser.minus = FALSE;
+    i_init_parser(&parser, stm);
     obj = i_create_type(&parser, type);
+    i_close_parser(&parser);
     return obj;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void i_write_string(Stream *stm, const String *str)
+static void i_flush(i_Writer *writer, const bool_t all)
+{
+    cassert_no_null(writer);
+    if (all == TRUE || strbuf_len(writer->buf) >= i_BUFFER_SIZE)
+    {
+        stm_writef(writer->stm, strbuf_data(writer->buf));
+        strbuf_clear(writer->buf);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_write_string(i_Writer *writer, const String *str)
 {
     if (str != NULL)
     {
+        /* Runs of bytes without escapes are appended at once (UTF8 multibyte >= 0x80) */
         const char_t *cstr = tc(str);
-        uint32_t cp = unicode_to_u32(cstr, ekUTF8);
-        stm_writef(stm, "\"");
-        while (cp != 0)
+        const char_t *run = cstr;
+        strbuf_cat(writer->buf, "\"");
+        for (; *cstr != '\0'; ++cstr)
         {
-            if (cp == '"')
-                stm_writef(stm, "\\\"");
-            else if (cp == '\\')
-                stm_writef(stm, "\\\\");
-            //else if (cp == '/')
-            //  stm_writef(stm, "\\/");
-            else if (cp == '\b')
-                stm_writef(stm, "\\b");
-            else if (cp == '\f')
-                stm_writef(stm, "\\f");
-            else if (cp == '\n')
-                stm_writef(stm, "\\n");
-            else if (cp == '\r')
-                stm_writef(stm, "\\r");
-            else if (cp == '\t')
-                stm_writef(stm, "\\t");
-            else if (cp >= 32)
-                stm_write_char(stm, cp);
-            cstr = unicode_next(cstr, ekUTF8);
-            cp = unicode_to_u32(cstr, ekUTF8);
+            const char_t *esc = NULL;
+            byte_t c = (byte_t)*cstr;
+            if (c >= 32 && c != '"' && c != '\\')
+                continue;
+
+            if (c == '"')
+                esc = "\\\"";
+            else if (c == '\\')
+                esc = "\\\\";
+            //else if (c == '/')
+            //  esc = "\\/";
+            else if (c == '\b')
+                esc = "\\b";
+            else if (c == '\f')
+                esc = "\\f";
+            else if (c == '\n')
+                esc = "\\n";
+            else if (c == '\r')
+                esc = "\\r";
+            else if (c == '\t')
+                esc = "\\t";
+
+            strbuf_cat_n(writer->buf, run, (uint32_t)(cstr - run));
+            if (esc != NULL)
+                strbuf_cat(writer->buf, esc);
+            run = cstr + 1;
         }
-        stm_writef(stm, "\"");
+        strbuf_cat_n(writer->buf, run, (uint32_t)(cstr - run));
+        strbuf_cat(writer->buf, "\"");
     }
     else
     {
-        stm_writef(stm, "null");
+        strbuf_cat(writer->buf, "null");
     }    
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void i_write_array(Stream *stm, const Array *array, const char_t *type)
+static void i_write_array(i_Writer *writer, const Array *array, const char_t *type)
 {
     if (array != NULL)
     {
@@ -1028,25 +1564,26 @@ static void i_write_array(Stream *stm, const Array *array, const char_t *type)
         String *subtype = NULL;
         dtype_t atype = _dbind_type(type, &subtype, NULL);
         const char_t *stype = subtype != NULL ? tc(subtype) : NULL;
-        stm_writef(stm, "[ ");
+        strbuf_cat(writer->buf, "[ ");
         for (i = 0; i < n; ++i, data += es)
         {
-            i_write_type(stm, atype, stype, (const void*)data, TRUE);
+            i_write_type(writer, atype, stype, (const void*)data, TRUE);
             if (i < n - 1)
-                stm_writef(stm, ", ");
+                strbuf_cat(writer->buf, ", ");
+            i_flush(writer, FALSE);
         }
-        stm_writef(stm, " ]");
+        strbuf_cat(writer->buf, " ]");
         str_destopt(&subtype);
     }
     else
     {
-        stm_writef(stm, "null");
+        strbuf_cat(writer->buf, "null");
     }
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void i_write_arrpt(Stream *stm, const Array *array, const char_t *type)
+static void i_write_arrpt(i_Writer *writer, const Array *array, const char_t *type)
 {
     if (array != NULL)
     {
@@ -1055,24 +1592,26 @@ static void i_write_arrpt(Stream *stm, const Array *array, const char_t *type)
         String *subtype = NULL;
         dtype_t atype = _dbind_type(type, &subtype, NULL);
         const char_t *stype = subtype != NULL ? tc(subtype) : NULL;
-        stm_writef(stm, "[ ");
+        strbuf_cat(writer->buf, "[ ");
         if (atype == ekDTYPE_STRING)
         {
             for (i = 0; i < n; ++i, data += sizeof(void*))
             {
-                stm_writef(stm, "\n");
-                i_write_string(stm, *(String**)data);
+                strbuf_cat(writer->buf, "\n");
+                i_write_string(writer, *(String**)data);
                 if (i < n - 1)
-                    stm_writef(stm, ", ");
+                    strbuf_cat(writer->buf, ", ");
+                i_flush(writer, FALSE);
             }
         }
         else if (atype == ekDTYPE_OBJECT)
         {
             for (i = 0; i < n; ++i, data += sizeof(void*))
             {
-                i_write_object(stm, *(const void**)data, stype, TRUE);
+                i_write_object(writer, *(const void**)data, stype, TRUE);
                 if (i < n - 1)
-                    stm_writef(stm, ", ");
+                    strbuf_cat(writer->buf, ", ");
+                i_flush(writer, FALSE);
             }
         }
         else
@@ -1080,12 +1619,12 @@ static void i_write_arrpt(Stream *stm, const Array *array, const char_t *type)
             cassert_msg(FALSE, "Json: Invalid ArrPt type.");
         }
 
-        stm_writef(stm, " ]");
+        strbuf_cat(writer->buf, " ]");
         str_destopt(&subtype);
     }
     else
     {
-        stm_writef(stm, "null");
+        strbuf_cat(writer->buf, "null");
     }
 }
 
@@ -1095,7 +1634,7 @@ static void i_write_arrpt(Stream *stm, const Array *array, const char_t *type)
 
 /*---------------------------------------------------------------------------*/
 
-static void i_write_object(Stream *stm, const void *object, const char_t *type, const bool_t inarray)
+static void i_write_object(i_Writer *writer, const void *object, const char_t *type, const bool_t inarray)
 {
     if (object != NULL)
     {
@@ -1106,9 +1645,9 @@ static void i_write_object(Stream *stm, const void *object, const char_t *type,
         cassert_msg(ok == TRUE, "Json: Unknown struct type.");
         unref(ok);
 
-        stm_writef(stm, "{");
+        strbuf_cat(writer->buf, "{");
         if (inarray == TRUE)
-            stm_writef(stm, "\n");
+            strbuf_cat(writer->buf, "\n");
 
         for (i = 0; i < n; ++i)
         {
@@ -1119,26 +1658,27 @@ static void i_write_object(Stream *stm, const void *object, const char_t *type,
             ok = _dbind_member_i(type, i, &mname, &moffset, &mtype, &mstype);
             cassert_msg(ok == TRUE, "Json: Unknown struct member.");
             if (i_with_nl(mtype) == TRUE || i_with_nl(ptype) == TRUE)
-                stm_writef(stm, "\n");
-            stm_printf(stm, "\n\"%s\" : ", mname);
-            i_write_type(stm, mtype, mstype, (const void*)((byte_t*)object + moffset), FALSE);
+                strbuf_cat(writer->buf, "\n");
+            strbuf_printf(writer->buf, "\n\"%s\" : ", mname);
+            i_write_type(writer, mtype, mstype, (const void*)((byte_t*)object + moffset), FALSE);
             if (i < n - 1)
-                stm_writef(stm, ", ");
+                strbuf_cat(writer->buf, ", ");
+            i_flush(writer, FALSE);
             ptype = mtype;
             //if (i_with_nl(mtype) == TRUE)
-            //    stm_writef(stm, "\n");
+            //    strbuf_cat(writer->buf, "\n");
         }
-        stm_writef(stm, " }");
+        strbuf_cat(writer->buf, " }");
     }
     else
     {
-        stm_writef(stm, "null");
+        strbuf_cat(writer->buf, "null");
     }
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void i_write_type(Stream *stm, dtype_t type, const char_t *subtype, const void *data, const bool_t inarray)
+static void i_write_type(i_Writer *writer, dtype_t type, const char_t *subtype, const void *data, const bool_t inarray)
 {
     cassert_no_null(data);
     switch (type)
@@ -1146,77 +1686,77 @@ static void i_write_type(Stream *stm, dtype_t type, const char_t *subtype, const
         case ekDTYPE_BOOL:
             if (*(bool_t*)data == TRUE)
             {
-                stm_writef(stm, "true");
+                strbuf_cat(writer->buf, "true");
             }
             else
             {
                 cassert(*(bool_t*)data == FALSE);
-                stm_writef(stm, "false");
+                strbuf_cat(writer->buf, "false");
             }
             break;
 
         case ekDTYPE_INT8:
-            stm_printf(stm, "%d", *(int8_t*)data);
+            strbuf_printf(writer->buf, "%d", *(int8_t*)data);
             break;
 
         case ekDTYPE_INT16:
-            stm_printf(stm, "%d", *(int16_t*)data);
+            strbuf_printf(writer->buf, "%d", *(int16_t*)data);
             break;
 
         case ekDTYPE_INT32:
-            stm_printf(stm, "%d", *(int32_t*)data);
+            strbuf_printf(writer->buf, "%d", *(int32_t*)data);
             break;
 
         case ekDTYPE_INT64:
-            stm_printf(stm, "%" PRId64, *(int64_t*)data);
+            strbuf_printf(writer->buf, "%" PRId64, *(int64_t*)data);
             break;
 
         case ekDTYPE_UINT8:
-            stm_printf(stm, "%u", *(uint8_t*)data);
+            strbuf_printf(writer->buf, "%u", *(uint8_t*)data);
             break;
 
         case ekDTYPE_UINT16:
-            stm_printf(stm, "%u", *(uint16_t*)data);
+            strbuf_printf(writer->buf, "%u", *(uint16_t*)data);
             break;
 
         case ekDTYPE_UINT32:
-            stm_printf(stm, "%u", *(uint32_t*)data);
+            strbuf_printf(writer->buf, "%u", *(uint32_t*)data);
             break;
 
         case ekDTYPE_UINT64:
-            stm_printf(stm, "%" PRIu64, *(uint64_t*)data);
+            strbuf_printf(writer->buf, "%" PRIu64, *(uint64_t*)data);
             break;
 
         case ekDTYPE_REAL32:
-            stm_printf(stm, "%f", *(real32_t*)data);
+            strbuf_printf(writer->buf, "%f", *(real32_t*)data);
             break;
 
         case ekDTYPE_REAL64:
-            stm_printf(stm, "%f", *(real64_t*)data);
+            strbuf_printf(writer->buf, "%f", *(real64_t*)data);
             break;
         case ekDTYPE_ENUM:
-            stm_printf(stm, "%u", *(enum_t*)data);
+            strbuf_printf(writer->buf, "%u", *(enum_t*)data);
             break;
 
         case ekDTYPE_STRING:
         case ekDTYPE_STRING_PTR:
-            i_write_string(stm, *(String**)data);
+            i_write_string(writer, *(String**)data);
             break;
 
         case ekDTYPE_ARRAY:
-            i_write_array(stm, *(Array**)data, subtype);
+            i_write_array(writer, *(Array**)data, subtype);
             break;
 
         case ekDTYPE_ARRPTR:
-            i_write_arrpt(stm, *(Array**)data, subtype);
+            i_write_arrpt(writer, *(Array**)data, subtype);
             break;
 
         case ekDTYPE_OBJECT:
-            i_write_object(stm, data, subtype, inarray);
+            i_write_object(writer, data, subtype, inarray);
             break;
 
         case ekDTYPE_OBJECT_PTR:
-            i_write_object(stm, *(const void**)data, subtype, inarray);
+            i_write_object(writer, *(const void**)data, subtype, inarray);
             break;
 
         case ekDTYPE_OBJECT_OPAQUE:
@@ -1229,11 +1769,16 @@ static void i_write_type(Stream *stm, dtype_t type, const char_t *subtype, const
 
 void json_write_imp(Stream *stm, const void *data, const JsonOpts *opts, const char_t *type)
 {
+    i_Writer writer;
     String *subtype = NULL;
     dtype_t dtype = _dbind_type(type, &subtype, NULL);
     unref(opts);
-    i_write_type(stm, dtype, subtype != NULL ? tc(subtype) : NULL, data, FALSE);
-    stm_writef(stm, "\n");
+    writer.stm = stm;
+    writer.buf = strbuf_create(2 * i_BUFFER_SIZE);
+    i_write_type(&writer, dtype, subtype != NULL ? tc(subtype) : NULL, data, FALSE);
+    strbuf_cat(writer.buf, "\n");
+    i_flush(&writer, TRUE);
+    strbuf_destroy(&writer.buf);
     str_destopt(&subtype);
 }
 
@@ -1251,3 +1796,555 @@ void json_destopt_imp(void **data, const char_t *type)
     dbind_destopt_imp((byte_t**)data, type);
 }
 
+
+/*---------------------------------------------------------------------------*/
+
+#define i_MAX_DEPTH     512
+
+typedef enum _rstate_t
+{
+    i_ekSTATE_VALUE,
+    i_ekSTATE_FIRST_VALUE,
+    i_ekSTATE_KEY,
+    i_ekSTATE_FIRST_KEY,
+    i_ekSTATE_COLON,
+    i_ekSTATE_NEXT,
+    i_ekSTATE_END
+} rstate_t;
+
+struct _jsonreader_t
+{
+    i_Parser parser;
+    rstate_t state;
+    jsonev_t event;
+    uint32_t depth;
+    byte_t stack[i_MAX_DEPTH];
+};
+
+struct _jsonnode_t
+{
+    jsontype_t type;
+    bool_t value;
+    uint32_t hash;
+    String *key;
+    String *text;
+    ArrPt(JsonNode) *children;
+};
+
+DeclPt(JsonNode);
+
+/*---------------------------------------------------------------------------*/
+
+JsonReader *json_reader_create(Stream *stm, const JsonOpts *opts)
+{
+    JsonReader *reader = heap_new(JsonReader);
+    unref(opts);
+    i_init_parser(&reader->parser, stm);
+    reader->state = i_ekSTATE_VALUE;
+    reader->event = ekJSON_EOF;
+    reader->depth = 0;
+    return reader;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void json_reader_destroy(JsonReader **reader)
+{
+    cassert_no_null(reader);
+    cassert_no_null(*reader);
+    i_close_parser(&(*reader)->parser);
+    heap_delete(reader, JsonReader);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static jsonev_t i_reader_error(JsonReader *reader, const char_t *errmsg)
+{
+    cassert_no_null(reader);
+    i_error(FALSE, TRUE, &reader->parser, errmsg);
+    reader->state = i_ekSTATE_END;
+    return ekJSON_ERROR;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static jsonev_t i_reader_push(JsonReader *reader, const jtoken_t token, const rstate_t state, const jsonev_t event)
+{
+    cassert_no_null(reader);
+    if (reader->depth == i_MAX_DEPTH)
+        return i_reader_error(reader, "Json nesting too deep");
+    reader->stack[reader->depth++] = (byte_t)token;
+    reader->state = state;
+    return event;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static jsonev_t i_reader_pop(JsonReader *reader, const jtoken_t token, const jsonev_t event)
+{
+    cassert_no_null(reader);
+    if (reader->depth == 0 || reader->stack[reader->depth - 1] != (byte_t)token)
+        return i_reader_error(reader, "Unbalanced Json container");
+    reader->depth -= 1;
+    reader->state = i_ekSTATE_NEXT;
+    return event;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static jsonev_t i_reader_value(JsonReader *reader)
+{
+    cassert_no_null(reader);
+    switch (reader->parser.token) {
+    case i_ekTRUE:
+    case i_ekFALSE:
+        reader->state = i_ekSTATE_NEXT;
+        return ekJSON_BOOL;
+    case i_ekNULL:
+        reader->state = i_ekSTATE_NEXT;
+        return ekJSON_NULL;
+    case i_ekNUMBER:
+        reader->state = i_ekSTATE_NEXT;
+        return ekJSON_NUMBER;
+    case i_ekSTRING:
+        reader->state = i_ekSTATE_NEXT;
+        return ekJSON_STRING;
+    case i_ekOPEN_OBJECT:
+        return i_reader_push(reader, i_ekOPEN_OBJECT, i_ekSTATE_FIRST_KEY, ekJSON_OBJECT_BEGIN);
+    case i_ekOPEN_ARRAY:
+        return i_reader_push(reader, i_ekOPEN_ARRAY, i_ekSTATE_FIRST_VALUE, ekJSON_ARRAY_BEGIN);
+    case i_ekCLOSE_ARRAY:
+        return i_reader_error(reader, "Unexpected Json token ']'");
+    case i_ekCLOSE_OBJECT:
+        return i_reader_error(reader, "Unexpected Json token '}'");
+    case i_ekCOMMA:
+        return i_reader_error(reader, "Unexpected Json token ','");
+    case i_ekCOLON:
+        return i_reader_error(reader, "Unexpected Json token ':'");
+    case i_ekEOF:
+        return i_reader_error(reader, "Unexpected end of Json");
+    case i_ekUNKNOWN:
+        return i_reader_error(reader, "Unknown Json token");
+    cassert_default();
+    }
+
+    return i_reader_error(reader, "Fatal Json parsing error");
+}
+
+/*---------------------------------------------------------------------------*/
+
+static jsonev_t i_reader_key(JsonReader *reader)
+{
+    cassert_no_null(reader);
+    if (reader->parser.token != i_ekSTRING)
+        return i_reader_error(reader, "Expected Json 'string' (member name)");
+
+    /* ':' is read in the next call, keeping the key lexeme alive */
+    reader->state = i_ekSTATE_COLON;
+    return ekJSON_KEY;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static jsonev_t i_reader_next(JsonReader *reader)
+{
+    cassert_no_null(reader);
+    switch (reader->state) {
+    case i_ekSTATE_VALUE:
+        i_new_token(&reader->parser);
+        /* Top level: empty stream or several concatenated values (Json lines) */
+        if (reader->depth == 0 && reader->parser.token == i_ekEOF)
+        {
+            reader->state = i_ekSTATE_END;
+            return ekJSON_EOF;
+        }
+        return i_reader_value(reader);
+
+    case i_ekSTATE_FIRST_VALUE:
+        i_new_token(&reader->parser);
+        if (reader->parser.token == i_ekCLOSE_ARRAY)
+            return i_reader_pop(reader, i_ekOPEN_ARRAY, ekJSON_ARRAY_END);
+        return i_reader_value(reader);
+
+    case i_ekSTATE_FIRST_KEY:
+        i_new_token(&reader->parser);
+        if (reader->parser.token == i_ekCLOSE_OBJECT)
+            return i_reader_pop(reader, i_ekOPEN_OBJECT, ekJSON_OBJECT_END);
+        return i_reader_key(reader);
+
+    case i_ekSTATE_KEY:
+        i_new_token(&reader->parser);
+        return i_reader_key(reader);
+
+    case i_ekSTATE_COLON:
+        i_new_token(&reader->parser);
+        if (reader->parser.token != i_ekCOLON)
+            return i_reader_error(reader, "Expected Json ':' (object member)");
+        i_new_token(&reader->parser);
+        return i_reader_value(reader);
+
+    case i_ekSTATE_NEXT:
+        if (reader->depth == 0)
+        {
+            reader->state = i_ekSTATE_VALUE;
+            return i_reader_next(reader);
+        }
+
+        i_new_token(&reader->parser);
+        switch (reader->parser.token) {
+        case i_ekCOMMA:
+            if (reader->stack[reader->depth - 1] == (byte_t)i_ekOPEN_OBJECT)
+                reader->state = i_ekSTATE_KEY;
+            else
+                reader->state = i_ekSTATE_VALUE;
+            return i_reader_next(reader);
+        case i_ekCLOSE_OBJECT:
+            return i_reader_pop(reader, i_ekOPEN_OBJECT, ekJSON_OBJECT_END);
+        case i_ekCLOSE_ARRAY:
+            return i_reader_pop(reader, i_ekOPEN_ARRAY, ekJSON_ARRAY_END);
+        case i_ekTRUE:
+        case i_ekFALSE:
+        case i_ekNULL:
+        case i_ekNUMBER:
+        case i_ekSTRING:
+        case i_ekOPEN_ARRAY:
+        case i_ekOPEN_OBJECT:
+        case i_ekCOLON:
+        case i_ekEOF:
+        case i_ekUNKNOWN:
+            return i_reader_error(reader, "Expected Json ',' or container end");
+        cassert_default();
+        }
+        break;
+
+    case i_ekSTATE_END:
+        return reader->event;
+    cassert_default();
+    }
+
+    return i_reader_error(reader, "Fatal Json parsing error");
+}
+
+/*---------------------------------------------------------------------------*/
+
+jsonev_t json_reader_next(JsonReader *reader)
+{
+    cassert_no_null(reader);
+    reader->event = i_reader_next(reader);
+    return reader->event;
+}
+
+/*---------------------------------------------------------------------------*/
+
+jsonev_t json_reader_event(const JsonReader *reader)
+{
+    cassert_no_null(reader);
+    return reader->event;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t json_reader_depth(const JsonReader *reader)
+{
+    cassert_no_null(reader);
+    return reader->depth;
+}
+
+/*---------------------------------------------------------------------------*/
+
+const char_t *json_reader_text(const JsonReader *reader, uint32_t *size)
+{
+    cassert_no_null(reader);
+    switch (reader->event) {
+    case ekJSON_KEY:
+    case ekJSON_STRING:
+    case ekJSON_NUMBER:
+        ptr_assign(size, reader->parser.lexsize);
+        return reader->parser.lexeme;
+    case ekJSON_OBJECT_BEGIN:
+    case ekJSON_OBJECT_END:
+    case ekJSON_ARRAY_BEGIN:
+    case ekJSON_ARRAY_END:
+    case ekJSON_BOOL:
+    case ekJSON_NULL:
+    case ekJSON_EOF:
+    case ekJSON_ERROR:
+        ptr_assign(size, 0);
+        return "";
+    cassert_default();
+    }
+
+    return "";
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t json_reader_bool(const JsonReader *reader)
+{
+    cassert_no_null(reader);
+    cassert(reader->event == ekJSON_BOOL);
+    return (bool_t)(reader->parser.token == i_ekTRUE);
+}
+
+/*---------------------------------------------------------------------------*/
+
+real64_t json_reader_real64(const JsonReader *reader)
+{
+    cassert_no_null(reader);
+    cassert(reader->event == ekJSON_NUMBER);
+    return str_to_r64(reader->parser.number, NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+
+int64_t json_reader_int64(const JsonReader *reader)
+{
+    cassert_no_null(reader);
+    cassert(reader->event == ekJSON_NUMBER);
+    return str_to_i64(reader->parser.number, 10, NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t json_reader_skip(JsonReader *reader)
+{
+    uint32_t depth;
+    cassert_no_null(reader);
+
+    /* Skip the value of this member */
+    if (reader->event == ekJSON_KEY)
+        json_reader_next(reader);
+
+    if (reader->event != ekJSON_OBJECT_BEGIN && reader->event != ekJSON_ARRAY_BEGIN)
+        return (bool_t)(reader->event != ekJSON_ERROR && reader->event != ekJSON_EOF);
+
+    depth = reader->depth;
+    while (reader->depth >= depth)
+    {
+        jsonev_t event = json_reader_next(reader);
+        if (event == ekJSON_ERROR || event == ekJSON_EOF)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static JsonNode *i_create_node(const jsontype_t type)
+{
+    JsonNode *node = heap_new0(JsonNode);
+    node->type = type;
+    return node;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void json_node_destroy(JsonNode **node)
+{
+    cassert_no_null(node);
+    cassert_no_null(*node);
+    str_destopt(&(*node)->key);
+    str_destopt(&(*node)->text);
+    if ((*node)->children != NULL)
+        arrpt_destroy(&(*node)->children, json_node_destroy, JsonNode);
+    heap_delete(node, JsonNode);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Empty keys ("") are valid Json. 'bhash_from_block' doesn't accept empty blocks */
+static uint32_t i_key_hash(const char_t *key, const uint32_t size)
+{
+    return size > 0 ? bhash_from_block((const byte_t*)key, size) : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static JsonNode *i_reader_node(JsonReader *reader)
+{
+    JsonNode *node = NULL;
+    cassert_no_null(reader);
+    switch (reader->event) {
+    case ekJSON_NULL:
+        return i_create_node(ekJSON_TNULL);
+
+    case ekJSON_BOOL:
+        node = i_create_node(ekJSON_TBOOL);
+        node->value = json_reader_bool(reader);
+        return node;
+
+    case ekJSON_NUMBER:
+        node = i_create_node(ekJSON_TNUMBER);
+        node->text = str_c(reader->parser.number);
+        return node;
+
+    case ekJSON_STRING:
+        node = i_create_node(ekJSON_TSTRING);
+        node->text = str_c(reader->parser.lexeme);
+        return node;
+
+    case ekJSON_ARRAY_BEGIN:
+        node = i_create_node(ekJSON_TARRAY);
+        node->children = arrpt_create(JsonNode);
+        while (json_reader_next(reader) != ekJSON_ARRAY_END)
+        {
+            JsonNode *child = i_reader_node(reader);
+            if (child == NULL)
+            {
+                json_node_destroy(&node);
+                return NULL;
+            }
+
+            arrpt_append(node->children, child, JsonNode);
+        }
+        return node;
+
+    case ekJSON_OBJECT_BEGIN:
+        node = i_create_node(ekJSON_TOBJECT);
+        node->children = arrpt_create(JsonNode);
+        while (json_reader_next(reader) != ekJSON_OBJECT_END)
+        {
+            JsonNode *child = NULL;
+            String *key = NULL;
+            if (reader->event == ekJSON_KEY)
+            {
+                key = str_c(reader->parser.lexeme);
+                json_reader_next(reader);
+                child = i_reader_node(reader);
+            }
+
+            if (child == NULL)
+            {
+                str_destopt(&key);
+                json_node_destroy(&node);
+                return NULL;
+            }
+
+            child->hash = i_key_hash(tc(key), str_len(key));
+            child->key = key;
+            arrpt_append(node->children, child, JsonNode);
+        }
+        return node;
+
+    case ekJSON_OBJECT_END:
+    case ekJSON_ARRAY_END:
+    case ekJSON_KEY:
+    case ekJSON_EOF:
+    case ekJSON_ERROR:
+        return NULL;
+    cassert_default();
+    }
+
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+JsonNode *json_reader_node(JsonReader *reader)
+{
+    cassert_no_null(reader);
+    if (reader->event == ekJSON_KEY)
+        json_reader_next(reader);
+    return i_reader_node(reader);
+}
+
+/*---------------------------------------------------------------------------*/
+
+JsonNode *json_read_node(Stream *stm, const JsonOpts *opts)
+{
+    JsonReader *reader = json_reader_create(stm, opts);
+    JsonNode *node = NULL;
+    json_reader_next(reader);
+    node = i_reader_node(reader);
+    json_reader_destroy(&reader);
+    return node;
+}
+
+/*---------------------------------------------------------------------------*/
+
+jsontype_t json_node_type(const JsonNode *node)
+{
+    cassert_no_null(node);
+    return node->type;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t json_node_size(const JsonNode *node)
+{
+    cassert_no_null(node);
+    if (node->children != NULL)
+        return arrpt_size(node->children, JsonNode);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+const JsonNode *json_node_get(const JsonNode *node, const uint32_t index)
+{
+    cassert_no_null(node);
+    cassert_no_null(node->children);
+    return arrpt_get_const(node->children, index, JsonNode);
+}
+
+/*---------------------------------------------------------------------------*/
+
+const char_t *json_node_key(const JsonNode *node, const uint32_t index)
+{
+    const JsonNode *child = json_node_get(node, index);
+    cassert(node->type == ekJSON_TOBJECT);
+    return tc(child->key);
+}
+
+/*---------------------------------------------------------------------------*/
+
+const JsonNode *json_node_member(const JsonNode *node, const char_t *key)
+{
+    uint32_t hash;
+    cassert_no_null(node);
+    cassert(node->type == ekJSON_TOBJECT);
+    hash = i_key_hash(key, str_len_c(key));
+    arrpt_foreach_const(child, node->children, JsonNode)
+        if (child->hash == hash && str_equ(child->key, key) == TRUE)
+            return child;
+    arrpt_end();
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t json_node_bool(const JsonNode *node)
+{
+    cassert_no_null(node);
+    cassert(node->type == ekJSON_TBOOL);
+    return node->value;
+}
+
+/*---------------------------------------------------------------------------*/
+
+real64_t json_node_real64(const JsonNode *node)
+{
+    cassert_no_null(node);
+    cassert(node->type == ekJSON_TNUMBER);
+    return str_to_r64(tc(node->text), NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+
+int64_t json_node_int64(const JsonNode *node)
+{
+    cassert_no_null(node);
+    cassert(node->type == ekJSON_TNUMBER);
+    return str_to_i64(tc(node->text), 10, NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+
+const char_t *json_node_text(const JsonNode *node)
+{
+    cassert_no_null(node);
+    if (node->text != NULL)
+        return tc(node->text);
+    return "";
+}
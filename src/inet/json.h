@@ -23,6 +23,50 @@ void json_destroy_imp(void **data, const char_t *type);
 
 void json_destopt_imp(void **data, const char_t *type);
 
+JsonReader *json_reader_create(Stream *stm, const JsonOpts *opts);
+
+void json_reader_destroy(JsonReader **reader);
+
+jsonev_t json_reader_next(JsonReader *reader);
+
+jsonev_t json_reader_event(const JsonReader *reader);
+
+uint32_t json_reader_depth(const JsonReader *reader);
+
+const char_t *json_reader_text(const JsonReader *reader, uint32_t *size);
+
+bool_t json_reader_bool(const JsonReader *reader);
+
+real64_t json_reader_real64(const JsonReader *reader);
+
+int64_t json_reader_int64(const JsonReader *reader);
+
+bool_t json_reader_skip(JsonReader *reader);
+
+JsonNode *json_reader_node(JsonReader *reader);
+
+JsonNode *json_read_node(Stream *stm, const JsonOpts *opts);
+
+void json_node_destroy(JsonNode **node);
+
+jsontype_t json_node_type(const JsonNode *node);
+
+uint32_t json_node_size(const JsonNode *node);
+
+const JsonNode *json_node_get(const JsonNode *node, const uint32_t index);
+
+const char_t *json_node_key(const JsonNode *node, const uint32_t index);
+
+const JsonNode *json_node_member(const JsonNode *node, const char_t *key);
+
+bool_t json_node_bool(const JsonNode *node);
+
+real64_t json_node_real64(const JsonNode *node);
+
+int64_t json_node_int64(const JsonNode *node);
+
+const char_t *json_node_text(const JsonNode *node);
+
 __END_C
 
 #define json_read(stm, opts, type)\
@@ -31,9 +31,15 @@ struct _oshttp_t
     bool_t secure;
     Stream *resp_headers;
     Stream *resp_data;
+    Stream *body;
     ierror_t error;
 };
 
+struct _oshttpmulti_t
+{
+    CURLM *multi;
+};
+
 /*---------------------------------------------------------------------------*/
 
 void oshttp_init(void)
@@ -59,6 +65,7 @@ OSHttp *oshttp_create(const char_t *host, const uint16_t port, const bool_t secu
     http->headers = NULL;
     http->resp_headers = NULL;
     http->resp_data = NULL;
+    http->body = NULL;
 
     if (secure == TRUE)
         http->host_url = str_printf("https://%s", host);
@@ -130,16 +137,27 @@ void oshttp_add_header(OSHttp *http, const char_t *name, const char_t *value)
 
 /*---------------------------------------------------------------------------*/
 
+void oshttp_body_stream(OSHttp *http, Stream *body)
+{
+    cassert_no_null(http);
+    http->body = body;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static size_t i_write_response(char *buffer, size_t size, size_t nitems, void *userdata)
 {
     Stream *stm = (Stream*)userdata;
     stm_write(stm, (const byte_t*)buffer, (uint32_t)(size * nitems));
+    /* Returning less than the block size makes curl abort with CURLE_WRITE_ERROR */
+    if (stm_state(stm) != ekSTOK)
+        return 0;
     return nitems * size;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void i_request(OSHttp *http, const bool_t use_get, const char_t *path, const byte_t *data, const uint32_t size, const bool_t auto_redirect, ierror_t *error)
+static bool_t i_setup(OSHttp *http, const bool_t use_get, const char_t *path, const byte_t *data, const uint32_t size, const bool_t auto_redirect, ierror_t *error)
 {
     int res = 0;
     cassert_no_null(http);
@@ -147,7 +165,7 @@ static void i_request(OSHttp *http, const bool_t use_get, const char_t *path, co
     if (http->error != ekIOK)
     {
         ptr_assign(error, http->error);
-        return;
+        return FALSE;
     }
 
     // Seems that CURLOPT_FOLLOWLOCATION fails
@@ -193,7 +211,10 @@ static void i_request(OSHttp *http, const bool_t use_get, const char_t *path, co
         stm_close(&http->resp_data);
 
     http->resp_headers = stm_memory(100 * 1024);
-    http->resp_data = stm_memory(1024 * 1024);
+
+    /* The caller stream receives the body as it arrives, without buffering */
+    if (http->body == NULL)
+        http->resp_data = stm_memory(1024 * 1024);
 
     res = curl_easy_setopt(http->curl, CURLOPT_HEADERFUNCTION, i_write_response);
     cassert(res == CURLE_OK);
@@ -202,18 +223,59 @@ static void i_request(OSHttp *http, const bool_t use_get, const char_t *path, co
 
     res = curl_easy_setopt(http->curl, CURLOPT_WRITEFUNCTION, i_write_response);
     cassert(res == CURLE_OK);
-    res = curl_easy_setopt(http->curl, CURLOPT_WRITEDATA, http->resp_data);
+    res = curl_easy_setopt(http->curl, CURLOPT_WRITEDATA, http->body != NULL ? http->body : http->resp_data);
     cassert(res == CURLE_OK);
+    return TRUE;
+}
 
-    res = curl_easy_perform(http->curl);
-	if (res == CURLE_OK)
-    {
-        ptr_assign(error, ekIOK);
+/*---------------------------------------------------------------------------*/
+
+static ierror_t i_curl_error(const CURLcode code)
+{
+    switch (code) {
+    case CURLE_OK:
+        return ekIOK;
+    case CURLE_COULDNT_RESOLVE_PROXY:
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+        return ekINOHOST;
+    case CURLE_OPERATION_TIMEDOUT:
+        return ekITIMEOUT;
+    /* Callbacks (body stream) or connection broken in the middle of the transfer */
+    case CURLE_WRITE_ERROR:
+    case CURLE_READ_ERROR:
+    case CURLE_ABORTED_BY_CALLBACK:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_PARTIAL_FILE:
+        return ekISTREAM;
+    /* The server answered, but not as expected */
+    case CURLE_GOT_NOTHING:
+    case CURLE_HTTP_RETURNED_ERROR:
+    case CURLE_TOO_MANY_REDIRECTS:
+    case CURLE_SSL_CONNECT_ERROR:
+    case CURLE_PEER_FAILED_VERIFICATION:
+    case CURLE_BAD_CONTENT_ENCODING:
+#if LIBCURL_VERSION_NUM >= 0x073300
+    case CURLE_WEIRD_SERVER_REPLY:
+#endif
+        return ekISERVER;
+    case CURLE_UNSUPPORTED_PROTOCOL:
+    case CURLE_NOT_BUILT_IN:
+        return ekINOIMPL;
+    default:
+        return ekIUNDEF;
     }
-    else
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_request(OSHttp *http, const bool_t use_get, const char_t *path, const byte_t *data, const uint32_t size, const bool_t auto_redirect, ierror_t *error)
+{
+    if (i_setup(http, use_get, path, data, size, auto_redirect, error) == TRUE)
     {
-        // TODO: Error codes
-        ptr_assign(error, ekISERVER);
+        CURLcode res = curl_easy_perform(http->curl);
+        ptr_assign(error, i_curl_error(res));
     }
 }
 
@@ -246,13 +308,122 @@ Stream *oshttp_response(OSHttp *http)
 
 void oshttp_response_body(OSHttp *http, Stream *body, ierror_t *error)
 {
-    const byte_t *data = NULL;
-    uint32_t size = 0;
     cassert_no_null(http);
-    data = stm_buffer(http->resp_data);
-    size = stm_buffer_size(http->resp_data);
-    stm_write(body, data, size);
-    stm_close(&http->resp_data);
+    if (http->resp_data != NULL)
+    {
+        const byte_t *data = stm_buffer(http->resp_data);
+        uint32_t size = stm_buffer_size(http->resp_data);
+        stm_write(body, data, size);
+        stm_close(&http->resp_data);
+    }
+
     ptr_assign(error, ekIOK);
 }
 
+/*---------------------------------------------------------------------------*/
+
+OSHttpMulti *oshttp_multi_create(const uint32_t max_host_connections)
+{
+    OSHttpMulti *multi = heap_new(OSHttpMulti);
+    CURLMcode res;
+    multi->multi = curl_multi_init();
+    cassert_no_null(multi->multi);
+    /* Finished connections are kept alive and reused by later requests to the same host */
+    res = curl_multi_setopt(multi->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)max_host_connections);
+    cassert_unref(res == CURLM_OK, res);
+    res = curl_multi_setopt(multi->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    cassert(res == CURLM_OK);
+    return multi;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void oshttp_multi_destroy(OSHttpMulti **multi)
+{
+    cassert_no_null(multi);
+    cassert_no_null(*multi);
+    curl_multi_cleanup((*multi)->multi);
+    heap_delete(multi, OSHttpMulti);
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t oshttp_multi_add(OSHttpMulti *multi, OSHttp *http, const bool_t use_get, const char_t *path, const byte_t *data, const uint32_t size, ierror_t *error)
+{
+    cassert_no_null(multi);
+    cassert_no_null(http);
+    if (i_setup(http, use_get, path, data, size, TRUE, error) == TRUE)
+    {
+        CURLcode res = curl_easy_setopt(http->curl, CURLOPT_PRIVATE, http);
+        cassert_unref(res == CURLE_OK, res);
+        if (curl_multi_add_handle(multi->multi, http->curl) == CURLM_OK)
+        {
+            ptr_assign(error, ekIOK);
+            return TRUE;
+        }
+
+        ptr_assign(error, ekIUNDEF);
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void oshttp_multi_remove(OSHttpMulti *multi, OSHttp *http)
+{
+    CURLMcode res;
+    cassert_no_null(multi);
+    cassert_no_null(http);
+    res = curl_multi_remove_handle(multi->multi, http->curl);
+    cassert_unref(res == CURLM_OK, res);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t oshttp_multi_perform(OSHttpMulti *multi, const uint32_t timeout_ms)
+{
+    int running = 0;
+    CURLMcode res;
+    cassert_no_null(multi);
+    res = curl_multi_perform(multi->multi, &running);
+    cassert_unref(res == CURLM_OK, res);
+    if (running > 0 && timeout_ms > 0)
+    {
+        /* curl_multi_poll needs libcurl 7.66. curl_multi_wait returns at once without sockets */
+#if LIBCURL_VERSION_NUM >= 0x074200
+        res = curl_multi_poll(multi->multi, NULL, 0, (int)timeout_ms, NULL);
+#else
+        res = curl_multi_wait(multi->multi, NULL, 0, (int)timeout_ms, NULL);
+#endif
+        cassert(res == CURLM_OK);
+        res = curl_multi_perform(multi->multi, &running);
+        cassert(res == CURLM_OK);
+    }
+
+    return (uint32_t)running;
+}
+
+/*---------------------------------------------------------------------------*/
+
+OSHttp *oshttp_multi_done(OSHttpMulti *multi, ierror_t *error)
+{
+    int pending = 0;
+    CURLMsg *msg = NULL;
+    cassert_no_null(multi);
+    while ((msg = curl_multi_info_read(multi->multi, &pending)) != NULL)
+    {
+        if (msg->msg == CURLMSG_DONE)
+        {
+            OSHttp *http = NULL;
+            CURLcode res = curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&http);
+            cassert_unref(res == CURLE_OK, res);
+            cassert_no_null(http);
+            ptr_assign(error, i_curl_error(msg->data.result));
+            oshttp_multi_remove(multi, http);
+            return http;
+        }
+    }
+
+    return NULL;
+}
@@ -26,6 +26,8 @@ void oshttp_clear_headers(OSHttp *http);
 
 void oshttp_add_header(OSHttp *http, const char_t *name, const char_t *value);
 
+void oshttp_body_stream(OSHttp *http, Stream *body);
+
 void oshttp_get(OSHttp *http, const char_t *path, const byte_t *data, const uint32_t size, const bool_t auto_redirect, ierror_t *error);
 
 void oshttp_post(OSHttp *http, const char_t *path, const byte_t *data, const uint32_t size, const bool_t auto_redirect, ierror_t *error);
@@ -34,5 +36,17 @@ Stream *oshttp_response(OSHttp *http);
 
 void oshttp_response_body(OSHttp *http, Stream *body, ierror_t *error);
 
+OSHttpMulti *oshttp_multi_create(const uint32_t max_host_connections);
+
+void oshttp_multi_destroy(OSHttpMulti **multi);
+
+bool_t oshttp_multi_add(OSHttpMulti *multi, OSHttp *http, const bool_t use_get, const char_t *path, const byte_t *data, const uint32_t size, ierror_t *error);
+
+void oshttp_multi_remove(OSHttpMulti *multi, OSHttp *http);
+
+uint32_t oshttp_multi_perform(OSHttpMulti *multi, const uint32_t timeout_ms);
+
+OSHttp *oshttp_multi_done(OSHttpMulti *multi, ierror_t *error);
+
 __END_C
 
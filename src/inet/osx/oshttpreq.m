@@ -62,6 +62,7 @@ struct _oshttp_t
     String *protocol;
     Stream *headers;
     Stream *body;
+    Stream *sink;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -152,6 +153,7 @@ OSHttp *oshttp_create(const char_t *host, const uint16_t port, const bool_t secu
     http->protocol = NULL;
     http->headers = NULL;
     http->body = NULL;
+    http->sink = NULL;
     return http;
 }
 
@@ -183,6 +185,14 @@ void oshttp_destroy(OSHttp **http)
 
 /*---------------------------------------------------------------------------*/
 
+void oshttp_body_stream(OSHttp *http, Stream *body)
+{
+    cassert_no_null(http);
+    http->sink = body;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static __INLINE bool_t i_reserved_header(const char_t *header)
 {
     if (str_equ_nocase(header, "content-length") == TRUE)
@@ -331,9 +341,18 @@ static void i_response(NSData *data, NSURLResponse *response, NSError *error, OS
             stm_write_char(http->headers, 10);
         }
         
-        http->body = stm_memory(dsize + 32);
-        stm_write(http->body, dbytes, dsize);
-        http->error = ekIOK;
+        /* NSURLSession delivers the whole body, it is written to the caller stream without extra copy */
+        if (http->sink != NULL)
+        {
+            stm_write(http->sink, dbytes, dsize);
+            http->error = stm_state(http->sink) == ekSTOK ? ekIOK : ekISTREAM;
+        }
+        else
+        {
+            http->body = stm_memory(dsize + 32);
+            stm_write(http->body, dbytes, dsize);
+            http->error = ekIOK;
+        }
         http->response = TRUE;
     }
     else
@@ -445,7 +464,7 @@ void oshttp_response_body(OSHttp *http, Stream *body, ierror_t *error)
     cassert_no_null(http);
 	cassert(http->response == TRUE);
 
-    if (http->error == ekIOK)
+    if (http->error == ekIOK && http->body != NULL)
     {
         uint32_t size = stm_buffer_size(http->body);
         stm_pipe(http->body, body, size);
@@ -454,3 +473,93 @@ void oshttp_response_body(OSHttp *http, Stream *body, ierror_t *error)
 	ptr_assign(error, http->error);
 }
 
+/*---------------------------------------------------------------------------*/
+
+/* NSURLSession has no multi interface: requests run synchronously when added */
+typedef struct _done_t i_Done;
+
+struct _done_t
+{
+    OSHttp *http;
+    ierror_t error;
+};
+
+DeclSt(i_Done);
+
+struct _oshttpmulti_t
+{
+    ArrSt(i_Done) *done;
+};
+
+/*---------------------------------------------------------------------------*/
+
+OSHttpMulti *oshttp_multi_create(const uint32_t max_host_connections)
+{
+    OSHttpMulti *multi = heap_new(OSHttpMulti);
+    multi->done = arrst_create(i_Done);
+    unref(max_host_connections);
+    return multi;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void oshttp_multi_destroy(OSHttpMulti **multi)
+{
+    cassert_no_null(multi);
+    cassert_no_null(*multi);
+    arrst_destroy(&(*multi)->done, NULL, i_Done);
+    heap_delete(multi, OSHttpMulti);
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t oshttp_multi_add(OSHttpMulti *multi, OSHttp *http, const bool_t use_get, const char_t *path, const byte_t *data, const uint32_t size, ierror_t *error)
+{
+    i_Done *done = NULL;
+    cassert_no_null(multi);
+    done = arrst_new(multi->done, i_Done);
+    done->http = http;
+    i_request(http, use_get == TRUE ? @"GET" : @"POST", path, data, size, TRUE, &done->error);
+    ptr_assign(error, ekIOK);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void oshttp_multi_remove(OSHttpMulti *multi, OSHttp *http)
+{
+    cassert_no_null(multi);
+    arrst_foreach(done, multi->done, i_Done)
+        if (done->http == http)
+        {
+            arrst_delete(multi->done, done_i, NULL, i_Done);
+            break;
+        }
+    arrst_end();
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t oshttp_multi_perform(OSHttpMulti *multi, const uint32_t timeout_ms)
+{
+    unref(multi);
+    unref(timeout_ms);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+OSHttp *oshttp_multi_done(OSHttpMulti *multi, ierror_t *error)
+{
+    cassert_no_null(multi);
+    if (arrst_size(multi->done, i_Done) > 0)
+    {
+        i_Done *done = arrst_get(multi->done, 0, i_Done);
+        OSHttp *http = done->http;
+        ptr_assign(error, done->error);
+        arrst_delete(multi->done, 0, NULL, i_Done);
+        return http;
+    }
+
+    return NULL;
+}
@@ -38,6 +38,7 @@ struct _oshttp_t
     ierror_t error;
     bool_t secure;
     Stream *headers;
+    Stream *body;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -128,6 +129,47 @@ void oshttp_add_header(OSHttp *http, const char_t *name, const char_t *value)
 
 /*---------------------------------------------------------------------------*/
 
+void oshttp_body_stream(OSHttp *http, Stream *body)
+{
+    cassert_no_null(http);
+    http->body = body;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_read_body(OSHttp *http, Stream *body, ierror_t *error)
+{
+    cassert_no_null(http);
+    if (http->hRequest != NULL)
+    {
+        char szBuffer[1024];
+        DWORD dwByteRead = 0;
+
+        do
+        {
+        	if (InternetReadFile(http->hRequest, szBuffer, sizeof(szBuffer), &dwByteRead) == TRUE)
+            {
+                stm_write(body, (const byte_t*)szBuffer, (uint32_t)dwByteRead);
+                if (stm_state(body) != ekSTOK)
+                {
+                    ptr_assign(error, ekISTREAM);
+                    return;
+                }
+            }
+            else
+            {
+                ptr_assign(error, ekISTREAM);
+                return;
+            }
+
+        } while (dwByteRead);
+    }
+
+    ptr_assign(error, ekIOK);
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void i_request(OSHttp *http, const WCHAR *verb, const char_t *path, const byte_t *data, const uint32_t size, const bool_t auto_redirect, ierror_t *error)
 {
     WCHAR wpath[1024];
@@ -173,7 +215,10 @@ static void i_request(OSHttp *http, const WCHAR *verb, const char_t *path, const
 
 	if (status == TRUE)
     {
-        ptr_assign(error, ekIOK);
+        if (http->body != NULL)
+            i_read_body(http, http->body, error);
+        else
+            ptr_assign(error, ekIOK);
     }
     else
     {
@@ -251,27 +296,96 @@ Stream *oshttp_response(OSHttp *http)
 
 void oshttp_response_body(OSHttp *http, Stream *body, ierror_t *error)
 {
-    cassert_no_null(http);
-    if (http->hRequest != NULL)
-    {
-        char szBuffer[1024];
-        DWORD dwByteRead = 0;
+    i_read_body(http, body, error);
+}
 
-        do
-        {
-        	if (InternetReadFile(http->hRequest, szBuffer, sizeof(szBuffer), &dwByteRead) == TRUE)
-            {
-                stm_write(body, (const byte_t*)szBuffer, (uint32_t)dwByteRead);
-            }
-            else
-            {
-                ptr_assign(error, ekISTREAM);
-                return;
-            }
+/*---------------------------------------------------------------------------*/
 
-        } while (dwByteRead);
-    }
+/* WinINet has no multi interface: requests run synchronously when added */
+typedef struct _done_t i_Done;
+
+struct _done_t
+{
+    OSHttp *http;
+    ierror_t error;
+};
+
+DeclSt(i_Done);
+
+struct _oshttpmulti_t
+{
+    ArrSt(i_Done) *done;
+};
+
+/*---------------------------------------------------------------------------*/
+
+OSHttpMulti *oshttp_multi_create(const uint32_t max_host_connections)
+{
+    OSHttpMulti *multi = heap_new(OSHttpMulti);
+    multi->done = arrst_create(i_Done);
+    unref(max_host_connections);
+    return multi;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void oshttp_multi_destroy(OSHttpMulti **multi)
+{
+    cassert_no_null(multi);
+    cassert_no_null(*multi);
+    arrst_destroy(&(*multi)->done, NULL, i_Done);
+    heap_delete(multi, OSHttpMulti);
+}
+
+/*---------------------------------------------------------------------------*/
 
+bool_t oshttp_multi_add(OSHttpMulti *multi, OSHttp *http, const bool_t use_get, const char_t *path, const byte_t *data, const uint32_t size, ierror_t *error)
+{
+    i_Done *done = NULL;
+    cassert_no_null(multi);
+    done = arrst_new(multi->done, i_Done);
+    done->http = http;
+    i_request(http, use_get == TRUE ? L"GET" : L"POST", path, data, size, TRUE, &done->error);
     ptr_assign(error, ekIOK);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void oshttp_multi_remove(OSHttpMulti *multi, OSHttp *http)
+{
+    cassert_no_null(multi);
+    arrst_foreach(done, multi->done, i_Done)
+        if (done->http == http)
+        {
+            arrst_delete(multi->done, done_i, NULL, i_Done);
+            break;
+        }
+    arrst_end();
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t oshttp_multi_perform(OSHttpMulti *multi, const uint32_t timeout_ms)
+{
+    unref(multi);
+    unref(timeout_ms);
+    return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+
+OSHttp *oshttp_multi_done(OSHttpMulti *multi, ierror_t *error)
+{
+    cassert_no_null(multi);
+    if (arrst_size(multi->done, i_Done) > 0)
+    {
+        i_Done *done = arrst_get(multi->done, 0, i_Done);
+        OSHttp *http = done->http;
+        ptr_assign(error, done->error);
+        arrst_delete(multi->done, 0, NULL, i_Done);
+        return http;
+    }
+
+    return NULL;
+}
@@ -18,7 +18,8 @@
 
 #include "arrpt.h"
 #include "bfile.h"
-#include "bthread.h"
+#include "bmutex.h"
+#include "bpool.h"
 #include "bstd.h"
 #include "core.h"
 #include "cassert.h"
@@ -63,7 +64,7 @@ typedef enum _task_state_t
 struct i_task_t
 {
     OSApp *osapp;
-    Thread *thread;
+    Mutex *mutex;
     void *data;
     real64_t updtime;
     real64_t lastupd;
@@ -71,6 +72,7 @@ struct i_task_t
     FPtr_task_update func_update;
     FPtr_task_end func_end;
     tstate_t state;
+    uint32_t rvalue;
 };
 
 struct i_app_t
@@ -89,6 +91,8 @@ struct i_app_t
     FPtr_call func_async_call;
     String *locale;
     ArrPt(i_Task) *scheduler;
+    Pool *pool;
+    Mutex *mutex;
 };
 
 DeclSt(i_Task);
@@ -100,7 +104,6 @@ static void i_destroy_task(i_Task **task)
 {
     cassert_no_null(task);
     cassert_no_null(*task);
-    bthread_close(&(*task)->thread);
     heap_delete(task, i_Task);
 }
 
@@ -122,6 +125,8 @@ static void i_destroy_app(i_App **app)
     ptr_destopt(clock_destroy, &(*app)->clock, Clock);
     ptr_destopt(clock_destroy, &(*app)->app_clock, Clock);
     str_destroy(&(*app)->locale);
+    ptr_destopt(bpool_destroy, &(*app)->pool, Pool);
+    bmutex_close(&(*app)->mutex);
     arrpt_destroy(&(*app)->scheduler, i_destroy_task, i_Task);
     gui_context_destroy(&(*app)->native_gui);
     obj_delete(app, i_App);
@@ -151,38 +156,58 @@ static void i_terminate(const bool_t abnormal_terminate)
 
 /*---------------------------------------------------------------------------*/
 
-// This function will run in a secondary thread
+// This function will run in a pool thread
 // It should not call GUI functions
+// The task can be deleted by the main thread as soon as it is marked as FINISH
 static uint32_t i_dispatch_task(i_Task *task)
 {
     uint32_t rvalue = UINT32_MAX;
     void *data;
     cassert_no_null(task);
-    cassert(task->state == i_ekSTATE_WAITING);
-    task->state = i_ekSTATE_RUNNING;
     data = osapp_begin_thread(task->osapp);
     cassert_no_nullf(task->func_main);
     rvalue = task->func_main(task->data);
-    task->state = i_ekSTATE_FINISH;
     osapp_end_thread(task->osapp, data);
+    bmutex_lock(task->mutex);
+    cassert(task->state == i_ekSTATE_RUNNING);
+    task->rvalue = rvalue;
+    task->state = i_ekSTATE_FINISH;
+    bmutex_unlock(task->mutex);
     return rvalue;
 }
 
 /*---------------------------------------------------------------------------*/
 
+static tstate_t i_task_state(const i_Task *task)
+{
+    tstate_t state;
+    cassert_no_null(task);
+    bmutex_lock(task->mutex);
+    state = task->state;
+    bmutex_unlock(task->mutex);
+    return state;
+}
+
+/*---------------------------------------------------------------------------*/
+
 // This function runs in the MAIN thread
-static void i_scheduler_cycle(ArrPt(i_Task) *scheduler, const real64_t crtime)
+static void i_scheduler_cycle(i_App *app, const real64_t crtime)
 {
     i_Task *deleted_task = NULL;
+    cassert_no_null(app);
 
-    arrpt_foreach(task, scheduler, i_Task)
-        if (task->state == i_ekSTATE_WAITING)
+    arrpt_foreach(task, app->scheduler, i_Task)
+        tstate_t state = i_task_state(task);
+        if (state == i_ekSTATE_WAITING)
         {
-            cassert(task->thread == NULL);
-            task->thread = bthread_create(i_dispatch_task, task, i_Task);
+            if (app->pool == NULL)
+                app->pool = bpool_create(0);
+
+            task->state = i_ekSTATE_RUNNING;
             task->lastupd = crtime;
+            bpool_add(app->pool, i_dispatch_task, task, i_Task);
         }
-        else if (task->state == i_ekSTATE_RUNNING)
+        else if (state == i_ekSTATE_RUNNING)
         {
             if (task->func_update != NULL)
             {
@@ -193,13 +218,12 @@ static void i_scheduler_cycle(ArrPt(i_Task) *scheduler, const real64_t crtime)
                 }
             }
         }
-        else if (task->state == i_ekSTATE_FINISH)
+        else if (state == i_ekSTATE_FINISH)
         {
             if (deleted_task == NULL)
             {
-                uint32_t rvalue = bthread_wait(task->thread);
                 if (task->func_end != NULL)
-                    task->func_end(task->data, rvalue);
+                    task->func_end(task->data, task->rvalue);
                 deleted_task = task;
             }
         }
@@ -207,8 +231,8 @@ static void i_scheduler_cycle(ArrPt(i_Task) *scheduler, const real64_t crtime)
 
     if (deleted_task != NULL)
     {
-        uint32_t index = arrpt_find(scheduler, deleted_task, i_Task);
-        arrpt_delete(scheduler, index, i_destroy_task, i_Task);
+        uint32_t index = arrpt_find(app->scheduler, deleted_task, i_Task);
+        arrpt_delete(app->scheduler, index, i_destroy_task, i_Task);
     }
 }
 
@@ -222,7 +246,7 @@ static void i_OnTimerSignal(i_App *app)
     {
         if (app->state == i_ekSTATE_RUNNING)
         {
-            i_scheduler_cycle(app->scheduler, crtime);
+            i_scheduler_cycle(app, crtime);
             gui_update_transitions(prtime, crtime);
 
             if (app->func_update != NULL)
@@ -349,6 +373,8 @@ void osmain_imp(
     app->func_async_call = NULL;
     app->locale = str_c("");
     app->scheduler = arrpt_create(i_Task);
+    app->pool = NULL;
+    app->mutex = bmutex_create();
     gui_context_set_current(app->native_gui);
 
     osapp_OnThemeChanged(app->osapp, listener(NULL, i_OnTheme, void));
@@ -376,7 +402,7 @@ void osapp_task_imp(void *data, const real32_t updtime, FPtr_task_main func_task
     i_Task *task = heap_new0(i_Task);
     cassert_no_null(app);
     task->osapp = app->osapp;
-    task->thread = NULL;
+    task->mutex = app->mutex;
     task->data = data;
     task->updtime = updtime <= 0 && func_task_update ? .04 : updtime;
     task->lastupd = 0.;
@@ -384,6 +410,7 @@ void osapp_task_imp(void *data, const real32_t updtime, FPtr_task_main func_task
     task->func_update = func_task_update;
     task->func_end = func_task_end;
     task->state = i_ekSTATE_WAITING;
+    task->rvalue = UINT32_MAX;
     arrpt_append(app->scheduler, task, i_Task);
 }
 
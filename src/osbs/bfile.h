@@ -49,6 +49,10 @@ bool_t bfile_read(File *file, byte_t *data, const uint32_t size, uint32_t *rsize
 
 bool_t bfile_write(File *file, const byte_t *data, const uint32_t size, uint32_t *wsize, ferror_t *error);
 
+const byte_t *bfile_mmap(const char_t *pathname, uint32_t *size, ferror_t *error);
+
+void bfile_munmap(const byte_t **data, const uint32_t size);
+
 bool_t bfile_delete(const char_t *pathname, ferror_t *error);
 
 __END_C
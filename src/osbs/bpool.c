@@ -0,0 +1,426 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: bpool.c
+ *
+ */
+
+/* Fixed-size thread pool */
+
+#include "bpool.h"
+#include "bthread.h"
+#include "osbs.h"
+#include "osbs.inl"
+#include "bmem.h"
+#include "cassert.h"
+
+/*
+ * Jobs are stored in a bounded multi-producer/multi-consumer ring.
+ * Each cell carries a sequence number that tells producers and consumers
+ * whether the cell is free or filled for the current lap, so enqueue and
+ * dequeue only need a CAS on their own cursor. Idle workers block on a
+ * semaphore that is posted once per added job. Threads that can't go on
+ * (full queue, parallel-for waiting for its helpers) run queued jobs
+ * meanwhile, so they never block a pool whose workers are doing the same.
+ */
+
+#define i_QUEUE_SIZE    4096
+#define i_QUEUE_MASK    (i_QUEUE_SIZE - 1)
+#define i_CACHE_LINE    64
+#define i_MAX_THREADS   64
+#define i_MAX_CHUNKS    0xFFFF
+#define i_SPAN(lo, hi)  (((hi) << 16) | (lo))
+#define i_LO(span)      ((span) & 0xFFFF)
+#define i_HI(span)      ((span) >> 16)
+
+typedef struct _cell_t i_Cell;
+typedef struct _slot_t i_Slot;
+typedef struct _pfor_t i_PFor;
+typedef struct _pjob_t i_PJob;
+
+struct _cell_t
+{
+    volatile uint32_t seq;
+    FPtr_thread_main func;
+    void *data;
+};
+
+struct _pool_t
+{
+    volatile uint32_t enqueue;
+    byte_t pad0[i_CACHE_LINE - sizeof(uint32_t)];
+    volatile uint32_t dequeue;
+    byte_t pad1[i_CACHE_LINE - sizeof(uint32_t)];
+    volatile uint32_t shutdown;
+    uint32_t nthreads;
+    Semaphore *sem;
+    Thread *threads[i_MAX_THREADS];
+    i_Cell cells[i_QUEUE_SIZE];
+};
+
+/*
+ * Parallel-for splits the range in chunks of 'grain' iterations. Each
+ * participant owns a span of chunks [lo, hi) packed in a 32 bits word.
+ * The owner takes chunks from 'lo'; idle participants steal the upper
+ * half of the largest span. Both operations are a single CAS.
+ */
+struct _slot_t
+{
+    volatile uint32_t span;
+    byte_t pad[i_CACHE_LINE - sizeof(uint32_t)];
+};
+
+struct _pfor_t
+{
+    FPtr_parallel_for func;
+    void *data;
+    uint32_t range;
+    uint32_t grain;
+    uint32_t nslots;
+    volatile uint32_t done;
+    Semaphore *sem;
+    i_Slot slots[i_MAX_THREADS + 1];
+};
+
+struct _pjob_t
+{
+    i_PFor *pfor;
+    uint32_t slot;
+};
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_enqueue(Pool *pool, FPtr_thread_main func, void *data)
+{
+    uint32_t pos = _osbs_atomic_load(&pool->enqueue);
+    i_Cell *cell = NULL;
+
+    for (;;)
+    {
+        int32_t dif;
+        cell = &pool->cells[pos & i_QUEUE_MASK];
+        dif = (int32_t)(_osbs_atomic_load(&cell->seq) - pos);
+        if (dif == 0)
+        {
+            if (_osbs_atomic_cas(&pool->enqueue, pos, pos + 1) == TRUE)
+                break;
+            pos = _osbs_atomic_load(&pool->enqueue);
+        }
+        else if (dif < 0)
+        {
+            /* Queue full */
+            return FALSE;
+        }
+        else
+        {
+            pos = _osbs_atomic_load(&pool->enqueue);
+        }
+    }
+
+    cell->func = func;
+    cell->data = data;
+    _osbs_atomic_store(&cell->seq, pos + 1);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_dequeue(Pool *pool, FPtr_thread_main *func, void **data)
+{
+    uint32_t pos = _osbs_atomic_load(&pool->dequeue);
+    i_Cell *cell = NULL;
+
+    for (;;)
+    {
+        int32_t dif;
+        cell = &pool->cells[pos & i_QUEUE_MASK];
+        dif = (int32_t)(_osbs_atomic_load(&cell->seq) - (pos + 1));
+        if (dif == 0)
+        {
+            if (_osbs_atomic_cas(&pool->dequeue, pos, pos + 1) == TRUE)
+                break;
+            pos = _osbs_atomic_load(&pool->dequeue);
+        }
+        else if (dif < 0)
+        {
+            /* Queue empty */
+            return FALSE;
+        }
+        else
+        {
+            pos = _osbs_atomic_load(&pool->dequeue);
+        }
+    }
+
+    *func = cell->func;
+    *data = cell->data;
+    _osbs_atomic_store(&cell->seq, pos + i_QUEUE_SIZE);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_worker(Pool *pool)
+{
+    cassert_no_null(pool);
+    for (;;)
+    {
+        FPtr_thread_main func = NULL;
+        void *data = NULL;
+        if (i_dequeue(pool, &func, &data) == TRUE)
+        {
+            func(data);
+        }
+        else
+        {
+            if (_osbs_atomic_load(&pool->shutdown) == 1)
+                break;
+            _osbs_sem_wait(pool->sem);
+        }
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+Pool *bpool_create(const uint32_t nthreads)
+{
+    Pool *pool = (Pool*)bmem_aligned_malloc(sizeof(Pool), i_CACHE_LINE);
+    uint32_t i;
+    bmem_zero(pool, Pool);
+    pool->nthreads = nthreads > 0 ? nthreads : osbs_num_cores();
+    if (pool->nthreads > i_MAX_THREADS)
+        pool->nthreads = i_MAX_THREADS;
+    pool->sem = _osbs_sem_create();
+
+    for (i = 0; i < i_QUEUE_SIZE; ++i)
+        pool->cells[i].seq = i;
+
+    for (i = 0; i < pool->nthreads; ++i)
+        pool->threads[i] = bthread_create(i_worker, pool, Pool);
+
+    return pool;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bpool_destroy(Pool **pool)
+{
+    uint32_t i;
+    cassert_no_null(pool);
+    cassert_no_null(*pool);
+
+    /* Workers drain the pending jobs before leaving */
+    _osbs_atomic_store(&(*pool)->shutdown, 1);
+    _osbs_sem_post((*pool)->sem, (*pool)->nthreads);
+
+    for (i = 0; i < (*pool)->nthreads; ++i)
+    {
+        bthread_wait((*pool)->threads[i]);
+        bthread_close(&(*pool)->threads[i]);
+    }
+
+    _osbs_sem_destroy(&(*pool)->sem);
+    bmem_free((byte_t*)*pool);
+    *pool = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t bpool_nthreads(const Pool *pool)
+{
+    cassert_no_null(pool);
+    return pool->nthreads;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bpool_add_imp(Pool *pool, FPtr_thread_main func, void *data)
+{
+    cassert_no_null(pool);
+    cassert_no_nullf(func);
+    cassert(_osbs_atomic_load(&pool->shutdown) == 0);
+
+    /* Back-pressure: the caller runs queued jobs until a cell is free.
+       A full queue is never empty, unless a worker is releasing a cell right now */
+    while (i_enqueue(pool, func, data) == FALSE)
+    {
+        FPtr_thread_main qfunc = NULL;
+        void *qdata = NULL;
+        if (i_dequeue(pool, &qfunc, &qdata) == TRUE)
+            qfunc(qdata);
+    }
+
+    _osbs_sem_post(pool->sem, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_pop(i_PFor *pfor, const uint32_t slot, uint32_t *chunk)
+{
+    volatile uint32_t *span = &pfor->slots[slot].span;
+    for (;;)
+    {
+        uint32_t cur = _osbs_atomic_load(span);
+        uint32_t lo = i_LO(cur), hi = i_HI(cur);
+        if (lo >= hi)
+            return FALSE;
+
+        if (_osbs_atomic_cas(span, cur, i_SPAN(lo + 1, hi)) == TRUE)
+        {
+            *chunk = lo;
+            return TRUE;
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_steal(i_PFor *pfor, const uint32_t slot)
+{
+    for (;;)
+    {
+        uint32_t victim = UINT32_MAX, cur = 0, size = 0;
+        uint32_t i;
+
+        for (i = 0; i < pfor->nslots; ++i)
+        {
+            if (i != slot)
+            {
+                uint32_t span = _osbs_atomic_load(&pfor->slots[i].span);
+                uint32_t lo = i_LO(span), hi = i_HI(span);
+                if (hi > lo && hi - lo > size)
+                {
+                    victim = i;
+                    cur = span;
+                    size = hi - lo;
+                }
+            }
+        }
+
+        if (victim == UINT32_MAX)
+            return FALSE;
+
+        {
+            uint32_t hi = i_HI(cur);
+            uint32_t mid = hi - (size + 1) / 2;
+            if (_osbs_atomic_cas(&pfor->slots[victim].span, cur, i_SPAN(i_LO(cur), mid)) == TRUE)
+            {
+                /* Our own span is empty, nobody else can modify it */
+                _osbs_atomic_store(&pfor->slots[slot].span, i_SPAN(mid, hi));
+                return TRUE;
+            }
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_participate(i_PFor *pfor, const uint32_t slot)
+{
+    do
+    {
+        uint32_t chunk;
+        while (i_pop(pfor, slot, &chunk) == TRUE)
+        {
+            uint32_t st = chunk * pfor->grain;
+            uint32_t ed = st + pfor->grain;
+            if (ed > pfor->range)
+                ed = pfor->range;
+            pfor->func(pfor->data, st, ed);
+        }
+
+    } while (i_steal(pfor, slot) == TRUE);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_pfor_job(i_PJob *job)
+{
+    cassert_no_null(job);
+    i_participate(job->pfor, job->slot);
+    _osbs_atomic_add(&job->pfor->done, 1);
+    _osbs_sem_post(job->pfor->sem, 1);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Nested calls (from a pool job) are allowed. Helper jobs queued behind busy
+ * workers would never run if the caller just waited for them: the caller
+ * runs queued jobs (its own helpers or others) while its helpers are pending.
+ */
+void bparallel_for_imp(Pool *pool, const uint32_t range, const uint32_t grain, FPtr_parallel_for func, void *data)
+{
+    uint32_t nthreads = pool != NULL ? pool->nthreads : 0;
+    uint32_t nchunks, i;
+    i_PFor pfor;
+    i_PJob jobs[i_MAX_THREADS + 1];
+    cassert_no_nullf(func);
+
+    if (range == 0)
+        return;
+
+    pfor.grain = grain;
+    if (pfor.grain == 0)
+    {
+        /* Several chunks per participant, so stealing can balance the load */
+        pfor.grain = range / ((nthreads + 1) * 8);
+        if (pfor.grain == 0)
+            pfor.grain = 1;
+    }
+
+    if ((range - 1) / pfor.grain + 1 > i_MAX_CHUNKS)
+        pfor.grain = (range - 1) / i_MAX_CHUNKS + 1;
+
+    nchunks = (range - 1) / pfor.grain + 1;
+    pfor.nslots = nthreads + 1 < nchunks ? nthreads + 1 : nchunks;
+
+    if (pfor.nslots == 1)
+    {
+        func(data, 0, range);
+        return;
+    }
+
+    pfor.func = func;
+    pfor.data = data;
+    pfor.range = range;
+    pfor.done = 0;
+    pfor.sem = _osbs_sem_create();
+    for (i = 0; i < pfor.nslots; ++i)
+    {
+        uint32_t lo = (i * nchunks) / pfor.nslots;
+        uint32_t hi = ((i + 1) * nchunks) / pfor.nslots;
+        pfor.slots[i].span = i_SPAN(lo, hi);
+    }
+
+    for (i = 1; i < pfor.nslots; ++i)
+    {
+        jobs[i].pfor = &pfor;
+        jobs[i].slot = i;
+        bpool_add(pool, i_pfor_job, &jobs[i], i_PJob);
+    }
+
+    /* The calling thread is the participant 0 */
+    i_participate(&pfor, 0);
+
+    /* With the queue empty, all the helpers are running in other threads */
+    while (_osbs_atomic_load(&pfor.done) < pfor.nslots - 1)
+    {
+        FPtr_thread_main qfunc = NULL;
+        void *qdata = NULL;
+        if (i_dequeue(pool, &qfunc, &qdata) == FALSE)
+            break;
+        qfunc(qdata);
+    }
+
+    for (i = 1; i < pfor.nslots; ++i)
+        _osbs_sem_wait(pfor.sem);
+
+    _osbs_sem_destroy(&pfor.sem);
+}
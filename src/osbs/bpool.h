@@ -0,0 +1,41 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: bpool.h
+ *
+ */
+
+/* Fixed-size thread pool */
+
+#include "osbs.hxx"
+
+__EXTERN_C
+
+Pool *bpool_create(const uint32_t nthreads);
+
+void bpool_destroy(Pool **pool);
+
+uint32_t bpool_nthreads(const Pool *pool);
+
+void bpool_add_imp(Pool *pool, FPtr_thread_main func, void *data);
+
+void bparallel_for_imp(Pool *pool, const uint32_t range, const uint32_t grain, FPtr_parallel_for func, void *data);
+
+__END_C
+
+#define bpool_add(pool, func, data, type)\
+    (\
+        (void)((data) == (type*)(data)),\
+        FUNC_CHECK_THREAD_MAIN(func, type),\
+        bpool_add_imp(pool, (FPtr_thread_main)func, (void*)(data))\
+    )
+
+#define bparallel_for(pool, range, grain, func, data, type)\
+    (\
+        (void)((data) == (type*)(data)),\
+        FUNC_CHECK_PARALLEL_FOR(func, type),\
+        bparallel_for_imp(pool, range, grain, (FPtr_parallel_for)func, (void*)(data))\
+    )
@@ -35,6 +35,26 @@ bool_t bsocket_read(Socket *socket, byte_t *data, const uint32_t size, uint32_t
 
 bool_t bsocket_write(Socket *socket, const byte_t *data, const uint32_t size, uint32_t *wsize, serror_t *error);
 
+void bsocket_nonblock(Socket *socket, const bool_t nonblock);
+
+Socket *bsocket_accept_nonblock(Socket *socket, serror_t *error);
+
+bool_t bsocket_recv(Socket *socket, byte_t *data, const uint32_t size, uint32_t *rsize, serror_t *error);
+
+bool_t bsocket_send(Socket *socket, const byte_t *data, const uint32_t size, uint32_t *wsize, serror_t *error);
+
+SocketPoll *bsocket_poll_create(serror_t *error);
+
+void bsocket_poll_destroy(SocketPoll **poll);
+
+bool_t bsocket_poll_add(SocketPoll *poll, Socket *socket, const uint32_t events, void *data);
+
+bool_t bsocket_poll_modify(SocketPoll *poll, Socket *socket, const uint32_t events, void *data);
+
+void bsocket_poll_remove(SocketPoll *poll, Socket *socket);
+
+uint32_t bsocket_poll_wait(SocketPoll *poll, SocketEvent *events, const uint32_t max_events, const uint32_t timeout_ms, serror_t *error);
+
 
 uint32_t bsocket_url_ip(const char_t *url, serror_t *error);
 
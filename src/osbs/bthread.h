@@ -33,7 +33,7 @@ __END_C
 
 #define bthread_create(thmain, data, type)\
     (\
-        (void)(data == (type*)data),\
+        (void)((data) == (type*)(data)),\
         FUNC_CHECK_THREAD_MAIN(thmain, type),\
-        bthread_create_imp((FPtr_thread_main)thmain, (void*)data)\
+        bthread_create_imp((FPtr_thread_main)thmain, (void*)(data))\
     )
@@ -12,19 +12,111 @@
 
 #include "log.h"
 #include "log.inl"
+#include "osbs.h"
+#include "osbs.inl"
 #include "blib.inl"
 #include "cassert.h"
 #include "bfile.h"
+#include "bmem.h"
 #include "bmutex.h"
 #include "bstd.h"
+#include "bthread.h"
 #include "btime.h"
 
+/*
+ * Async mode. Callers format the message straight into a cell of a ring
+ * chosen by thread id, so threads rarely share a ring. Each ring is a
+ * bounded multi-producer/single-consumer queue: producers claim cells with
+ * a CAS on 'enqueue' and publish them through the cell sequence number.
+ * The writer thread is the only consumer. It drains all rings, converts
+ * timestamps and sends the lines to the outputs in large blocks. It blocks
+ * on a semaphore when idle and is posted only if it announced it was sleeping.
+ * With a full ring, producers drop the message or, in block mode, wait on a
+ * second semaphore that the writer posts after each drain.
+ *
+ * Binary mode. Messages are not formatted. The log file receives the
+ * 'btime_now' timestamp, a 32 bits id of the format string and the raw
+ * arguments. Cells carry the format text, but the writer puts it in the file
+ * only the first time the id appears there, so events are a few bytes. The
+ * table of known ids is reset with each new file. 'utils/logdec' renders the
+ * file to text.
+ * File: "NLOG" u16 version, u8 endian (0 little, 1 big), u8 zero, records:
+ * 'F' u32 id, u16 size, format text
+ * 'E' u32 id, u64 time, u16 size, arguments
+ * 'T' u64 time, u16 size, text (already formatted message)
+ * Arguments follow the format conversions: integers, chars, pointers and
+ * reals as 8 bytes, '*' widths as 8 bytes, strings as u16 size and text.
+ * Wide chars and strings ('%lc', '%ls') are written as text records.
+ */
+
+#define i_MSG_SIZE      1024
+#define i_RING_SIZE     64
+#define i_RING_MASK     (i_RING_SIZE - 1)
+#define i_NUM_RINGS     8
+#define i_BATCH_SIZE    (32 * 1024)
+#define i_CACHE_LINE    64
+#define i_RECORD_SIZE   (i_MSG_SIZE + 32)
+#define i_NUM_FORMATS   4096
+#define i_BIN_VERSION   1
+
+#define i_KIND_TEXT     0
+#define i_KIND_EVENT    1
+#define i_KIND_BINTEXT  2
+
+typedef struct _logcell_t i_Cell;
+typedef struct _logring_t i_Ring;
+typedef struct _logasync_t i_Async;
+
+struct _logcell_t
+{
+    volatile uint32_t seq;
+    uint32_t size;
+    uint64_t time;
+    uint32_t id;
+    uint16_t kind;
+    uint16_t fsize;
+    char_t text[i_MSG_SIZE];
+};
+
+struct _logring_t
+{
+    volatile uint32_t enqueue;
+    byte_t pad0[i_CACHE_LINE - sizeof(uint32_t)];
+    volatile uint32_t dequeue;
+    byte_t pad1[i_CACHE_LINE - sizeof(uint32_t)];
+    i_Cell cells[i_RING_SIZE];
+};
+
+struct _logasync_t
+{
+    i_Ring rings[i_NUM_RINGS];
+    volatile uint32_t sleeping;
+    volatile uint32_t shutdown;
+    volatile uint32_t dropped;
+    volatile uint32_t waiting;
+    bool_t block;
+    Semaphore *wake;
+    Semaphore *space;
+    Thread *thread;
+    File *logfile;
+    uint64_t second;
+    char_t time[16];
+    uint32_t outsize;
+    uint32_t filesize;
+    char_t out[i_BATCH_SIZE];
+    char_t file[i_BATCH_SIZE];
+};
+
 /*---------------------------------------------------------------------------*/
 
 static Mutex *i_LOG_MUTEX = NULL;
 static bool_t i_LOG_STDOUT = TRUE;
 static bool_t i_LOG_STDERR = FALSE;
 static char_t i_LOG_FILEPATH[512] = "";
+static i_Async *i_LOG_ASYNC = NULL;
+static File *i_LOG_FILE = NULL;
+static bool_t i_LOG_BINARY = FALSE;
+static uint32_t i_LOG_FORMATS[i_NUM_FORMATS];
 
 /*---------------------------------------------------------------------------*/
 
@@ -39,6 +131,9 @@ void _log_start(void)
 void _log_finish(void)
 {
     cassert(i_LOG_MUTEX != NULL);
+    log_async(FALSE, FALSE);
+    if (i_LOG_FILE != NULL)
+        bfile_close(&i_LOG_FILE);
     bmutex_close(&i_LOG_MUTEX);
 }
 
@@ -60,6 +155,662 @@ static void i_unlock(void)
 
 /*---------------------------------------------------------------------------*/
 
+static void i_put(byte_t *dest, uint32_t *pos, const void *data, const uint32_t size)
+{
+    if (size > 0)
+    {
+        bmem_copy(dest + *pos, (const byte_t*)data, size);
+        *pos += size;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Called with the lock. TRUE the first time the id is seen in the file */
+static bool_t i_new_format(const uint32_t id)
+{
+    uint32_t i;
+    for (i = 0; i < i_NUM_FORMATS; ++i)
+    {
+        uint32_t *slot = &i_LOG_FORMATS[(id + i) & (i_NUM_FORMATS - 1)];
+        if (*slot == id)
+            return FALSE;
+
+        if (*slot == 0)
+        {
+            *slot = id;
+            return TRUE;
+        }
+    }
+
+    /* Table full, the definition goes with every event */
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Called with the lock. Length of all binary records of a message (definition + event) */
+static uint32_t i_record(byte_t *dest, const i_Cell *cell)
+{
+    uint32_t pos = 0;
+    cassert_no_null(cell);
+    if (cell->kind == i_KIND_EVENT)
+    {
+        uint16_t asize = (uint16_t)(cell->size - cell->fsize);
+        if (i_new_format(cell->id) == TRUE)
+        {
+            dest[pos++] = 'F';
+            i_put(dest, &pos, &cell->id, sizeof(uint32_t));
+            i_put(dest, &pos, &cell->fsize, sizeof(uint16_t));
+            i_put(dest, &pos, cell->text, cell->fsize);
+        }
+
+        dest[pos++] = 'E';
+        i_put(dest, &pos, &cell->id, sizeof(uint32_t));
+        i_put(dest, &pos, &cell->time, sizeof(uint64_t));
+        i_put(dest, &pos, &asize, sizeof(uint16_t));
+        i_put(dest, &pos, cell->text + cell->fsize, asize);
+    }
+    else
+    {
+        uint16_t size = (uint16_t)cell->size;
+        dest[pos++] = 'T';
+        i_put(dest, &pos, &cell->time, sizeof(uint64_t));
+        i_put(dest, &pos, &size, sizeof(uint16_t));
+        i_put(dest, &pos, cell->text, size);
+    }
+
+    cassert(pos <= i_RECORD_SIZE);
+    return pos;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_format_id(const char_t *format, uint32_t *size)
+{
+    /* FNV-1a, zero marks the empty slots */
+    uint32_t hash = 2166136261u;
+    const char_t *f = format;
+    while (*f != '\0')
+    {
+        hash ^= (uint32_t)(byte_t)*f++;
+        hash *= 16777619u;
+    }
+
+    *size = (uint32_t)(f - format);
+    return hash != 0 ? hash : 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_put64(byte_t *dest, uint32_t *pos, const uint64_t value)
+{
+    if (*pos + sizeof(uint64_t) > i_MSG_SIZE)
+        return FALSE;
+    i_put(dest, pos, &value, sizeof(uint64_t));
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* With precision ('prec' >= 0), 'str' doesn't need the final '\0' */
+static bool_t i_put_str(byte_t *dest, uint32_t *pos, const char_t *str, const int32_t prec)
+{
+    const char_t *s = str != NULL ? str : "(null)";
+    uint32_t len = 0;
+    uint16_t size = 0;
+    if (*pos + sizeof(uint16_t) > i_MSG_SIZE)
+        return FALSE;
+
+    /* Strings that don't fit are truncated */
+    while ((prec < 0 || len < (uint32_t)prec) && s[len] != '\0' && *pos + sizeof(uint16_t) + len < i_MSG_SIZE)
+        len += 1;
+
+    size = (uint16_t)len;
+    i_put(dest, pos, &size, sizeof(uint16_t));
+    i_put(dest, pos, s, len);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Copies the raw arguments walking the printf conversions of the format.
+ * FALSE if some conversion is unknown or doesn't fit, then the message is
+ * formatted as text.
+ */
+static bool_t i_encode(i_Cell *cell, const char_t *format, va_list args)
+{
+    const char_t *f = format;
+    byte_t *dest = (byte_t*)cell->text;
+    uint32_t fsize = 0;
+    uint32_t pos = 0;
+    bool_t ok = TRUE;
+
+    cell->id = i_format_id(format, &fsize);
+    if (fsize >= i_MSG_SIZE / 2)
+        return FALSE;
+
+    bmem_copy(dest, (const byte_t*)format, fsize);
+    cell->fsize = (uint16_t)fsize;
+    pos = fsize;
+    while (*f != '\0' && ok == TRUE)
+    {
+        uint32_t len = 0;
+        int32_t prec = -1;
+        if (*f++ != '%')
+            continue;
+
+        if (*f == '%')
+        {
+            f += 1;
+            continue;
+        }
+
+        while (*f == '-' || *f == '+' || *f == ' ' || *f == '#' || *f == '0' || *f == '\'')
+            f += 1;
+
+        /* Width and precision, '*' takes an int argument */
+        if (*f == '*')
+        {
+            ok = i_put64(dest, &pos, (uint64_t)(int64_t)va_arg(args, int));
+            f += 1;
+        }
+
+        while (*f >= '0' && *f <= '9')
+            f += 1;
+
+        /* Negative '*' precision is taken as if omitted */
+        if (*f == '.')
+        {
+            f += 1;
+            prec = 0;
+            if (*f == '*')
+            {
+                prec = (int32_t)va_arg(args, int);
+                ok = i_put64(dest, &pos, (uint64_t)(int64_t)prec);
+                f += 1;
+            }
+
+            while (*f >= '0' && *f <= '9')
+            {
+                if (prec < i_MSG_SIZE)
+                    prec = prec * 10 + (int32_t)(*f - '0');
+                f += 1;
+            }
+        }
+
+        if (ok == FALSE)
+            break;
+
+        /* 1 long, 2 long long, 3 size_t, 4 long double */
+        switch (*f) {
+        case 'h':
+            f += f[1] == 'h' ? 2 : 1;
+            break;
+        case 'l':
+            len = f[1] == 'l' ? 2 : 1;
+            f += len;
+            break;
+        case 'j':
+        case 'q':
+            len = 2;
+            f += 1;
+            break;
+        case 'z':
+        case 't':
+            len = 3;
+            f += 1;
+            break;
+        case 'L':
+            len = 4;
+            f += 1;
+            break;
+        case 'I':
+            if (f[1] == '6' && f[2] == '4')
+            {
+                len = 2;
+                f += 3;
+            }
+            else if (f[1] == '3' && f[2] == '2')
+            {
+                f += 3;
+            }
+            else
+            {
+                len = 3;
+                f += 1;
+            }
+            break;
+        default:
+            break;
+        }
+
+        switch (*f++) {
+        case 'd':
+        case 'i':
+            if (len == 1)
+                ok = i_put64(dest, &pos, (uint64_t)(int64_t)va_arg(args, long));
+            else if (len == 2)
+                ok = i_put64(dest, &pos, (uint64_t)va_arg(args, long long));
+            else if (len == 3)
+                ok = i_put64(dest, &pos, (uint64_t)(int64_t)va_arg(args, ptrdiff_t));
+            else
+                ok = i_put64(dest, &pos, (uint64_t)(int64_t)va_arg(args, int));
+            break;
+
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            if (len == 1)
+                ok = i_put64(dest, &pos, (uint64_t)va_arg(args, unsigned long));
+            else if (len == 2)
+                ok = i_put64(dest, &pos, (uint64_t)va_arg(args, unsigned long long));
+            else if (len == 3)
+                ok = i_put64(dest, &pos, (uint64_t)va_arg(args, size_t));
+            else
+                ok = i_put64(dest, &pos, (uint64_t)va_arg(args, unsigned int));
+            break;
+
+        case 'c':
+            if (len == 1)
+                ok = FALSE;
+            else
+                ok = i_put64(dest, &pos, (uint64_t)(int64_t)va_arg(args, int));
+            break;
+
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+        {
+            real64_t value = len == 4 ? (real64_t)va_arg(args, long double) : va_arg(args, real64_t);
+            uint64_t bits;
+            bmem_copy((byte_t*)&bits, (const byte_t*)&value, sizeof(uint64_t));
+            ok = i_put64(dest, &pos, bits);
+            break;
+        }
+
+        case 's':
+            if (len == 1)
+                ok = FALSE;
+            else
+                ok = i_put_str(dest, &pos, va_arg(args, const char_t*), prec);
+            break;
+
+        case 'p':
+            ok = i_put64(dest, &pos, (uint64_t)(size_t)va_arg(args, void*));
+            break;
+
+        case 'n':
+            va_arg(args, void*);
+            break;
+
+        default:
+            ok = FALSE;
+            break;
+        }
+    }
+
+    if (ok == FALSE)
+        return FALSE;
+
+    cell->kind = i_KIND_EVENT;
+    cell->size = pos;
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_text(i_Cell *cell, const char_t *format, va_list args)
+{
+    uint32_t size = bstd_vsprintf(cell->text, i_MSG_SIZE, format, args);
+    cassert(size < i_MSG_SIZE);
+    if (size >= i_MSG_SIZE)
+        size = i_MSG_SIZE - 1;
+    cell->kind = i_LOG_BINARY == TRUE ? i_KIND_BINTEXT : i_KIND_TEXT;
+    cell->fsize = 0;
+    cell->size = size;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Synchronous binary mode, the record goes straight to the file (kept open, like the writer does) */
+static void i_write_record(const i_Cell *cell)
+{
+    byte_t record[i_RECORD_SIZE];
+    i_lock();
+    if (i_LOG_FILEPATH[0] != '\0')
+    {
+        uint32_t size = i_record(record, cell);
+        if (i_LOG_FILE == NULL)
+            i_LOG_FILE = bfile_open(i_LOG_FILEPATH, ekAPPEND, NULL);
+
+        if (i_LOG_FILE != NULL)
+            bfile_write(i_LOG_FILE, record, size, NULL, NULL);
+    }
+    i_unlock();
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Called with the lock. Before changing the file or the mode */
+static void i_close_files(void)
+{
+    if (i_LOG_FILE != NULL)
+        bfile_close(&i_LOG_FILE);
+
+    if (i_LOG_ASYNC != NULL && i_LOG_ASYNC->logfile != NULL)
+        bfile_close(&i_LOG_ASYNC->logfile);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Called with the lock. A new binary file forgets the known formats */
+static void i_binary_header(void)
+{
+    bmem_zero_n(i_LOG_FORMATS, i_NUM_FORMATS, uint32_t);
+
+    if (i_LOG_FILEPATH[0] != '\0')
+    {
+        File *file = bfile_create(i_LOG_FILEPATH, NULL);
+        if (file != NULL)
+        {
+            byte_t header[8] = {'N', 'L', 'O', 'G', 0, 0, 0, 0};
+            uint16_t version = i_BIN_VERSION;
+            bmem_copy(header + 4, (const byte_t*)&version, sizeof(uint16_t));
+            header[6] = osbs_endian() == ekLITEND ? 0 : 1;
+            bfile_write(file, header, sizeof(header), NULL, NULL);
+            bfile_close(&file);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Called with the lock */
+static void i_write_batch(i_Async *async)
+{
+    cassert_no_null(async);
+
+    if (async->outsize > 0)
+    {
+        if (i_LOG_STDOUT == TRUE)
+            bstd_write((const byte_t*)async->out, async->outsize, NULL);
+
+        if (i_LOG_STDERR == TRUE)
+            bstd_ewrite((const byte_t*)async->out, async->outsize, NULL);
+    }
+
+    /* The writer keeps the file open, 'log_file' closes it */
+    if (async->filesize > 0 && i_LOG_FILEPATH[0] != '\0')
+    {
+        if (async->logfile == NULL)
+            async->logfile = bfile_open(i_LOG_FILEPATH, ekAPPEND, NULL);
+
+        if (async->logfile != NULL)
+            bfile_write(async->logfile, (const byte_t*)async->file, async->filesize, NULL, NULL);
+    }
+
+    async->outsize = 0;
+    async->filesize = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_batch_line(i_Async *async, const uint64_t time, const char_t *text, const uint32_t size)
+{
+    cassert_no_null(async);
+    if (async->filesize + size + 32 > i_BATCH_SIZE)
+        i_write_batch(async);
+
+    /* Consecutive messages usually share the second, localtime() once */
+    if (time / 1000000 != async->second)
+    {
+        Date date;
+        btime_to_date(time, &date);
+        bstd_sprintf(async->time, sizeof(async->time), "[%02d:%02d:%02d] ", date.hour, date.minute, date.second);
+        async->second = time / 1000000;
+    }
+
+    blib_strcpy(async->out + async->outsize, 16, async->time);
+    bmem_copy((byte_t*)(async->out + async->outsize + 11), (const byte_t*)text, size);
+    async->out[async->outsize + 11 + size] = '\n';
+    blib_strcpy(async->file + async->filesize, 16, async->time);
+    bmem_copy((byte_t*)(async->file + async->filesize + 11), (const byte_t*)text, size);
+    async->file[async->filesize + 11 + size] = '\r';
+    async->file[async->filesize + 12 + size] = '\n';
+    async->outsize += size + 12;
+    async->filesize += size + 13;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Binary records go only to the file */
+static void i_batch_cell(i_Async *async, const i_Cell *cell)
+{
+    cassert_no_null(async);
+    cassert_no_null(cell);
+    /* A text message queued before 'log_binary' can't go as a line into the binary file */
+    if (cell->kind == i_KIND_TEXT && i_LOG_BINARY == FALSE)
+    {
+        i_batch_line(async, cell->time, cell->text, cell->size);
+    }
+    else
+    {
+        if (async->filesize + i_RECORD_SIZE > i_BATCH_SIZE)
+            i_write_batch(async);
+        async->filesize += i_record((byte_t*)(async->file + async->filesize), cell);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Only the writer thread modifies 'dequeue'. The lock is held for the whole
+ * drain: the known formats and the file don't change in the middle of a batch.
+ */
+static bool_t i_drain(i_Async *async)
+{
+    uint32_t pos[i_NUM_RINGS];
+    bool_t any = FALSE;
+    uint32_t i;
+    cassert_no_null(async);
+    i_lock();
+
+    {
+        uint32_t dropped = _osbs_atomic_load(&async->dropped);
+        if (dropped > 0)
+        {
+            i_Cell cell;
+            cell.time = btime_now();
+            cell.kind = i_LOG_BINARY == TRUE ? i_KIND_BINTEXT : i_KIND_TEXT;
+            cell.fsize = 0;
+            cell.size = bstd_sprintf(cell.text, i_MSG_SIZE, "%u log messages dropped.", dropped);
+            _osbs_atomic_add(&async->dropped, (uint32_t)0 - dropped);
+            i_batch_cell(async, &cell);
+            any = TRUE;
+        }
+    }
+
+    for (i = 0; i < i_NUM_RINGS; ++i)
+    {
+        i_Ring *ring = &async->rings[i];
+        pos[i] = ring->dequeue;
+        for (;;)
+        {
+            i_Cell *cell = &ring->cells[pos[i] & i_RING_MASK];
+            if (_osbs_atomic_load(&cell->seq) != pos[i] + 1)
+                break;
+
+            i_batch_cell(async, cell);
+            _osbs_atomic_store(&cell->seq, pos[i] + i_RING_SIZE);
+            pos[i] += 1;
+            any = TRUE;
+        }
+    }
+
+    /* log_flush() waits for 'dequeue', lines must be already written */
+    i_write_batch(async);
+    i_unlock();
+    for (i = 0; i < i_NUM_RINGS; ++i)
+        _osbs_atomic_store(&async->rings[i].dequeue, pos[i]);
+
+    return any;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_pending(i_Async *async)
+{
+    uint32_t i;
+    cassert_no_null(async);
+    if (_osbs_atomic_load(&async->dropped) > 0 || _osbs_atomic_load(&async->waiting) > 0)
+        return TRUE;
+
+    for (i = 0; i < i_NUM_RINGS; ++i)
+    {
+        i_Ring *ring = &async->rings[i];
+        if (_osbs_atomic_load(&ring->cells[ring->dequeue & i_RING_MASK].seq) == ring->dequeue + 1)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_writer(i_Async *async)
+{
+    cassert_no_null(async);
+    for (;;)
+    {
+        bool_t any = i_drain(async);
+        uint32_t waiting = _osbs_atomic_load(&async->waiting);
+        if (waiting > 0)
+            _osbs_sem_post(async->space, waiting);
+
+        if (any == TRUE)
+            continue;
+
+        if (_osbs_atomic_load(&async->shutdown) == 1)
+            break;
+
+        /* Announce the sleep, then check again to not miss a late message */
+        _osbs_atomic_store(&async->sleeping, 1);
+        if (i_pending(async) == TRUE || _osbs_atomic_load(&async->shutdown) == 1)
+        {
+            /* A producer could have taken the flag and posted */
+            if (_osbs_atomic_cas(&async->sleeping, 1, 0) == FALSE)
+                _osbs_sem_wait(async->wake);
+        }
+        else
+        {
+            _osbs_sem_wait(async->wake);
+        }
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_wake(i_Async *async)
+{
+    if (_osbs_atomic_load(&async->sleeping) == 1)
+    {
+        if (_osbs_atomic_cas(&async->sleeping, 1, 0) == TRUE)
+            _osbs_sem_post(async->wake, 1);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_Cell *i_claim(i_Async *async, i_Ring *ring, uint32_t *pos)
+{
+    for (;;)
+    {
+        uint32_t cur = _osbs_atomic_load(&ring->enqueue);
+        i_Cell *cell = &ring->cells[cur & i_RING_MASK];
+        int32_t dif = (int32_t)(_osbs_atomic_load(&cell->seq) - cur);
+        if (dif == 0)
+        {
+            if (_osbs_atomic_cas(&ring->enqueue, cur, cur + 1) == TRUE)
+            {
+                *pos = cur;
+                return cell;
+            }
+        }
+        else if (dif < 0)
+        {
+            /* Ring full */
+            if (async->block == FALSE)
+                return NULL;
+
+            _osbs_atomic_add(&async->waiting, 1);
+            i_wake(async);
+            _osbs_sem_wait(async->space);
+            _osbs_atomic_add(&async->waiting, UINT32_MAX);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static i_Cell *i_async_cell(i_Async *async, uint32_t *pos)
+{
+    uint32_t id = (uint32_t)bthread_current_id();
+    i_Ring *ring = &async->rings[(id ^ (id >> 3)) % i_NUM_RINGS];
+    i_Cell *cell = i_claim(async, ring, pos);
+    if (cell == NULL)
+        _osbs_atomic_add(&async->dropped, 1);
+    return cell;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Async or binary. The message is formatted (or encoded) into a cell */
+static uint32_t i_cell_printf(const char_t *format, va_list args0, va_list args1)
+{
+    i_Async *async = i_LOG_ASYNC;
+    i_Cell local;
+    i_Cell *cell = &local;
+    uint64_t time = btime_now();
+    uint32_t pos = 0;
+    uint32_t size = 0;
+
+    if (async != NULL)
+    {
+        cell = i_async_cell(async, &pos);
+        if (cell == NULL)
+            return 0;
+    }
+
+    cell->time = time;
+    if (i_LOG_BINARY == FALSE || i_encode(cell, format, args0) == FALSE)
+        i_text(cell, format, args1);
+
+    size = cell->size + 12;
+    if (async != NULL)
+    {
+        _osbs_atomic_store(&cell->seq, pos + 1);
+        i_wake(async);
+    }
+    else
+    {
+        i_write_record(cell);
+    }
+
+    return size;
+}
+
+/*---------------------------------------------------------------------------*/
+
 uint32_t log_printf(const char_t *format, ...)
 {
     char_t time_buffer[32];
@@ -68,6 +819,18 @@ uint32_t log_printf(const char_t *format, ...)
     uint32_t msg_size = 0;
     uint32_t total_size = 0;
 
+    if (i_LOG_ASYNC != NULL || i_LOG_BINARY == TRUE)
+    {
+        /* A second list, the binary encoding can give up halfway */
+        va_list args0, args1;
+        va_start(args0, format);
+        va_start(args1, format);
+        total_size = i_cell_printf(format, args0, args1);
+        va_end(args1);
+        va_end(args0);
+        return total_size;
+    }
+
     {
         Date date;
         btime_date(&date);
@@ -118,9 +881,13 @@ void log_output(const bool_t std, const bool_t err)
 
 /*---------------------------------------------------------------------------*/
 
+/* Queued messages go to the previous file */
 void log_file(const char_t *pathname)
 {
+    log_flush();
     i_lock();
+    i_close_files();
+
     if (pathname != NULL)
     {
         File *file = NULL;
@@ -128,6 +895,9 @@ void log_file(const char_t *pathname)
         file = bfile_create(i_LOG_FILEPATH, NULL);
         if (file != NULL)
             bfile_close(&file);
+
+        if (i_LOG_BINARY == TRUE)
+            i_binary_header();
     }
     else
     {
@@ -145,3 +915,95 @@ const char_t *log_get_file(void)
     else
         return i_LOG_FILEPATH;
 }
+
+/*---------------------------------------------------------------------------*/
+
+/* Starts a new file, the old one would mix text and binary records */
+void log_binary(const bool_t binary)
+{
+    log_flush();
+    i_lock();
+    if (binary != i_LOG_BINARY)
+    {
+        i_close_files();
+        if (binary == TRUE)
+            i_binary_header();
+    }
+
+    i_LOG_BINARY = binary;
+    i_unlock();
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Switch modes while other threads are not logging (startup, shutdown) */
+void log_async(const bool_t async, const bool_t block)
+{
+    if (async == TRUE)
+    {
+        if (i_LOG_ASYNC == NULL)
+        {
+            i_Async *lasync = (i_Async*)bmem_aligned_malloc(sizeof(i_Async), i_CACHE_LINE);
+            uint32_t i, j;
+            bmem_zero(lasync, i_Async);
+            for (i = 0; i < i_NUM_RINGS; ++i)
+            {
+                for (j = 0; j < i_RING_SIZE; ++j)
+                    lasync->rings[i].cells[j].seq = j;
+            }
+
+            lasync->second = UINT64_MAX;
+            lasync->wake = _osbs_sem_create();
+            lasync->space = _osbs_sem_create();
+            lasync->thread = bthread_create(i_writer, lasync, i_Async);
+
+            /* From now on, the writer has the only file handle */
+            i_lock();
+            i_close_files();
+            i_LOG_ASYNC = lasync;
+            i_unlock();
+        }
+
+        i_LOG_ASYNC->block = block;
+    }
+    else if (i_LOG_ASYNC != NULL)
+    {
+        i_Async *lasync = i_LOG_ASYNC;
+        /* New messages go synchronous, the writer drains the pending ones */
+        i_LOG_ASYNC = NULL;
+        _osbs_atomic_store(&lasync->shutdown, 1);
+        _osbs_sem_post(lasync->wake, 1);
+        bthread_wait(lasync->thread);
+        bthread_close(&lasync->thread);
+        if (lasync->logfile != NULL)
+            bfile_close(&lasync->logfile);
+        _osbs_sem_destroy(&lasync->wake);
+        _osbs_sem_destroy(&lasync->space);
+        bmem_free((byte_t*)lasync);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+void log_flush(void)
+{
+    i_Async *async = i_LOG_ASYNC;
+    if (async != NULL)
+    {
+        uint32_t target[i_NUM_RINGS];
+        uint32_t i;
+
+        for (i = 0; i < i_NUM_RINGS; ++i)
+            target[i] = _osbs_atomic_load(&async->rings[i].enqueue);
+
+        /* Messages claimed before the call are written when 'dequeue' reaches them */
+        for (i = 0; i < i_NUM_RINGS; ++i)
+        {
+            while ((int32_t)(_osbs_atomic_load(&async->rings[i].dequeue) - target[i]) < 0)
+            {
+                i_wake(async);
+                bthread_sleep(1);
+            }
+        }
+    }
+}
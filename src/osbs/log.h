@@ -23,4 +23,10 @@ void log_file(const char_t *pathname);
 
 const char_t *log_get_file(void);
 
+void log_async(const bool_t async, const bool_t block);
+
+void log_flush(void);
+
+void log_binary(const bool_t binary);
+
 __END_C
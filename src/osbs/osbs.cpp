@@ -42,6 +42,8 @@ public:
     uint32_t num_threads_dealloc;
     uint32_t num_sockets_alloc;
     uint32_t num_sockets_dealloc;
+    uint32_t num_sems_alloc;
+    uint32_t num_sems_dealloc;
 
     ~OsBs()
     {
@@ -138,6 +140,9 @@ void osbs_finish(void)
 
         if (i_OSBS.num_sockets_alloc != i_OSBS.num_sockets_dealloc)
             log_printf("Non-closed Sockets: %u/%u", i_OSBS.num_sockets_alloc, i_OSBS.num_sockets_dealloc);
+
+        if (i_OSBS.num_sems_alloc != i_OSBS.num_sems_dealloc)
+            log_printf("Non-dealloc Semaphores: %u/%u", i_OSBS.num_sems_alloc, i_OSBS.num_sems_dealloc);
     }
     else
     {
@@ -206,6 +211,13 @@ void _osbs_socket_alloc(void)
 
 /*---------------------------------------------------------------------------*/
 
+void _osbs_sem_alloc(void)
+{
+    i_incr(&i_OSBS.num_sems_alloc);
+}
+
+/*---------------------------------------------------------------------------*/
+
 void _osbs_directory_dealloc(void)
 {
     i_incr(&i_OSBS.num_directories_closed);
@@ -246,3 +258,10 @@ void _osbs_socket_dealloc(void)
     i_incr(&i_OSBS.num_sockets_dealloc);
 }
 
+/*---------------------------------------------------------------------------*/
+
+void _osbs_sem_dealloc(void)
+{
+    i_incr(&i_OSBS.num_sems_dealloc);
+}
+
@@ -25,5 +25,7 @@ win_t osbs_windows(void);
 
 endian_t osbs_endian(void);
 
+uint32_t osbs_num_cores(void);
+
 __END_C
 
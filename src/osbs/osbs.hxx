@@ -127,9 +127,19 @@ typedef enum _serror_t
     ekSTIMEOUT,
     ekSSTREAM,
     ekSUNDEF,
-    ekSOK
+    ekSOK,
+    ekSAGAIN
 } serror_t;
 
+typedef enum _sockev_t
+{
+    ekSOCK_READ = 1,
+    ekSOCK_WRITE = 2,
+    ekSOCK_EDGE = 4,
+    ekSOCK_HUP = 8,
+    ekSOCK_ERROR = 16
+} sockev_t;
+
 typedef struct _date_t Date;
 typedef struct _dir_t Dir;
 typedef struct _file_t File;
@@ -137,11 +147,18 @@ typedef struct _mutex_t Mutex;
 typedef struct _process_t Proc;
 typedef struct _thread_t Thread;
 typedef struct _socket_t Socket;
+typedef struct _spoll_t SocketPoll;
+typedef struct _sevent_t SocketEvent;
+typedef struct _pool_t Pool;
 
 typedef uint32_t(*FPtr_thread_main)(void *data);
 #define FUNC_CHECK_THREAD_MAIN(func, type)\
     (void)((uint32_t(*)(type*))func == func)
 
+typedef void(*FPtr_parallel_for)(void *data, const uint32_t st, const uint32_t ed);
+#define FUNC_CHECK_PARALLEL_FOR(func, type)\
+    (void)((void(*)(type*, const uint32_t, const uint32_t))func == func)
+
 struct _date_t
 {
     int16_t year;
@@ -153,6 +170,13 @@ struct _date_t
     uint8_t second;
 };
 
+struct _sevent_t
+{
+    Socket *socket;
+    void *data;
+    uint32_t events;
+};
+
 struct _procopt_t
 {
     uint32_t unused;
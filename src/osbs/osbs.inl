@@ -12,6 +12,8 @@
 
 #include "osbs.hxx"
 
+typedef struct _semaphore_t Semaphore;
+
 __EXTERN_C
 
 void _osbs_mutex(Mutex *mutex);
@@ -32,6 +34,8 @@ void _osbs_thread_alloc(void);
 
 void _osbs_socket_alloc(void);
 
+void _osbs_sem_alloc(void);
+
 void _osbs_directory_dealloc(void);
 
 void _osbs_file_dealloc(void);
@@ -44,5 +48,25 @@ void _osbs_thread_dealloc(void);
 
 void _osbs_socket_dealloc(void);
 
+void _osbs_sem_dealloc(void);
+
+void _osbs_thread_exit(void(*func)(void*), void *data);
+
+Semaphore *_osbs_sem_create(void);
+
+void _osbs_sem_destroy(Semaphore **sem);
+
+void _osbs_sem_post(Semaphore *sem, const uint32_t count);
+
+void _osbs_sem_wait(Semaphore *sem);
+
+uint32_t _osbs_atomic_load(volatile uint32_t *value);
+
+void _osbs_atomic_store(volatile uint32_t *value, const uint32_t newval);
+
+uint32_t _osbs_atomic_add(volatile uint32_t *value, const uint32_t incr);
+
+bool_t _osbs_atomic_cas(volatile uint32_t *value, const uint32_t expected, const uint32_t newval);
+
 __END_C
 
@@ -10,6 +10,11 @@
 
 /* Basic file system services */
 
+/* 'madvise' is not visible in strict C99 */
+#if !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include "bfile.h"
 
 #if !defined(__UNIX__)
@@ -20,6 +25,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -46,6 +52,7 @@ int lstat(const char *path, struct stat *buf);
 #include "ptr.h"
 #include "unicode.h"
 static const uint32_t i_NUM_RETRYS = 10;
+static const byte_t i_EMPTY_MAP[1] = { 0 };
 
 /* Not used, only for debugger inspection */
 struct _dir_t
@@ -557,6 +564,72 @@ bool_t bfile_write(File *file, const byte_t *data, const uint32_t size, uint32_t
 
 /*---------------------------------------------------------------------------*/
 
+const byte_t *bfile_mmap(const char_t *pathname, uint32_t *size, ferror_t *error)
+{
+    File *file = bfile_open(pathname, ekREAD, error);
+    const byte_t *data = NULL;
+    uint64_t fsize = 0;
+    cassert_no_null(size);
+    *size = 0;
+    if (file == NULL)
+        return NULL;
+
+    if (bfile_fstat(file, NULL, &fsize, NULL, error) == TRUE)
+    {
+        if (fsize == 0)
+        {
+            /* mmap() doesn't accept empty regions */
+            data = i_EMPTY_MAP;
+        }
+        else if (fsize < 0xFFFFFFFF)
+        {
+            void *map = mmap(NULL, (size_t)fsize, PROT_READ, MAP_PRIVATE, (int)(intptr_t)file, 0);
+            if (map != MAP_FAILED)
+            {
+                madvise(map, (size_t)fsize, MADV_SEQUENTIAL);
+                data = (const byte_t*)map;
+                *size = (uint32_t)fsize;
+            }
+            else
+            {
+                ptr_assign(error, errno == EACCES ? ekFNOACCESS : ekFUNDEF);
+            }
+        }
+        else
+        {
+            ptr_assign(error, ekFBIG);
+        }
+    }
+
+    /* The mapping remains valid after closing the descriptor */
+    bfile_close(&file);
+    if (data != NULL)
+        _osbs_file_alloc();
+    return data;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bfile_munmap(const byte_t **data, const uint32_t size)
+{
+    cassert_no_null(data);
+    cassert_no_null(*data);
+    if (size > 0)
+    {
+        int ret = munmap((void*)*data, (size_t)size);
+        cassert_unref(ret == 0, ret);
+    }
+    else
+    {
+        cassert(*data == i_EMPTY_MAP);
+    }
+
+    _osbs_file_dealloc();
+    *data = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
 bool_t bfile_delete(const char_t *filepath, ferror_t *error)
 {
     int res = unlink((const char*)filepath);
@@ -14,6 +14,7 @@
 #include "osbs.inl"
 #include "cassert.h"
 #include "ptr.h"
+#include "bmem.h"
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -24,6 +25,11 @@
 #include <errno.h>
 #include <netdb.h>
 #include <fcntl.h>
+#if defined(__LINUX__)
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
 #define SOCKET_ID       int
 #define SOCKET_NULL     -1
 #define SOCKET_FAIL     -1
@@ -34,6 +40,41 @@
 
 /*---------------------------------------------------------------------------*/
 
+typedef struct _reg_t i_Reg;
+
+struct _reg_t
+{
+    Socket *socket;
+    void *data;
+};
+
+#if defined(__LINUX__)
+
+/* Registered sockets are indexed by descriptor */
+struct _spoll_t
+{
+    int epfd;
+    uint32_t nregs;
+    i_Reg *regs;
+    uint32_t nevents;
+    struct epoll_event *events;
+};
+
+#else
+
+/* poll() fallback: level-triggered, ekSOCK_EDGE is ignored */
+struct _spoll_t
+{
+    uint32_t size;
+    uint32_t alloc;
+    i_Reg *regs;
+    struct pollfd *fds;
+};
+
+#endif
+
+/*---------------------------------------------------------------------------*/
+
 static const char_t *i_WELL_KNOW_URL = "www.google.com";
 
 /*---------------------------------------------------------------------------*/
@@ -559,6 +600,429 @@ bool_t bsocket_write(Socket *lsocket, const byte_t *data, const uint32_t size, u
 
 /*---------------------------------------------------------------------------*/
 
+static bool_t i_would_block(void)
+{
+    return (bool_t)(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bsocket_nonblock(Socket *lsocket, const bool_t nonblock)
+{
+    int flags = 0, ret = 0;
+    cassert_no_null(lsocket);
+    flags = fcntl((SOCKET_ID)(intptr_t)lsocket, F_GETFL, 0);
+    cassert(flags >= 0);
+    if (nonblock == TRUE)
+        flags |= O_NONBLOCK;
+    else
+        flags &= ~O_NONBLOCK;
+    ret = fcntl((SOCKET_ID)(intptr_t)lsocket, F_SETFL, flags);
+    cassert_unref(ret == 0, ret);
+}
+
+/*---------------------------------------------------------------------------*/
+
+Socket *bsocket_accept_nonblock(Socket *lsocket, serror_t *error)
+{
+    SOCKET_ID cliID;
+    struct sockaddr_in clData;
+    socklen_t sizeSt = sizeof(clData);
+    cassert_no_null(lsocket);
+
+    cliID = accept((SOCKET_ID)(intptr_t)lsocket, (struct sockaddr*)&clData, &sizeSt);
+    if (cliID == SOCKET_FAIL)
+    {
+        ptr_assign(error, i_would_block() ? ekSAGAIN : ekSUNDEF);
+        return NULL;
+    }
+
+    bsocket_nonblock((Socket*)(intptr_t)cliID, TRUE);
+
+    _osbs_socket_alloc();
+    ptr_assign(error, ekSOK);
+    return (Socket*)(intptr_t)cliID;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t bsocket_recv(Socket *lsocket, byte_t *data, const uint32_t size, uint32_t *rsize, serror_t *error)
+{
+    SSIZE_T num_rbytes = 0;
+    cassert_no_null(lsocket);
+    cassert_no_null(data);
+    num_rbytes = recv((SOCKET_ID)(intptr_t)lsocket, (char*)data, (SIZE_T)size, 0);
+    if (num_rbytes >= 0)
+    {
+        /* 0 bytes: the peer has closed the connection */
+        ptr_assign(rsize, (uint32_t)num_rbytes);
+        ptr_assign(error, ekSOK);
+        return TRUE;
+    }
+
+    ptr_assign(rsize, 0);
+    ptr_assign(error, i_would_block() ? ekSAGAIN : ekSSTREAM);
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t bsocket_send(Socket *lsocket, const byte_t *data, const uint32_t size, uint32_t *wsize, serror_t *error)
+{
+    SSIZE_T num_wbytes = 0;
+    cassert_no_null(lsocket);
+    cassert_no_null(data);
+#if defined(__LINUX__)
+    num_wbytes = send((SOCKET_ID)(intptr_t)lsocket, (const char*)data, (SIZE_T)size, MSG_NOSIGNAL);
+#else
+    num_wbytes = send((SOCKET_ID)(intptr_t)lsocket, (const char*)data, (SIZE_T)size, 0);
+#endif
+    if (num_wbytes >= 0)
+    {
+        ptr_assign(wsize, (uint32_t)num_wbytes);
+        ptr_assign(error, ekSOK);
+        return TRUE;
+    }
+
+    ptr_assign(wsize, 0);
+    ptr_assign(error, i_would_block() ? ekSAGAIN : ekSSTREAM);
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if defined(__LINUX__)
+
+static uint32_t i_to_epoll(const uint32_t events)
+{
+    uint32_t epev = EPOLLRDHUP;
+    if (events & ekSOCK_READ)
+        epev |= EPOLLIN;
+    if (events & ekSOCK_WRITE)
+        epev |= EPOLLOUT;
+    if (events & ekSOCK_EDGE)
+        epev |= EPOLLET;
+    return epev;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_from_epoll(const uint32_t epev)
+{
+    uint32_t events = 0;
+    if (epev & EPOLLIN)
+        events |= ekSOCK_READ;
+    if (epev & EPOLLOUT)
+        events |= ekSOCK_WRITE;
+    if (epev & (EPOLLHUP | EPOLLRDHUP))
+        events |= ekSOCK_HUP;
+    if (epev & EPOLLERR)
+        events |= ekSOCK_ERROR;
+    return events;
+}
+
+/*---------------------------------------------------------------------------*/
+
+SocketPoll *bsocket_poll_create(serror_t *error)
+{
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd != SOCKET_FAIL)
+    {
+        SocketPoll *poll = (SocketPoll*)bmem_malloc(sizeof(SocketPoll));
+        poll->epfd = epfd;
+        poll->nregs = 0;
+        poll->regs = NULL;
+        poll->nevents = 0;
+        poll->events = NULL;
+        ptr_assign(error, ekSOK);
+        return poll;
+    }
+    else
+    {
+        ptr_assign(error, ekSUNDEF);
+        return NULL;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bsocket_poll_destroy(SocketPoll **poll)
+{
+    cassert_no_null(poll);
+    cassert_no_null(*poll);
+    close((*poll)->epfd);
+    if ((*poll)->regs != NULL)
+        bmem_free((byte_t*)(*poll)->regs);
+    if ((*poll)->events != NULL)
+        bmem_free((byte_t*)(*poll)->events);
+    bmem_free((byte_t*)*poll);
+    *poll = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_epoll_ctl(SocketPoll *poll, const int op, Socket *lsocket, const uint32_t events, void *data)
+{
+    SOCKET_ID fd = (SOCKET_ID)(intptr_t)lsocket;
+    struct epoll_event ev;
+    cassert_no_null(poll);
+    cassert_no_null(lsocket);
+    cassert(fd >= 0);
+
+    if ((uint32_t)fd >= poll->nregs)
+    {
+        uint32_t nregs = poll->nregs > 0 ? poll->nregs : 64;
+        while ((uint32_t)fd >= nregs)
+            nregs *= 2;
+
+        if (poll->regs == NULL)
+            poll->regs = (i_Reg*)bmem_malloc(nregs * sizeof(i_Reg));
+        else
+            poll->regs = (i_Reg*)bmem_realloc((byte_t*)poll->regs, poll->nregs * sizeof(i_Reg), nregs * sizeof(i_Reg));
+
+        bmem_set_zero((byte_t*)(poll->regs + poll->nregs), (nregs - poll->nregs) * sizeof(i_Reg));
+        poll->nregs = nregs;
+    }
+
+    bmem_zero(&ev, struct epoll_event);
+    ev.events = i_to_epoll(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(poll->epfd, op, fd, &ev) == 0)
+    {
+        poll->regs[fd].socket = lsocket;
+        poll->regs[fd].data = data;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t bsocket_poll_add(SocketPoll *poll, Socket *lsocket, const uint32_t events, void *data)
+{
+    return i_epoll_ctl(poll, EPOLL_CTL_ADD, lsocket, events, data);
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t bsocket_poll_modify(SocketPoll *poll, Socket *lsocket, const uint32_t events, void *data)
+{
+    return i_epoll_ctl(poll, EPOLL_CTL_MOD, lsocket, events, data);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bsocket_poll_remove(SocketPoll *poll, Socket *lsocket)
+{
+    SOCKET_ID fd = (SOCKET_ID)(intptr_t)lsocket;
+    struct epoll_event ev;
+    cassert_no_null(poll);
+    cassert_no_null(lsocket);
+    cassert((uint32_t)fd < poll->nregs);
+    bmem_zero(&ev, struct epoll_event);
+    epoll_ctl(poll->epfd, EPOLL_CTL_DEL, fd, &ev);
+    poll->regs[fd].socket = NULL;
+    poll->regs[fd].data = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t bsocket_poll_wait(SocketPoll *poll, SocketEvent *events, const uint32_t max_events, const uint32_t timeout_ms, serror_t *error)
+{
+    int i, n;
+    cassert_no_null(poll);
+    cassert_no_null(events);
+    cassert(max_events > 0);
+
+    if (max_events > poll->nevents)
+    {
+        if (poll->events != NULL)
+            bmem_free((byte_t*)poll->events);
+        poll->events = (struct epoll_event*)bmem_malloc(max_events * sizeof(struct epoll_event));
+        poll->nevents = max_events;
+    }
+
+    n = epoll_wait(poll->epfd, poll->events, (int)max_events, timeout_ms == UINT32_MAX ? -1 : (int)timeout_ms);
+    if (n == SOCKET_FAIL)
+    {
+        ptr_assign(error, errno == EINTR ? ekSAGAIN : ekSUNDEF);
+        return 0;
+    }
+
+    for (i = 0; i < n; ++i)
+    {
+        const i_Reg *reg = &poll->regs[poll->events[i].data.fd];
+        events[i].socket = reg->socket;
+        events[i].data = reg->data;
+        events[i].events = i_from_epoll(poll->events[i].events);
+    }
+
+    ptr_assign(error, n > 0 ? ekSOK : ekSTIMEOUT);
+    return (uint32_t)n;
+}
+
+#else
+
+/*---------------------------------------------------------------------------*/
+
+SocketPoll *bsocket_poll_create(serror_t *error)
+{
+    SocketPoll *poll = (SocketPoll*)bmem_malloc(sizeof(SocketPoll));
+    poll->size = 0;
+    poll->alloc = 0;
+    poll->regs = NULL;
+    poll->fds = NULL;
+    ptr_assign(error, ekSOK);
+    return poll;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bsocket_poll_destroy(SocketPoll **poll)
+{
+    cassert_no_null(poll);
+    cassert_no_null(*poll);
+    if ((*poll)->regs != NULL)
+    {
+        bmem_free((byte_t*)(*poll)->regs);
+        bmem_free((byte_t*)(*poll)->fds);
+    }
+    bmem_free((byte_t*)*poll);
+    *poll = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_find(const SocketPoll *poll, Socket *lsocket)
+{
+    uint32_t i;
+    for (i = 0; i < poll->size; ++i)
+    {
+        if (poll->regs[i].socket == lsocket)
+            return i;
+    }
+
+    return UINT32_MAX;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static short i_to_poll(const uint32_t events)
+{
+    short pev = 0;
+    if (events & ekSOCK_READ)
+        pev |= POLLIN;
+    if (events & ekSOCK_WRITE)
+        pev |= POLLOUT;
+    return pev;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t bsocket_poll_add(SocketPoll *poll, Socket *lsocket, const uint32_t events, void *data)
+{
+    cassert_no_null(poll);
+    cassert_no_null(lsocket);
+    if (i_find(poll, lsocket) != UINT32_MAX)
+        return FALSE;
+
+    if (poll->size == poll->alloc)
+    {
+        uint32_t alloc = poll->alloc > 0 ? poll->alloc * 2 : 64;
+        if (poll->regs == NULL)
+        {
+            poll->regs = (i_Reg*)bmem_malloc(alloc * sizeof(i_Reg));
+            poll->fds = (struct pollfd*)bmem_malloc(alloc * sizeof(struct pollfd));
+        }
+        else
+        {
+            poll->regs = (i_Reg*)bmem_realloc((byte_t*)poll->regs, poll->alloc * sizeof(i_Reg), alloc * sizeof(i_Reg));
+            poll->fds = (struct pollfd*)bmem_realloc((byte_t*)poll->fds, poll->alloc * sizeof(struct pollfd), alloc * sizeof(struct pollfd));
+        }
+        poll->alloc = alloc;
+    }
+
+    poll->regs[poll->size].socket = lsocket;
+    poll->regs[poll->size].data = data;
+    poll->fds[poll->size].fd = (SOCKET_ID)(intptr_t)lsocket;
+    poll->fds[poll->size].events = i_to_poll(events);
+    poll->fds[poll->size].revents = 0;
+    poll->size += 1;
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t bsocket_poll_modify(SocketPoll *poll, Socket *lsocket, const uint32_t events, void *data)
+{
+    uint32_t i;
+    cassert_no_null(poll);
+    i = i_find(poll, lsocket);
+    if (i == UINT32_MAX)
+        return FALSE;
+    poll->regs[i].data = data;
+    poll->fds[i].events = i_to_poll(events);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bsocket_poll_remove(SocketPoll *poll, Socket *lsocket)
+{
+    uint32_t i;
+    cassert_no_null(poll);
+    i = i_find(poll, lsocket);
+    cassert(i != UINT32_MAX);
+    poll->size -= 1;
+    poll->regs[i] = poll->regs[poll->size];
+    poll->fds[i] = poll->fds[poll->size];
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t bsocket_poll_wait(SocketPoll *spoll, SocketEvent *events, const uint32_t max_events, const uint32_t timeout_ms, serror_t *error)
+{
+    uint32_t i, n = 0;
+    int ret;
+    cassert_no_null(spoll);
+    cassert_no_null(events);
+    cassert(max_events > 0);
+    ret = poll(spoll->fds, (nfds_t)spoll->size, timeout_ms == UINT32_MAX ? -1 : (int)timeout_ms);
+    if (ret == SOCKET_FAIL)
+    {
+        ptr_assign(error, errno == EINTR ? ekSAGAIN : ekSUNDEF);
+        return 0;
+    }
+
+    for (i = 0; i < spoll->size && n < max_events; ++i)
+    {
+        short rev = spoll->fds[i].revents;
+        if (rev != 0)
+        {
+            events[n].socket = spoll->regs[i].socket;
+            events[n].data = spoll->regs[i].data;
+            events[n].events = 0;
+            if (rev & POLLIN)
+                events[n].events |= ekSOCK_READ;
+            if (rev & POLLOUT)
+                events[n].events |= ekSOCK_WRITE;
+            if (rev & POLLHUP)
+                events[n].events |= ekSOCK_HUP;
+            if (rev & (POLLERR | POLLNVAL))
+                events[n].events |= ekSOCK_ERROR;
+            n += 1;
+        }
+    }
+
+    ptr_assign(error, n > 0 ? ekSOK : ekSTIMEOUT);
+    return n;
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*/
+
 //bool_t bsocket_shutdown(Socket *socket, serror_t *error);
 //bool_t bsocket_shutdown(Socket *lsocket, serror_t *error)
 //{
@@ -17,6 +17,7 @@
 #endif
 
 #include "osbs.inl"
+#include "bmem.h"
 #include "cassert.h"
 #include <errno.h>
 #include <pthread.h>
@@ -158,3 +159,124 @@ void bthread_sleep(const uint32_t milliseconds)
     usleep(milliseconds * 1000);
 }
 
+
+/*---------------------------------------------------------------------------*/
+
+static pthread_once_t i_EXIT_ONCE = PTHREAD_ONCE_INIT;
+static pthread_key_t i_EXIT_KEY;
+static void(*i_EXIT_FUNC)(void*) = NULL;
+
+/*---------------------------------------------------------------------------*/
+
+static void i_exit_key(void)
+{
+    int ret = pthread_key_create(&i_EXIT_KEY, i_EXIT_FUNC);
+    cassert_unref(ret == 0, ret);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 'func(data)' is called when the current thread ends. Same 'func' for all threads */
+void _osbs_thread_exit(void(*func)(void*), void *data)
+{
+    int ret = 0;
+    cassert_no_null(data);
+    cassert(i_EXIT_FUNC == NULL || i_EXIT_FUNC == func);
+    i_EXIT_FUNC = func;
+    pthread_once(&i_EXIT_ONCE, i_exit_key);
+    ret = pthread_setspecific(i_EXIT_KEY, data);
+    cassert_unref(ret == 0, ret);
+}
+
+/*---------------------------------------------------------------------------*/
+
+struct _semaphore_t
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t count;
+};
+
+/*---------------------------------------------------------------------------*/
+
+Semaphore *_osbs_sem_create(void)
+{
+    Semaphore *sem = (Semaphore*)bmem_malloc(sizeof(Semaphore));
+    int ret = 0;
+    cassert_no_null(sem);
+    ret = pthread_mutex_init(&sem->mutex, NULL);
+    cassert_unref(ret == 0, ret);
+    ret = pthread_cond_init(&sem->cond, NULL);
+    cassert(ret == 0);
+    sem->count = 0;
+    _osbs_sem_alloc();
+    return sem;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void _osbs_sem_destroy(Semaphore **sem)
+{
+    cassert_no_null(sem);
+    cassert_no_null(*sem);
+    pthread_cond_destroy(&(*sem)->cond);
+    pthread_mutex_destroy(&(*sem)->mutex);
+    bmem_free((byte_t*)*sem);
+    _osbs_sem_dealloc();
+    *sem = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void _osbs_sem_post(Semaphore *sem, const uint32_t count)
+{
+    cassert_no_null(sem);
+    pthread_mutex_lock(&sem->mutex);
+    sem->count += count;
+    if (count == 1)
+        pthread_cond_signal(&sem->cond);
+    else
+        pthread_cond_broadcast(&sem->cond);
+    pthread_mutex_unlock(&sem->mutex);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void _osbs_sem_wait(Semaphore *sem)
+{
+    cassert_no_null(sem);
+    pthread_mutex_lock(&sem->mutex);
+    while (sem->count == 0)
+        pthread_cond_wait(&sem->cond, &sem->mutex);
+    sem->count -= 1;
+    pthread_mutex_unlock(&sem->mutex);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t _osbs_atomic_load(volatile uint32_t *value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void _osbs_atomic_store(volatile uint32_t *value, const uint32_t newval)
+{
+    __atomic_store_n(value, newval, __ATOMIC_RELEASE);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t _osbs_atomic_add(volatile uint32_t *value, const uint32_t incr)
+{
+    return __atomic_fetch_add(value, incr, __ATOMIC_ACQ_REL);
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t _osbs_atomic_cas(volatile uint32_t *value, const uint32_t expected, const uint32_t newval)
+{
+    uint32_t exp = expected;
+    return __atomic_compare_exchange_n(value, &exp, newval, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ? TRUE : FALSE;
+}
@@ -35,6 +35,7 @@ struct _dir_t
 };
 
 static const uint32_t i_NUM_RETRYS = 10;
+static const byte_t i_EMPTY_MAP[1] = { 0 };
 
 /*---------------------------------------------------------------------------*/
 
@@ -625,6 +626,76 @@ bool_t bfile_write(File *file, const byte_t *data, const uint32_t size, uint32_t
 
 /*---------------------------------------------------------------------------*/
 
+const byte_t *bfile_mmap(const char_t *pathname, uint32_t *size, ferror_t *error)
+{
+    File *file = bfile_open(pathname, ekREAD, error);
+    const byte_t *data = NULL;
+    uint64_t fsize = 0;
+    cassert_no_null(size);
+    *size = 0;
+    if (file == NULL)
+        return NULL;
+
+    if (bfile_fstat(file, NULL, &fsize, NULL, error) == TRUE)
+    {
+        if (fsize == 0)
+        {
+            /* CreateFileMapping() doesn't accept empty files */
+            data = i_EMPTY_MAP;
+        }
+        else if (fsize < 0xFFFFFFFF)
+        {
+            HANDLE mapping = CreateFileMapping((HANDLE)file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping != NULL)
+            {
+                data = (const byte_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (data != NULL)
+                    *size = (uint32_t)fsize;
+                else
+                    i_file_error(error);
+
+                /* The view remains valid after closing the mapping handle */
+                CloseHandle(mapping);
+            }
+            else
+            {
+                i_file_error(error);
+            }
+        }
+        else
+        {
+            ptr_assign(error, ekFBIG);
+        }
+    }
+
+    bfile_close(&file);
+    if (data != NULL)
+        _osbs_file_alloc();
+    return data;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bfile_munmap(const byte_t **data, const uint32_t size)
+{
+    cassert_no_null(data);
+    cassert_no_null(*data);
+    if (size > 0)
+    {
+        BOOL ok = UnmapViewOfFile((LPCVOID)*data);
+        cassert_unref(ok != 0, ok);
+    }
+    else
+    {
+        cassert(*data == i_EMPTY_MAP);
+    }
+
+    _osbs_file_dealloc();
+    *data = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
 bool_t bfile_delete(const char_t *pathname, ferror_t *error)
 {
     WCHAR pathnamew[MAX_PATH + 1];
@@ -14,6 +14,7 @@
 #include "osbs.inl"
 #include "cassert.h"
 #include "ptr.h"
+#include "bmem.h"
 
 #if !defined(__WINDOWS__)
 #error This file is for Windows system
@@ -37,6 +38,25 @@
 
 /*---------------------------------------------------------------------------*/
 
+typedef struct _reg_t i_Reg;
+
+struct _reg_t
+{
+    Socket *socket;
+    void *data;
+};
+
+/* WSAPoll based: level-triggered, ekSOCK_EDGE is ignored */
+struct _spoll_t
+{
+    uint32_t size;
+    uint32_t alloc;
+    i_Reg *regs;
+    WSAPOLLFD *fds;
+};
+
+/*---------------------------------------------------------------------------*/
+
 static const char_t *i_WELL_KNOW_URL = "www.google.com";
 
 /*---------------------------------------------------------------------------*/
@@ -606,6 +626,251 @@ bool_t bsocket_write(Socket *lsocket, const byte_t *data, const uint32_t size, u
 
 /*---------------------------------------------------------------------------*/
 
+static bool_t i_would_block(void)
+{
+    int sock_error = WSAGetLastError();
+    return (bool_t)(sock_error == WSAEWOULDBLOCK || sock_error == WSAEINTR);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bsocket_nonblock(Socket *lsocket, const bool_t nonblock)
+{
+    u_long mode = nonblock == TRUE ? 1 : 0;
+    int ret = 0;
+    cassert_no_null(lsocket);
+    ret = ioctlsocket((SOCKET)lsocket, FIONBIO, &mode);
+    cassert_unref(ret == 0, ret);
+}
+
+/*---------------------------------------------------------------------------*/
+
+Socket *bsocket_accept_nonblock(Socket *lsocket, serror_t *error)
+{
+    SOCKET cliID;
+    struct sockaddr_in clData;
+    socklen_t sizeSt = sizeof(clData);
+    cassert_no_null(lsocket);
+    cliID = accept((SOCKET)lsocket, (struct sockaddr*)&clData, &sizeSt);
+    if (cliID == INVALID_SOCKET)
+    {
+        ptr_assign(error, i_would_block() ? ekSAGAIN : ekSUNDEF);
+        return NULL;
+    }
+
+    /* Accepted sockets inherit the non-blocking mode of the listener */
+    _osbs_socket_alloc();
+    ptr_assign(error, ekSOK);
+    return (Socket*)(intptr_t)cliID;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t bsocket_recv(Socket *lsocket, byte_t *data, const uint32_t size, uint32_t *rsize, serror_t *error)
+{
+    int num_rbytes = 0;
+    cassert_no_null(lsocket);
+    cassert_no_null(data);
+    num_rbytes = recv((SOCKET)lsocket, (char*)data, (int)size, 0);
+    if (num_rbytes >= 0)
+    {
+        /* 0 bytes: the peer has closed the connection */
+        ptr_assign(rsize, (uint32_t)num_rbytes);
+        ptr_assign(error, ekSOK);
+        return TRUE;
+    }
+
+    ptr_assign(rsize, 0);
+    ptr_assign(error, i_would_block() ? ekSAGAIN : ekSSTREAM);
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t bsocket_send(Socket *lsocket, const byte_t *data, const uint32_t size, uint32_t *wsize, serror_t *error)
+{
+    int num_wbytes = 0;
+    cassert_no_null(lsocket);
+    cassert_no_null(data);
+    num_wbytes = send((SOCKET)lsocket, (const char*)data, (int)size, 0);
+    if (num_wbytes >= 0)
+    {
+        ptr_assign(wsize, (uint32_t)num_wbytes);
+        ptr_assign(error, ekSOK);
+        return TRUE;
+    }
+
+    ptr_assign(wsize, 0);
+    ptr_assign(error, i_would_block() ? ekSAGAIN : ekSSTREAM);
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+SocketPoll *bsocket_poll_create(serror_t *error)
+{
+    SocketPoll *poll = (SocketPoll*)bmem_malloc(sizeof(SocketPoll));
+    poll->size = 0;
+    poll->alloc = 0;
+    poll->regs = NULL;
+    poll->fds = NULL;
+    ptr_assign(error, ekSOK);
+    return poll;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bsocket_poll_destroy(SocketPoll **poll)
+{
+    cassert_no_null(poll);
+    cassert_no_null(*poll);
+    if ((*poll)->regs != NULL)
+    {
+        bmem_free((byte_t*)(*poll)->regs);
+        bmem_free((byte_t*)(*poll)->fds);
+    }
+    bmem_free((byte_t*)*poll);
+    *poll = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_find(const SocketPoll *poll, Socket *lsocket)
+{
+    uint32_t i;
+    for (i = 0; i < poll->size; ++i)
+    {
+        if (poll->regs[i].socket == lsocket)
+            return i;
+    }
+
+    return UINT32_MAX;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static SHORT i_to_poll(const uint32_t events)
+{
+    SHORT pev = 0;
+    if (events & ekSOCK_READ)
+        pev |= POLLRDNORM;
+    if (events & ekSOCK_WRITE)
+        pev |= POLLWRNORM;
+    return pev;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t bsocket_poll_add(SocketPoll *poll, Socket *lsocket, const uint32_t events, void *data)
+{
+    cassert_no_null(poll);
+    cassert_no_null(lsocket);
+    if (i_find(poll, lsocket) != UINT32_MAX)
+        return FALSE;
+
+    if (poll->size == poll->alloc)
+    {
+        uint32_t alloc = poll->alloc > 0 ? poll->alloc * 2 : 64;
+        if (poll->regs == NULL)
+        {
+            poll->regs = (i_Reg*)bmem_malloc(alloc * sizeof(i_Reg));
+            poll->fds = (WSAPOLLFD*)bmem_malloc(alloc * sizeof(WSAPOLLFD));
+        }
+        else
+        {
+            poll->regs = (i_Reg*)bmem_realloc((byte_t*)poll->regs, poll->alloc * sizeof(i_Reg), alloc * sizeof(i_Reg));
+            poll->fds = (WSAPOLLFD*)bmem_realloc((byte_t*)poll->fds, poll->alloc * sizeof(WSAPOLLFD), alloc * sizeof(WSAPOLLFD));
+        }
+        poll->alloc = alloc;
+    }
+
+    poll->regs[poll->size].socket = lsocket;
+    poll->regs[poll->size].data = data;
+    poll->fds[poll->size].fd = (SOCKET)lsocket;
+    poll->fds[poll->size].events = i_to_poll(events);
+    poll->fds[poll->size].revents = 0;
+    poll->size += 1;
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t bsocket_poll_modify(SocketPoll *poll, Socket *lsocket, const uint32_t events, void *data)
+{
+    uint32_t i;
+    cassert_no_null(poll);
+    i = i_find(poll, lsocket);
+    if (i == UINT32_MAX)
+        return FALSE;
+    poll->regs[i].data = data;
+    poll->fds[i].events = i_to_poll(events);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void bsocket_poll_remove(SocketPoll *poll, Socket *lsocket)
+{
+    uint32_t i;
+    cassert_no_null(poll);
+    i = i_find(poll, lsocket);
+    cassert(i != UINT32_MAX);
+    poll->size -= 1;
+    poll->regs[i] = poll->regs[poll->size];
+    poll->fds[i] = poll->fds[poll->size];
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t bsocket_poll_wait(SocketPoll *poll, SocketEvent *events, const uint32_t max_events, const uint32_t timeout_ms, serror_t *error)
+{
+    uint32_t i, n = 0;
+    int ret;
+    cassert_no_null(poll);
+    cassert_no_null(events);
+    cassert(max_events > 0);
+
+    /* WSAPoll fails with an empty set: wait like poll() does */
+    if (poll->size == 0)
+    {
+        Sleep(timeout_ms == UINT32_MAX ? INFINITE : (DWORD)timeout_ms);
+        ptr_assign(error, ekSTIMEOUT);
+        return 0;
+    }
+
+    ret = WSAPoll(poll->fds, (ULONG)poll->size, timeout_ms == UINT32_MAX ? -1 : (INT)timeout_ms);
+    if (ret == SOCKET_ERROR)
+    {
+        ptr_assign(error, i_would_block() ? ekSAGAIN : ekSUNDEF);
+        return 0;
+    }
+
+    for (i = 0; i < poll->size && n < max_events; ++i)
+    {
+        SHORT rev = poll->fds[i].revents;
+        if (rev != 0)
+        {
+            events[n].socket = poll->regs[i].socket;
+            events[n].data = poll->regs[i].data;
+            events[n].events = 0;
+            if (rev & POLLRDNORM)
+                events[n].events |= ekSOCK_READ;
+            if (rev & POLLWRNORM)
+                events[n].events |= ekSOCK_WRITE;
+            if (rev & POLLHUP)
+                events[n].events |= ekSOCK_HUP;
+            if (rev & (POLLERR | POLLNVAL))
+                events[n].events |= ekSOCK_ERROR;
+            n += 1;
+        }
+    }
+
+    ptr_assign(error, n > 0 ? ekSOK : ekSTIMEOUT);
+    return n;
+}
+
+/*---------------------------------------------------------------------------*/
+
 //bool_t bsocket_shutdown(Socket *socket, serror_t *error);
 //bool_t bsocket_shutdown(Socket *lsocket, serror_t *error)
 //{
@@ -119,3 +119,114 @@ void bthread_sleep(const uint32_t milliseconds)
 {
     Sleep(milliseconds);
 }
+
+/*---------------------------------------------------------------------------*/
+
+static INIT_ONCE i_EXIT_ONCE = INIT_ONCE_STATIC_INIT;
+static DWORD i_EXIT_KEY = FLS_OUT_OF_INDEXES;
+static void(*i_EXIT_FUNC)(void*) = NULL;
+
+/*---------------------------------------------------------------------------*/
+
+static VOID WINAPI i_exit(PVOID data)
+{
+    if (data != NULL && i_EXIT_FUNC != NULL)
+        i_EXIT_FUNC((void*)data);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static BOOL CALLBACK i_exit_key(PINIT_ONCE once, PVOID param, PVOID *context)
+{
+    unref(once);
+    unref(param);
+    unref(context);
+    i_EXIT_KEY = FlsAlloc(i_exit);
+    return (BOOL)(i_EXIT_KEY != FLS_OUT_OF_INDEXES);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 'func(data)' is called when the current thread ends. Same 'func' for all threads */
+void _osbs_thread_exit(void(*func)(void*), void *data)
+{
+    BOOL ok;
+    cassert_no_null(data);
+    cassert(i_EXIT_FUNC == NULL || i_EXIT_FUNC == func);
+    i_EXIT_FUNC = func;
+    ok = InitOnceExecuteOnce(&i_EXIT_ONCE, i_exit_key, NULL, NULL);
+    cassert(ok != 0);
+    ok = FlsSetValue(i_EXIT_KEY, (PVOID)data);
+    cassert_unref(ok != 0, ok);
+}
+
+/*---------------------------------------------------------------------------*/
+
+Semaphore *_osbs_sem_create(void)
+{
+    HANDLE sem = CreateSemaphore(NULL, 0, MAXLONG, NULL);
+    cassert_no_null(sem);
+    _osbs_sem_alloc();
+    return (Semaphore*)sem;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void _osbs_sem_destroy(Semaphore **sem)
+{
+    BOOL ok;
+    cassert_no_null(sem);
+    cassert_no_null(*sem);
+    ok = CloseHandle((HANDLE)*sem);
+    cassert_unref(ok != 0, ok);
+    _osbs_sem_dealloc();
+    *sem = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void _osbs_sem_post(Semaphore *sem, const uint32_t count)
+{
+    BOOL ok;
+    cassert_no_null(sem);
+    ok = ReleaseSemaphore((HANDLE)sem, (LONG)count, NULL);
+    cassert_unref(ok != 0, ok);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void _osbs_sem_wait(Semaphore *sem)
+{
+    DWORD res;
+    cassert_no_null(sem);
+    res = WaitForSingleObject((HANDLE)sem, INFINITE);
+    cassert_unref(res == WAIT_OBJECT_0, res);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t _osbs_atomic_load(volatile uint32_t *value)
+{
+    return (uint32_t)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void _osbs_atomic_store(volatile uint32_t *value, const uint32_t newval)
+{
+    InterlockedExchange((volatile LONG*)value, (LONG)newval);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t _osbs_atomic_add(volatile uint32_t *value, const uint32_t incr)
+{
+    return (uint32_t)InterlockedExchangeAdd((volatile LONG*)value, (LONG)incr);
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t _osbs_atomic_cas(volatile uint32_t *value, const uint32_t expected, const uint32_t newval)
+{
+    return (uint32_t)InterlockedCompareExchange((volatile LONG*)value, (LONG)newval, (LONG)expected) == expected ? TRUE : FALSE;
+}
@@ -112,6 +112,7 @@
 
     #define __SCANF(format_idx, arg_idx)    __attribute__((__format__ (__scanf__, format_idx, arg_idx)))
     #define __TYPECHECK                     __attribute__((unused))
+    #define __THREAD_LOCAL                  __thread
 
     #if (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3)
         #define __ALLOC_SIZE(x)             __attribute__((__alloc_size__(x)))
@@ -136,6 +137,7 @@
     #define __PRINTF(format_idx, arg_idx)
     #define __SCANF(format_idx, arg_idx)
     #define __TYPECHECK                     _inline
+    #define __THREAD_LOCAL                  __declspec(thread)
     #define __ALLOC_SIZE(x)
     #define __ALLOC_SIZE2(x,y)
     #define __TRUE_EXPECTED(expr)           (expr)
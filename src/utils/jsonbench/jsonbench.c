@@ -0,0 +1,195 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: jsonbench.c
+ *
+ */
+
+/* Json parsing throughput */
+
+#include "coreall.h"
+#include "inet.h"
+#include "json.h"
+
+typedef struct _item_t Item;
+
+struct _item_t
+{
+    uint32_t id;
+    String *name;
+    String *description;
+    real64_t price;
+    bool_t stock;
+    ArrSt(int32_t) *values;
+};
+
+DeclSt(Item);
+
+typedef struct _feed_t Feed;
+
+struct _feed_t
+{
+    ArrSt(Item) *items;
+};
+
+/*---------------------------------------------------------------------------*/
+
+static Stream *i_feed(const uint32_t n)
+{
+    Feed *feed = dbind_create(Feed);
+    Stream *stm = stm_memory(1024 * 1024);
+    uint32_t i, j;
+
+    for (i = 0; i < n; ++i)
+    {
+        Item *item = arrst_new(feed->items, Item);
+        dbind_init(item, Item);
+        item->id = i;
+        str_upd(&item->name, "Product name with a \"quoted\" word");
+        str_upd(&item->description, "A longer description text that contains a few escapes\tand plain words, enough to be representative of real feeds.");
+        item->price = (real64_t)i * 1.25 - 500;
+        item->stock = (bool_t)(i % 3 == 0);
+        for (j = 0; j < 8; ++j)
+            arrst_append(item->values, (int32_t)(i * j) - 1000, int32_t);
+    }
+
+    json_write(stm, feed, NULL, Feed);
+    dbind_destroy(&feed, Feed);
+    return stm;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static real64_t i_mbs(const uint32_t size, const uint64_t micros)
+{
+    return ((real64_t)size / (1024. * 1024.)) / ((real64_t)(micros > 0 ? micros : 1) / 1000000.);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint64_t i_lexer(const byte_t *data, const uint32_t size, uint32_t *ntokens)
+{
+    /* Only the tokenizer of the previous json_read_imp (no values, no binding).
+       It's a lower bound of the old parser time, not the old parser itself */
+    Stream *stm = stm_from_block(data, size);
+    uint64_t t = btime_now();
+    ltoken_t token;
+    *ntokens = 0;
+    stm_token_escapes(stm, TRUE);
+    for (token = stm_read_token(stm); token != ekTEOF; token = stm_read_token(stm))
+        *ntokens += 1;
+    t = btime_now() - t;
+    stm_close(&stm);
+    return t;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint64_t i_reader(const byte_t *data, const uint32_t size, uint32_t *nevents)
+{
+    Stream *stm = stm_from_block(data, size);
+    uint64_t t = btime_now();
+    JsonReader *reader = json_reader_create(stm, NULL);
+    jsonev_t event = json_reader_next(reader);
+    *nevents = 0;
+    while (event != ekJSON_EOF && event != ekJSON_ERROR)
+    {
+        *nevents += 1;
+        event = json_reader_next(reader);
+    }
+    json_reader_destroy(&reader);
+    t = btime_now() - t;
+    stm_close(&stm);
+    return t;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint64_t i_dbind(const byte_t *data, const uint32_t size, uint32_t *nitems)
+{
+    Stream *stm = stm_from_block(data, size);
+    uint64_t t = btime_now();
+    Feed *feed = json_read(stm, NULL, Feed);
+    t = btime_now() - t;
+    *nitems = feed != NULL ? arrst_size(feed->items, Item) : 0;
+    json_destopt(&feed, Feed);
+    stm_close(&stm);
+    return t;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint64_t i_dom(const byte_t *data, const uint32_t size, uint32_t *nitems)
+{
+    Stream *stm = stm_from_block(data, size);
+    uint64_t t = btime_now();
+    JsonNode *node = json_read_node(stm, NULL);
+    t = btime_now() - t;
+    *nitems = node != NULL ? json_node_size(json_node_member(node, "items")) : 0;
+    if (node != NULL)
+        json_node_destroy(&node);
+    stm_close(&stm);
+    return t;
+}
+
+/*---------------------------------------------------------------------------*/
+
+typedef uint64_t(*FPtr_bench)(const byte_t *data, const uint32_t size, uint32_t *count);
+
+static void i_bench(const char_t *name, FPtr_bench func, const byte_t *data, const uint32_t size, const uint32_t reps)
+{
+    uint64_t best = UINT64_MAX;
+    uint32_t i, count = 0;
+    for (i = 0; i < reps; ++i)
+    {
+        uint64_t t = func(data, size, &count);
+        if (t < best)
+            best = t;
+    }
+
+    bstd_printf("%-28s %10u %10.1f ms %10.1f MB/s\n", name, count, (real64_t)best / 1000., i_mbs(size, best));
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    uint32_t n = 20000, reps = 5;
+    Stream *stm;
+
+    core_start();
+    inet_start();
+
+    if (argc > 1)
+        n = str_to_u32(argv[1], 10, NULL);
+    if (argc > 2)
+        reps = str_to_u32(argv[2], 10, NULL);
+
+    dbind(Item, uint32_t, id);
+    dbind(Item, String*, name);
+    dbind(Item, String*, description);
+    dbind(Item, real64_t, price);
+    dbind(Item, bool_t, stock);
+    dbind(Item, ArrSt(int32_t)*, values);
+    dbind(Feed, ArrSt(Item)*, items);
+
+    stm = i_feed(n);
+
+    {
+        const byte_t *data = stm_buffer(stm);
+        uint32_t size = stm_buffer_size(stm);
+        bstd_printf("Json feed: %u objects, %.2f MB, best of %u\n", n, (real64_t)size / (1024. * 1024.), reps);
+        i_bench("Lexer only (tokens)", i_lexer, data, size, reps);
+        i_bench("JsonReader (events)", i_reader, data, size, reps);
+        i_bench("json_read_node (items)", i_dom, data, size, reps);
+        i_bench("json_read dbind (items)", i_dbind, data, size, reps);
+    }
+
+    stm_close(&stm);
+    inet_finish();
+    core_finish();
+    return 0;
+}
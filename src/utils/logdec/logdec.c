@@ -0,0 +1,58 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: logdec.c
+ *
+ */
+
+/* Binary log (log_binary) to text */
+
+#include "coreall.h"
+
+int main(int argc, char *argv[])
+{
+    Buffer *buffer = NULL;
+    Stream *stm = NULL;
+    int ret = 0;
+
+    core_start();
+
+    if (argc < 2)
+    {
+        bstd_printf("Use: logdec file.log [output.txt]\n");
+        core_finish();
+        return 1;
+    }
+
+    buffer = hfile_buffer(argv[1], NULL);
+    if (argc > 2)
+        stm = stm_to_file(argv[2], NULL);
+    else
+        stm = kSTDOUT;
+
+    if (buffer != NULL && stm != NULL && buffer_size(buffer) >= 8 && bmem_cmp(buffer_data(buffer), (const byte_t*)"NLOG", 4) == 0)
+    {
+        if (logbin_text(buffer_data(buffer), buffer_size(buffer), stm) == FALSE)
+        {
+            bstd_eprintf("Corrupt or truncated record in '%s'.\n", argv[1]);
+            ret = 1;
+        }
+    }
+    else
+    {
+        bstd_eprintf("'%s' is not a binary log.\n", argv[1]);
+        ret = 1;
+    }
+
+    if (buffer != NULL)
+        buffer_destroy(&buffer);
+
+    if (stm != NULL && stm != kSTDOUT)
+        stm_close(&stm);
+
+    core_finish();
+    return ret;
+}
@@ -0,0 +1,785 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: naptest.c
+ *
+ */
+
+/* Regression tests */
+
+#include "naptest.h"
+#include "coreall.h"
+#include "draw2dall.h"
+#include "httpreq.h"
+#include "inet.h"
+#include "json.h"
+#include "regex.h"
+
+typedef struct _numbers_t Numbers;
+
+struct _numbers_t
+{
+    uint32_t id;
+    ArrSt(uint32_t) *values;
+};
+
+static uint32_t i_FAILS = 0;
+
+/*---------------------------------------------------------------------------*/
+
+void test_check_imp(const bool_t ok, const char_t *cond, const char_t *file, const uint32_t line)
+{
+    if (ok == FALSE)
+    {
+        bstd_printf("FAIL (%s:%u): %s\n", file, line, cond);
+        i_FAILS += 1;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_assert(void *item, const uint32_t group, const char_t *caption, const char_t *detail, const char_t *file, const uint32_t line)
+{
+    unref(item);
+    unref(group);
+    bstd_printf("FAIL (%s:%u): %s: %s\n", file, line, caption, detail);
+    i_FAILS += 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_match(const char_t *pattern, const char_t *str)
+{
+    RegEx *regex = regex_create(pattern);
+    bool_t match = regex_match(regex, str);
+    regex_destroy(&regex);
+    return match;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_test_regex(void)
+{
+    /* The accept state must not take the transitions of codepoint 0 */
+    test_check(i_match("cb", "cba") == FALSE);
+    test_check(i_match("cb", "cb") == TRUE);
+    test_check(i_match("cb", "c") == FALSE);
+    test_check(i_match("a*b[cd]*", "aaabcdc") == TRUE);
+    test_check(i_match("a*b[cd]*", "abx") == FALSE);
+
+    /* 2^8 DFA states, the state index is resized several times */
+    {
+        RegEx *regex = regex_create("[ab]*a[ab][ab][ab][ab][ab][ab][ab]");
+        char_t str[16];
+        uint32_t i, j;
+        for (i = 0; i < 4096; ++i)
+        {
+            for (j = 0; j < 12; ++j)
+                str[j] = (i >> j) & 1 ? 'a' : 'b';
+            str[12] = '\0';
+            test_check(regex_match(regex, str) == (bool_t)(str[4] == 'a'));
+        }
+
+        regex_destroy(&regex);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_search(const char_t *pattern, const char_t *str, const uint32_t start, const uint32_t end)
+{
+    RegEx *regex = regex_create(pattern);
+    uint32_t pstart = UINT32_MAX, pend = UINT32_MAX;
+    bool_t found = regex_search(regex, str, str_len_c(str), &pstart, &pend);
+    regex_destroy(&regex);
+    if (start == UINT32_MAX)
+        return (bool_t)(found == FALSE);
+    return (bool_t)(found == TRUE && pstart == start && pend == end);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Leftmost-longest match by brute force */
+static bool_t i_naive(const RegEx *regex, const char_t *str, uint32_t *start, uint32_t *end)
+{
+    char_t sub[32];
+    uint32_t n = str_len_c(str), i, j;
+    for (i = 0; i <= n; ++i)
+    {
+        for (j = n + 1; j > i; --j)
+        {
+            str_copy_cn(sub, 32, str + i, j - 1 - i);
+            sub[j - 1 - i] = '\0';
+            if (regex_match(regex, sub) == TRUE)
+            {
+                *start = i;
+                *end = j - 1;
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_test_search(void)
+{
+    test_check(i_search("cb", "accbaa", 2, 4) == TRUE);
+    test_check(i_search("cb", "accaa", UINT32_MAX, 0) == TRUE);
+    test_check(i_search("a[bc]*", "xxabcbd", 2, 6) == TRUE);
+    test_check(i_search("a*", "bab", 0, 0) == TRUE);
+    /* A thread of an earlier start returns to the start state */
+    test_check(i_search("(ab)*c", "xababcab", 1, 6) == TRUE);
+    test_check(i_search("x(ab)*", "abxababa", 2, 7) == TRUE);
+
+    /* Empty matches are not repeated at the end of the previous match */
+    {
+        RegEx *regex = regex_create("a*");
+        RegExIt *iter = regex_iter_mem(regex, "bab", 3);
+        uint32_t size;
+        uint64_t offset;
+        test_check(regex_iter_next(iter, &size, &offset) != NULL && offset == 0 && size == 0);
+        test_check(regex_iter_next(iter, &size, &offset) != NULL && offset == 1 && size == 1);
+        test_check(regex_iter_next(iter, &size, &offset) != NULL && offset == 3 && size == 0);
+        test_check(regex_iter_next(iter, &size, &offset) == NULL);
+        regex_iter_destroy(&iter);
+        regex_destroy(&regex);
+    }
+
+    /* All the strings of 'abc' up to length 7 */
+    {
+        const char_t *patterns[] = { "(ab)*c", "a*b", "[ab]*c", "b(a*c)*", "ab*", "c*" };
+        uint32_t i, j, k;
+        for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); ++i)
+        {
+            RegEx *regex = regex_create(patterns[i]);
+            for (j = 0; j < 2187; ++j)
+            {
+                char_t str[8];
+                uint32_t v = j, n = 1 + j % 7;
+                uint32_t start1 = 0, end1 = 0, start2 = 0, end2 = 0;
+                bool_t found1, found2;
+                for (k = 0; k < n; ++k, v /= 3)
+                    str[k] = (char_t)('a' + v % 3);
+                str[n] = '\0';
+                found1 = regex_search(regex, str, n, &start1, &end1);
+                found2 = i_naive(regex, str, &start2, &end2);
+                test_check(found1 == found2 && start1 == start2 && end1 == end2);
+            }
+
+            regex_destroy(&regex);
+        }
+    }
+
+    /* 2^13 DFA states: The DFA memory is exhausted and the search continues with the NFA simulation */
+    {
+        RegEx *regex = regex_create("a[ab][ab][ab][ab][ab][ab][ab][ab][ab][ab][ab][ab][ab]c");
+        char_t str[4096];
+        uint32_t i, j, seed = 1, start = 0, end = 0, from = 0;
+        for (i = 0; i < 4095; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            str[i] = (seed >> 16) % 31 == 0 ? 'c' : ((seed >> 16) & 1 ? 'a' : 'b');
+        }
+        str[4095] = '\0';
+
+        for (i = 0; i + 15 <= 4095; ++i)
+        {
+            bool_t match = (bool_t)(str[i] == 'a' && str[i + 14] == 'c');
+            for (j = i + 1; j < i + 14 && match == TRUE; ++j)
+                match = (bool_t)(str[j] != 'c');
+
+            if (match == TRUE)
+            {
+                test_check(regex_search(regex, str + from, 4095 - from, &start, &end) == TRUE);
+                test_check(from + start == i && from + end == i + 15);
+                from = i + 15;
+                i += 14;
+            }
+        }
+
+        test_check(regex_search(regex, str + from, 4095 - from, NULL, NULL) == FALSE);
+        regex_destroy(&regex);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_test_search_stm(void)
+{
+    uint32_t i, size = 300 * 1024;
+    byte_t *data = heap_new_n(size, byte_t);
+    for (i = 0; i < size; ++i)
+        data[i] = (byte_t)('a' + (i % 7));
+
+    /* Matches across the window bounds are found in the stream as in memory */
+    {
+        RegEx *regex = regex_create("ab[c-f]*");
+        RegExIt *iter1 = regex_iter_mem(regex, (const char_t*)data, size);
+        Stream *stm = stm_from_block(data, size);
+        RegExIt *iter2 = regex_iter_stm(regex, stm);
+        uint32_t n = 0;
+        for (;;)
+        {
+            uint32_t size1 = 0, size2 = 0;
+            uint64_t offset1 = 0, offset2 = 0;
+            const char_t *match1 = regex_iter_next(iter1, &size1, &offset1);
+            const char_t *match2 = regex_iter_next(iter2, &size2, &offset2);
+            test_check((match1 == NULL) == (match2 == NULL));
+            if (match1 == NULL || match2 == NULL)
+                break;
+            test_check(size1 == size2 && offset1 == offset2 && offset1 == n * 7);
+            n += 1;
+        }
+
+        test_check(n == (size - 2) / 7 + 1);
+        regex_iter_destroy(&iter1);
+        regex_iter_destroy(&iter2);
+        stm_close(&stm);
+        regex_destroy(&regex);
+    }
+
+    /* A match longer than the initial window: The window grows */
+    {
+        RegEx *regex = regex_create("<[a-g]*>");
+        Stream *stm = NULL;
+        RegExIt *iter = NULL;
+        const char_t *match = NULL;
+        uint32_t msize = 0;
+        uint64_t offset = 0;
+        data[10000] = '<';
+        data[10000 + 100000] = '>';
+        stm = stm_from_block(data, size);
+        iter = regex_iter_stm(regex, stm);
+        match = regex_iter_next(iter, &msize, &offset);
+        test_check(match != NULL && offset == 10000 && msize == 100001);
+        test_check(match != NULL && match[0] == '<' && match[msize - 1] == '>');
+        test_check(regex_iter_next(iter, NULL, NULL) == NULL);
+        test_check(regex_iter_truncated(iter) == FALSE);
+        regex_iter_destroy(&iter);
+        stm_close(&stm);
+        regex_destroy(&regex);
+        data[10000] = (byte_t)('a' + (10000 % 7));
+        data[10000 + 100000] = (byte_t)('a' + ((10000 + 100000) % 7));
+    }
+
+    /* '.*' takes the whole stream */
+    {
+        RegEx *regex = regex_create(".*");
+        Stream *stm = stm_from_block(data, size);
+        RegExIt *iter = regex_iter_stm(regex, stm);
+        uint32_t msize = 0;
+        test_check(regex_iter_next(iter, &msize, NULL) != NULL && msize == size);
+        test_check(regex_iter_next(iter, NULL, NULL) == NULL);
+        test_check(regex_iter_truncated(iter) == FALSE);
+        regex_iter_destroy(&iter);
+        stm_close(&stm);
+        regex_destroy(&regex);
+    }
+
+    /* Over the max window (16Mb), matches are truncated and reported */
+    {
+        uint32_t bsize = 17 * 1024 * 1024;
+        byte_t *big = heap_new_n(bsize, byte_t);
+        RegEx *regex = regex_create(".*");
+        Stream *stm = NULL;
+        RegExIt *iter = NULL;
+        uint64_t total = 0;
+        uint32_t msize = 0;
+        bmem_set1(big, bsize, 'a');
+        stm = stm_from_block(big, bsize);
+        iter = regex_iter_stm(regex, stm);
+        while (regex_iter_next(iter, &msize, NULL) != NULL)
+        {
+            test_check(msize <= 16 * 1024 * 1024);
+            total += msize;
+        }
+
+        test_check(total == bsize);
+        test_check(regex_iter_truncated(iter) == TRUE);
+        regex_iter_destroy(&iter);
+        stm_close(&stm);
+        regex_destroy(&regex);
+        heap_delete_n(&big, bsize, byte_t);
+    }
+
+    heap_delete_n(&data, size, byte_t);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Reads '"string"' or '["string", ...]' and checks the string value */
+static bool_t i_json_string(Stream *stm, const char_t *str)
+{
+    JsonReader *reader = json_reader_create(stm, NULL);
+    bool_t ok = FALSE;
+    jsonev_t event = json_reader_next(reader);
+    if (event == ekJSON_ARRAY_BEGIN)
+        event = json_reader_next(reader);
+
+    if (event == ekJSON_STRING)
+    {
+        uint32_t size = 0;
+        const char_t *text = json_reader_text(reader, &size);
+        ok = (bool_t)(size == str_len_c(str) && str_equ_c(text, str) == TRUE);
+    }
+
+    /* Whole input */
+    while (event != ekJSON_EOF && event != ekJSON_ERROR)
+        event = json_reader_next(reader);
+
+    json_reader_destroy(&reader);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_json_block(const char_t *json, const char_t *str)
+{
+    Stream *stm = stm_from_block((const byte_t*)json, str_len_c(json));
+    bool_t ok = i_json_string(stm, str);
+    stm_close(&stm);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+typedef struct _server_t i_Server;
+
+struct _server_t
+{
+    Socket *socket;
+    const char_t *response;
+    uint32_t nrequests;
+};
+
+/*---------------------------------------------------------------------------*/
+
+/* Sends the response in small pieces, as a slow peer */
+static uint32_t i_server_main(i_Server *server)
+{
+    Socket *client = bsocket_accept(server->socket, 5000, NULL);
+    if (client != NULL)
+    {
+        const char_t *data = server->response;
+        uint32_t size = str_len_c(data);
+        while (size > 0)
+        {
+            uint32_t n = size < 7 ? size : 7;
+            if (bsocket_write(client, (const byte_t*)data, n, NULL, NULL) == FALSE)
+                break;
+
+            data += n;
+            size -= n;
+            bthread_sleep(1);
+        }
+
+        bsocket_close(&client);
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Minimal HTTP/1.1 server: Each request in its own connection. The body is the request path */
+static uint32_t i_http_main(i_Server *server)
+{
+    uint32_t i;
+    for (i = 0; i < server->nrequests; ++i)
+    {
+        Socket *client = bsocket_accept(server->socket, 5000, NULL);
+        char_t request[1024];
+        uint32_t size = 0;
+        if (client == NULL)
+            break;
+
+        for (;;)
+        {
+            uint32_t rsize = 0;
+            if (size == sizeof(request) - 1 || bsocket_recv(client, (byte_t*)request + size, sizeof(request) - 1 - size, &rsize, NULL) == FALSE || rsize == 0)
+                break;
+
+            size += rsize;
+            request[size] = '\0';
+            if (str_str(request, "\r\n\r\n") != NULL)
+                break;
+        }
+
+        if (size > 4 && str_is_prefix(request, "GET ") == TRUE)
+        {
+            const char_t *path = request + 4;
+            const char_t *end = str_str(path, " ");
+            uint32_t psize = end != NULL ? (uint32_t)(end - path) : 0;
+            /* Out of the heap: this thread runs while the main thread uses it */
+            char_t response[1200];
+            uint32_t rsize = bstd_sprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Length: %u\r\nConnection: close\r\n\r\n%.*s", psize, (int)psize, path);
+            bsocket_write(client, (const byte_t*)response, rsize, NULL, NULL);
+        }
+
+        bsocket_close(&client);
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Loopback server. Returns the listening port. With 'nrequests' > 0 it's an HTTP server */
+static Thread *i_server(i_Server *server, const char_t *response, const uint32_t nrequests, uint16_t *port)
+{
+    server->socket = bsocket_server(0, 16, NULL);
+    server->response = response;
+    server->nrequests = nrequests;
+    if (server->socket == NULL)
+        return NULL;
+
+    bsocket_local_ip(server->socket, NULL, port);
+    if (nrequests > 0)
+        return bthread_create(i_http_main, server, i_Server);
+    return bthread_create(i_server_main, server, i_Server);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_server_end(i_Server *server, Thread **thread)
+{
+    bthread_wait(*thread);
+    bthread_close(thread);
+    bsocket_close(&server->socket);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_test_json(void)
+{
+    /* Zero length text runs */
+    test_check(i_json_block("\"x\"", "x") == TRUE);
+    test_check(i_json_block("\"\"", "") == TRUE);
+    test_check(i_json_block("\"a\\n\"", "a\n") == TRUE);
+    test_check(i_json_block("\"\\n\"", "\n") == TRUE);
+
+    /* Strings cut at the end of the parser buffer (4096 bytes) */
+    {
+        const char_t *strs[] = { "\"\"", "\"ab\"", "\"\\t\"", "\"a\\tb\"" };
+        const char_t *values[] = { "", "ab", "\t", "a\tb" };
+        char_t json[4200];
+        uint32_t i, j;
+        for (i = 0; i < sizeof(strs) / sizeof(strs[0]); ++i)
+        {
+            for (j = 4088; j < 4100; ++j)
+            {
+                bmem_set1((byte_t*)json, j, ' ');
+                json[0] = '[';
+                str_copy_c(json + j, 4200 - j, strs[i]);
+                str_cat_c(json, 4200, "]");
+                test_check(i_json_block(json, values[i]) == TRUE);
+            }
+        }
+    }
+
+    /* Empty keys */
+    {
+        const char_t *json = "{\"\":1, \"a\":2}";
+        Stream *stm = stm_from_block((const byte_t*)json, str_len_c(json));
+        JsonNode *node = json_read_node(stm, NULL);
+        test_check(node != NULL);
+        if (node != NULL)
+        {
+            const JsonNode *empty = json_node_member(node, "");
+            const JsonNode *a = json_node_member(node, "a");
+            test_check(empty != NULL && json_node_int64(empty) == 1);
+            test_check(a != NULL && json_node_int64(a) == 2);
+            json_node_destroy(&node);
+        }
+
+        stm_close(&stm);
+    }
+
+    /* Socket streams deliver data as it arrives */
+    {
+        i_Server server;
+        uint16_t port = 0;
+        Thread *thread = i_server(&server, "[\"socket stream\\n\", 1]", 0, &port);
+        test_check(thread != NULL);
+        if (thread != NULL)
+        {
+            Socket *socket = bsocket_connect(bsocket_str_ip("127.0.0.1"), port, 5000, NULL);
+            test_check(socket != NULL);
+            if (socket != NULL)
+            {
+                Stream *stm = stm_socket(socket);
+                test_check(i_json_string(stm, "socket stream\n") == TRUE);
+                stm_close(&stm);
+            }
+
+            i_server_end(&server, &thread);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_test_font_extents(void)
+{
+    Font *font = font_system(12, 0);
+    uint32_t hits0 = 0, misses0 = 0, hits1 = 0, misses1 = 0;
+    real32_t width = -1, height = -1;
+    font_extents_stats(&hits0, &misses0);
+
+    /* Empty text is measured and cached as any other */
+    font_extents(font, "", -1, &width, &height);
+    test_check(width >= 0 && height >= 0);
+    font_extents(font, "", -1, &width, &height);
+    font_extents(font, "Hello", -1, &width, &height);
+    test_check(width > 0 && height > 0);
+    font_extents(font, "Hello", -1, NULL, NULL);
+    font_extents_stats(&hits1, &misses1);
+    test_check(hits1 - hits0 == 2 && misses1 - misses0 == 2);
+    font_destroy(&font);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_test_http(void)
+{
+    /* Concurrent requests to a loopback server */
+    {
+        i_Server server;
+        uint16_t port = 0;
+        Thread *thread = i_server(&server, NULL, 8, &port);
+        test_check(thread != NULL);
+        if (thread != NULL)
+        {
+            HttpMulti *multi = http_multi_create(4);
+            Stream *bodies[8];
+            uint32_t i, ndone = 0;
+            for (i = 0; i < 8; ++i)
+            {
+                String *url = str_printf("http://127.0.0.1:%u/item/%u", (uint32_t)port, i);
+                ierror_t error = ekIUNDEF;
+                Http *http = NULL;
+                bodies[i] = stm_memory(64);
+                http = http_async_get(multi, tc(url), bodies[i], &error);
+                test_check(http != NULL && error == ekIOK);
+                str_destroy(&url);
+            }
+
+            while (ndone < 8)
+            {
+                Http *http = NULL;
+                ierror_t error = ekIUNDEF;
+                uint32_t running = http_multi_perform(multi, 100);
+                while ((http = http_multi_done(multi, &error)) != NULL)
+                {
+                    test_check(error == ekIOK && http_response_status(http) == 200);
+                    http_destroy(&http);
+                    ndone += 1;
+                }
+
+                if (running == 0 && ndone < 8)
+                {
+                    test_check(FALSE);
+                    break;
+                }
+            }
+
+            for (i = 0; i < 8; ++i)
+            {
+                String *path = str_printf("/item/%u", i);
+                test_check(stm_buffer_size(bodies[i]) == str_len(path));
+                test_check(bmem_cmp(stm_buffer(bodies[i]), (const byte_t*)tc(path), str_len(path)) == 0);
+                str_destroy(&path);
+                stm_close(&bodies[i]);
+            }
+
+            http_multi_destroy(&multi);
+            i_server_end(&server, &thread);
+        }
+    }
+
+    /* Synchronous requests report the curl error, as the async ones */
+    {
+        Socket *socket = bsocket_server(0, 1, NULL);
+        uint16_t port = 0;
+        test_check(socket != NULL);
+        if (socket != NULL)
+        {
+            String *url = NULL;
+            ierror_t error = ekIOK;
+            Stream *stm = NULL;
+            /* The port is free again: Nobody listens */
+            bsocket_local_ip(socket, NULL, &port);
+            bsocket_close(&socket);
+            url = str_printf("http://127.0.0.1:%u/", (uint32_t)port);
+            stm = http_dget(tc(url), NULL, &error);
+            test_check(stm == NULL && error == ekINOHOST);
+            if (stm != NULL)
+                stm_close(&stm);
+            str_destroy(&url);
+        }
+    }
+
+    /* Server failures: Nothing sent, body cut before Content-Length */
+    {
+        const char_t *responses[] = {
+            "",
+            "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\nshort" };
+        const ierror_t errors[] = { ekISERVER, ekISTREAM };
+        uint32_t i;
+        for (i = 0; i < 2; ++i)
+        {
+            i_Server server;
+            uint16_t port = 0;
+            Thread *thread = i_server(&server, responses[i], 0, &port);
+            test_check(thread != NULL);
+            if (thread != NULL)
+            {
+                String *url = str_printf("http://127.0.0.1:%u/", (uint32_t)port);
+                ierror_t error = ekIOK;
+                Stream *stm = http_dget(tc(url), NULL, &error);
+                test_check(stm == NULL && error == errors[i]);
+                if (stm != NULL)
+                    stm_close(&stm);
+                str_destroy(&url);
+                i_server_end(&server, &thread);
+            }
+        }
+    }
+
+    /* A failing body stream aborts the transfer */
+    {
+        i_Server server;
+        uint16_t port = 0;
+        Thread *thread = i_server(&server, NULL, 1, &port);
+        test_check(thread != NULL);
+        if (thread != NULL)
+        {
+            String *url = str_printf("http://127.0.0.1:%u/item/0", (uint32_t)port);
+            Stream *body = stm_memory(64);
+            ierror_t error = ekIOK;
+            stm_corrupt(body);
+            test_check(http_dget_stream(tc(url), body, NULL, &error) == FALSE);
+            test_check(error == ekISTREAM);
+            stm_close(&body);
+            str_destroy(&url);
+            i_server_end(&server, &thread);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* All threads (de)serialize the same type: They share its plan */
+static uint32_t i_dbind_main(Numbers *numbers)
+{
+    uint32_t i, fails = 0;
+    for (i = 0; i < 200; ++i)
+    {
+        Stream *stm = stm_memory(256);
+        Numbers *copy = NULL;
+        dbind_write(stm, numbers, Numbers);
+        copy = dbind_read(stm, Numbers);
+        if (copy == NULL || copy->id != numbers->id || arrst_size(copy->values, uint32_t) != arrst_size(numbers->values, uint32_t))
+            fails += 1;
+        else if (bmem_cmp((const byte_t*)arrst_all_const(copy->values, uint32_t), (const byte_t*)arrst_all_const(numbers->values, uint32_t), arrst_size(copy->values, uint32_t) * sizeof(uint32_t)) != 0)
+            fails += 1;
+        if (copy != NULL)
+            dbind_destroy(&copy, Numbers);
+        stm_close(&stm);
+    }
+
+    return fails;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_test_dbind(void)
+{
+    dbind(Numbers, uint32_t, id);
+    dbind(Numbers, ArrSt(uint32_t)*, values);
+
+    /* The plan is compiled by the first thread that needs it */
+    {
+        Numbers *numbers = dbind_create(Numbers);
+        Thread *threads[4];
+        uint32_t i;
+        numbers->id = 7;
+        for (i = 0; i < 10; ++i)
+            arrst_append(numbers->values, i * i, uint32_t);
+
+        for (i = 0; i < 4; ++i)
+            threads[i] = bthread_create(i_dbind_main, numbers, Numbers);
+
+        for (i = 0; i < 4; ++i)
+        {
+            test_check(bthread_wait(threads[i]) == 0);
+            bthread_close(&threads[i]);
+        }
+
+        dbind_destroy(&numbers, Numbers);
+    }
+
+    /* Hostile array size: 'n * sizeof(uint32_t)' overflows */
+    {
+        Stream *stm = stm_memory(64);
+        Numbers *numbers = NULL;
+        stm_write_u32(stm, 1);
+        stm_write_u32(stm, 0x40000001);
+        stm_write_u32(stm, 5);
+        numbers = dbind_read(stm, Numbers);
+        test_check(numbers == NULL || arrst_size(numbers->values, uint32_t) == 0);
+        if (numbers != NULL)
+            dbind_destroy(&numbers, Numbers);
+        stm_close(&stm);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    unref(argc);
+    unref(argv);
+    /* Small blocks are recycled in size classes */
+    heap_size_classes(TRUE);
+    core_start();
+    cassert_set_func(NULL, i_assert);
+    draw2d_start();
+    inet_start();
+    test_socket_poll();
+    test_pool();
+    test_heap();
+    test_log();
+    test_hashtab();
+    test_strbuf();
+    test_rbtree();
+    i_test_regex();
+    i_test_search();
+    i_test_search_stm();
+    i_test_dbind();
+    i_test_json();
+    i_test_http();
+    test_pixbuf_convert();
+    test_quantize();
+    test_resample();
+    test_extcache();
+    i_test_font_extents();
+    inet_finish();
+    draw2d_finish();
+    core_finish();
+
+    if (i_FAILS > 0)
+    {
+        bstd_printf("naptest: %u checks failed\n", i_FAILS);
+        return 1;
+    }
+
+    bstd_printf("naptest: all checks passed\n");
+    return 0;
+}
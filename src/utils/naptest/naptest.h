@@ -0,0 +1,40 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: naptest.h
+ *
+ */
+
+/* Regression tests */
+
+#include "core.hxx"
+
+#define test_check(cond)\
+    test_check_imp((bool_t)(cond), #cond, __FILE__, __LINE__)
+
+void test_check_imp(const bool_t ok, const char_t *cond, const char_t *file, const uint32_t line);
+
+void test_heap(void);
+
+void test_log(void);
+
+void test_hashtab(void);
+
+void test_strbuf(void);
+
+void test_rbtree(void);
+
+void test_socket_poll(void);
+
+void test_pool(void);
+
+void test_pixbuf_convert(void);
+
+void test_quantize(void);
+
+void test_resample(void);
+
+void test_extcache(void);
@@ -0,0 +1,883 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: ntcore.c
+ *
+ */
+
+/* core library tests */
+
+#include "naptest.h"
+#include "heap.h"
+#include "hashst.h"
+#include "hashpt.h"
+#include "rbtree.h"
+#include "hfile.h"
+#include "logbin.h"
+#include "stream.h"
+#include "strings.h"
+#include "buffer.h"
+#include "bfile.h"
+#include "log.h"
+#include "bmem.h"
+#include "bthread.h"
+#include "osbs.h"
+
+/*---------------------------------------------------------------------------*/
+
+typedef struct _hobj_t i_HObj;
+
+struct _hobj_t
+{
+    uint64_t key;
+};
+
+DeclPt(i_HObj);
+
+static uint32_t i_HOBJ_DESTROYED = 0;
+
+/*---------------------------------------------------------------------------*/
+
+typedef struct _heapth_t i_HeapTh;
+
+struct _heapth_t
+{
+    byte_t **blocks;
+    uint32_t n;
+};
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint32_t i_block_size(const uint32_t i)
+{
+    return i % 4 == 3 ? 300 : 8 + (i % 32) * 8;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Half of the blocks are freed by the main thread, after this one ends */
+static uint32_t i_heap_thread(i_HeapTh *th)
+{
+    uint32_t i;
+    for (i = 0; i < th->n; ++i)
+    {
+        th->blocks[i] = heap_malloc(i_block_size(i), "NapTestBlock");
+        th->blocks[i][0] = (byte_t)i;
+    }
+
+    for (i = 0; i < th->n; i += 2)
+        heap_free(&th->blocks[i], i_block_size(i), "NapTestBlock");
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * The arenas of ended threads are reused: Pages don't grow with new threads.
+ * Each arena keeps alive its current pages (at most two).
+ */
+static void i_heap_threads(void)
+{
+    uint32_t pages = heap_pages_alive(), round, i, j;
+    for (round = 0; round < 8; ++round)
+    {
+        i_HeapTh th[4];
+        Thread *thread[4];
+        heap_start_mt();
+        for (i = 0; i < 4; ++i)
+        {
+            th[i].n = 2000;
+            th[i].blocks = heap_new_n(th[i].n, byte_t*);
+            thread[i] = bthread_create(i_heap_thread, &th[i], i_HeapTh);
+        }
+
+        for (i = 0; i < 4; ++i)
+        {
+            bthread_wait(thread[i]);
+            bthread_close(&thread[i]);
+            for (j = 1; j < th[i].n; j += 2)
+            {
+                test_check(th[i].blocks[j][0] == (byte_t)j);
+                heap_free(&th[i].blocks[j], i_block_size(j), "NapTestBlock");
+            }
+
+            heap_delete_n(&th[i].blocks, th[i].n, byte_t*);
+        }
+
+        heap_end_mt();
+        test_check(heap_pages_alive() <= pages + 4 * 2);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* naptest runs with size classes: Idle slots must not pin their pages */
+void test_heap(void)
+{
+    uint32_t n = 20000, i;
+    uint32_t pages = heap_pages_alive();
+    byte_t **blocks = heap_new_n(n, byte_t*);
+
+    for (i = 0; i < n; ++i)
+    {
+        uint32_t size = 8 + (i % 16) * 8;
+        blocks[i] = heap_malloc(size, "NapTestBlock");
+        blocks[i][0] = (byte_t)i;
+    }
+
+    test_check(heap_pages_alive() > pages + 8);
+
+    /* Scrambled order, pages become empty at different times */
+    for (i = 0; i < n; ++i)
+    {
+        uint32_t j = (i * 7919) % n;
+        uint32_t size = 8 + (j % 16) * 8;
+        test_check(blocks[j][0] == (byte_t)j);
+        heap_free(&blocks[j], size, "NapTestBlock");
+    }
+
+    /* Only a few pages keep idle slots (current page, pages with other blocks) */
+    test_check(heap_pages_alive() <= pages + 4);
+
+    /* Slots are recycled again */
+    for (i = 0; i < n; ++i)
+        blocks[i] = heap_malloc(24, "NapTestBlock");
+    for (i = 0; i < n; ++i)
+        heap_free(&blocks[i], 24, "NapTestBlock");
+    test_check(heap_pages_alive() <= pages + 4);
+
+    heap_delete_n(&blocks, n, byte_t*);
+    i_heap_threads();
+}
+
+/*---------------------------------------------------------------------------*/
+
+static const char_t *i_LOG_LINES[] = {
+    "42 items, abc, 3.142",
+    "wxy|pq|   ab",
+    "   -17|z   |0000beef|-5",
+    "wide",
+    "100% done" };
+
+/*---------------------------------------------------------------------------*/
+
+static void i_log_events(void)
+{
+    /* Buffers without the final '\0', limited by the precision */
+    char_t buf4[4] = {'w', 'x', 'y', 'z'};
+    char_t buf2[2] = {'p', 'q'};
+    log_printf("%d items, %s, %.3f", 42, "abc", 3.14159);
+    log_printf("%.*s|%.2s|%5s", 3, buf4, buf2, "ab");
+    log_printf("%*d|%-4c|%08x|%lld", 6, -17, 'z', 0xBEEFu, (long long)-5);
+    /* Wide strings go as text records */
+    log_printf("%ls", L"wide");
+    log_printf("100%% done");
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Each line is "[time] text", the events are logged 'times' times */
+static bool_t i_log_check(Stream *stm, const uint32_t times)
+{
+    uint32_t i, j;
+    for (i = 0; i < times; ++i)
+    {
+        for (j = 0; j < sizeof(i_LOG_LINES) / sizeof(const char_t*); ++j)
+        {
+            const char_t *line = stm_read_line(stm);
+            const char_t *text = line != NULL ? str_str(line, "] ") : NULL;
+            if (text == NULL || str_equ_c(text + 2, i_LOG_LINES[j]) == FALSE)
+                return FALSE;
+        }
+    }
+
+    return (bool_t)(stm_read_line(stm) == NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_put(byte_t *data, uint32_t *pos, const void *value, const uint32_t size)
+{
+    bmem_copy(data + *pos, (const byte_t*)value, size);
+    *pos += size;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Definition and event records in a binary log */
+static uint32_t i_log_record(byte_t *data, uint32_t pos, const uint32_t id, const char_t *format, const byte_t *args, const uint16_t asize)
+{
+    uint16_t fsize = (uint16_t)str_len_c(format);
+    uint64_t time = 0;
+    data[pos++] = 'F';
+    i_put(data, &pos, &id, sizeof(id));
+    i_put(data, &pos, &fsize, sizeof(fsize));
+    i_put(data, &pos, format, fsize);
+    data[pos++] = 'E';
+    i_put(data, &pos, &id, sizeof(id));
+    i_put(data, &pos, &time, sizeof(time));
+    i_put(data, &pos, &asize, sizeof(asize));
+    i_put(data, &pos, args, asize);
+    return pos;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Formats of a damaged or hostile file don't drive printf */
+static void i_log_hostile(void)
+{
+    byte_t data[512];
+    byte_t args[16];
+    uint64_t value = 7;
+    int64_t star = -2000000000;
+    uint32_t pos = 8;
+    bmem_copy(data, (const byte_t*)"NLOG\1\0\0\0", 8);
+    data[6] = osbs_endian() == ekLITEND ? 0 : 1;
+    bmem_copy(args, (const byte_t*)&value, sizeof(value));
+    bmem_copy(args + 8, (const byte_t*)&star, sizeof(star));
+    pos = i_log_record(data, pos, 1, "%999999999d|", args, 8);
+    pos = i_log_record(data, pos, 2, "%d|%*d|%.999999999s", args, 16);
+    pos = i_log_record(data, pos, 3, "%5$n%d", args, 8);
+    pos = i_log_record(data, pos, 4, "%--++--5d|", args, 8);
+
+    {
+        Stream *stm = stm_memory(1024);
+        const char_t *line = NULL;
+        test_check(logbin_text(data, pos, stm) == TRUE);
+        /* Widths are bounded */
+        line = stm_read_line(stm);
+        test_check(line != NULL && str_len_c(line) < 1100 && str_str(line, "7|") != NULL);
+        /* Missing arguments */
+        line = stm_read_line(stm);
+        test_check(line != NULL && str_str(line, "<truncated>") != NULL);
+        /* Positional arguments are unknown */
+        line = stm_read_line(stm);
+        test_check(line != NULL && str_str(line, "<unknown conversion>") != NULL);
+        /* Repeated flags */
+        line = stm_read_line(stm);
+        test_check(line != NULL && str_str(line, "] +7   |") != NULL);
+        test_check(stm_read_line(stm) == NULL);
+        stm_close(&stm);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Binary (sync and async) and async text logs in the working dir, rendered back to text */
+void test_log(void)
+{
+    const char_t *pathname = "naptest.log";
+    Buffer *buffer = NULL;
+    log_output(FALSE, FALSE);
+
+    log_binary(TRUE);
+    log_file(pathname);
+    i_log_events();
+    log_async(TRUE, TRUE);
+    i_log_events();
+    log_flush();
+    log_async(FALSE, FALSE);
+    log_binary(FALSE);
+    log_file(NULL);
+
+    buffer = hfile_buffer(pathname, NULL);
+    test_check(buffer != NULL);
+    if (buffer != NULL)
+    {
+        Stream *stm = stm_memory(1024);
+        test_check(logbin_text(buffer_data(buffer), buffer_size(buffer), stm) == TRUE);
+        test_check(i_log_check(stm, 2) == TRUE);
+        stm_close(&stm);
+        buffer_destroy(&buffer);
+    }
+
+    log_file(pathname);
+    log_async(TRUE, TRUE);
+    i_log_events();
+    log_flush();
+    log_async(FALSE, FALSE);
+    log_file(NULL);
+
+    {
+        Stream *stm = hfile_stream(pathname, NULL);
+        test_check(stm != NULL);
+        if (stm != NULL)
+        {
+            test_check(i_log_check(stm, 1) == TRUE);
+            stm_close(&stm);
+        }
+    }
+
+    log_output(TRUE, FALSE);
+    bfile_delete(pathname, NULL);
+    i_log_hostile();
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 'hashst_next' leaves the position at the end of the slots */
+static uint32_t i_hash_capacity(HashSt(uint32_t) *hash)
+{
+    uint32_t pos = 0;
+    while (hashst_next(hash, &pos, uint32_t) != NULL) {}
+    return pos;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Same contents as the model: lookups, size and a full traversal */
+static bool_t i_hash_model(HashSt(uint32_t) *hash, const bool_t *present, const uint32_t *values, const uint32_t n)
+{
+    uint32_t i, count = 0, pos = 0;
+    bool_t ok = TRUE;
+    const uint32_t *value = NULL;
+    for (i = 0; i < n; ++i)
+    {
+        value = hashst_get(hash, &i, uint32_t);
+        if (present[i] == TRUE)
+        {
+            count += 1;
+            if (value == NULL || *value != values[i])
+                ok = FALSE;
+        }
+        else if (value != NULL)
+        {
+            ok = FALSE;
+        }
+    }
+
+    if (hashst_size(hash, uint32_t) != count)
+        ok = FALSE;
+
+    i = 0;
+    while ((value = hashst_next(hash, &pos, uint32_t)) != NULL)
+    {
+        const uint32_t *key = (const uint32_t*)hashst_key(hash, pos, uint32_t);
+        if (*key >= n || present[*key] == FALSE || values[*key] != *value)
+            ok = FALSE;
+        i += 1;
+    }
+
+    return (bool_t)(ok == TRUE && i == count);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_hobj_destroy(i_HObj **obj)
+{
+    heap_delete(obj, i_HObj);
+    i_HOBJ_DESTROYED += 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void test_hashtab(void)
+{
+    uint32_t n = 5000;
+    bool_t *present = heap_new_n0(n, bool_t);
+    uint32_t *values = heap_new_n0(n, uint32_t);
+
+    /* Deleting while the table grows: every third key is removed right after inserting the next */
+    {
+        HashSt(uint32_t) *hash = hashst_create(uint32_t, uint32_t);
+        uint32_t k;
+        for (k = 0; k < n; ++k)
+        {
+            uint32_t *value = hashst_insert(hash, &k, uint32_t);
+            test_check(value != NULL && *value == 0);
+            *value = k * 7 + 1;
+            values[k] = k * 7 + 1;
+            present[k] = TRUE;
+            test_check(hashst_insert(hash, &k, uint32_t) == NULL);
+            if (k % 3 == 2)
+            {
+                uint32_t key = k - 1;
+                test_check(hashst_delete(hash, &key, NULL, uint32_t) == TRUE);
+                test_check(hashst_delete(hash, &key, NULL, uint32_t) == FALSE);
+                present[key] = FALSE;
+            }
+
+            if (k % 499 == 0)
+                test_check(i_hash_model(hash, present, values, n) == TRUE);
+        }
+
+        test_check(i_hash_model(hash, present, values, n) == TRUE);
+        /* Load factor at most 3/4 */
+        test_check(hashst_size(hash, uint32_t) * 4 <= i_hash_capacity(hash) * 3);
+
+        /* Delete everything, in an order unrelated to the slots */
+        for (k = 0; k < n; ++k)
+        {
+            uint32_t key = (k * 761) % n;
+            test_check(hashst_delete(hash, &key, NULL, uint32_t) == present[key]);
+            present[key] = FALSE;
+        }
+
+        test_check(hashst_size(hash, uint32_t) == 0);
+        test_check(i_hash_model(hash, present, values, n) == TRUE);
+        hashst_destroy(&hash, NULL, uint32_t);
+    }
+
+    /* Random inserts and deletes over a small key range: long clusters that wrap around */
+    {
+        HashSt(uint32_t) *hash = hashst_create(uint32_t, uint32_t);
+        uint32_t seed = 5, i, range = 600;
+        for (i = 0; i < 40000; ++i)
+        {
+            uint32_t key;
+            seed = seed * 1103515245 + 12345;
+            key = (seed >> 8) % range;
+            if ((seed >> 20) % 2 == 0)
+            {
+                uint32_t *value = hashst_insert(hash, &key, uint32_t);
+                test_check((value != NULL) == (present[key] == FALSE));
+                if (value != NULL)
+                {
+                    *value = i;
+                    values[key] = i;
+                    present[key] = TRUE;
+                }
+            }
+            else
+            {
+                test_check(hashst_delete(hash, &key, NULL, uint32_t) == present[key]);
+                present[key] = FALSE;
+            }
+
+            if (i % 997 == 0)
+                test_check(i_hash_model(hash, present, values, range) == TRUE);
+        }
+
+        test_check(i_hash_model(hash, present, values, range) == TRUE);
+        hashst_destroy(&hash, NULL, uint32_t);
+        bmem_set_zero((byte_t*)present, n * sizeof(bool_t));
+    }
+
+    /* No tombstones: insert/delete cycles neither grow the table nor slow lookups */
+    {
+        HashSt(uint32_t) *hash = hashst_create(uint32_t, uint32_t);
+        uint32_t k, capacity;
+        for (k = 0; k < 8; ++k)
+        {
+            *hashst_insert(hash, &k, uint32_t) = k + 1;
+            values[k] = k + 1;
+            present[k] = TRUE;
+        }
+
+        capacity = i_hash_capacity(hash);
+        for (k = 8; k < n; ++k)
+        {
+            test_check(hashst_insert(hash, &k, uint32_t) != NULL);
+            test_check(hashst_delete(hash, &k, NULL, uint32_t) == TRUE);
+        }
+
+        test_check(i_hash_capacity(hash) == capacity);
+        test_check(i_hash_model(hash, present, values, n) == TRUE);
+        hashst_destroy(&hash, NULL, uint32_t);
+        bmem_set_zero((byte_t*)present, n * sizeof(bool_t));
+    }
+
+    /* Pointer tables own their objects through the destroy function */
+    {
+        HashPt(i_HObj) *hash = hashpt_create(uint64_t, i_HObj);
+        uint64_t k;
+        i_HOBJ_DESTROYED = 0;
+        for (k = 0; k < 1000; ++k)
+        {
+            uint64_t key = k << 40 | k;
+            i_HObj *obj = heap_new(i_HObj);
+            obj->key = key;
+            test_check(hashpt_insert(hash, &key, obj, i_HObj) == TRUE);
+            test_check(hashpt_insert(hash, &key, obj, i_HObj) == FALSE);
+        }
+
+        for (k = 0; k < 1000; k += 2)
+        {
+            uint64_t key = k << 40 | k;
+            test_check(hashpt_delete(hash, &key, i_hobj_destroy, i_HObj) == TRUE);
+        }
+
+        test_check(i_HOBJ_DESTROYED == 500);
+        test_check(hashpt_size(hash, i_HObj) == 500);
+        for (k = 0; k < 1000; ++k)
+        {
+            uint64_t key = k << 40 | k;
+            const i_HObj *obj = hashpt_get(hash, &key, i_HObj);
+            test_check(k % 2 == 0 ? obj == NULL : (obj != NULL && obj->key == key));
+        }
+
+        hashpt_foreach(obj, hash, i_HObj)
+            test_check(*(const uint64_t*)hashpt_key(hash, obj_pos, i_HObj) == obj->key);
+        hashpt_fornext(obj, hash, i_HObj)
+
+        hashpt_destroy(&hash, i_hobj_destroy, i_HObj);
+        test_check(i_HOBJ_DESTROYED == 1000);
+    }
+
+    heap_delete_n(&present, n, bool_t);
+    heap_delete_n(&values, n, uint32_t);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 'n' chars from a fixed pattern, starting at 'start' */
+static void i_pattern(char_t *dest, const uint32_t start, const uint32_t n)
+{
+    uint32_t i;
+    for (i = 0; i < n; ++i)
+        dest[i] = (char_t)('a' + (start + i) % 26);
+    dest[n] = '\0';
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_repl(const char_t *result, String *str)
+{
+    bool_t ok = str_equ_c(tc(str), result);
+    ok = (bool_t)(ok == TRUE && str_len(str) == str_len_c(result));
+    str_destroy(&str);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void test_strbuf(void)
+{
+    /* Growth past the initial capacity, mixing all the appends */
+    {
+        StrBuf *buf = strbuf_create(4);
+        char_t *expected = heap_new_n(20000, char_t);
+        char_t piece[300];
+        uint32_t i, len = 0;
+        test_check(strbuf_len(buf) == 0 && str_equ_c(strbuf_data(buf), "") == TRUE);
+        for (i = 0; len < 19000; ++i)
+        {
+            uint32_t n = (i * 37) % 250;
+            i_pattern(piece, i, n);
+            switch (i % 3) {
+            case 0:
+                strbuf_cat(buf, piece);
+                break;
+            case 1:
+                strbuf_cat_n(buf, piece, n);
+                break;
+            default:
+                /* Results shorter and longer than the spare room */
+                strbuf_printf(buf, "%s", piece);
+            }
+
+            bmem_copy((byte_t*)(expected + len), (const byte_t*)piece, n + 1);
+            len += n;
+            test_check(strbuf_len(buf) == len);
+        }
+
+        test_check(str_equ_c(strbuf_data(buf), expected) == TRUE);
+        strbuf_printf(buf, "%u-%s-%d", 12345u, "xyz", -7);
+        test_check(str_equ_c(strbuf_data(buf) + len, "12345-xyz--7") == TRUE);
+        strbuf_cat_n(buf, "abc", 0);
+        test_check(strbuf_len(buf) == len + 12);
+        strbuf_clear(buf);
+        test_check(strbuf_len(buf) == 0 && str_equ_c(strbuf_data(buf), "") == TRUE);
+        strbuf_cat(buf, "again");
+        test_check(str_equ_c(strbuf_data(buf), "again") == TRUE);
+        strbuf_destroy(&buf);
+        heap_delete_n(&expected, 20000, char_t);
+    }
+
+    /* 'strbuf_take' gives an exact size String and leaves the buffer empty and usable */
+    {
+        StrBuf *buf = strbuf_create(0);
+        String *str = strbuf_take(buf);
+        test_check(str_equ_c(tc(str), "") == TRUE && str_len(str) == 0);
+        str_destroy(&str);
+
+        strbuf_cat(buf, "hello");
+        str = strbuf_take(buf);
+        test_check(strbuf_len(buf) == 0 && str_equ_c(strbuf_data(buf), "") == TRUE);
+        test_check(str_equ_c(tc(str), "hello") == TRUE && str_len(str) == 5);
+        /* The taken String is a regular one */
+        str_cat(&str, " world");
+        test_check(str_equ_c(tc(str), "hello world") == TRUE);
+        str_destroy(&str);
+
+        {
+            char_t piece[1001];
+            uint32_t n;
+            for (n = 0; n < 1000; n += 61)
+            {
+                i_pattern(piece, n, n);
+                strbuf_cat_n(buf, piece, n);
+                str = strbuf_take(buf);
+                test_check(str_len(str) == n && str_equ_c(tc(str), piece) == TRUE);
+                str_destroy(&str);
+            }
+        }
+
+        /* Exactly full buffer, no shrink */
+        strbuf_destroy(&buf);
+        buf = strbuf_create(16);
+        strbuf_cat(buf, "0123456789abcde");
+        str = strbuf_take(buf);
+        test_check(str_len(str) == 15 && str_equ_c(tc(str), "0123456789abcde") == TRUE);
+        str_destroy(&str);
+        strbuf_destroy(&buf);
+    }
+
+    /* Replacements go left to right, without overlaps, one pair after another */
+    test_check(i_repl("bb", str_repl("aaaa", "aa", "b", NULL)) == TRUE);
+    test_check(i_repl("ba", str_repl("aaa", "aa", "b", NULL)) == TRUE);
+    test_check(i_repl("aba", str_repl("aba", "ab", "aba", "aa", "a", NULL)) == TRUE);
+    test_check(i_repl("aab", str_repl("ab", "a", "aa", NULL)) == TRUE);
+    test_check(i_repl("ccc", str_repl("abc", "a", "b", "b", "c", NULL)) == TRUE);
+    test_check(i_repl("", str_repl("aaa", "a", "", NULL)) == TRUE);
+    test_check(i_repl("", str_repl("aaa", "a", "", "", "x", NULL)) == TRUE);
+    test_check(i_repl("xyz", str_repl("xaybz", "a", "", "b", "", NULL)) == TRUE);
+    /* Empty patterns and NULL replacements are ignored */
+    test_check(i_repl("abc", str_repl("abc", "", "x", NULL)) == TRUE);
+    test_check(i_repl("abc", str_repl("abc", "b", NULL, NULL)) == TRUE);
+    test_check(i_repl("", str_repl("", "a", "b", NULL)) == TRUE);
+    test_check(i_repl("abc", str_repl("abc", NULL)) == TRUE);
+    test_check(i_repl("abc", str_repl("abc", "abcd", "x", NULL)) == TRUE);
+    test_check(i_repl("x", str_repl("abc", "abc", "x", NULL)) == TRUE);
+
+    /* Long results, many matches */
+    {
+        char_t *src = heap_new_n(3001, char_t);
+        String *str = NULL;
+        uint32_t i;
+        for (i = 0; i < 3000; ++i)
+            src[i] = (char_t)(i % 3 == 0 ? '#' : '.');
+        src[3000] = '\0';
+        str = str_repl(src, "#", "<tag>", NULL);
+        test_check(str_len(str) == 2000 + 1000 * 5);
+        test_check(str_equ_c(tc(str) + str_len(str) - 7, "<tag>..") == TRUE);
+        str_destroy(&str);
+        str = str_repl(src, "#", "<tag>", "<tag>", "#", NULL);
+        test_check(str_equ_c(tc(str), src) == TRUE);
+        str_destroy(&str);
+        heap_delete_n(&src, 3001, char_t);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int i_cmp_u32(const uint32_t *value1, const uint32_t *value2)
+{
+    return *value1 < *value2 ? -1 : (*value1 > *value2 ? 1 : 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Odd keys 1, 3, ..., 2n-1 */
+static RBTree *i_odd_tree(uint32_t *keys, const uint32_t n)
+{
+    uint32_t i;
+    for (i = 0; i < n; ++i)
+        keys[i] = 2 * i + 1;
+    return rbtree_from_sorted((FPtr_compare)i_cmp_u32, (const byte_t*)keys, n, sizeof(uint32_t), FALSE, "NapTestTree");
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Balance, sizes and the in-order sequence, both ways */
+static bool_t i_tree_is(const RBTree *tree, const uint32_t *keys, const uint32_t n)
+{
+    RBIter iter;
+    const uint32_t *elem = NULL;
+    uint32_t i = 0;
+    bool_t ok = (bool_t)(rbtree_check(tree) == TRUE && rbtree_size(tree) == n);
+
+    elem = (const uint32_t*)rbtree_iter_begin(tree, &iter, FALSE);
+    while (elem != NULL)
+    {
+        if (i >= n || *elem != keys[i])
+            ok = FALSE;
+        i += 1;
+        elem = (const uint32_t*)rbtree_iter_next(&iter);
+    }
+
+    if (i != n || rbtree_iter_next(&iter) != NULL)
+        ok = FALSE;
+
+    elem = (const uint32_t*)rbtree_iter_end(tree, &iter, FALSE);
+    while (elem != NULL)
+    {
+        if (i == 0 || *elem != keys[i - 1])
+            ok = FALSE;
+        i -= 1;
+        elem = (const uint32_t*)rbtree_iter_prev(&iter);
+    }
+
+    return (bool_t)(ok == TRUE && i == 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* First odd key >= 'value' in a tree of 'n' odd keys */
+static const uint32_t *i_odd_lower(const uint32_t *keys, const uint32_t n, const uint32_t value)
+{
+    uint32_t i = value / 2;
+    return i < n ? keys + i : NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_tree_seeks(const RBTree *tree, const uint32_t *keys, const uint32_t n)
+{
+    bool_t ok = TRUE;
+    uint32_t v;
+    for (v = 0; v <= 2 * n + 1; ++v)
+    {
+        RBIter iter;
+        const uint32_t *lower = i_odd_lower(keys, n, v);
+        const uint32_t *upper = i_odd_lower(keys, n, v + 1);
+        const uint32_t *elem = (const uint32_t*)rbtree_iter_seek(tree, &iter, &v, FALSE);
+        if (v % 2 == 1 && v < 2 * n)
+            ok = (bool_t)(ok == TRUE && elem != NULL && *elem == v);
+        else
+            ok = (bool_t)(ok == TRUE && elem == NULL);
+
+        elem = (const uint32_t*)rbtree_iter_lower(tree, &iter, &v, FALSE);
+        ok = (bool_t)(ok == TRUE && (lower == NULL ? elem == NULL : (elem != NULL && *elem == *lower)));
+
+        /* Seek paths go on as any other iterator */
+        if (elem != NULL)
+        {
+            const uint32_t *prev = (const uint32_t*)rbtree_iter_prev(&iter);
+            ok = (bool_t)(ok == TRUE && (lower == keys ? prev == NULL : (prev != NULL && *prev == *(lower - 1))));
+        }
+
+        elem = (const uint32_t*)rbtree_iter_upper(tree, &iter, &v, FALSE);
+        ok = (bool_t)(ok == TRUE && (upper == NULL ? elem == NULL : (elem != NULL && *elem == *upper)));
+        if (elem != NULL)
+        {
+            const uint32_t *next = (const uint32_t*)rbtree_iter_next(&iter);
+            ok = (bool_t)(ok == TRUE && (upper == keys + n - 1 ? next == NULL : (next != NULL && *next == *(upper + 1))));
+        }
+    }
+
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Odd keys in [lo, hi) */
+static uint32_t i_odd_count(const uint32_t n, const uint32_t lo, const uint32_t hi)
+{
+    uint32_t first = lo / 2, last = hi / 2;
+    if (first > n)
+        first = n;
+    if (last > n)
+        last = n;
+    return last > first ? last - first : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void test_rbtree(void)
+{
+    /* Sizes coprime with 7, so 'i * 7 % n' scatters all the keys */
+    const uint32_t sizes[] = { 0, 1, 2, 24, 47, 100, 211, 299 };
+    uint32_t *keys = heap_new_n(300, uint32_t);
+    uint32_t *rest = heap_new_n(300, uint32_t);
+    uint32_t n, s;
+
+    /* Bulk loaded trees of every size up to 300 */
+    for (n = 0; n < 300; ++n)
+    {
+        /* Ranges: empty, reversed, a few elements (one by one) and most of them (rebuild) */
+        const uint32_t ranges[][2] = {
+            { 0, 0 }, { 7, 3 }, { n, n + 5 }, { n / 2, n / 2 + 4 }, { 0, 3 },
+            { 2 * n - 4, 2 * n + 9 }, { 2, 2 * n - 2 }, { 0, 2 * n + 2 }, { n / 3, 2 * n } };
+        RBTree *tree = i_odd_tree(keys, n);
+        uint32_t i, j;
+        test_check(i_tree_is(tree, keys, n) == TRUE);
+        test_check(i_tree_seeks(tree, keys, n) == TRUE);
+
+        for (i = 0; i < sizeof(ranges) / sizeof(ranges[0]); ++i)
+        {
+            uint32_t lo = ranges[i][0], hi = ranges[i][1];
+            test_check(rbtree_count_range(tree, &lo, &hi, FALSE) == (lo < hi ? i_odd_count(n, lo, hi) : 0));
+        }
+
+        rbtree_destroy(&tree, NULL, NULL, "NapTestTree");
+
+        for (i = 0; i < sizeof(ranges) / sizeof(ranges[0]); ++i)
+        {
+            uint32_t lo = ranges[i][0], hi = ranges[i][1];
+            uint32_t ndel = lo < hi ? i_odd_count(n, lo, hi) : 0, nrest = 0;
+            tree = i_odd_tree(keys, n);
+            test_check(rbtree_delete_range(tree, &lo, &hi, NULL, NULL) == ndel);
+            for (j = 0; j < n; ++j)
+            {
+                if (lo >= hi || keys[j] < lo || keys[j] >= hi)
+                    rest[nrest++] = keys[j];
+            }
+
+            test_check(nrest == n - ndel);
+            test_check(i_tree_is(tree, rest, nrest) == TRUE);
+            test_check(rbtree_count_range(tree, &lo, &hi, FALSE) == 0);
+
+            /* The tree left by a range delete keeps working */
+            for (j = 0; j < nrest; j += 3)
+                test_check(rbtree_delete(tree, &rest[j], NULL, NULL) == TRUE);
+
+            for (j = 0; j < nrest; j += 3)
+            {
+                uint32_t *elem = (uint32_t*)rbtree_insert(tree, &rest[j], NULL);
+                test_check(elem != NULL);
+                if (elem != NULL)
+                    *elem = rest[j];
+            }
+
+            test_check(i_tree_is(tree, rest, nrest) == TRUE);
+            rbtree_destroy(&tree, NULL, NULL, "NapTestTree");
+        }
+    }
+
+    /* Trees grown by single inserts */
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        RBTree *tree = rbtree_create((FPtr_compare)i_cmp_u32, sizeof(uint32_t), 0, "NapTestTree");
+        uint32_t i, lo, hi;
+        n = sizes[s];
+        for (i = 0; i < n; ++i)
+        {
+            uint32_t k = 2 * ((i * 7) % n) + 1;
+            uint32_t *elem = (uint32_t*)rbtree_insert(tree, &k, NULL);
+            test_check(elem != NULL);
+            if (elem != NULL)
+                *elem = k;
+            keys[i] = 2 * i + 1;
+        }
+
+        test_check(i_tree_is(tree, keys, n) == TRUE);
+        test_check(i_tree_seeks(tree, keys, n) == TRUE);
+
+        /* Iterators over a tree changed by deletes */
+        for (i = 0; i < n; i += 2)
+            test_check(rbtree_delete(tree, &keys[i], NULL, NULL) == TRUE);
+
+        for (i = 1; i < n; i += 2)
+            keys[i / 2] = keys[i];
+
+        test_check(i_tree_is(tree, keys, n / 2) == TRUE);
+
+        /* Range operations over an inserted tree */
+        n /= 2;
+        lo = keys[n / 4] - 1;
+        hi = n > 0 ? keys[n - n / 4 - 1] + 1 : 0;
+        test_check(rbtree_count_range(tree, &lo, &hi, FALSE) == n - 2 * (n / 4));
+        test_check(rbtree_delete_range(tree, &lo, &hi, NULL, NULL) == n - 2 * (n / 4));
+        test_check(rbtree_check(tree) == TRUE);
+        test_check(rbtree_size(tree) == 2 * (n / 4));
+        rbtree_destroy(&tree, NULL, NULL, "NapTestTree");
+    }
+
+    heap_delete_n(&keys, 300, uint32_t);
+    heap_delete_n(&rest, 300, uint32_t);
+}
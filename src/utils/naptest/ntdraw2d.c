@@ -0,0 +1,812 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: ntdraw2d.c
+ *
+ */
+
+/* draw2d library tests */
+
+#include "naptest.h"
+#include "extcache.inl"
+#include "color.h"
+#include "palette.h"
+#include "pixbuf.h"
+#include "bmath.h"
+#include "bmem.h"
+#include "bpool.h"
+#include "cassert.h"
+#include "ptr.h"
+#include "bstd.h"
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE color_t i_rgba(const uint32_t r, const uint32_t g, const uint32_t b, const uint32_t a)
+{
+    return (color_t)((a << 24) | (b << 16) | (g << 8) | r);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static __INLINE uint32_t i_channel(const color_t c, const uint32_t k)
+{
+    return (uint32_t)((c >> (k * 8)) & 0xFF);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_is_indexed(const pixformat_t format)
+{
+    return (bool_t)(format == ekINDEX1 || format == ekINDEX2 || format == ekINDEX4 || format == ekINDEX8);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Random pixels. Indexed values can take any index of its format */
+static Pixbuf *i_random_pixbuf(const uint32_t width, const uint32_t height, const pixformat_t format, uint32_t *seed)
+{
+    Pixbuf *pixbuf = pixbuf_create(width, height, format);
+    uint32_t i, j;
+    for (j = 0; j < height; ++j)
+    {
+        for (i = 0; i < width; ++i)
+        {
+            uint32_t v = i_rand(seed);
+            if (i_is_indexed(format) == TRUE)
+                v %= 1u << pixbuf_format_bpp(format);
+            else if (format == ekGRAY8)
+                v &= 0xFF;
+            else if (format == ekRGB24)
+                v |= 0xFF000000;
+            else
+                v = v | (i_rand(seed) << 24);
+            pixbuf_set(pixbuf, i, j, v);
+        }
+    }
+
+    return pixbuf;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static Palette *i_random_palette(const uint32_t size, uint32_t *seed)
+{
+    Palette *palette = palette_create(size);
+    color_t *colors = palette_colors(palette);
+    uint32_t i;
+    for (i = 0; i < size; ++i)
+        colors[i] = (color_t)(i_rand(seed) | (i_rand(seed) << 24));
+    return palette;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_dist(const color_t c1, const color_t c2)
+{
+    uint32_t k, d = 0;
+    for (k = 0; k < 4; ++k)
+    {
+        int32_t dk = (int32_t)i_channel(c1, k) - (int32_t)i_channel(c2, k);
+        d += (uint32_t)(dk * dk);
+    }
+
+    return d;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 'index' is one of the nearest colors of the first 'n' palette entries */
+static bool_t i_is_nearest(const color_t *colors, const uint32_t n, const color_t c, const uint32_t index)
+{
+    uint32_t i, dist = i_dist(c, colors[index]);
+    if (index >= n)
+        return FALSE;
+
+    for (i = 0; i < n; ++i)
+    {
+        if (i_dist(c, colors[i]) < dist)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Pixel as color, one by one through 'pixbuf_get' */
+static color_t i_pixel_color(const Pixbuf *pixbuf, const Palette *palette, const uint32_t x, const uint32_t y)
+{
+    uint32_t v = pixbuf_get(pixbuf, x, y);
+    switch (pixbuf_format(pixbuf)) {
+    case ekINDEX1:
+    case ekINDEX2:
+    case ekINDEX4:
+    case ekINDEX8:
+        cassert(v < palette_size(palette));
+        return palette_ccolors(palette)[v];
+    case ekGRAY8:
+        return i_rgba(v, v, v, 255);
+    case ekRGB24:
+    case ekRGBA32:
+        return (color_t)v;
+    case ekFIMAGE:
+    cassert_default();
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Scalar reference of one converted pixel */
+static bool_t i_convert_pixel(const Pixbuf *src, const Pixbuf *dest, const Palette *palette, const uint32_t x, const uint32_t y)
+{
+    pixformat_t iformat = pixbuf_format(src);
+    pixformat_t oformat = pixbuf_format(dest);
+    color_t c = i_pixel_color(src, palette, x, y);
+    uint32_t v = pixbuf_get(dest, x, y);
+    switch (oformat) {
+    case ekINDEX1:
+    case ekINDEX2:
+    case ekINDEX4:
+    case ekINDEX8:
+    {
+        uint32_t n = 1u << pixbuf_format_bpp(oformat);
+        if (palette_size(palette) < n)
+            n = palette_size(palette);
+
+        /* Indices that fit are kept */
+        if (i_is_indexed(iformat) == TRUE && pixbuf_get(src, x, y) < n)
+            return (bool_t)(v == pixbuf_get(src, x, y));
+        return i_is_nearest(palette_ccolors(palette), n, c, v);
+    }
+
+    case ekGRAY8:
+        return (bool_t)(v == (77 * i_channel(c, 0) + 148 * i_channel(c, 1) + 30 * i_channel(c, 2)) / 255);
+    case ekRGB24:
+        return (bool_t)(v == (c | 0xFF000000));
+    case ekRGBA32:
+        return (bool_t)(v == c);
+    case ekFIMAGE:
+    cassert_default();
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Every format pair against the pixel by pixel result. Sizes with odd
+ * widths and pixel counts that leave tails to the vector kernels.
+ */
+void test_pixbuf_convert(void)
+{
+    const pixformat_t formats[] = { ekINDEX1, ekINDEX2, ekINDEX4, ekINDEX8, ekGRAY8, ekRGB24, ekRGBA32 };
+    const uint32_t widths[] = { 1, 7, 16, 17, 31, 33, 67 };
+    const uint32_t nformats = sizeof(formats) / sizeof(formats[0]);
+    uint32_t seed = 17;
+    uint32_t i, j, w;
+
+    for (i = 0; i < nformats; ++i)
+    {
+        for (j = 0; j < nformats; ++j)
+        {
+            if (i == j)
+                continue;
+
+            for (w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+            {
+                uint32_t width = widths[w], height = 3 + w % 3;
+                Pixbuf *src = i_random_pixbuf(width, height, formats[i], &seed);
+                Palette *palette = NULL;
+                Pixbuf *dest = NULL;
+                uint32_t x, y, fails = 0;
+
+                /* Source palette of indexed inputs, target palette of the rest */
+                if (i_is_indexed(formats[i]) == TRUE)
+                    palette = i_random_palette(1u << pixbuf_format_bpp(formats[i]), &seed);
+                else if (i_is_indexed(formats[j]) == TRUE)
+                    palette = i_random_palette(1u << pixbuf_format_bpp(formats[j]), &seed);
+
+                dest = pixbuf_convert(src, palette, formats[j]);
+                test_check(pixbuf_format(dest) == formats[j]);
+                test_check(pixbuf_width(dest) == width && pixbuf_height(dest) == height);
+                for (y = 0; y < height; ++y)
+                {
+                    for (x = 0; x < width; ++x)
+                    {
+                        if (i_convert_pixel(src, dest, palette, x, y) == FALSE)
+                            fails += 1;
+                    }
+                }
+
+                test_check(fails == 0);
+                pixbuf_destroy(&src);
+                pixbuf_destroy(&dest);
+                ptr_destopt(palette_destroy, &palette, Palette);
+            }
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* 'ncolors' different colors (with alpha in RGBA32 images) in random order */
+static Pixbuf *i_few_colors(const uint32_t width, const uint32_t height, const pixformat_t format, const uint32_t ncolors, uint32_t *seed)
+{
+    Pixbuf *pixbuf = pixbuf_create(width, height, format);
+    uint32_t i, j;
+    cassert(ncolors <= 256);
+    for (j = 0; j < height; ++j)
+    {
+        for (i = 0; i < width; ++i)
+        {
+            /* All the colors appear at least once */
+            uint32_t k = j * width + i < ncolors ? j * width + i : i_rand(seed) % ncolors;
+            if (format == ekGRAY8)
+                pixbuf_set(pixbuf, i, j, k);
+            else if (format == ekRGB24)
+                pixbuf_set(pixbuf, i, j, i_rgba(k, 255 - k, (k * 7) & 0xFF, 255));
+            else
+                pixbuf_set(pixbuf, i, j, i_rgba(k, 255 - k, (k * 7) & 0xFF, (k * 13) & 0xFF));
+        }
+    }
+
+    return pixbuf;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Smooth gradients with thousands of colors */
+static Pixbuf *i_gradient(const uint32_t width, const uint32_t height)
+{
+    Pixbuf *pixbuf = pixbuf_create(width, height, ekRGB24);
+    uint32_t i, j;
+    for (j = 0; j < height; ++j)
+    {
+        for (i = 0; i < width; ++i)
+            pixbuf_set(pixbuf, i, j, i_rgba(i * 255 / (width - 1), j * 255 / (height - 1), (i + j) * 255 / (width + height - 2), 255));
+    }
+
+    return pixbuf;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Images with 'ncolors' or less are mapped back without loss */
+static bool_t i_lossless(const Pixbuf *pixbuf, const Pixbuf *indexed, const Palette *palette)
+{
+    uint32_t i, j;
+    for (j = 0; j < pixbuf_height(pixbuf); ++j)
+    {
+        for (i = 0; i < pixbuf_width(pixbuf); ++i)
+        {
+            if (i_pixel_color(indexed, palette, i, j) != i_pixel_color(pixbuf, NULL, i, j))
+                return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Mean of a channel of the original and the quantized image */
+static void i_means(const Pixbuf *pixbuf, const Pixbuf *indexed, const Palette *palette, const uint32_t k, real64_t *mean, real64_t *qmean, real64_t *error)
+{
+    uint32_t i, j, n = pixbuf_width(pixbuf) * pixbuf_height(pixbuf);
+    *mean = 0;
+    *qmean = 0;
+    *error = 0;
+    for (j = 0; j < pixbuf_height(pixbuf); ++j)
+    {
+        for (i = 0; i < pixbuf_width(pixbuf); ++i)
+        {
+            real64_t v = (real64_t)i_channel(i_pixel_color(pixbuf, NULL, i, j), k);
+            real64_t q = (real64_t)i_channel(i_pixel_color(indexed, palette, i, j), k);
+            *mean += v;
+            *qmean += q;
+            *error += v > q ? v - q : q - v;
+        }
+    }
+
+    *mean /= n;
+    *qmean /= n;
+    *error /= n;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static pixformat_t i_index_format(const uint32_t ncolors)
+{
+    if (ncolors <= 2)
+        return ekINDEX1;
+    if (ncolors <= 4)
+        return ekINDEX2;
+    if (ncolors <= 16)
+        return ekINDEX4;
+    return ekINDEX8;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void test_quantize(void)
+{
+    const pixformat_t formats[] = { ekGRAY8, ekRGB24, ekRGBA32 };
+    const uint32_t ncolors[] = { 1, 2, 3, 4, 5, 16, 17, 200, 256 };
+    uint32_t seed = 5;
+    uint32_t i, j, d;
+
+    /* Exact palettes (hashed lookup): the size is the number of colors */
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+    {
+        for (j = 0; j < sizeof(ncolors) / sizeof(ncolors[0]); ++j)
+        {
+            for (d = 0; d < 2; ++d)
+            {
+                Pixbuf *pixbuf = i_few_colors(37, 29, formats[i], ncolors[j], &seed);
+                uint32_t n = ncolors[j] < 2 ? 2 : ncolors[j];
+                Palette *palette = NULL;
+                Pixbuf *indexed = pixbuf_quantize(pixbuf, n, (bool_t)d, &palette);
+                test_check(palette_size(palette) == ncolors[j]);
+                test_check(pixbuf_format(indexed) == i_index_format(ncolors[j]));
+                test_check(i_lossless(pixbuf, indexed, palette) == TRUE);
+                pixbuf_destroy(&indexed);
+                palette_destroy(&palette);
+
+                /* A palette bigger than needed is the same */
+                if (ncolors[j] < 256)
+                {
+                    indexed = pixbuf_quantize(pixbuf, 256, (bool_t)d, &palette);
+                    test_check(palette_size(palette) == ncolors[j]);
+                    test_check(i_lossless(pixbuf, indexed, palette) == TRUE);
+                    pixbuf_destroy(&indexed);
+                    palette_destroy(&palette);
+                }
+
+                pixbuf_destroy(&pixbuf);
+            }
+        }
+    }
+
+    /* One color more than allowed goes to median cut */
+    {
+        Pixbuf *pixbuf = i_few_colors(37, 29, ekRGB24, 17, &seed);
+        Palette *palette = NULL;
+        Pixbuf *indexed = pixbuf_quantize(pixbuf, 16, FALSE, &palette);
+        test_check(palette_size(palette) == 16);
+        test_check(pixbuf_format(indexed) == ekINDEX4);
+        test_check(i_lossless(pixbuf, indexed, palette) == FALSE);
+        pixbuf_destroy(&indexed);
+        palette_destroy(&palette);
+        pixbuf_destroy(&pixbuf);
+    }
+
+    /* Median cut, with and without dither */
+    for (j = 0; j < 3; ++j)
+    {
+        const uint32_t n = j == 0 ? 4 : (j == 1 ? 16 : 256);
+        /* Mean error per channel. Dithering adds noise, but keeps the mean color */
+        const real64_t maxerror = j == 0 ? 40 : (j == 1 ? 24 : 6);
+        Pixbuf *pixbuf = i_gradient(97, 61);
+        for (d = 0; d < 2; ++d)
+        {
+            Palette *palette = NULL;
+            Pixbuf *indexed = pixbuf_quantize(pixbuf, n, (bool_t)d, &palette);
+            uint32_t k, x, y;
+            bool_t ok = TRUE;
+            test_check(palette_size(palette) == n);
+            test_check(pixbuf_format(indexed) == i_index_format(n));
+            for (y = 0; y < pixbuf_height(indexed); ++y)
+            {
+                for (x = 0; x < pixbuf_width(indexed); ++x)
+                {
+                    if (pixbuf_get(indexed, x, y) >= n)
+                        ok = FALSE;
+                }
+            }
+
+            test_check(ok == TRUE);
+
+            for (k = 0; k < 3; ++k)
+            {
+                real64_t mean, qmean, error;
+                i_means(pixbuf, indexed, palette, k, &mean, &qmean, &error);
+                test_check(error < maxerror);
+                if (d == 1)
+                    test_check(qmean - mean < 1 && mean - qmean < 1);
+            }
+
+            pixbuf_destroy(&indexed);
+            palette_destroy(&palette);
+        }
+
+        pixbuf_destroy(&pixbuf);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static real64_t i_kernel(const resample_t filter, const real64_t x)
+{
+    real64_t ax = bmath_absd(x);
+    switch (filter) {
+    case ekRBOX:
+        return (x > -.5 && x <= .5) ? 1 : 0;
+    case ekRBILINEAR:
+        return ax < 1 ? 1 - ax : 0;
+    case ekRBICUBIC:
+        if (ax < 1)
+            return (1.5 * ax - 2.5) * ax * ax + 1;
+        if (ax < 2)
+            return ((-.5 * ax + 2.5) * ax - 4) * ax + 2;
+        return 0;
+    case ekRLANCZOS:
+        if (ax == 0)
+            return 1;
+        if (ax < 3)
+            return 3 * bmath_sind(kBMATH_PId * x) * bmath_sind(kBMATH_PId * x / 3) / (kBMATH_PId * kBMATH_PId * x * x);
+        return 0;
+    cassert_default();
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Scalar reference, one channel line in floating point. Windows are clipped at the edges */
+static void i_ref_line(const byte_t *src, const uint32_t isize, const uint32_t istep, byte_t *dest, const uint32_t osize, const uint32_t ostep, const resample_t filter)
+{
+    const real64_t support[] = { .5, 1, 2, 3 };
+    real64_t scale = (real64_t)isize / (real64_t)osize;
+    real64_t fscale = scale > 1 ? scale : 1;
+    real64_t sup = support[filter] * fscale;
+    uint32_t i;
+    for (i = 0; i < osize; ++i)
+    {
+        real64_t center = ((real64_t)i + .5) * scale;
+        int32_t xmin = (int32_t)bmath_floord(center - sup + .5);
+        int32_t xmax = (int32_t)bmath_floord(center + sup + .5);
+        real64_t total = 0, acc = 0, v;
+        int32_t x;
+        if (xmin < 0)
+            xmin = 0;
+        if (xmax > (int32_t)isize)
+            xmax = (int32_t)isize;
+
+        for (x = xmin; x < xmax; ++x)
+        {
+            real64_t w = i_kernel(filter, ((real64_t)x - center + .5) / fscale);
+            total += w;
+            acc += w * (real64_t)src[(uint32_t)x * istep];
+        }
+
+        v = bmath_floord(acc / total + .5);
+        dest[i * ostep] = (byte_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Horizontal pass, then vertical pass, both rounded to bytes as the resampler */
+static Pixbuf *i_ref_resample(const Pixbuf *pixbuf, const uint32_t width, const uint32_t height, const resample_t filter)
+{
+    uint32_t swidth = pixbuf_width(pixbuf), sheight = pixbuf_height(pixbuf);
+    uint32_t bpp = pixbuf_format_bpp(pixbuf_format(pixbuf)) / 8;
+    Pixbuf *tmp = pixbuf_create(width, sheight, pixbuf_format(pixbuf));
+    Pixbuf *dest = pixbuf_create(width, height, pixbuf_format(pixbuf));
+    const byte_t *src = pixbuf_cdata(pixbuf);
+    byte_t *tdata = pixbuf_data(tmp);
+    byte_t *ddata = pixbuf_data(dest);
+    uint32_t i, k;
+
+    for (i = 0; i < sheight; ++i)
+    {
+        for (k = 0; k < bpp; ++k)
+        {
+            if (swidth != width)
+                i_ref_line(src + i * swidth * bpp + k, swidth, bpp, tdata + i * width * bpp + k, width, bpp, filter);
+            else
+                bmem_copy(tdata + i * width * bpp, src + i * swidth * bpp, width * bpp);
+        }
+    }
+
+    for (i = 0; i < width * bpp; ++i)
+    {
+        if (sheight != height)
+            i_ref_line(tdata + i, sheight, width * bpp, ddata + i, height, width * bpp, filter);
+    }
+
+    if (sheight == height)
+        bmem_copy(ddata, tdata, width * height * bpp);
+
+    pixbuf_destroy(&tmp);
+    return dest;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Largest channel difference */
+static uint32_t i_max_diff(const Pixbuf *pixbuf1, const Pixbuf *pixbuf2, const uint32_t channel)
+{
+    uint32_t bpp = pixbuf_format_bpp(pixbuf_format(pixbuf1)) / 8;
+    uint32_t i, n = pixbuf_width(pixbuf1) * pixbuf_height(pixbuf1) * bpp;
+    const byte_t *data1 = pixbuf_cdata(pixbuf1);
+    const byte_t *data2 = pixbuf_cdata(pixbuf2);
+    uint32_t diff = 0;
+    for (i = 0; i < n; ++i)
+    {
+        if (channel == UINT32_MAX || i % bpp == channel)
+        {
+            uint32_t d = data1[i] > data2[i] ? data1[i] - data2[i] : data2[i] - data1[i];
+            if (d > diff)
+                diff = d;
+        }
+    }
+
+    return diff;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Opaque pixels. Random noise over a ramp, so windows don't hide errors */
+static Pixbuf *i_noisy_ramp(const uint32_t width, const uint32_t height, const pixformat_t format, const uint32_t alpha, uint32_t *seed)
+{
+    Pixbuf *pixbuf = pixbuf_create(width, height, format);
+    uint32_t bpp = pixbuf_format_bpp(format) / 8;
+    byte_t *data = pixbuf_data(pixbuf);
+    uint32_t i, j, k;
+    for (j = 0; j < height; ++j)
+    {
+        for (i = 0; i < width; ++i, data += bpp)
+        {
+            for (k = 0; k < bpp; ++k)
+            {
+                if (k == 3)
+                    data[k] = alpha == UINT32_MAX ? (byte_t)i_rand(seed) : (byte_t)alpha;
+                else
+                    data[k] = (byte_t)((i * 200) / width + i_rand(seed) % 56);
+            }
+        }
+    }
+
+    return pixbuf;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void test_resample(void)
+{
+    const pixformat_t formats[] = { ekGRAY8, ekRGB24, ekRGBA32 };
+    const resample_t filters[] = { ekRBOX, ekRBILINEAR, ekRBICUBIC, ekRLANCZOS };
+    /* Source and target sizes: up, down, mixed, one pixel, odd widths */
+    const uint32_t sizes[][4] = {
+        { 37, 23, 101, 7 },
+        { 64, 48, 17, 13 },
+        { 5, 5, 64, 3 },
+        { 1, 9, 7, 1 },
+        { 300, 2, 37, 5 },
+        { 33, 17, 33, 40 },
+        { 19, 31, 57, 31 } };
+    Pool *pool = bpool_create(3);
+    uint32_t seed = 11;
+    uint32_t i, j, f;
+
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+    {
+        for (j = 0; j < sizeof(sizes) / sizeof(sizes[0]); ++j)
+        {
+            Pixbuf *pixbuf = i_noisy_ramp(sizes[j][0], sizes[j][1], formats[i], 255, &seed);
+            for (f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f)
+            {
+                Pixbuf *resampled = pixbuf_resample(pixbuf, sizes[j][2], sizes[j][3], filters[f], NULL);
+                Pixbuf *presampled = pixbuf_resample(pixbuf, sizes[j][2], sizes[j][3], filters[f], pool);
+                Pixbuf *ref = i_ref_resample(pixbuf, sizes[j][2], sizes[j][3], filters[f]);
+                test_check(pixbuf_format(resampled) == formats[i]);
+                test_check(pixbuf_width(resampled) == sizes[j][2] && pixbuf_height(resampled) == sizes[j][3]);
+                /* Fixed point weights round differently than doubles */
+                test_check(i_max_diff(resampled, ref, UINT32_MAX) <= 1);
+                /* Parallel rows are the same */
+                test_check(bmem_cmp(pixbuf_cdata(resampled), pixbuf_cdata(presampled), pixbuf_dsize(resampled)) == 0);
+                pixbuf_destroy(&resampled);
+                pixbuf_destroy(&presampled);
+                pixbuf_destroy(&ref);
+            }
+
+            pixbuf_destroy(&pixbuf);
+        }
+    }
+
+    /* Flat images stay flat, edge pixels included. Translucent colors round trip the premultiply */
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]) + 1; ++i)
+    {
+        pixformat_t format = i < sizeof(formats) / sizeof(formats[0]) ? formats[i] : ekRGBA32;
+        byte_t alpha = i < sizeof(formats) / sizeof(formats[0]) ? 255 : 77;
+        uint32_t bpp = pixbuf_format_bpp(format) / 8;
+        for (j = 0; j < sizeof(sizes) / sizeof(sizes[0]); ++j)
+        {
+            Pixbuf *pixbuf = pixbuf_create(sizes[j][0], sizes[j][1], format);
+            byte_t *data = pixbuf_data(pixbuf);
+            uint32_t k, n = pixbuf_dsize(pixbuf);
+            for (k = 0; k < n; ++k)
+                data[k] = (bpp == 4 && k % 4 == 3) ? alpha : 201;
+
+            for (f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f)
+            {
+                Pixbuf *resampled = pixbuf_resample(pixbuf, sizes[j][2], sizes[j][3], filters[f], pool);
+                const byte_t *rdata = pixbuf_cdata(resampled);
+                bool_t flat = TRUE;
+                n = pixbuf_dsize(resampled);
+                for (k = 0; k < n; ++k)
+                {
+                    if (bpp == 4 && k % 4 == 3)
+                    {
+                        if (rdata[k] != alpha)
+                            flat = FALSE;
+                    }
+                    else if (alpha == 255)
+                    {
+                        if (rdata[k] != 201)
+                            flat = FALSE;
+                    }
+                    else if (rdata[k] < 200 || rdata[k] > 202)
+                    {
+                        flat = FALSE;
+                    }
+                }
+
+                test_check(flat == TRUE);
+                pixbuf_destroy(&resampled);
+            }
+
+            pixbuf_destroy(&pixbuf);
+        }
+    }
+
+    /* Alpha is resampled as is, color goes premultiplied */
+    for (j = 0; j < sizeof(sizes) / sizeof(sizes[0]); ++j)
+    {
+        Pixbuf *pixbuf = i_noisy_ramp(sizes[j][0], sizes[j][1], ekRGBA32, UINT32_MAX, &seed);
+        Pixbuf *clear = i_noisy_ramp(sizes[j][0], sizes[j][1], ekRGBA32, 0, &seed);
+        for (f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f)
+        {
+            Pixbuf *resampled = pixbuf_resample(pixbuf, sizes[j][2], sizes[j][3], filters[f], pool);
+            Pixbuf *ref = i_ref_resample(pixbuf, sizes[j][2], sizes[j][3], filters[f]);
+            Pixbuf *rclear = pixbuf_resample(clear, sizes[j][2], sizes[j][3], filters[f], pool);
+            test_check(i_max_diff(resampled, ref, 3) <= 1);
+            /* Fully transparent stays transparent */
+            {
+                const byte_t *data = pixbuf_cdata(rclear);
+                uint32_t k, n = pixbuf_width(rclear) * pixbuf_height(rclear);
+                bool_t transparent = TRUE;
+                for (k = 0; k < n; ++k)
+                {
+                    if (data[k * 4 + 3] != 0)
+                        transparent = FALSE;
+                }
+
+                test_check(transparent == TRUE);
+            }
+
+            pixbuf_destroy(&resampled);
+            pixbuf_destroy(&ref);
+            pixbuf_destroy(&rclear);
+        }
+
+        pixbuf_destroy(&pixbuf);
+        pixbuf_destroy(&clear);
+    }
+
+    bpool_destroy(&pool);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_cached(ExtCache *cache, const char_t *text, const real32_t width)
+{
+    real32_t w = -1, h = -1;
+    if (extcache_get(cache, 0, 0, 12, text, -1, &w, &h) == TRUE)
+        return (bool_t)(w == width && h == 2 * width);
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_add(ExtCache *cache, const char_t *text, const real32_t width)
+{
+    extcache_add(cache, 0, 0, 12, text, -1, width, 2 * width);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void test_extcache(void)
+{
+    /* Hits, misses and recency */
+    {
+        ExtCache *cache = extcache_create(4);
+        uint32_t hits = 0, misses = 0;
+        real32_t w = -1, h = -1;
+        test_check(i_cached(cache, "a", 1) == FALSE);
+        i_add(cache, "a", 1);
+        i_add(cache, "b", 2);
+        i_add(cache, "c", 3);
+        i_add(cache, "d", 4);
+        test_check(extcache_size(cache) == 4);
+        test_check(i_cached(cache, "b", 2) == TRUE);
+        test_check(i_cached(cache, "c", 3) == TRUE);
+        test_check(i_cached(cache, "d", 4) == TRUE);
+        test_check(i_cached(cache, "a", 1) == TRUE);
+
+        /* 'b' is the least recently used */
+        i_add(cache, "e", 5);
+        test_check(extcache_size(cache) == 4);
+        test_check(i_cached(cache, "b", 2) == FALSE);
+        i_add(cache, "b", 6);
+        test_check(i_cached(cache, "c", 3) == FALSE);
+        test_check(i_cached(cache, "d", 4) == TRUE);
+        test_check(i_cached(cache, "a", 1) == TRUE);
+        test_check(i_cached(cache, "e", 5) == TRUE);
+        test_check(i_cached(cache, "b", 6) == TRUE);
+
+        /* Re-adding updates the entry in place */
+        i_add(cache, "d", 7);
+        test_check(extcache_size(cache) == 4);
+        test_check(i_cached(cache, "d", 7) == TRUE);
+
+        /* Font attributes and refwidth are part of the key. Any negative refwidth is the same */
+        extcache_add(cache, 0, 0, 12, "a", 100, 8, 9);
+        test_check(extcache_get(cache, 0, 0, 12, "a", 100, &w, &h) == TRUE && w == 8 && h == 9);
+        test_check(extcache_get(cache, 0, 0, 12, "a", -5, &w, &h) == FALSE);
+        test_check(extcache_get(cache, 1, 0, 12, "d", -1, NULL, NULL) == FALSE);
+        test_check(extcache_get(cache, 0, 1, 12, "d", -1, NULL, NULL) == FALSE);
+        test_check(extcache_get(cache, 0, 0, 13, "d", -1, NULL, NULL) == FALSE);
+        test_check(extcache_get(cache, 0, 0, 12, "d", -3, NULL, NULL) == TRUE);
+
+        /* Empty text is cached as any other */
+        i_add(cache, "", 10);
+        test_check(i_cached(cache, "", 10) == TRUE);
+
+        extcache_stats(cache, &hits, &misses);
+        test_check(hits == 12 && misses == 7);
+        extcache_destroy(&cache);
+    }
+
+    /* Capacity. Only the last added survive a sequential scan */
+    {
+        ExtCache *cache = extcache_create(100);
+        char_t text[32];
+        uint32_t i, nhits = 0;
+        for (i = 0; i < 1000; ++i)
+        {
+            bstd_sprintf(text, sizeof(text), "text %u", i);
+            i_add(cache, text, (real32_t)i);
+            test_check(extcache_size(cache) == (i < 100 ? i + 1 : 100));
+        }
+
+        for (i = 0; i < 1000; ++i)
+        {
+            bool_t hit;
+            bstd_sprintf(text, sizeof(text), "text %u", i);
+            hit = i_cached(cache, text, (real32_t)i);
+            test_check(hit == (bool_t)(i >= 900));
+            if (hit == TRUE)
+                nhits += 1;
+        }
+
+        test_check(nhits == 100);
+        extcache_destroy(&cache);
+    }
+}
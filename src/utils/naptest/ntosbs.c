@@ -0,0 +1,276 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: ntosbs.c
+ *
+ */
+
+/* osbs library tests */
+
+#include "naptest.h"
+#include "bsocket.h"
+#include "bpool.h"
+#include "heap.h"
+#include "bmem.h"
+#include "cassert.h"
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_wait(SocketPoll *poll, Socket *socket, const uint32_t events)
+{
+    SocketEvent ev[4];
+    uint32_t i, n = 0, flags = 0;
+    serror_t error = ENUM_MAX(serror_t);
+    n = bsocket_poll_wait(poll, ev, 4, 5000, &error);
+    test_check(n > 0 && error == ekSOK);
+    for (i = 0; i < n; ++i)
+    {
+        if (ev[i].socket == socket)
+        {
+            test_check(ev[i].data == (void*)socket);
+            flags |= ev[i].events;
+        }
+    }
+
+    return flags & events;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Non-blocking sockets on loopback */
+void test_socket_poll(void)
+{
+    Socket *server = NULL, *client = NULL, *peer = NULL;
+    SocketPoll *poll = NULL;
+    SocketEvent ev[4];
+    serror_t error = ENUM_MAX(serror_t);
+    byte_t data[1024];
+    uint32_t size = 0, total = 0;
+    uint16_t port = 0;
+
+    /* Existing values must keep their number */
+    test_check(ekSUNDEF == 5 && ekSOK == 6 && ekSAGAIN == 7);
+
+    server = bsocket_server(0, 4, NULL);
+    test_check(server != NULL);
+    if (server == NULL)
+        return;
+
+    bsocket_local_ip(server, NULL, &port);
+    bsocket_nonblock(server, TRUE);
+    test_check(bsocket_accept_nonblock(server, &error) == NULL && error == ekSAGAIN);
+
+    poll = bsocket_poll_create(&error);
+    test_check(poll != NULL && error == ekSOK);
+    if (poll == NULL)
+    {
+        bsocket_close(&server);
+        return;
+    }
+
+    /* Nothing registered or ready: the wait times out */
+    test_check(bsocket_poll_wait(poll, ev, 4, 10, &error) == 0 && error == ekSTIMEOUT);
+
+    test_check(bsocket_poll_add(poll, server, ekSOCK_READ, server) == TRUE);
+    client = bsocket_connect(bsocket_str_ip("127.0.0.1"), port, 5000, &error);
+    test_check(client != NULL && error == ekSOK);
+    if (client != NULL)
+    {
+        test_check(i_wait(poll, server, ekSOCK_READ) == ekSOCK_READ);
+        peer = bsocket_accept_nonblock(server, &error);
+        test_check(peer != NULL && error == ekSOK);
+    }
+
+    if (peer != NULL)
+    {
+        bsocket_nonblock(client, TRUE);
+        bsocket_poll_remove(poll, server);
+
+        /* No data yet */
+        test_check(bsocket_recv(peer, data, sizeof(data), &size, &error) == FALSE && size == 0 && error == ekSAGAIN);
+
+        /* Writable client */
+        test_check(bsocket_poll_add(poll, client, ekSOCK_WRITE, client) == TRUE);
+        test_check(i_wait(poll, client, ekSOCK_WRITE) == ekSOCK_WRITE);
+        bsocket_poll_remove(poll, client);
+
+        /* Readable peer */
+        test_check(bsocket_poll_add(poll, peer, ekSOCK_READ, peer) == TRUE);
+        test_check(bsocket_send(client, (const byte_t*)"ping", 4, &size, &error) == TRUE && size == 4 && error == ekSOK);
+        test_check(i_wait(poll, peer, ekSOCK_READ) == ekSOCK_READ);
+        test_check(bsocket_recv(peer, data, sizeof(data), &size, &error) == TRUE && size == 4 && error == ekSOK);
+        test_check(bmem_cmp(data, (const byte_t*)"ping", 4) == 0);
+
+        /* Fill the socket buffers until the send would block */
+        bmem_set1(data, sizeof(data), 'x');
+        for (;;)
+        {
+            if (bsocket_send(client, data, sizeof(data), &size, &error) == FALSE)
+                break;
+            total += size;
+            if (total > 64 * 1024 * 1024)
+                break;
+        }
+
+        test_check(error == ekSAGAIN && size == 0);
+
+        /* Drained data makes the client writable again */
+        while (total > 0)
+        {
+            if (i_wait(poll, peer, ekSOCK_READ) != ekSOCK_READ)
+                break;
+
+            while (bsocket_recv(peer, data, sizeof(data), &size, &error) == TRUE && size > 0)
+            {
+                cassert(size <= total);
+                total -= size;
+            }
+
+            if (error != ekSOK && error != ekSAGAIN)
+                break;
+        }
+
+        test_check(total == 0);
+
+        bsocket_poll_remove(poll, peer);
+        test_check(bsocket_poll_add(poll, client, ekSOCK_WRITE, client) == TRUE);
+        test_check(i_wait(poll, client, ekSOCK_WRITE) == ekSOCK_WRITE);
+        bsocket_poll_remove(poll, client);
+        bsocket_close(&peer);
+    }
+
+    if (client != NULL)
+        bsocket_close(&client);
+
+    bsocket_poll_destroy(&poll);
+    bsocket_close(&server);
+}
+
+/*---------------------------------------------------------------------------*/
+
+typedef struct _ptest_t i_PTest;
+
+struct _ptest_t
+{
+    Pool *pool;
+    uint32_t *hits;
+    uint32_t range;
+    uint32_t grain;
+};
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_job(uint32_t *hit)
+{
+    *hit += 1;
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_for(i_PTest *test, const uint32_t st, const uint32_t ed)
+{
+    uint32_t i;
+    cassert(st < ed && ed <= test->range);
+    for (i = st; i < ed; ++i)
+        test->hits[i] += 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Each outer iteration runs an inner loop over its own block */
+static void i_nested(i_PTest *test, const uint32_t st, const uint32_t ed)
+{
+    uint32_t i;
+    for (i = st; i < ed; ++i)
+    {
+        i_PTest inner;
+        inner.pool = test->pool;
+        inner.hits = test->hits + i * test->grain;
+        inner.range = test->grain;
+        inner.grain = 0;
+        bparallel_for(test->pool, inner.range, 7, i_for, &inner, i_PTest);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Every index is visited once */
+static bool_t i_pfor(Pool *pool, const uint32_t range, const uint32_t grain)
+{
+    i_PTest test;
+    uint32_t i;
+    bool_t ok = TRUE;
+    test.pool = pool;
+    test.hits = heap_new_n0(range + 1, uint32_t);
+    test.range = range;
+    test.grain = grain;
+    bparallel_for(pool, range, grain, i_for, &test, i_PTest);
+    for (i = 0; i < range; ++i)
+    {
+        if (test.hits[i] != 1)
+            ok = FALSE;
+    }
+
+    heap_delete_n(&test.hits, range + 1, uint32_t);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void test_pool(void)
+{
+    const uint32_t ranges[] = { 0, 1, 2, 13, 1000, 100003 };
+    const uint32_t grains[] = { 0, 1, 7, 1000 };
+    Pool *pool = bpool_create(4);
+    uint32_t i, j;
+    test_check(bpool_nthreads(pool) == 4);
+
+    /* More jobs than queue cells: the caller runs jobs while the queue is full */
+    {
+        uint32_t n = 10000;
+        uint32_t *hits = heap_new_n0(n, uint32_t);
+        Pool *lpool = bpool_create(2);
+        for (i = 0; i < n; ++i)
+            bpool_add(lpool, i_job, &hits[i], uint32_t);
+
+        /* Pending jobs are done before destroy returns */
+        bpool_destroy(&lpool);
+        for (i = 0; i < n; ++i)
+            test_check(hits[i] == 1);
+        heap_delete_n(&hits, n, uint32_t);
+    }
+
+    /* Automatic (0) and explicit grain, with and without pool */
+    for (i = 0; i < sizeof(ranges) / sizeof(uint32_t); ++i)
+    {
+        for (j = 0; j < sizeof(grains) / sizeof(uint32_t); ++j)
+        {
+            test_check(i_pfor(pool, ranges[i], grains[j]) == TRUE);
+            test_check(i_pfor(NULL, ranges[i], grains[j]) == TRUE);
+        }
+    }
+
+    /* Nested loops, more outer iterations than workers. With one worker,
+       it waits for inner helpers queued behind the outer ones */
+    for (i = 1; i <= 4; i *= 4)
+    {
+        Pool *lpool = bpool_create(i);
+        i_PTest test;
+        uint32_t outer = 32, block = 500;
+        test.pool = lpool;
+        test.hits = heap_new_n0(outer * block, uint32_t);
+        test.range = outer;
+        test.grain = block;
+        bparallel_for(lpool, outer, 1, i_nested, &test, i_PTest);
+        for (j = 0; j < outer * block; ++j)
+            test_check(test.hits[j] == 1);
+        heap_delete_n(&test.hits, outer * block, uint32_t);
+        bpool_destroy(&lpool);
+    }
+
+    bpool_destroy(&pool);
+}
@@ -0,0 +1,103 @@
+/*
+ * NAppGUI Cross-platform C SDK
+ * 2015-2022 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: pixbench.c
+ *
+ */
+
+/* Pixel format conversion throughput */
+
+#include "coreall.h"
+#include "draw2dall.h"
+
+static const char_t *i_NAMES[] = {
+    "INDEX1",
+    "INDEX2",
+    "INDEX4",
+    "INDEX8",
+    "GRAY8",
+    "RGB24",
+    "RGBA32"
+};
+
+/*---------------------------------------------------------------------------*/
+
+static Pixbuf *i_pixbuf(const uint32_t width, const uint32_t height, const pixformat_t format)
+{
+    Pixbuf *pixbuf = pixbuf_create(width, height, format);
+    byte_t *data = pixbuf_data(pixbuf);
+    uint32_t i, n = pixbuf_dsize(pixbuf);
+    uint32_t seed = 1;
+
+    /* Runs of equal pixels, as in real images */
+    for (i = 0; i < n; ++i)
+    {
+        if (i % 64 == 0)
+            seed = seed * 1103515245 + 12345;
+        data[i] = (byte_t)(seed >> (8 + (i % 3)));
+    }
+
+    return pixbuf;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static real64_t i_mps(const uint32_t pixels, const uint64_t micros)
+{
+    return ((real64_t)pixels / 1000000.) / ((real64_t)(micros > 0 ? micros : 1) / 1000000.);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_bench(const Pixbuf *pixbuf, const pixformat_t oformat, const uint32_t reps)
+{
+    uint64_t best = UINT64_MAX;
+    uint32_t i;
+
+    for (i = 0; i < reps; ++i)
+    {
+        uint64_t t = btime_now();
+        Pixbuf *npixbuf = pixbuf_convert(pixbuf, NULL, oformat);
+        t = btime_now() - t;
+        pixbuf_destroy(&npixbuf);
+        if (t < best)
+            best = t;
+    }
+
+    bstd_printf("%-8s -> %-8s %10.1f ms %10.1f MP/s\n", i_NAMES[pixbuf_format(pixbuf)], i_NAMES[oformat], (real64_t)best / 1000., i_mps(pixbuf_size(pixbuf), best));
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    uint32_t size = 2048, reps = 5;
+    uint32_t i, j;
+
+    draw2d_start();
+
+    if (argc > 1)
+        size = str_to_u32(argv[1], 10, NULL);
+    if (argc > 2)
+        reps = str_to_u32(argv[2], 10, NULL);
+
+    bstd_printf("Pixbuf %ux%u, best of %u\n", size, size, reps);
+
+    for (i = 0; i <= (uint32_t)ekRGBA32; ++i)
+    {
+        Pixbuf *pixbuf = i_pixbuf(size, size, (pixformat_t)i);
+        for (j = 0; j <= (uint32_t)ekRGBA32; ++j)
+        {
+            if (i != j)
+                i_bench(pixbuf, (pixformat_t)j, reps);
+        }
+
+        pixbuf_destroy(&pixbuf);
+    }
+
+    draw2d_finish();
+    return 0;
+}